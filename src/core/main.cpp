@@ -73,7 +73,9 @@ void help()
 	logit_s << "--update-amps <us_amp>,<ds_amp>: Updates upstream and downstream amps if they changed inbetween scans.\n";
 	logit_s << "--update-quant-amps <us_amp>,<ds_amp>: Updates upstream and downstream amps for quantification if they changed inbetween scans.\n";
     logit_s<<"--quick-and-dirty : Integrate the detector range into 1 spectra.\n";
-//	logit_s<< "--mem-limit <limit> : Limit the memory usage. Append M for megabytes or G for gigabytes\n";
+    logit_s<< "--mem-limit <limit> : Limit the memory usage. Append M for megabytes or G for gigabytes. Larger spectra volumes are mapped from a scratch file in img.dat\n";
+    logit_s<< "--peak-window-tol <tol> : Peak, step and tail terms are only evaluated where they are above tol relative to their maximum. Default " << DEFAULT_PEAK_WINDOW_TOLERANCE << ", 0 evaluates every channel\n";
+    logit_s<< "--h5-compression <filter[:level]> : Compression for analyzed h5 datasets. none, deflate, shuffle-deflate, lz4 (no level) or zstd (need their hdf5 plugin). Default shuffle-deflate:4, about 5x smaller than none on mca_arr but a viewer reading a single pixel spectrum pays about 1.0 ms instead of 0.08 ms. Use none for files that are browsed pixel by pixel\n";
     logit_s<<"--optimize-fit-override-params : <int> Integrate the 8 largest mda datasets and fit with multiple params.\n"<<
                "  1 = matrix batch fit\n  2 = batch fit without tails\n  3 = batch fit with tails\n  4 = batch fit with free E, everything else fixed \n";
     logit_s<<"--optimize-fit-routine : <general,hybrid> General (default): passes elements amplitudes as fit parameters. Hybrid only passes fit parameters and fits element amplitudes using NNLS\n";
@@ -87,7 +89,8 @@ void help()
     logit_s<<"  roi_plus : SVD method \n";
     logit_s<<"  nnls : Non-Negative Least Squares \n";
     logit_s<<"  tails : Fit with multiple parameters \n";
-    logit_s<<"  matrix : Fit with locked parameters \n\n";
+    logit_s<<"  matrix : Fit with locked parameters \n";
+    logit_s<<"--warm-start : Start each pixel's nnls / tails fit from the previous pixel's solution. Falls back to a cold start if it diverges \n\n";
     logit_s<<"Dataset: "<<"\n";
     logit_s<<"--dir : Dataset directory \n";
     logit_s<<"--files : Dataset files: comma (',') separated if multiple \n";
@@ -182,19 +185,66 @@ void set_mem_limit(Command_Line_Parser& clp, data_struct::Analysis_Job<T_real>&
     if (clp.option_exists("--mem-limit"))
     {
         std::string memlimit = clp.get_option("--mem-limit");
-        if (memlimit.rfind('M'))
+        long long multiplier = 0;
+        if (memlimit.length() > 1 && (memlimit.back() == 'M' || memlimit.back() == 'm'))
         {
-
+            multiplier = 1024LL * 1024LL;
         }
-        else if (memlimit.rfind('G'))
+        else if (memlimit.length() > 1 && (memlimit.back() == 'G' || memlimit.back() == 'g'))
         {
+            multiplier = 1024LL * 1024LL * 1024LL;
+        }
 
+        if (multiplier > 0 && memlimit.find_first_not_of("0123456789") == memlimit.length() - 1)
+        {
+            analysis_job.mem_limit = std::stoll(memlimit.substr(0, memlimit.length() - 1)) * multiplier;
+            logI << "Memory limit " << analysis_job.mem_limit << " bytes\n";
         }
         else
         {
             logW << "Could not parse --mem-limit parameter. Make sure to use M for megabytes or G for gigabytes. ex 200M\n";
         }
-        //analysis_job.mem_limit = ;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+template <typename T_real>
+void set_peak_window_tolerance(Command_Line_Parser& clp, data_struct::Analysis_Job<T_real>& analysis_job)
+{
+    if (clp.option_exists("--peak-window-tol"))
+    {
+        std::string tol_str = clp.get_option("--peak-window-tol");
+        char* end = nullptr;
+        double tol = std::strtod(tol_str.c_str(), &end);
+        if (tol_str.length() > 0 && end != nullptr && *end == '\0' && tol >= 0.0 && tol < 1.0)
+        {
+            analysis_job.peak_window_tolerance = (T_real)tol;
+            logI << "Peak window tolerance " << analysis_job.peak_window_tolerance << "\n";
+        }
+        else
+        {
+            logW << "Could not parse --peak-window-tol parameter. Needs to be in [0, 1), ex 1e-7\n";
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+void set_h5_layout(Command_Line_Parser& clp)
+{
+    if (clp.option_exists("--h5-compression"))
+    {
+        io::file::H5_Layout_Policy policy = io::file::HDF5_IO::inst()->layout_policy();
+        if (policy.parse(clp.get_option("--h5-compression")))
+        {
+            logI << "Analyzed h5 compression " << policy.to_string() << "\n";
+            io::file::HDF5_IO::inst()->set_layout_policy(policy);
+        }
+        else
+        {
+            logW << "Could not parse --h5-compression parameter. ex shuffle-deflate:4 or zstd:3\n";
+        }
     }
 }
 
@@ -338,6 +388,12 @@ void set_fit_routines(Command_Line_Parser& clp, data_struct::Analysis_Job<T_real
             }
         }
     }
+
+    //Start each pixel from its neighbor's fit
+    if (clp.option_exists("--warm-start"))
+    {
+        analysis_job.neighbor_warm_start = true;
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -701,6 +757,8 @@ int run_fits(Command_Line_Parser& clp)
     }
     set_fit_routines(clp, analysis_job);
     set_mem_limit(clp, analysis_job);
+    set_peak_window_tolerance(clp, analysis_job);
+    set_h5_layout(clp);
 
 
     //Should we sum up all the detectors and process it as one?
@@ -741,7 +799,10 @@ int run_fits(Command_Line_Parser& clp)
         
         if (analysis_job.fitting_routines.size() > 0)
         {
-            process_dataset_files(&analysis_job);
+            if (false == process_dataset_files(&analysis_job))
+            {
+                return -1;
+            }
             analysis_job.generate_average_h5 = true;
         }
         else
@@ -886,6 +947,7 @@ int main(int argc, char* argv[])
     }
 
     Command_Line_Parser clp(argc, argv);
+    bool fits_ok = true;
 
     if (clp.option_exists("-h"))
     {
@@ -904,7 +966,7 @@ int main(int argc, char* argv[])
     }
     else if (clp.option_exists("--fit") )
     {
-        run_fits(clp);
+        fits_ok = (run_fits(clp) == 0);
     }
 
     if (clp.option_exists("--quantify-with"))
@@ -924,7 +986,11 @@ int main(int argc, char* argv[])
     logI << "=-=-=-=-=-=- Total elapsed time: " << elapsed_seconds.count() << "s =-=-=-=-=-=-=-\n" << std::endl; //endl will flush the print.
 
 
+    // run and check the writes still queued before exit tears anything down
+    bool saved = io::file::HDF5_Writer::inst()->shutdown();
+
     data_struct::Element_Info_Map<float>::inst()->clear();
     data_struct::Element_Info_Map<double>::inst()->clear();
 
+    return (saved && fits_ok) ? 0 : -1;
 }
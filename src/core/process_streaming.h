@@ -48,6 +48,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef PROCESS_STREAMING_H
 #define PROCESS_STREAMING_H
 
+#include <memory>
+
 #include "core/defines.h"
 #include "data_struct/analysis_job.h"
 #include "data_struct/stream_block.h"
@@ -64,16 +66,31 @@ template<typename T_real>
 DLL_EXPORT data_struct::Stream_Block<T_real>* proc_spectra_block( data_struct::Stream_Block<T_real>* stream_block )
 {
 
+    // blocks of a run share elements_to_fit, so each worker resolves the result slots once. Reuse is decided on
+    // the element names, a new run's dict can land on the address of the last one
+    thread_local std::unique_ptr<data_struct::Fit_Result_Layout<T_real> > layout;
+    thread_local std::vector<T_real> pixel_results;
+    if (layout == nullptr || false == layout->same_elements(stream_block->elements_to_fit))
+    {
+        layout.reset(new data_struct::Fit_Result_Layout<T_real>(stream_block->elements_to_fit));
+    }
+    else
+    {
+        layout->rebind(stream_block->elements_to_fit);
+    }
+    const std::vector<const data_struct::Spectra<T_real>*> batch = { stream_block->spectra };
+    const T_real livetime = stream_block->spectra->elapsed_livetime();
+
     for (auto& itr : stream_block->fitting_blocks)
     {
-        std::unordered_map<std::string, T_real> counts_dict;
-        stream_block->fitting_blocks[itr.first].fit_routine->fit_spectra(stream_block->model, stream_block->spectra, stream_block->elements_to_fit, counts_dict);
+        pixel_results.assign(layout->size(), (T_real)0.0);
+        itr.second.fit_routine->fit_spectra_batch(stream_block->model, batch, *layout, pixel_results.data());
         //make count / sec
-        for (auto& el_itr : *(stream_block->elements_to_fit))
+        for (size_t s = 0; s < layout->num_elements(); s++)
         {
-            stream_block->fitting_blocks[itr.first].fit_counts[el_itr.first] = counts_dict[el_itr.first] / stream_block->spectra->elapsed_livetime();
+            itr.second.fit_counts[layout->name(s)] = pixel_results[s] / livetime;
         }
-        stream_block->fitting_blocks[itr.first].fit_counts[STR_NUM_ITR] = counts_dict[STR_NUM_ITR];
+        itr.second.fit_counts[STR_NUM_ITR] = pixel_results[layout->num_iter_slot()];
     }
     return stream_block;
 }
@@ -49,6 +49,63 @@ POSSIBILITY OF SUCH DAMAGE.
 
 using namespace std::placeholders; //for _1, _2,
 
+// ----------------------------------------------------------------------------
+
+size_t fit_tile_size(data_struct::Fitting_Routines routine, size_t num_pixels, size_t num_threads)
+{
+    // smallest tile worth a task and how many tiles each thread should get to even out the load
+    size_t min_tile = 1;
+    size_t tiles_per_thread = 16;
+    switch (routine)
+    {
+        case data_struct::Fitting_Routines::ROI:
+            min_tile = 4096;
+            tiles_per_thread = 4;
+            break;
+        case data_struct::Fitting_Routines::SVD:
+        case data_struct::Fitting_Routines::NNLS:
+            min_tile = 256;
+            tiles_per_thread = 8;
+            break;
+        case data_struct::Fitting_Routines::GAUSS_MATRIX:
+            min_tile = FIT_TILE_BATCH_SIZE;
+            tiles_per_thread = 16;
+            break;
+        case data_struct::Fitting_Routines::GAUSS_TAILS:
+            min_tile = 1;
+            tiles_per_thread = 32;
+            break;
+    }
+
+    size_t num_tiles = std::max(num_threads, (size_t)1) * tiles_per_thread;
+    size_t tile_size = (num_pixels + num_tiles - 1) / num_tiles;
+    return std::max(tile_size, min_tile);
+}
+
+// ----------------------------------------------------------------------------
+
+void wait_for_fit_job(std::future<void>& fit_job, const std::atomic<size_t>& pixels_done, size_t total_pixels, Callback_Func_Status_Def* status_callback)
+{
+    size_t total_blocks = total_pixels - 1;
+    size_t reported = 0;
+    while (fit_job.wait_for(std::chrono::milliseconds(FIT_PROGRESS_INTERVAL_MS)) != std::future_status::ready)
+    {
+        size_t done = pixels_done.load(std::memory_order_relaxed);
+        if (status_callback != nullptr && done > reported)
+        {
+            (*status_callback)(done - 1, total_blocks);
+            reported = done;
+        }
+    }
+    fit_job.get();
+    // the job may be one block of rows, only report what is actually done
+    size_t done = pixels_done.load(std::memory_order_relaxed);
+    if (status_callback != nullptr && done > reported)
+    {
+        (*status_callback)(done - 1, total_blocks);
+    }
+}
+
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
 
@@ -397,11 +454,13 @@ void load_and_fit_quatification_datasets(data_struct::Analysis_Job<double>* anal
                     full_path += std::to_string(detector_num);
                 }
                 logI << full_path << "\n";
+                data_struct::ArrayTr<double> fitted_spectra = f_routine->fitted_integrated_spectra();
+                data_struct::ArrayTr<double> fitted_background = f_routine->fitted_integrated_background();
                 #ifdef _BUILD_WITH_QT
-                visual::SavePlotSpectrasFromConsole(full_path + ".png", &ev, &sub_spectra, (ArrayTr<double>*)(&f_routine->fitted_integrated_spectra()), (ArrayTr<double>*)(&f_routine->fitted_integrated_background()), true);
+                visual::SavePlotSpectrasFromConsole(full_path + ".png", &ev, &sub_spectra, &fitted_spectra, &fitted_background, true);
                 #endif
 
-                io::file::csv::save_fit_and_int_spectra(full_path + ".csv", &ev, &sub_spectra, (ArrayTr<double>*)(&f_routine->fitted_integrated_spectra()), (ArrayTr<double>*)(&f_routine->fitted_integrated_background()));
+                io::file::csv::save_fit_and_int_spectra(full_path + ".csv", &ev, &sub_spectra, &fitted_spectra, &fitted_background);
             }
 
             detector->update_element_quants(fit_itr.first, STR_SR_CURRENT, quantification_standard, &quantification_model, quantification_standard->sr_current);
@@ -503,13 +562,14 @@ bool perform_quantification(data_struct::Analysis_Job<double>* analysis_job, boo
                 data_struct::Detector<double>* detector = analysis_job->get_detector(detector_num);
                 std::string str_detector_num = std::to_string(detector_num);
                 std::string full_save_path = analysis_job->dataset_directory + DIR_END_CHAR + "img.dat" + DIR_END_CHAR + dataset_file + ".h5" + str_detector_num;
-                if (io::file::HDF5_IO::inst()->start_save_seq(full_save_path, false, true))
+                io::file::H5_Session session(full_save_path);
+                if (session.open(false, true))
                 {
-                    if (false == io::file::HDF5_IO::inst()->save_quantification(detector))
+                    if (false == session.save_quantification(detector))
                     {
                         logE << "Error saving quantification to hdf5\n";
                     }
-                    io::file::HDF5_IO::inst()->end_save_seq();
+                    session.close();
                 }
             }
         }
@@ -50,7 +50,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #define PROCESS_WHOLE
 
 #include <iostream>
+#include <atomic>
 #include <queue>
+#include <deque>
+#include <memory>
 #include <string>
 #include <array>
 #include <vector>
@@ -72,11 +75,14 @@ POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 #include "core/defines.h"
+#include "core/mem_info.h"
 
 #include "workflow/threadpool.h"
 
 #include "io/file/hl_file_io.h"
 #include "io/file/mca_io.h"
+#include "io/file/hdf5_writer.h"
+#include "io/file/hdf5_session.h"
 
 #include "data_struct/spectra_volume.h"
 
@@ -104,6 +110,11 @@ POSSIBILITY OF SUCH DAMAGE.
 
 using namespace std::placeholders; //for _1, _2,
 
+// number of spectra handed to fit_spectra_batch at a time inside a tile
+#define FIT_TILE_BATCH_SIZE 64
+// how often proc_spectra wakes up to report progress while tiles are running
+#define FIT_PROGRESS_INTERVAL_MS 50
+
 
 // ----------------------------------------------------------------------------
 
@@ -123,6 +134,18 @@ void optimize_single_roi(data_struct::Analysis_Job<double>& analysis_job, std::s
 
 DLL_EXPORT void optimize_rois(data_struct::Analysis_Job<double>& analysis_job);
 
+/**
+ * @brief fit_tile_size : Number of pixels per scheduled tile. Cheap routines get large tiles so scheduling cost
+ *                        disappears, iterative routines get smaller ones so threads stay balanced.
+ */
+DLL_EXPORT size_t fit_tile_size(data_struct::Fitting_Routines routine, size_t num_pixels, size_t num_threads);
+
+/**
+ * @brief wait_for_fit_job : Block until fit_job is done, reporting progress from the pixel counter every
+ *                           FIT_PROGRESS_INTERVAL_MS.
+ */
+DLL_EXPORT void wait_for_fit_job(std::future<void>& fit_job, const std::atomic<size_t>& pixels_done, size_t total_pixels, Callback_Func_Status_Def* status_callback);
+
 // ----------------------------------------------------------------------------
 
 template<typename T_real>
@@ -158,17 +181,19 @@ DLL_EXPORT data_struct::Fit_Count_Dict<T_real>* generate_fit_count_dict(const Fi
 
 // ----------------------------------------------------------------------------
 
+/**
+ * @brief store_fit_counts : Save one pixel's counts into out_fit_counts. spectra_sum is spectra->sum(), passed in so
+ *                           routines fitting the same pixel can share it.
+ */
 template<typename T_real>
-DLL_EXPORT bool fit_single_spectra(fitting::routines::Base_Fit_Routine<T_real>* fit_routine,
-                        const fitting::models::Base_Model<T_real>* const model,
-                        const data_struct::Spectra<T_real>* const spectra,
-                        const data_struct::Fit_Element_Map_Dict<T_real>* const elements_to_fit,
-                        data_struct::Fit_Count_Dict<T_real>* out_fit_counts,
-                        size_t i,
-                        size_t j)
+DLL_EXPORT void store_fit_counts(std::unordered_map<std::string, T_real>& counts_dict,
+                                 const data_struct::Spectra<T_real>* const spectra,
+                                 T_real spectra_sum,
+                                 const data_struct::Fit_Element_Map_Dict<T_real>* const elements_to_fit,
+                                 data_struct::Fit_Count_Dict<T_real>* out_fit_counts,
+                                 size_t i,
+                                 size_t j)
 {
-    std::unordered_map<std::string, T_real> counts_dict;
-    fit_routine->fit_spectra(model, spectra, elements_to_fit, counts_dict);
     //save count / sec
     for (auto& el_itr : *elements_to_fit)
     {
@@ -180,7 +205,7 @@ DLL_EXPORT bool fit_single_spectra(fitting::routines::Base_Fit_Routine<T_real>*
     // add total fluorescense yield
     if (out_fit_counts->count(STR_TOTAL_FLUORESCENCE_YIELD))
     {
-        (*out_fit_counts)[STR_TOTAL_FLUORESCENCE_YIELD](i, j) = spectra->sum();
+        (*out_fit_counts)[STR_TOTAL_FLUORESCENCE_YIELD](i, j) = spectra_sum;
     }
     // add sum coherent and compton
     if (out_fit_counts->count(STR_SUM_ELASTIC_INELASTIC_AMP) > 0 && counts_dict.count(STR_COHERENT_SCT_AMPLITUDE) > 0 && counts_dict.count(STR_COMPTON_AMPLITUDE) > 0)
@@ -189,7 +214,7 @@ DLL_EXPORT bool fit_single_spectra(fitting::routines::Base_Fit_Routine<T_real>*
         // add total fluorescense yield
         if (out_fit_counts->count(STR_TOTAL_FLUORESCENCE_YIELD))
         {                   //                                      (sum - (elastic + inelastic)) / live time
-            (*out_fit_counts)[STR_TOTAL_FLUORESCENCE_YIELD](i, j) = (spectra->sum() - (*out_fit_counts)[STR_SUM_ELASTIC_INELASTIC_AMP](i, j)) / spectra->elapsed_livetime();
+            (*out_fit_counts)[STR_TOTAL_FLUORESCENCE_YIELD](i, j) = (spectra_sum - (*out_fit_counts)[STR_SUM_ELASTIC_INELASTIC_AMP](i, j)) / spectra->elapsed_livetime();
         }
     }
     else
@@ -197,116 +222,412 @@ DLL_EXPORT bool fit_single_spectra(fitting::routines::Base_Fit_Routine<T_real>*
         // add total fluorescense yield
         if (out_fit_counts->count(STR_TOTAL_FLUORESCENCE_YIELD))
         {
-            (*out_fit_counts)[STR_TOTAL_FLUORESCENCE_YIELD](i, j) = spectra->sum() / spectra->elapsed_livetime();
+            (*out_fit_counts)[STR_TOTAL_FLUORESCENCE_YIELD](i, j) = spectra_sum / spectra->elapsed_livetime();
         }
     }
+}
 
-    return true;
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+DLL_EXPORT void store_fit_counts(std::unordered_map<std::string, T_real>& counts_dict,
+                                 const data_struct::Spectra<T_real>* const spectra,
+                                 const data_struct::Fit_Element_Map_Dict<T_real>* const elements_to_fit,
+                                 data_struct::Fit_Count_Dict<T_real>* out_fit_counts,
+                                 size_t i,
+                                 size_t j)
+{
+    store_fit_counts(counts_dict, spectra, spectra->sum(), elements_to_fit, out_fit_counts, i, j);
 }
 
+// ----------------------------------------------------------------------------
 
+template<typename T_real>
+DLL_EXPORT bool fit_single_spectra(fitting::routines::Base_Fit_Routine<T_real>* fit_routine,
+                        const fitting::models::Base_Model<T_real>* const model,
+                        const data_struct::Spectra<T_real>* const spectra,
+                        const data_struct::Fit_Element_Map_Dict<T_real>* const elements_to_fit,
+                        data_struct::Fit_Count_Dict<T_real>* out_fit_counts,
+                        size_t i,
+                        size_t j)
+{
+    std::unordered_map<std::string, T_real> counts_dict;
+    fit_routine->fit_spectra(model, spectra, elements_to_fit, counts_dict);
+    store_fit_counts(counts_dict, spectra, elements_to_fit, out_fit_counts, i, j);
+    return true;
+}
 
 // ----------------------------------------------------------------------------
 
+/**
+ * @brief store_fit_results : Save one pixel's results (a layout row from fit_spectra_batch) into the cube as
+ *                            count / sec, with the total fluorescence yield and elastic + inelastic sum.
+ */
 template<typename T_real>
-DLL_EXPORT void proc_spectra(data_struct::Spectra_Volume<T_real>* spectra_volume,
-                             data_struct::Detector<T_real>* detector,
-                             ThreadPool* tp,
-                             bool save_spec_vol,
-                             Callback_Func_Status_Def* status_callback = nullptr)
+DLL_EXPORT void store_fit_results(const T_real* const pixel_results,
+                                  const data_struct::Spectra<T_real>* const spectra,
+                                  T_real spectra_sum,
+                                  data_struct::Fit_Result_Cube<T_real>* out_results,
+                                  size_t i,
+                                  size_t j)
 {
-    if (detector == nullptr)
+    const data_struct::Fit_Result_Layout<T_real>& layout = out_results->layout();
+    const T_real livetime = spectra->elapsed_livetime();
+    for (size_t s = 0; s < layout.num_elements(); s++)
     {
-        logE << "Detector meta information not loaded. Cannot process!\n";
-        return;
+        out_results->at(s, i, j) = pixel_results[s] / livetime;
     }
+    out_results->at(layout.num_iter_slot(), i, j) = pixel_results[layout.num_iter_slot()];
+    out_results->at(layout.residual_slot(), i, j) = pixel_results[layout.residual_slot()];
 
-    if (spectra_volume == nullptr)
+    if (layout.coherent_slot() > -1 && layout.compton_slot() > -1)
     {
-        logE << "Spectra Volume not loaded. Cannot process!\n";
-        return;
+        const T_real elastic_inelastic = pixel_results[layout.coherent_slot()] + pixel_results[layout.compton_slot()];
+        out_results->at(layout.sum_elastic_inelastic_slot(), i, j) = elastic_inelastic;
+        //                                                                   (sum - (elastic + inelastic)) / live time
+        out_results->at(layout.total_fluorescence_yield_slot(), i, j) = (spectra_sum - elastic_inelastic) / livetime;
     }
+    else
+    {
+        out_results->at(layout.total_fluorescence_yield_slot(), i, j) = spectra_sum / livetime;
+    }
+}
 
-    data_struct::Params_Override<T_real>* override_params = &(detector->fit_params_override_dict);
+// ----------------------------------------------------------------------------
 
-    //Range of energy in spectra to fit
-    fitting::models::Range energy_range = data_struct::get_energy_range(spectra_volume->samples_size(), &(detector->fit_params_override_dict.fit_params));
+template<typename T_real>
+DLL_EXPORT bool fit_single_spectra(fitting::routines::Base_Fit_Routine<T_real>* fit_routine,
+                                   const fitting::models::Base_Model<T_real>* const model,
+                                   const data_struct::Spectra<T_real>* const spectra,
+                                   data_struct::Fit_Result_Cube<T_real>* out_results,
+                                   size_t i,
+                                   size_t j)
+{
+    std::vector<T_real> pixel_results(out_results->layout().size(), (T_real)0.0);
+    fit_routine->fit_spectra_batch(model, { spectra }, out_results->layout(), pixel_results.data());
+    store_fit_results(pixel_results.data(), spectra, spectra->sum(), out_results, i, j);
+    return true;
+}
 
-    std::chrono::time_point<std::chrono::system_clock> start, end;
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief fit_spectra_tile : Fit the pixels [first_pixel, last_pixel) of the volume (row major index) in batches
+ *                           and add the number of finished pixels to pixels_done as it goes.
+ */
+template<typename T_real>
+DLL_EXPORT bool fit_spectra_tile(fitting::routines::Base_Fit_Routine<T_real>* fit_routine,
+                                 const fitting::models::Base_Model<T_real>* const model,
+                                 const data_struct::Spectra_Volume<T_real>* const spectra_volume,
+                                 data_struct::Fit_Result_Cube<T_real>* out_results,
+                                 size_t first_pixel,
+                                 size_t last_pixel,
+                                 std::atomic<size_t>* pixels_done)
+{
+    const size_t cols = spectra_volume->cols();
+    const size_t row_size = out_results->layout().size();
+    std::vector<const data_struct::Spectra<T_real>*> batch;
+    std::vector<T_real> results(FIT_TILE_BATCH_SIZE * row_size);
+    batch.reserve(FIT_TILE_BATCH_SIZE);
 
-    for (auto& itr : detector->fit_routines)
+    for (size_t p = first_pixel; p < last_pixel; p += FIT_TILE_BATCH_SIZE)
     {
-        fitting::routines::Base_Fit_Routine<T_real>* fit_routine = itr.second;
+        const size_t batch_end = std::min(p + (size_t)FIT_TILE_BATCH_SIZE, last_pixel);
+        batch.clear();
+        for (size_t q = p; q < batch_end; q++)
+        {
+            batch.push_back(&(*spectra_volume)[q / cols][q % cols]);
+        }
 
-        logI << "Processing  " << fit_routine->get_name() << "\n";
+        std::fill(results.begin(), results.end(), (T_real)0.0);
+        fit_routine->fit_spectra_batch(model, batch, out_results->layout(), results.data());
 
-        start = std::chrono::system_clock::now();
-        if (override_params->elements_to_fit.size() < 1)
+        for (size_t q = p; q < batch_end; q++)
         {
-            logE << "No elements to fit. Check  maps_fit_parameters_override.txt0 - 3 exist" << "\n";
-            continue;
+            store_fit_results(&results[(q - p) * row_size], batch[q - p], batch[q - p]->sum(), out_results, q / cols, q % cols);
         }
+        pixels_done->fetch_add(batch_end - p, std::memory_order_relaxed);
+    }
+    return true;
+}
 
-        //Fit job queue
-        std::queue<std::future<bool> >* fit_job_queue = new std::queue<std::future<bool> >();
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief fit_spectra_tile_fused : fit_spectra_tile for several routines in one pass. Each batch of pixels goes through
+ *                                 every routine while it is still in cache, the snip background and spectra sum of a
+ *                                 pixel are computed once and shared. out_results[r] belongs to fit_routines[r].
+ */
+template<typename T_real>
+DLL_EXPORT bool fit_spectra_tile_fused(const std::vector<fitting::routines::Base_Fit_Routine<T_real>*>& fit_routines,
+                                       const fitting::models::Base_Model<T_real>* const model,
+                                       const data_struct::Spectra_Volume<T_real>* const spectra_volume,
+                                       const std::vector<data_struct::Fit_Result_Cube<T_real>*>& out_results,
+                                       size_t first_pixel,
+                                       size_t last_pixel,
+                                       std::atomic<size_t>* pixels_done)
+{
+    const size_t cols = spectra_volume->cols();
+    std::vector<const data_struct::Spectra<T_real>*> batch;
+    std::vector<T_real> spectra_sums;
+    std::vector<std::vector<T_real> > results(fit_routines.size());
+    batch.reserve(FIT_TILE_BATCH_SIZE);
+    spectra_sums.reserve(FIT_TILE_BATCH_SIZE);
+    for (size_t r = 0; r < fit_routines.size(); r++)
+    {
+        results[r].resize(FIT_TILE_BATCH_SIZE * out_results[r]->layout().size());
+    }
 
-        //Allocate memeory to save fit counts
-        data_struct::Fit_Count_Dict<T_real>* element_fit_count_dict = generate_fit_count_dict(&override_params->elements_to_fit, spectra_volume->rows(), spectra_volume->cols(), true);
+    for (size_t p = first_pixel; p < last_pixel; p += FIT_TILE_BATCH_SIZE)
+    {
+        const size_t batch_end = std::min(p + (size_t)FIT_TILE_BATCH_SIZE, last_pixel);
+        batch.clear();
+        spectra_sums.clear();
+        for (size_t q = p; q < batch_end; q++)
+        {
+            batch.push_back(&(*spectra_volume)[q / cols][q % cols]);
+            spectra_sums.push_back(batch.back()->sum());
+        }
 
-        for (size_t i = 0; i < spectra_volume->rows(); i++)
         {
-            for (size_t j = 0; j < spectra_volume->cols(); j++)
+            // the first routine that needs a pixel's background computes it, the rest reuse it
+            data_struct::Snip_Background_Scope<T_real> background_scope;
+            for (size_t r = 0; r < fit_routines.size(); r++)
             {
-                //logD<< i<<" "<<j<<"\n";
-                fit_job_queue->emplace(tp->enqueue(fit_single_spectra<T_real>, fit_routine, detector->model, &(*spectra_volume)[i][j], &override_params->elements_to_fit, element_fit_count_dict, i, j));
+                std::fill(results[r].begin(), results[r].end(), (T_real)0.0);
+                fit_routines[r]->fit_spectra_batch(model, batch, out_results[r]->layout(), results[r].data());
             }
         }
 
-        size_t total_blocks = (spectra_volume->rows() * spectra_volume->cols()) - 1;
-        size_t cur_block = 0;
-        //wait for queue to finish processing
-        while (!fit_job_queue->empty())
+        for (size_t r = 0; r < fit_routines.size(); r++)
         {
-            auto ret = std::move(fit_job_queue->front());
-            fit_job_queue->pop();
-            ret.get();
-            if (status_callback != nullptr)
+            const size_t row_size = out_results[r]->layout().size();
+            for (size_t q = p; q < batch_end; q++)
             {
-                (*status_callback)(cur_block, total_blocks);
+                store_fit_results(&results[r][(q - p) * row_size], batch[q - p], spectra_sums[q - p], out_results[r], q / cols, q % cols);
             }
-            cur_block++;
         }
+        pixels_done->fetch_add(batch_end - p, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief save_fit_routine_results : Queue the save of a finished routine's counts and integrated spectra to h5_io.
+ *                                   The writer thread takes the results and frees them once they are written.
+ */
+template<typename T_real>
+void save_fit_routine_results(data_struct::Fitting_Routines routine,
+                              fitting::routines::Base_Fit_Routine<T_real>* fit_routine,
+                              data_struct::Fit_Result_Cube<T_real>* fit_results,
+                              data_struct::Spectra_Volume<T_real>* spectra_volume,
+                              std::shared_ptr<io::file::HDF5_IO> h5_io)
+{
+    // compare with and without --warm-start to see what seeding from neighbors saves
+    logI << "Fitting [ " << fit_routine->get_name() << " ] total iterations: " << fit_results->plane(fit_results->layout().num_iter_slot()).sum() << (fit_routine->neighbor_warm_start() ? " (warm start)" : "") << "\n";
 
-        std::chrono::time_point<std::chrono::system_clock> end = std::chrono::system_clock::now();
-        std::chrono::duration<double> elapsed_seconds = end - start;
-        logI << "Fitting [ " << fit_routine->get_name() << " ] elapsed time: " << elapsed_seconds.count() << "s" << "\n";
+    io::file::HDF5_Writer* writer = io::file::HDF5_Writer::inst();
+    const std::string name = fit_routine->get_name();
+    writer->enqueue(name + " counts", [name, fit_results, h5_io]()
+    {
+        // the writers take named counts, drop the cube before saving so only one copy is held for long
+        data_struct::Fit_Count_Dict<T_real>* element_fit_count_dict = fit_results->to_fit_count_dict();
+        delete fit_results;
+        bool ret = h5_io->save_element_fits(name, element_fit_count_dict);
+        element_fit_count_dict->clear();
+        delete element_fit_count_dict;
+        return ret;
+    });
 
-        io::file::HDF5_IO::inst()->save_element_fits(fit_routine->get_name(), element_fit_count_dict);
+    if (routine == data_struct::Fitting_Routines::GAUSS_MATRIX
+        || routine == data_struct::Fitting_Routines::NNLS
+        || routine == data_struct::Fitting_Routines::SVD)
+    {
+        // copies, the routine is reused by the next dataset while these are still queued
+        fitting::routines::Matrix_Optimized_Fit_Routine<T_real>* matrix_fit = (fitting::routines::Matrix_Optimized_Fit_Routine<T_real>*)fit_routine;
+        const data_struct::Range energy_range = matrix_fit->energy_range();
+        const data_struct::Spectra<T_real> int_spectra = matrix_fit->fitted_integrated_spectra();
+        const data_struct::Spectra<T_real> int_background = matrix_fit->fitted_integrated_background();
+        const size_t spectra_size = (*spectra_volume)[0][0].size();
+        writer->enqueue(name + " integrated spectra", [=]()
+        {
+            return h5_io->save_fitted_int_spectra(name, int_spectra, energy_range, int_background, spectra_size);
+        });
 
-        if (itr.first == data_struct::Fitting_Routines::GAUSS_MATRIX
-            || itr.first == data_struct::Fitting_Routines::NNLS
-            || itr.first == data_struct::Fitting_Routines::SVD)
+        if (routine == data_struct::Fitting_Routines::GAUSS_MATRIX)
         {
-            fitting::routines::Matrix_Optimized_Fit_Routine<T_real>* matrix_fit = (fitting::routines::Matrix_Optimized_Fit_Routine<T_real>*)fit_routine;
-            io::file::HDF5_IO::inst()->save_fitted_int_spectra(fit_routine->get_name(),
-                matrix_fit->fitted_integrated_spectra(),
-                matrix_fit->energy_range(),
-                matrix_fit->fitted_integrated_background(),
-                (*spectra_volume)[0][0].size());
+            const data_struct::Spectra<T_real> max_spectra = matrix_fit->max_integrated_spectra();
+            const data_struct::Spectra<T_real> max_10_spectra = matrix_fit->max_10_integrated_spectra();
+            writer->enqueue(name + " max 10 spectra", [=]()
+            {
+                return h5_io->save_max_10_spectra(name, energy_range, max_spectra, max_10_spectra, int_background);
+            });
         }
-        if (itr.first == data_struct::Fitting_Routines::GAUSS_MATRIX)
-        {
-            fitting::routines::Matrix_Optimized_Fit_Routine<T_real>* matrix_fit = (fitting::routines::Matrix_Optimized_Fit_Routine<T_real>*)fit_routine;
-            io::file::HDF5_IO::inst()->save_max_10_spectra(fit_routine->get_name(),
-                matrix_fit->energy_range(),
-                matrix_fit->max_integrated_spectra(),
-                matrix_fit->max_10_integrated_spectra(),
-                matrix_fit->fitted_integrated_background());
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief fit_row_blocks : Run tile_func(first_pixel, last_pixel) over the volume one block of rows at a time. The next
+ *                         block is paged in while the current one is fit and finished blocks are paged out, so a volume
+ *                         mapped from a scratch file keeps about two blocks in memory. A resident volume is one block.
+ */
+template<typename T_real, typename Tile_Func>
+void fit_row_blocks(data_struct::Spectra_Volume<T_real>* spectra_volume,
+                    ThreadPool* tp,
+                    size_t tile_size,
+                    std::atomic<size_t>& pixels_done,
+                    Callback_Func_Status_Def* status_callback,
+                    Tile_Func tile_func)
+{
+    const size_t rows = spectra_volume->rows();
+    const size_t cols = spectra_volume->cols();
+    const size_t block_rows = spectra_volume->block_rows();
+    spectra_volume->prefetch_rows(0, block_rows);
+    for (size_t first_row = 0; first_row < rows; first_row += block_rows)
+    {
+        const size_t last_row = std::min(first_row + block_rows, rows);
+        spectra_volume->prefetch_rows(last_row, last_row + block_rows);
+        //one pool task per tile of consecutive pixels, a single future for the block
+        std::future<void> fit_job = tp->enqueue_range(first_row * cols, last_row * cols, tile_size, tile_func);
+        wait_for_fit_job(fit_job, pixels_done, rows * cols, status_callback);
+        spectra_volume->release_rows(first_row, last_row);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief init_out_of_core : Map volumes bigger than the job's mem_limit (physical memory if not set) from a scratch
+ *                           file in the dataset's img.dat directory.
+ */
+template<typename T_real>
+void init_out_of_core(const data_struct::Analysis_Job<T_real>* const analysis_job, data_struct::Spectra_Volume<T_real>* spectra_volume)
+{
+    long long mem_limit = analysis_job->mem_limit;
+    if (mem_limit < 1)
+    {
+        mem_limit = get_total_mem();
+    }
+    spectra_volume->set_out_of_core(mem_limit, analysis_job->dataset_directory + "img.dat" + DIR_END_CHAR);
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief proc_spectra : Fit the volume with every routine of the detector and queue the results on the hdf5 writer.
+ *        They are saved to h5_io's open file, HDF5_IO::inst() if it is null. The queued writes keep h5_io alive.
+ * @return future that is ready once the save sequence is closed, spectra_volume has to be kept until then.
+ *         Not valid if nothing was processed.
+ */
+template<typename T_real>
+DLL_EXPORT std::future<bool> proc_spectra(data_struct::Spectra_Volume<T_real>* spectra_volume,
+                                          data_struct::Detector<T_real>* detector,
+                                          ThreadPool* tp,
+                                          bool save_spec_vol,
+                                          Callback_Func_Status_Def* status_callback = nullptr,
+                                          std::shared_ptr<io::file::HDF5_IO> h5_io = nullptr)
+{
+    if (detector == nullptr)
+    {
+        logE << "Detector meta information not loaded. Cannot process!\n";
+        return std::future<bool>();
+    }
+
+    if (spectra_volume == nullptr)
+    {
+        logE << "Spectra Volume not loaded. Cannot process!\n";
+        return std::future<bool>();
+    }
+
+    if (h5_io == nullptr)
+    {
+        // the singleton is never deleted
+        h5_io = std::shared_ptr<io::file::HDF5_IO>(io::file::HDF5_IO::inst(), [](io::file::HDF5_IO*) {});
+    }
+
+    data_struct::Params_Override<T_real>* override_params = &(detector->fit_params_override_dict);
+
+    //Range of energy in spectra to fit
+    fitting::models::Range energy_range = data_struct::get_energy_range(spectra_volume->samples_size(), &(detector->fit_params_override_dict.fit_params));
+
+    std::chrono::time_point<std::chrono::system_clock> start, end;
+    std::chrono::duration<double> elapsed_seconds;
+
+    const size_t total_pixels = spectra_volume->rows() * spectra_volume->cols();
+    const data_struct::Fit_Element_Map_Dict<T_real>* elements_to_fit = &override_params->elements_to_fit;
+    const fitting::models::Base_Model<T_real>* model = detector->model;
+
+    if (override_params->elements_to_fit.size() < 1)
+    {
+        logE << "No elements to fit. Check  maps_fit_parameters_override.txt0 - 3 exist" << "\n";
+    }
+    else if (detector->fit_routines.size() > 1)
+    {
+        //one sweep over the volume runs every routine, instead of streaming the volume once per routine
+        std::vector<fitting::routines::Base_Fit_Routine<T_real>*> fit_routines;
+        std::vector<data_struct::Fit_Result_Cube<T_real>*> fit_results;
+        const data_struct::Fit_Result_Layout<T_real> layout(elements_to_fit);
+        size_t tile_size = total_pixels;
+        std::string names;
+        for (auto& itr : detector->fit_routines)
+        {
+            fit_routines.push_back(itr.second);
+            //Allocate memeory to save fit counts
+            fit_results.push_back(new data_struct::Fit_Result_Cube<T_real>(layout, spectra_volume->rows(), spectra_volume->cols()));
+            tile_size = std::min(tile_size, fit_tile_size(itr.first, total_pixels, tp->size()));
+            names += " " + itr.second->get_name();
         }
 
-        delete fit_job_queue;
-        element_fit_count_dict->clear();
-        delete element_fit_count_dict;
+        logI << "Processing " << names << " in one pass\n";
+        start = std::chrono::system_clock::now();
+        std::atomic<size_t> pixels_done(0);
+        fit_row_blocks(spectra_volume, tp, tile_size, pixels_done, status_callback, [&](size_t first_pixel, size_t last_pixel)
+        {
+            fit_spectra_tile_fused<T_real>(fit_routines, model, spectra_volume, fit_results, first_pixel, last_pixel, &pixels_done);
+        });
+
+        end = std::chrono::system_clock::now();
+        elapsed_seconds = end - start;
+        logI << "Fitting [" << names << " ] elapsed time: " << elapsed_seconds.count() << "s" << "\n";
+
+        size_t r = 0;
+        for (auto& itr : detector->fit_routines)
+        {
+            save_fit_routine_results(itr.first, itr.second, fit_results[r], spectra_volume, h5_io);
+            r++;
+        }
+    }
+    else
+    {
+        const data_struct::Fit_Result_Layout<T_real> layout(elements_to_fit);
+        for (auto& itr : detector->fit_routines)
+        {
+            fitting::routines::Base_Fit_Routine<T_real>* fit_routine = itr.second;
+
+            logI << "Processing  " << fit_routine->get_name() << "\n";
+
+            start = std::chrono::system_clock::now();
+
+            //Allocate memeory to save fit counts
+            data_struct::Fit_Result_Cube<T_real>* fit_results = new data_struct::Fit_Result_Cube<T_real>(layout, spectra_volume->rows(), spectra_volume->cols());
+
+            const size_t tile_size = fit_tile_size(itr.first, total_pixels, tp->size());
+            std::atomic<size_t> pixels_done(0);
+            fit_row_blocks(spectra_volume, tp, tile_size, pixels_done, status_callback, [=, &pixels_done](size_t first_pixel, size_t last_pixel)
+            {
+                fit_spectra_tile<T_real>(fit_routine, model, spectra_volume, fit_results, first_pixel, last_pixel, &pixels_done);
+            });
+
+            end = std::chrono::system_clock::now();
+            elapsed_seconds = end - start;
+            logI << "Fitting [ " << fit_routine->get_name() << " ] elapsed time: " << elapsed_seconds.count() << "s" << "\n";
+
+            save_fit_routine_results(itr.first, fit_routine, fit_results, spectra_volume, h5_io);
+        }
     }
 
     T_real energy_offset = 0.0;
@@ -326,16 +647,25 @@ DLL_EXPORT void proc_spectra(data_struct::Spectra_Volume<T_real>* spectra_volume
         energy_quad = fit_params[STR_ENERGY_QUADRATIC].value;
     }
 
-    io::file::HDF5_IO::inst()->save_energy_calib(spectra_volume->samples_size(), energy_offset, energy_slope, energy_quad);
+    io::file::HDF5_Writer* writer = io::file::HDF5_Writer::inst();
+    const int spectra_size = spectra_volume->samples_size();
+    writer->enqueue("energy calibration", [=]()
+    {
+        return h5_io->save_energy_calib(spectra_size, energy_offset, energy_slope, energy_quad);
+    });
 
     if (save_spec_vol)
     {
-        io::file::HDF5_IO::inst()->save_spectra_volume("mca_arr", spectra_volume);
+        writer->enqueue("mca_arr", [spectra_volume, h5_io]()
+        {
+            return h5_io->save_spectra_volume("mca_arr", spectra_volume);
+        });
     }
-    
-    io::file::HDF5_IO::inst()->end_save_seq();
-
 
+    return writer->enqueue("closing file", [h5_io]()
+    {
+        return h5_io->end_save_seq();
+    });
 }
 
 
@@ -410,15 +740,42 @@ void find_quantifier_scalers(unordered_map<string, double>& pv_map, Quantificati
 // ----------------------------------------------------------------------------
 
 template<typename T_real>
-DLL_EXPORT void process_dataset_files(data_struct::Analysis_Job<T_real>* analysis_job, Callback_Func_Status_Def* status_callback = nullptr)
+DLL_EXPORT bool process_dataset_files(data_struct::Analysis_Job<T_real>* analysis_job, Callback_Func_Status_Def* status_callback = nullptr)
 {
     ThreadPool tp(analysis_job->num_threads);
 
+    // each detector file gets its own H5_Session, so the last one is still being written while the next one is
+    // loaded and fit. Its volume is kept until the queued mca_arr write is done.
+    struct Saving
+    {
+        data_struct::Spectra_Volume<T_real>* volume;
+        std::future<bool> done;
+        std::string path;
+    };
+    std::deque<Saving> saving;
+    auto finish_oldest = [&]()
+    {
+        if (saving.front().done.valid())
+        {
+            saving.front().done.wait();
+        }
+        delete saving.front().volume;
+        saving.pop_front();
+    };
+    auto finish_saving = [&]()
+    {
+        while (saving.size() > 0)
+        {
+            finish_oldest();
+        }
+    };
+
     for (auto& dataset_file : analysis_job->dataset_files)
     {
         //if quick and dirty then sum all detectors to 1 spectra volume and process it
         if (analysis_job->quick_and_dirty)
         {
+            finish_saving();
             process_dataset_files_quick_and_dirty(dataset_file, analysis_job, tp);
         }
         //otherwise process each detector separately
@@ -429,10 +786,17 @@ DLL_EXPORT void process_dataset_files(data_struct::Analysis_Job<T_real>* analysi
 
                 data_struct::Detector<T_real>* detector = analysis_job->get_detector(detector_num);
 
+                // at most two volumes, the one still saving and this one
+                while (saving.size() > 1)
+                {
+                    finish_oldest();
+                }
+
                 //Spectra volume data
                 data_struct::Spectra_Volume<T_real>* spectra_volume = new data_struct::Spectra_Volume<T_real>();
+                init_out_of_core(analysis_job, spectra_volume);
 
-                std::string fullpath;
+                std::string full_save_path;
                 size_t dlen = dataset_file.length();
                 bool is_mda = (dataset_file[dlen - 4] == '.' && dataset_file[dlen - 3] == 'm' && dataset_file[dlen - 2] == 'd' && dataset_file[dlen - 1] == 'a');
                 bool is_mca = (dataset_file[dlen - 4] == '.' && dataset_file[dlen - 3] == 'm' && dataset_file[dlen - 2] == 'c' && dataset_file[dlen - 1] == 'a');
@@ -444,18 +808,27 @@ DLL_EXPORT void process_dataset_files(data_struct::Analysis_Job<T_real>* analysi
                     {
                         str_detector_num = std::to_string(detector_num);
                     }
-                    std::string full_save_path = analysis_job->dataset_directory + "img.dat" + DIR_END_CHAR + dataset_file + ".h5" + str_detector_num;
-                    io::file::HDF5_IO::inst()->set_filename(full_save_path);
+                    full_save_path = analysis_job->dataset_directory + "img.dat" + DIR_END_CHAR + dataset_file + ".h5" + str_detector_num;
                 }
                 else
                 {
-                    std::string full_save_path = analysis_job->dataset_directory + "img.dat" + DIR_END_CHAR + dataset_file;
-                    io::file::HDF5_IO::inst()->set_filename(full_save_path);
+                    full_save_path = analysis_job->dataset_directory + "img.dat" + DIR_END_CHAR + dataset_file;
+                }
+                // loading may read back the analyzed file, not while it is still being written
+                for (const auto& itr : saving)
+                {
+                    if (itr.path == full_save_path)
+                    {
+                        finish_saving();
+                        break;
+                    }
                 }
+                std::shared_ptr<io::file::H5_Session> session = std::make_shared<io::file::H5_Session>(full_save_path);
 
                 bool loaded_from_analyzed_hdf5 = false;
                 //load spectra volume
-                if (false == io::file::load_spectra_volume(analysis_job->dataset_directory, dataset_file, detector_num, spectra_volume, &detector->fit_params_override_dict, &loaded_from_analyzed_hdf5, true))
+                bool loaded = io::file::load_spectra_volume(analysis_job->dataset_directory, dataset_file, detector_num, spectra_volume, &detector->fit_params_override_dict, &loaded_from_analyzed_hdf5, true, session.get());
+                if (false == loaded)
                 {
                     logW << "Skipping detector " << detector_num << "\n";
                     delete spectra_volume;
@@ -467,11 +840,18 @@ DLL_EXPORT void process_dataset_files(data_struct::Analysis_Job<T_real>* analysi
                 }
 
                 analysis_job->init_fit_routines(spectra_volume->samples_size(), true);
-                proc_spectra(spectra_volume, detector, &tp, !loaded_from_analyzed_hdf5, status_callback);
-                delete spectra_volume;
+                saving.push_back({ spectra_volume, proc_spectra(spectra_volume, detector, &tp, !loaded_from_analyzed_hdf5, status_callback, session), full_save_path });
             }
         }
     }
+    finish_saving();
+    // the saves ran on the writer thread, this is where their failures come back
+    if (false == io::file::HDF5_Writer::inst()->flush())
+    {
+        logE << "Not every analyzed dataset was saved completely\n";
+        return false;
+    }
+    return true;
 }
 
 // ----------------------------------------------------------------------------
@@ -485,13 +865,16 @@ DLL_EXPORT void process_dataset_files_quick_and_dirty(std::string dataset_file,
     //Spectra volume data
     data_struct::Spectra_Volume<T_real>* spectra_volume = new data_struct::Spectra_Volume<T_real>();
     data_struct::Spectra_Volume<T_real>* tmp_spectra_volume = new data_struct::Spectra_Volume<T_real>();
+    init_out_of_core(analysis_job, spectra_volume);
+    init_out_of_core(analysis_job, tmp_spectra_volume);
 
-    io::file::HDF5_IO::inst()->start_save_seq(full_save_path, true); // force to create new file for quick and dirty
+    std::shared_ptr<io::file::H5_Session> session = std::make_shared<io::file::H5_Session>(full_save_path);
+    session->open(true); // force to create new file for quick and dirty
 
     //load the first one
     size_t detector_num = analysis_job->detector_num_arr[0];
     bool is_loaded_from_analyzed_h5 = false;
-    if (false == io::file::load_spectra_volume(analysis_job->dataset_directory, dataset_file, detector_num, spectra_volume, &detector->fit_params_override_dict, &is_loaded_from_analyzed_h5, true))
+    if (false == io::file::load_spectra_volume(analysis_job->dataset_directory, dataset_file, detector_num, spectra_volume, &detector->fit_params_override_dict, &is_loaded_from_analyzed_h5, true, session.get()))
     {
         logE << "Loading all detectors for " << analysis_job->dataset_directory << DIR_END_CHAR << dataset_file << "\n";
         delete spectra_volume;
@@ -546,7 +929,11 @@ DLL_EXPORT void process_dataset_files_quick_and_dirty(std::string dataset_file,
 
     analysis_job->init_fit_routines(spectra_volume->samples_size(), true);
 
-    proc_spectra(spectra_volume, detector, &tp, !is_loaded_from_analyzed_h5, status_callback);
+    std::future<bool> saving_done = proc_spectra(spectra_volume, detector, &tp, !is_loaded_from_analyzed_h5, status_callback, session);
+    if (saving_done.valid())
+    {
+        saving_done.wait();
+    }
     delete spectra_volume;
 }
 
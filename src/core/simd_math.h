@@ -0,0 +1,592 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef SIMD_MATH_H
+#define SIMD_MATH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_MATH_SSE2
+#endif
+
+/**
+ * Vector exp, erfc and exp * erfc over arrays for float and double.
+ *
+ * The algorithms are written once against a small Pack interface (load / store / arithmetic / compare / select).
+ * Pack<T_real> is AVX-512, AVX2 or SSE2 depending on what the compiler targets (the AVX512 / AVX2 / SSE2 cmake
+ * options on MSVC, -march=native on gcc) and falls back to Scalar_Pack, which also handles the array tails. With no
+ * vector unit for the type (any build for float without SSE2, double without AVX2) exp, erfc and exp_erfc go straight
+ * to libm.
+ *
+ * Accuracy against libm over the ranges the Gaussian model uses:
+ *   exp  : a few ulp. Results below 2^-1021 (double) / 2^-124 (float) are flushed to 0.
+ *   erfc : erfc(z) = t * exp(-z^2 + P(t)), t = 1 / (1 + z / 2), P a Chebyshev series on t in [1/15, 1]. z^2 is split
+ *          into an exact high part so large z keep full relative precision. Under 1e-15 relative in double, 4e-7 in float,
+ *          and exp_erfc carries the rounding of a - zh^2 the same way.
+ */
+namespace simd_math
+{
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+struct Math_Consts;
+
+template<>
+struct Math_Consts<double>
+{
+    static constexpr double exp_lo = -708.0;
+    static constexpr double exp_hi = 709.782712893384;
+    static constexpr double log2e = 1.4426950408889634074;
+    static constexpr double ln2_hi = 6.93147180369123816490e-01;
+    static constexpr double ln2_lo = 1.90821492927058770002e-10;
+    // 1.5 * 2^52, (x + magic) - magic rounds to the nearest integer
+    static constexpr double round_magic = 6755399441055744.0;
+    // 2^52 + exponent bias, puts n + bias in the low mantissa bits
+    static constexpr double pow2_magic = 4503599627370496.0 + 1023.0;
+    static constexpr int mantissa_bits = 52;
+    // zh = round(z * split) / split has few enough bits for zh * zh to be exact for z <= erfc_z_max
+    static constexpr double erfc_split = 2097152.0;
+    static constexpr double erfc_z_max = 28.0;
+    static constexpr int exp_terms = 13;
+    static constexpr int erfc_terms = 25;
+};
+
+template<>
+struct Math_Consts<float>
+{
+    static constexpr float exp_lo = -86.5f;
+    static constexpr float exp_hi = 88.7228391f;
+    static constexpr float log2e = 1.44269504f;
+    static constexpr float ln2_hi = 0.693359375f;
+    static constexpr float ln2_lo = -2.12194440e-4f;
+    static constexpr float round_magic = 12582912.0f;
+    static constexpr float pow2_magic = 8388608.0f + 127.0f;
+    static constexpr int mantissa_bits = 23;
+    static constexpr float erfc_split = 128.0f;
+    static constexpr float erfc_z_max = 28.0f;
+    static constexpr int exp_terms = 8;
+    static constexpr int erfc_terms = 13;
+};
+
+// ----------------------------------------------------------------------------
+
+// Taylor coefficients of exp(r) for |r| <= ln(2) / 2, highest order first
+template<typename T_real>
+struct Exp_Coefs
+{
+    static constexpr T_real c[13] = {
+        (T_real)(1.0 / 479001600.0),
+        (T_real)(1.0 / 39916800.0),
+        (T_real)(1.0 / 3628800.0),
+        (T_real)(1.0 / 362880.0),
+        (T_real)(1.0 / 40320.0),
+        (T_real)(1.0 / 5040.0),
+        (T_real)(1.0 / 720.0),
+        (T_real)(1.0 / 120.0),
+        (T_real)(1.0 / 24.0),
+        (T_real)(1.0 / 6.0),
+        (T_real)(1.0 / 2.0),
+        (T_real)1.0,
+        (T_real)1.0
+    };
+};
+
+template<typename T_real>
+constexpr T_real Exp_Coefs<T_real>::c[13];
+
+// Chebyshev coefficients of log(erfc(z) / t) + z^2 in u = (15 t - 8) / 7, lowest order first, c[0] already halved
+template<typename T_real>
+struct Erfc_Coefs
+{
+    static constexpr T_real c[25] = {
+        (T_real)-6.12112796947552447228e-01,
+        (T_real)6.06609323395592969004e-01,
+        (T_real)1.40721642657179000442e-02,
+        (T_real)-8.30924380805546651025e-03,
+        (T_real)-5.53603888031182898882e-04,
+        (T_real)2.91228350442058419418e-04,
+        (T_real)1.63278956573187188084e-05,
+        (T_real)-1.40097155427387801651e-05,
+        (T_real)-3.74112133589807902088e-08,
+        (T_real)7.32820459094421082936e-07,
+        (T_real)-5.69680923265323928273e-08,
+        (T_real)-3.55965751878457468613e-08,
+        (T_real)6.84486612124641006193e-09,
+        (T_real)1.29035325454392602734e-09,
+        (T_real)-5.50518464101118921300e-10,
+        (T_real)-4.98991716070301856434e-12,
+        (T_real)3.26345753602652090264e-11,
+        (T_real)-4.34591064171893290413e-12,
+        (T_real)-1.21999369360656882699e-12,
+        (T_real)4.35609244530711647858e-13,
+        (T_real)-3.23310781901071930822e-15,
+        (T_real)-2.30906094212616347372e-14,
+        (T_real)4.28159569430819342273e-15,
+        (T_real)3.77116008776559596960e-16,
+        (T_real)-2.84259174900859667989e-16
+    };
+};
+
+template<typename T_real>
+constexpr T_real Erfc_Coefs<T_real>::c[25];
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief The Scalar_Pack struct : One lane. Used when no vector isa is enabled and for the tail of every array.
+ */
+template<typename T_real>
+struct Scalar_Pack
+{
+    typedef T_real real;
+    typedef T_real reg;
+    typedef bool mask;
+    static constexpr size_t lanes = 1;
+
+    static inline reg load(const T_real* p) { return *p; }
+    static inline void store(T_real* p, reg a) { *p = a; }
+    static inline reg set1(T_real v) { return v; }
+    static inline reg add(reg a, reg b) { return a + b; }
+    static inline reg sub(reg a, reg b) { return a - b; }
+    static inline reg mul(reg a, reg b) { return a * b; }
+    static inline reg div(reg a, reg b) { return a / b; }
+    // same operand order as minps / maxps, a nan in a returns b
+    static inline reg min(reg a, reg b) { return (a < b) ? a : b; }
+    static inline reg max(reg a, reg b) { return (a > b) ? a : b; }
+    static inline reg abs(reg a) { return (a < (T_real)0.0) ? -a : a; }
+    static inline mask lt(reg a, reg b) { return a < b; }
+    static inline mask gt(reg a, reg b) { return a > b; }
+    static inline mask is_nan(reg a) { return a != a; }
+    static inline reg select(mask m, reg a, reg b) { return m ? a : b; }
+    static inline reg round(reg a)
+    {
+        return (a + Math_Consts<T_real>::round_magic) - Math_Consts<T_real>::round_magic;
+    }
+    static inline reg pow2n(reg n)
+    {
+        T_real v = n + Math_Consts<T_real>::pow2_magic;
+        if (sizeof(T_real) == 8)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            bits <<= Math_Consts<T_real>::mantissa_bits;
+            std::memcpy(&v, &bits, sizeof(v));
+        }
+        else
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            bits <<= Math_Consts<T_real>::mantissa_bits;
+            std::memcpy(&v, &bits, sizeof(v));
+        }
+        return v;
+    }
+};
+
+template<typename T_real>
+struct Pack : public Scalar_Pack<T_real>
+{
+
+};
+
+// ----------------------------------------------------------------------------
+
+#if defined(__AVX512F__)
+
+template<>
+struct Pack<float>
+{
+    typedef float real;
+    typedef __m512 reg;
+    typedef __mmask16 mask;
+    static constexpr size_t lanes = 16;
+
+    static inline reg load(const float* p) { return _mm512_loadu_ps(p); }
+    static inline void store(float* p, reg a) { _mm512_storeu_ps(p, a); }
+    static inline reg set1(float v) { return _mm512_set1_ps(v); }
+    static inline reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm512_sub_ps(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+    static inline reg div(reg a, reg b) { return _mm512_div_ps(a, b); }
+    static inline reg min(reg a, reg b) { return _mm512_min_ps(a, b); }
+    static inline reg max(reg a, reg b) { return _mm512_max_ps(a, b); }
+    static inline reg abs(reg a) { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff))); }
+    static inline mask lt(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static inline mask gt(reg a, reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static inline mask is_nan(reg a) { return _mm512_cmp_ps_mask(a, a, _CMP_UNORD_Q); }
+    static inline reg select(mask m, reg a, reg b) { return _mm512_mask_blend_ps(m, b, a); }
+    static inline reg round(reg a) { return _mm512_sub_ps(_mm512_add_ps(a, set1(Math_Consts<float>::round_magic)), set1(Math_Consts<float>::round_magic)); }
+    static inline reg pow2n(reg n) { return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_castps_si512(_mm512_add_ps(n, set1(Math_Consts<float>::pow2_magic))), 23)); }
+};
+
+template<>
+struct Pack<double>
+{
+    typedef double real;
+    typedef __m512d reg;
+    typedef __mmask8 mask;
+    static constexpr size_t lanes = 8;
+
+    static inline reg load(const double* p) { return _mm512_loadu_pd(p); }
+    static inline void store(double* p, reg a) { _mm512_storeu_pd(p, a); }
+    static inline reg set1(double v) { return _mm512_set1_pd(v); }
+    static inline reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm512_sub_pd(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+    static inline reg div(reg a, reg b) { return _mm512_div_pd(a, b); }
+    static inline reg min(reg a, reg b) { return _mm512_min_pd(a, b); }
+    static inline reg max(reg a, reg b) { return _mm512_max_pd(a, b); }
+    static inline reg abs(reg a) { return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a), _mm512_set1_epi64(0x7fffffffffffffffLL))); }
+    static inline mask lt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    static inline mask gt(reg a, reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+    static inline mask is_nan(reg a) { return _mm512_cmp_pd_mask(a, a, _CMP_UNORD_Q); }
+    static inline reg select(mask m, reg a, reg b) { return _mm512_mask_blend_pd(m, b, a); }
+    static inline reg round(reg a) { return _mm512_sub_pd(_mm512_add_pd(a, set1(Math_Consts<double>::round_magic)), set1(Math_Consts<double>::round_magic)); }
+    static inline reg pow2n(reg n) { return _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_castpd_si512(_mm512_add_pd(n, set1(Math_Consts<double>::pow2_magic))), 52)); }
+};
+
+#elif defined(__AVX2__)
+
+template<>
+struct Pack<float>
+{
+    typedef float real;
+    typedef __m256 reg;
+    typedef __m256 mask;
+    static constexpr size_t lanes = 8;
+
+    static inline reg load(const float* p) { return _mm256_loadu_ps(p); }
+    static inline void store(float* p, reg a) { _mm256_storeu_ps(p, a); }
+    static inline reg set1(float v) { return _mm256_set1_ps(v); }
+    static inline reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm256_sub_ps(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static inline reg div(reg a, reg b) { return _mm256_div_ps(a, b); }
+    static inline reg min(reg a, reg b) { return _mm256_min_ps(a, b); }
+    static inline reg max(reg a, reg b) { return _mm256_max_ps(a, b); }
+    static inline reg abs(reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static inline mask lt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static inline mask gt(reg a, reg b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static inline mask is_nan(reg a) { return _mm256_cmp_ps(a, a, _CMP_UNORD_Q); }
+    static inline reg select(mask m, reg a, reg b) { return _mm256_blendv_ps(b, a, m); }
+    static inline reg round(reg a) { return _mm256_sub_ps(_mm256_add_ps(a, set1(Math_Consts<float>::round_magic)), set1(Math_Consts<float>::round_magic)); }
+    static inline reg pow2n(reg n) { return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_castps_si256(_mm256_add_ps(n, set1(Math_Consts<float>::pow2_magic))), 23)); }
+};
+
+template<>
+struct Pack<double>
+{
+    typedef double real;
+    typedef __m256d reg;
+    typedef __m256d mask;
+    static constexpr size_t lanes = 4;
+
+    static inline reg load(const double* p) { return _mm256_loadu_pd(p); }
+    static inline void store(double* p, reg a) { _mm256_storeu_pd(p, a); }
+    static inline reg set1(double v) { return _mm256_set1_pd(v); }
+    static inline reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm256_sub_pd(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static inline reg div(reg a, reg b) { return _mm256_div_pd(a, b); }
+    static inline reg min(reg a, reg b) { return _mm256_min_pd(a, b); }
+    static inline reg max(reg a, reg b) { return _mm256_max_pd(a, b); }
+    static inline reg abs(reg a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static inline mask lt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static inline mask gt(reg a, reg b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static inline mask is_nan(reg a) { return _mm256_cmp_pd(a, a, _CMP_UNORD_Q); }
+    static inline reg select(mask m, reg a, reg b) { return _mm256_blendv_pd(b, a, m); }
+    static inline reg round(reg a) { return _mm256_sub_pd(_mm256_add_pd(a, set1(Math_Consts<double>::round_magic)), set1(Math_Consts<double>::round_magic)); }
+    static inline reg pow2n(reg n) { return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(_mm256_add_pd(n, set1(Math_Consts<double>::pow2_magic))), 52)); }
+};
+
+#elif defined(SIMD_MATH_SSE2)
+
+template<>
+struct Pack<float>
+{
+    typedef float real;
+    typedef __m128 reg;
+    typedef __m128 mask;
+    static constexpr size_t lanes = 4;
+
+    static inline reg load(const float* p) { return _mm_loadu_ps(p); }
+    static inline void store(float* p, reg a) { _mm_storeu_ps(p, a); }
+    static inline reg set1(float v) { return _mm_set1_ps(v); }
+    static inline reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+    static inline reg sub(reg a, reg b) { return _mm_sub_ps(a, b); }
+    static inline reg mul(reg a, reg b) { return _mm_mul_ps(a, b); }
+    static inline reg div(reg a, reg b) { return _mm_div_ps(a, b); }
+    static inline reg min(reg a, reg b) { return _mm_min_ps(a, b); }
+    static inline reg max(reg a, reg b) { return _mm_max_ps(a, b); }
+    static inline reg abs(reg a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static inline mask lt(reg a, reg b) { return _mm_cmplt_ps(a, b); }
+    static inline mask gt(reg a, reg b) { return _mm_cmpgt_ps(a, b); }
+    static inline mask is_nan(reg a) { return _mm_cmpunord_ps(a, a); }
+    static inline reg select(mask m, reg a, reg b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static inline reg round(reg a) { return _mm_sub_ps(_mm_add_ps(a, set1(Math_Consts<float>::round_magic)), set1(Math_Consts<float>::round_magic)); }
+    static inline reg pow2n(reg n) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_castps_si128(_mm_add_ps(n, set1(Math_Consts<float>::pow2_magic))), 23)); }
+};
+
+// two double lanes do not beat libm, Pack<double> stays scalar on SSE2
+
+#endif
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief exp_sum_pack : exp(hi + lo) where hi + lo is not rounded to one value. lo is added after the ln2 reduction
+ *                       of hi, so exp(-z^2 + small) and exp(a - z^2) keep the precision of the unevaluated sum.
+ */
+template<typename P>
+inline typename P::reg exp_sum_pack(typename P::reg hi, typename P::reg lo)
+{
+    typedef typename P::real T_real;
+    typedef typename P::reg reg;
+    typedef Math_Consts<T_real> C;
+
+    reg x = P::add(hi, lo);
+    reg xc = P::min(P::max(x, P::set1(C::exp_lo)), P::set1(C::exp_hi));
+    reg n = P::round(P::mul(xc, P::set1(C::log2e)));
+    // lanes outside [exp_lo, exp_hi] get a meaningless r here, they are replaced below
+    reg r = P::sub(P::add(P::sub(hi, P::mul(n, P::set1(C::ln2_hi))), lo), P::mul(n, P::set1(C::ln2_lo)));
+
+    const T_real* coefs = Exp_Coefs<T_real>::c + (13 - C::exp_terms);
+    reg p = P::set1(coefs[0]);
+    for (int i = 1; i < C::exp_terms; i++)
+    {
+        p = P::add(P::mul(p, r), P::set1(coefs[i]));
+    }
+
+    // 2 * 2^(n-1) keeps the exponent field valid for n = 1024 near the overflow limit
+    reg res = P::mul(P::add(p, p), P::pow2n(P::sub(n, P::set1((T_real)1.0))));
+    res = P::select(P::lt(x, P::set1(C::exp_lo)), P::set1((T_real)0.0), res);
+    res = P::select(P::gt(x, P::set1(C::exp_hi)), P::set1(std::numeric_limits<T_real>::infinity()), res);
+    return P::select(P::is_nan(x), x, res);
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename P>
+inline typename P::reg exp_pack(typename P::reg x)
+{
+    return exp_sum_pack<P>(x, P::set1((typename P::real)0.0));
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief erfc_parts : For z = |w| returns t and the exponent arguments so that erfc(z) = t * exp(hi + lo),
+ *                     hi = -zh^2 exact and lo = (zh - z)(zh + z) + P(t).
+ */
+template<typename P>
+inline void erfc_parts(typename P::reg w, typename P::reg& t, typename P::reg& hi, typename P::reg& lo)
+{
+    typedef typename P::real T_real;
+    typedef typename P::reg reg;
+    typedef Math_Consts<T_real> C;
+
+    reg z = P::min(P::abs(w), P::set1(C::erfc_z_max));
+    t = P::div(P::set1((T_real)1.0), P::add(P::set1((T_real)1.0), P::mul(P::set1((T_real)0.5), z)));
+
+    // clenshaw on u = (15 t - 8) / 7
+    reg u = P::mul(P::sub(P::mul(t, P::set1((T_real)15.0)), P::set1((T_real)8.0)), P::set1((T_real)(1.0 / 7.0)));
+    reg two_u = P::add(u, u);
+    reg b1 = P::set1((T_real)0.0);
+    reg b2 = P::set1((T_real)0.0);
+    const T_real* coefs = Erfc_Coefs<T_real>::c;
+    for (int k = C::erfc_terms - 1; k > 0; k--)
+    {
+        reg b0 = P::add(P::sub(P::mul(two_u, b1), b2), P::set1(coefs[k]));
+        b2 = b1;
+        b1 = b0;
+    }
+    reg poly = P::add(P::sub(P::mul(u, b1), b2), P::set1(coefs[0]));
+
+    reg zh = P::mul(P::round(P::mul(z, P::set1(C::erfc_split))), P::set1((T_real)1.0 / C::erfc_split));
+    hi = P::sub(P::set1((T_real)0.0), P::mul(zh, zh));
+    lo = P::add(P::mul(P::sub(zh, z), P::add(zh, z)), poly);
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename P>
+inline typename P::reg erfc_pack(typename P::reg w)
+{
+    typedef typename P::real T_real;
+    typedef typename P::reg reg;
+
+    reg t, hi, lo;
+    erfc_parts<P>(w, t, hi, lo);
+    reg r = P::mul(t, exp_sum_pack<P>(hi, lo));
+    r = P::select(P::lt(w, P::set1((T_real)0.0)), P::sub(P::set1((T_real)2.0), r), r);
+    return P::select(P::is_nan(w), w, r);
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief exp_erfc_pack : exp(a) * erfc(w). For w >= 0 a is added to -zh^2 with its rounding error carried into lo,
+ *                        so a large a does not overflow where erfc underflows.
+ */
+template<typename P>
+inline typename P::reg exp_erfc_pack(typename P::reg a, typename P::reg w)
+{
+    typedef typename P::real T_real;
+    typedef typename P::reg reg;
+
+    reg t, hi, lo;
+    erfc_parts<P>(w, t, hi, lo);
+    typename P::mask negative = P::lt(w, P::set1((T_real)0.0));
+    reg a_pos = P::select(negative, P::set1((T_real)0.0), a);
+    // two-sum of hi + a
+    reg s = P::add(hi, a_pos);
+    reg sb = P::sub(s, hi);
+    lo = P::add(lo, P::add(P::sub(hi, P::sub(s, sb)), P::sub(a_pos, sb)));
+    reg r = P::mul(t, exp_sum_pack<P>(s, lo));
+    r = P::select(negative, P::mul(exp_pack<P>(a), P::sub(P::set1((T_real)2.0), r)), r);
+    r = P::select(P::is_nan(w), w, r);
+    return P::select(P::is_nan(a), a, r);
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief exp : out[i] = exp(in[i]). in and out may be the same array.
+ */
+template<typename T_real>
+void exp(const T_real* in, T_real* out, size_t n)
+{
+    typedef Pack<T_real> P;
+    size_t i = 0;
+    if (P::lanes == 1)
+    {
+        for (; i < n; i++)
+        {
+            out[i] = std::exp(in[i]);
+        }
+        return;
+    }
+    for (; i + P::lanes <= n; i += P::lanes)
+    {
+        P::store(out + i, exp_pack<P>(P::load(in + i)));
+    }
+    for (; i < n; i++)
+    {
+        out[i] = exp_pack<Scalar_Pack<T_real> >(in[i]);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief erfc : out[i] = erfc(in[i]). in and out may be the same array.
+ */
+template<typename T_real>
+void erfc(const T_real* in, T_real* out, size_t n)
+{
+    typedef Pack<T_real> P;
+    size_t i = 0;
+    if (P::lanes == 1)
+    {
+        for (; i < n; i++)
+        {
+            out[i] = std::erfc(in[i]);
+        }
+        return;
+    }
+    for (; i + P::lanes <= n; i += P::lanes)
+    {
+        P::store(out + i, erfc_pack<P>(P::load(in + i)));
+    }
+    for (; i < n; i++)
+    {
+        out[i] = erfc_pack<Scalar_Pack<T_real> >(in[i]);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief exp_erfc : out[i] = exp(a[i]) * erfc(w[i]). out may alias a or w.
+ */
+template<typename T_real>
+void exp_erfc(const T_real* a, const T_real* w, T_real* out, size_t n)
+{
+    typedef Pack<T_real> P;
+    size_t i = 0;
+    if (P::lanes == 1)
+    {
+        // like exp and erfc. The split z^2 needs exactly rounded arithmetic, x87 excess precision breaks it
+        for (; i < n; i++)
+        {
+            out[i] = std::exp(a[i]) * std::erfc(w[i]);
+        }
+        return;
+    }
+    for (; i + P::lanes <= n; i += P::lanes)
+    {
+        P::store(out + i, exp_erfc_pack<P>(P::load(a + i), P::load(w + i)));
+    }
+    for (; i < n; i++)
+    {
+        out[i] = exp_erfc_pack<Scalar_Pack<T_real> >(a[i], w[i]);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+} //namespace simd_math
+
+#endif // SIMD_MATH_H
@@ -48,6 +48,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "analysis_job.h"
+#include "fitting/models/gaussian_model.h"
 
 namespace data_struct
 {
@@ -59,6 +60,7 @@ Analysis_Job<T_real>::Analysis_Job()
 {
     _optimizer = &_lmfit_optimizer;
     optimize_fit_routine = OPTIMIZE_FIT_ROUTINE::ALL_PARAMS;
+    neighbor_warm_start = false;
     _last_init_sample_size = 0;
 	_first_init = true;
     num_threads = std::thread::hardware_concurrency();
@@ -80,6 +82,7 @@ Analysis_Job<T_real>::Analysis_Job()
     network_source_port = "43434";
     network_stream_port = "43434";
 	mem_limit = -1;
+    peak_window_tolerance = (T_real)DEFAULT_PEAK_WINDOW_TOLERANCE;
 	update_theta_str = "";
 	update_us_amps_str = "";
 	update_ds_amps_str = "";
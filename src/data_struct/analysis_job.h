@@ -143,6 +143,9 @@ public:
 
 	long long mem_limit;
 
+    //relative truncation tolerance of the Gaussian model's peak, step and tail windows, 0 evaluates every channel
+    T_real peak_window_tolerance;
+
 	std::string update_us_amps_str;
 
 	std::string update_ds_amps_str;
@@ -153,6 +156,9 @@ public:
 
     OPTIMIZE_FIT_ROUTINE optimize_fit_routine;
 
+    //start each pixel's fit from its neighbor's solution
+    bool neighbor_warm_start;
+
     //list of quantification standards to use
     vector<Quantification_Standard<T_real>> standard_element_weights;
 
@@ -0,0 +1,143 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+
+#include "background.h"
+
+namespace data_struct
+{
+
+// ----------------------------------------------------------------------------
+// -----------------------------Snip_Schedule_Cache----------------------------
+// ----------------------------------------------------------------------------
+template<typename T_real>
+Snip_Schedule_Cache<T_real>* Snip_Schedule_Cache<T_real>::_this_inst(0);
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+Snip_Schedule_Cache<T_real>* Snip_Schedule_Cache<T_real>::inst()
+{
+    // first call happens from a fitting thread. A local static is built once, later calls (every pixel) only
+    // check its guard and do not lock
+    static Snip_Schedule_Cache* inst_ptr = (_this_inst = new Snip_Schedule_Cache());
+    return inst_ptr;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+Snip_Schedule_Cache<T_real>::Snip_Schedule_Cache() : _generation(1)
+{
+
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+Snip_Schedule_Cache<T_real>::~Snip_Schedule_Cache()
+{
+    clear();
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+std::shared_ptr<const Snip_Schedule<T_real>> Snip_Schedule_Cache<T_real>::get(size_t num_channels, T_real energy_offset, T_real energy_linear, T_real energy_quadratic, T_real width, T_real xmin, T_real xmax)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (const auto& itr : _schedules)
+        {
+            if (itr->matches(num_channels, energy_offset, energy_linear, energy_quadratic, width, xmin, xmax))
+            {
+                return itr;
+            }
+        }
+    }
+
+    // build outside the lock, if two threads race on the same key the second one is dropped
+    std::shared_ptr<Snip_Schedule<T_real>> schedule = std::make_shared<Snip_Schedule<T_real>>();
+    schedule->build(num_channels, energy_offset, energy_linear, energy_quadratic, width, xmin, xmax);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto& itr : _schedules)
+    {
+        if (itr->matches(num_channels, energy_offset, energy_linear, energy_quadratic, width, xmin, xmax))
+        {
+            return itr;
+        }
+    }
+    if (_schedules.size() >= SNIP_SCHEDULE_CACHE_SIZE)
+    {
+        _schedules.erase(_schedules.begin());
+    }
+    _schedules.push_back(schedule);
+    return schedule;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Snip_Schedule_Cache<T_real>::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _schedules.clear();
+    _generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+size_t Snip_Schedule_Cache<T_real>::size()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _schedules.size();
+}
+
+// ----------------------------------------------------------------------------
+
+} //namespace data_struct
@@ -0,0 +1,653 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef BACKGROUND_H
+#define BACKGROUND_H
+
+#include "data_struct/spectra.h"
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace data_struct
+{
+
+using namespace std;
+
+// upper bound on window halvings, only reached when the widths are not finite (energy slope of 0)
+#define SNIP_MAX_LEVELS 64
+
+// number of calibrations Snip_Schedule_Cache keeps, oldest is dropped first
+#define SNIP_SCHEDULE_CACHE_SIZE 32
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+DLL_EXPORT ArrayTr<T_real> convolve1d(const ArrayTr<T_real>& arr, const ArrayTr<T_real>& boxcar)
+{
+    ArrayTr<T_real> new_background(arr.size());
+    new_background.setZero(arr.size());
+    //convolve 1d
+
+    size_t const nf = arr.size();
+    size_t const ng = boxcar.size();
+    ArrayTr<T_real> const& min_v = (nf < ng) ? arr : boxcar;
+    ArrayTr<T_real> const& max_v = (nf < ng) ? boxcar : arr;
+    size_t const n = std::max(nf, ng) - std::min(nf, ng) + 1;
+    ArrayTr<T_real> out(n);
+    out.setZero(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (int j(min_v.size() - 1), k(i); j >= 0; --j)
+        {
+            out[i] += min_v[j] * max_v[k];
+            ++k;
+        }
+    }
+    T_real norm = 1 / T_real(boxcar.size());
+    int j = min_v.size() / 2;
+    for (size_t i = 0; i < n; i++)
+    {
+        new_background[j] = out[i] * norm;
+        j++;
+    }
+
+    return new_background;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief boxcar_smooth : O(n) running sum version of convolve1d with a boxcar of ones. out[i + boxcar_size / 2] is the
+ *                        mean of in[i .. i + boxcar_size - 1], the first boxcar_size / 2 and last channels are 0 like
+ *                        convolve1d. The sum is carried in double so it stays within a few ulp of the direct sum.
+ *                        in and out must not overlap and n must be >= boxcar_size.
+ */
+template<typename T_real>
+void boxcar_smooth(const T_real* in, size_t n, size_t boxcar_size, T_real* out)
+{
+    const size_t half = boxcar_size / 2;
+    const size_t num_windows = n - boxcar_size + 1;
+    const T_real norm = 1 / T_real(boxcar_size);
+
+    std::fill(out, out + half, (T_real)0.0);
+    std::fill(out + half + num_windows, out + n, (T_real)0.0);
+
+    double sum = 0.0;
+    for (size_t i = 0; i < boxcar_size; i++)
+    {
+        sum += in[i];
+    }
+    out[half] = T_real(sum) * norm;
+    for (size_t i = 1; i < num_windows; i++)
+    {
+        sum += (double)in[i + boxcar_size - 1] - (double)in[i - 1];
+        out[half + i] = T_real(sum) * norm;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+DLL_EXPORT ArrayTr<T_real> convolve1d(const ArrayTr<T_real>& arr, size_t boxcar_size)
+{
+    if (boxcar_size == 0 || (size_t)arr.size() < boxcar_size)
+    {
+        ArrayTr<T_real> boxcar(boxcar_size);
+        boxcar.setConstant(boxcar_size, 1.0);
+        return convolve1d(arr, boxcar);
+    }
+    ArrayTr<T_real> new_background(arr.size());
+    boxcar_smooth(arr.data(), arr.size(), boxcar_size, new_background.data());
+    return new_background;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief The Snip_Simd struct : Vector width used by snip_pass and the gather / min kernel for one block of lanes.
+ *        Chosen at compile time from the AVX512 / AVX2 build options (-march=native on gcc), scalar otherwise.
+ */
+template<typename T_real>
+struct Snip_Simd
+{
+    static constexpr size_t lanes = 1;
+
+    static inline void block(T_real* bkg, const int32_t* lo, const int32_t* hi, size_t k)
+    {
+        T_real temp = (bkg[lo[k]] + bkg[hi[k]]) / (T_real)2.0;
+        bkg[k] = (bkg[k] > temp) ? temp : bkg[k];
+    }
+};
+
+// min(temp, b) returns temp only when temp < b, the same as the scalar compare including nan's
+#if defined(__AVX512F__)
+
+template<>
+struct Snip_Simd<float>
+{
+    static constexpr size_t lanes = 16;
+
+    static inline void block(float* bkg, const int32_t* lo, const int32_t* hi, size_t k)
+    {
+        __m512 a = _mm512_i32gather_ps(_mm512_loadu_si512((const void*)(lo + k)), bkg, 4);
+        __m512 c = _mm512_i32gather_ps(_mm512_loadu_si512((const void*)(hi + k)), bkg, 4);
+        __m512 temp = _mm512_mul_ps(_mm512_add_ps(a, c), _mm512_set1_ps(0.5f));
+        _mm512_storeu_ps(bkg + k, _mm512_min_ps(temp, _mm512_loadu_ps(bkg + k)));
+    }
+};
+
+template<>
+struct Snip_Simd<double>
+{
+    static constexpr size_t lanes = 8;
+
+    static inline void block(double* bkg, const int32_t* lo, const int32_t* hi, size_t k)
+    {
+        __m512d a = _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(lo + k)), bkg, 8);
+        __m512d c = _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)(hi + k)), bkg, 8);
+        __m512d temp = _mm512_mul_pd(_mm512_add_pd(a, c), _mm512_set1_pd(0.5));
+        _mm512_storeu_pd(bkg + k, _mm512_min_pd(temp, _mm512_loadu_pd(bkg + k)));
+    }
+};
+
+#elif defined(__AVX2__)
+
+template<>
+struct Snip_Simd<float>
+{
+    static constexpr size_t lanes = 8;
+
+    static inline void block(float* bkg, const int32_t* lo, const int32_t* hi, size_t k)
+    {
+        __m256 a = _mm256_i32gather_ps(bkg, _mm256_loadu_si256((const __m256i*)(lo + k)), 4);
+        __m256 c = _mm256_i32gather_ps(bkg, _mm256_loadu_si256((const __m256i*)(hi + k)), 4);
+        __m256 temp = _mm256_mul_ps(_mm256_add_ps(a, c), _mm256_set1_ps(0.5f));
+        _mm256_storeu_ps(bkg + k, _mm256_min_ps(temp, _mm256_loadu_ps(bkg + k)));
+    }
+};
+
+template<>
+struct Snip_Simd<double>
+{
+    static constexpr size_t lanes = 4;
+
+    static inline void block(double* bkg, const int32_t* lo, const int32_t* hi, size_t k)
+    {
+        __m256d a = _mm256_i32gather_pd(bkg, _mm_loadu_si128((const __m128i*)(lo + k)), 8);
+        __m256d c = _mm256_i32gather_pd(bkg, _mm_loadu_si128((const __m128i*)(hi + k)), 8);
+        __m256d temp = _mm256_mul_pd(_mm256_add_pd(a, c), _mm256_set1_pd(0.5));
+        _mm256_storeu_pd(bkg + k, _mm256_min_pd(temp, _mm256_loadu_pd(bkg + k)));
+    }
+};
+
+#endif
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief The Snip_Schedule class : Clamped lo / hi window indices for every SNIP pass. They only depend on the energy
+ *        calibration, the snip width and the fit range, so one schedule serves every spectra with that calibration.
+ *        Each width level also records which vector blocks can be updated at once: snip updates the background in
+ *        place from low to high channel, so a block is only safe when none of its lanes read a channel that an
+ *        earlier lane of the same block writes.
+ */
+template<typename T_real>
+class Snip_Schedule
+{
+public:
+
+    Snip_Schedule() : _num_channels(0), _energy_offset(0), _energy_linear(0), _energy_quadratic(0), _width(0), _xmin(0), _xmax(0), _valid(false)
+    {
+
+    }
+
+    bool matches(size_t num_channels, T_real energy_offset, T_real energy_linear, T_real energy_quadratic, T_real width, T_real xmin, T_real xmax) const
+    {
+        return _valid
+            && _num_channels == num_channels
+            && _energy_offset == energy_offset
+            && _energy_linear == energy_linear
+            && _energy_quadratic == energy_quadratic
+            && _width == width
+            && _xmin == xmin
+            && _xmax == xmax;
+    }
+
+    void build(size_t num_channels, T_real energy_offset, T_real energy_linear, T_real energy_quadratic, T_real width, T_real xmin, T_real xmax)
+    {
+        _num_channels = num_channels;
+        _energy_offset = energy_offset;
+        _energy_linear = energy_linear;
+        _energy_quadratic = energy_quadratic;
+        _width = width;
+        _xmin = xmin;
+        _xmax = xmax;
+        _lo.clear();
+        _hi.clear();
+        _block_safe.clear();
+        _pass_levels.clear();
+        _num_levels = 0;
+        _valid = true;
+
+        if (num_channels == 0)
+        {
+            return;
+        }
+
+        // same expressions as the original per spectra computation so the windows match bit for bit
+        ArrayTr<T_real> energy = ArrayTr<T_real>::LinSpaced(num_channels, 0, num_channels - 1);
+        energy = energy_offset + (energy * energy_linear) + (Eigen::pow(energy, (T_real)2.0) * energy_quadratic);
+
+        ArrayTr<T_real> tmp = std::pow((energy_offset / (T_real)2.3548), (T_real)2.0) + energy * (T_real)2.96 * energy_linear;
+        tmp = tmp.unaryExpr([](T_real r) { return r < 0.0 ? (T_real)0.0 : r;  });
+
+        ArrayTr<T_real> current_width = (T_real)2.35 * Eigen::sqrt(tmp);
+        current_width = width * current_width / energy_linear;  // in channels
+
+        int max_of_xmin = (std::max)(xmin, (T_real)0.0);
+        int min_of_xmax = (std::min)(xmax, T_real(num_channels - 1));
+
+        // two fixed passes at the starting width, then halve the window area until it is below half a channel
+        _add_level(current_width, max_of_xmin, min_of_xmax);
+        _pass_levels.push_back(0);
+        _pass_levels.push_back(0);
+        bool first_level = true;
+        while (current_width.maxCoeff() >= 0.5 && _num_levels < SNIP_MAX_LEVELS)
+        {
+            if (false == first_level)
+            {
+                _add_level(current_width, max_of_xmin, min_of_xmax);
+            }
+            first_level = false;
+            _pass_levels.push_back(_num_levels - 1);
+            current_width = current_width / T_real(M_SQRT2); // window_rf
+        }
+    }
+
+    size_t num_channels() const { return _num_channels; }
+
+    size_t num_passes() const { return _pass_levels.size(); }
+
+    const int32_t* lo(size_t pass) const { return &_lo[_pass_levels[pass] * _num_channels]; }
+
+    const int32_t* hi(size_t pass) const { return &_hi[_pass_levels[pass] * _num_channels]; }
+
+    const uint8_t* block_safe(size_t pass) const { return &_block_safe[_pass_levels[pass] * _blocks_per_level()]; }
+
+private:
+
+    size_t _blocks_per_level() const { return _num_channels / Snip_Simd<T_real>::lanes; }
+
+    void _add_level(const ArrayTr<T_real>& current_width, int max_of_xmin, int min_of_xmax)
+    {
+        const size_t n = _num_channels;
+        const size_t offset = _lo.size();
+        _lo.resize(offset + n);
+        _hi.resize(offset + n);
+        int32_t* lo = &_lo[offset];
+        int32_t* hi = &_hi[offset];
+        // clamp in floating point first so nan / inf widths never hit an undefined float to int conversion
+        const T_real lo_limit = (T_real)-1.0;
+        const T_real hi_limit = T_real(n);
+        for (size_t k = 0; k < n; k++)
+        {
+            long int lo_index = (long int)std::fmin(std::fmax((T_real)k - current_width[k], lo_limit), hi_limit);
+            long int hi_index = (long int)std::fmin(std::fmax((T_real)k + current_width[k], lo_limit), hi_limit);
+            if (std::isnan(current_width[k]))
+            {
+                lo_index = -1;
+                hi_index = -1;
+            }
+            if (lo_index < max_of_xmin)
+            {
+                lo_index = max_of_xmin;
+            }
+            if (lo_index > min_of_xmax)
+            {
+                lo_index = min_of_xmax;
+            }
+            if (hi_index > min_of_xmax)
+            {
+                hi_index = min_of_xmax;
+            }
+            if (hi_index < max_of_xmin)
+            {
+                hi_index = max_of_xmin;
+            }
+            lo[k] = (int32_t)lo_index;
+            hi[k] = (int32_t)hi_index;
+        }
+
+        const size_t lanes = Snip_Simd<T_real>::lanes;
+        const size_t num_blocks = _blocks_per_level();
+        const size_t block_offset = _block_safe.size();
+        _block_safe.resize(block_offset + num_blocks);
+        for (size_t b = 0; b < num_blocks; b++)
+        {
+            const int32_t k0 = (int32_t)(b * lanes);
+            bool safe = true;
+            for (int32_t k = k0; k < k0 + (int32_t)lanes; k++)
+            {
+                // reading a channel below the block or at / above itself sees the same value as the in place loop
+                safe = safe && (lo[k] < k0 || lo[k] >= k) && (hi[k] < k0 || hi[k] >= k);
+            }
+            _block_safe[block_offset + b] = safe ? 1 : 0;
+        }
+        _num_levels++;
+    }
+
+    size_t _num_channels;
+    T_real _energy_offset;
+    T_real _energy_linear;
+    T_real _energy_quadratic;
+    T_real _width;
+    T_real _xmin;
+    T_real _xmax;
+    bool _valid;
+
+    size_t _num_levels = 0;
+    std::vector<int32_t> _lo;
+    std::vector<int32_t> _hi;
+    std::vector<uint8_t> _block_safe;
+    std::vector<size_t> _pass_levels;
+};
+
+// ----------------------------------------------------------------------------
+
+//singleton
+/**
+ * @brief The Snip_Schedule_Cache class : Process wide cache of read only Snip_Schedule's keyed by channel count,
+ *        energy calibration, snip width and fit range. Schedules are handed out as shared_ptr so clear() never pulls
+ *        one out from under a thread that is still using it. Cleared when override parameters are (re)loaded.
+ */
+template<typename T_real>
+class DLL_EXPORT Snip_Schedule_Cache
+{
+public:
+
+    static Snip_Schedule_Cache* inst();
+
+    ~Snip_Schedule_Cache();
+
+    std::shared_ptr<const Snip_Schedule<T_real>> get(size_t num_channels, T_real energy_offset, T_real energy_linear, T_real energy_quadratic, T_real width, T_real xmin, T_real xmax);
+
+    void clear();
+
+    size_t size();
+
+    // bumped by clear(), lets per thread copies notice the cache was invalidated
+    unsigned int generation() const { return _generation.load(std::memory_order_acquire); }
+
+private:
+
+    Snip_Schedule_Cache();
+
+    static Snip_Schedule_Cache *_this_inst;
+
+    std::mutex _mutex;
+
+    std::vector<std::shared_ptr<const Snip_Schedule<T_real>>> _schedules;
+
+    std::atomic<unsigned int> _generation;
+};
+
+TEMPLATE_CLASS_DLL_EXPORT Snip_Schedule_Cache<float>;
+TEMPLATE_CLASS_DLL_EXPORT Snip_Schedule_Cache<double>;
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief get_snip_schedule : Schedule for this calibration. Checks the calling thread's last schedule before going to
+ *                            the shared cache, so a map fit with one calibration never takes the cache lock per pixel.
+ */
+template<typename T_real>
+std::shared_ptr<const Snip_Schedule<T_real>> get_snip_schedule(size_t num_channels, T_real energy_offset, T_real energy_linear, T_real energy_quadratic, T_real width, T_real xmin, T_real xmax)
+{
+    thread_local std::shared_ptr<const Snip_Schedule<T_real>> last_schedule;
+    thread_local unsigned int last_generation = 0;
+
+    Snip_Schedule_Cache<T_real>* cache = Snip_Schedule_Cache<T_real>::inst();
+    unsigned int generation = cache->generation();
+    if (last_schedule == nullptr
+        || last_generation != generation
+        || false == last_schedule->matches(num_channels, energy_offset, energy_linear, energy_quadratic, width, xmin, xmax))
+    {
+        last_schedule = cache->get(num_channels, energy_offset, energy_linear, energy_quadratic, width, xmin, xmax);
+        last_generation = generation;
+    }
+    return last_schedule;
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief snip_pass : One in place SNIP clipping pass, bkg[k] = min(bkg[k], (bkg[lo[k]] + bkg[hi[k]]) / 2) for
+ *                    k = 0 .. n - 1 in order. Blocks flagged safe in the schedule go through Snip_Simd.
+ */
+template<typename T_real>
+void snip_pass(T_real* bkg, const int32_t* lo, const int32_t* hi, const uint8_t* block_safe, size_t n)
+{
+    const size_t lanes = Snip_Simd<T_real>::lanes;
+    size_t k = 0;
+    for (size_t b = 0; lanes > 1 && k + lanes <= n; b++, k += lanes)
+    {
+        if (block_safe[b])
+        {
+            Snip_Simd<T_real>::block(bkg, lo, hi, k);
+        }
+        else
+        {
+            for (size_t i = k; i < k + lanes; i++)
+            {
+                T_real temp = (bkg[lo[i]] + bkg[hi[i]]) / (T_real)2.0;
+                bkg[i] = (bkg[i] > temp) ? temp : bkg[i];
+            }
+        }
+    }
+    for (; k < n; k++)
+    {
+        T_real temp = (bkg[lo[k]] + bkg[hi[k]]) / (T_real)2.0;
+        bkg[k] = (bkg[k] > temp) ? temp : bkg[k];
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief snip_background : Estimate the background of spectra with a precomputed schedule built for spectra.size()
+ *                          channels. background is resized only when its size differs so callers can keep one
+ *                          buffer per thread.
+ */
+template<typename T_real>
+DLL_EXPORT void snip_background(const Spectra<T_real>& spectra, const Snip_Schedule<T_real>& schedule, ArrayTr<T_real>& background)
+{
+    const size_t n = spectra.size();
+    if (background.size() != (Eigen::Index)n)
+    {
+        background.resize(n);
+    }
+    if (n == 0)
+    {
+        return;
+    }
+
+    // smooth the background
+    if (n < 5)
+    {
+        background = convolve1d<T_real>(spectra, (size_t)5);
+    }
+    else
+    {
+        boxcar_smooth(spectra.data(), n, 5, background.data());
+    }
+
+    background = Eigen::log(Eigen::log(background + (T_real)1.0) + (T_real)1.0);
+
+    for (size_t pass = 0; pass < schedule.num_passes(); pass++)
+    {
+        snip_pass(background.data(), schedule.lo(pass), schedule.hi(pass), schedule.block_safe(pass), n);
+    }
+
+    background = Eigen::exp(Eigen::exp(background) - (T_real)1.0) - (T_real)1.0;
+    background = background.unaryExpr([](T_real v) { return std::isfinite(v) ? v : (T_real)0.0; });
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief The Snip_Background_Scope class : While one is alive on a thread, shared_snip_background() keeps every
+ *        background computed on that thread so routines fitting the same block of spectra back to back compute each
+ *        one once. Entries are keyed by spectra address, the scope must not outlive the block it was made for.
+ */
+template<typename T_real>
+class Snip_Background_Scope
+{
+public:
+
+    Snip_Background_Scope() : _prev(_active()), _cursor(0) { _active() = this; }
+
+    ~Snip_Background_Scope() { _active() = _prev; }
+
+    Snip_Background_Scope(const Snip_Background_Scope&) = delete;
+
+    Snip_Background_Scope& operator=(const Snip_Background_Scope&) = delete;
+
+    static Snip_Background_Scope* active() { return _active(); }
+
+    const ArrayTr<T_real>& background(const Spectra<T_real>& spectra, const std::shared_ptr<const Snip_Schedule<T_real>>& schedule)
+    {
+        // routines walk the block in the same order, start looking after the last hit
+        const size_t n = _entries.size();
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t idx = (_cursor + i) % n;
+            if (_entries[idx].spectra == &spectra && _entries[idx].schedule == schedule)
+            {
+                _cursor = idx + 1;
+                return _entries[idx].background;
+            }
+        }
+        _entries.emplace_back();
+        Entry& entry = _entries.back();
+        entry.spectra = &spectra;
+        entry.schedule = schedule;
+        snip_background(spectra, *schedule, entry.background);
+        _cursor = 0;
+        return entry.background;
+    }
+
+private:
+
+    struct Entry
+    {
+        const Spectra<T_real>* spectra;
+        std::shared_ptr<const Snip_Schedule<T_real>> schedule;
+        ArrayTr<T_real> background;
+    };
+
+    static Snip_Background_Scope*& _active()
+    {
+        thread_local Snip_Background_Scope* active = nullptr;
+        return active;
+    }
+
+    Snip_Background_Scope* _prev;
+
+    // deque so references handed out stay valid as it grows
+    std::deque<Entry> _entries;
+
+    size_t _cursor;
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief shared_snip_background : snip_background through the thread's Snip_Background_Scope if there is one,
+ *                                 otherwise computed into scratch. The reference is good until the scope ends or
+ *                                 scratch is reused.
+ */
+template<typename T_real>
+const ArrayTr<T_real>& shared_snip_background(const Spectra<T_real>& spectra, const std::shared_ptr<const Snip_Schedule<T_real>>& schedule, ArrayTr<T_real>& scratch)
+{
+    Snip_Background_Scope<T_real>* scope = Snip_Background_Scope<T_real>::active();
+    if (scope != nullptr)
+    {
+        return scope->background(spectra, schedule);
+    }
+    snip_background(spectra, *schedule, scratch);
+    return scratch;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+DLL_EXPORT ArrayTr<T_real> snip_background(const Spectra<T_real> * const spectra, T_real energy_offset, T_real energy_linear, T_real energy_quadratic, T_real width, T_real xmin, T_real xmax)
+{
+    ArrayTr<T_real> background;
+    if (spectra == nullptr || spectra->size() == 0)
+    {
+        return background;
+    }
+
+    std::shared_ptr<const Snip_Schedule<T_real>> schedule = get_snip_schedule(spectra->size(), energy_offset, energy_linear, energy_quadratic, width, xmin, xmax);
+    snip_background(*spectra, *schedule, background);
+    return background;
+}
+
+// ----------------------------------------------------------------------------
+
+} //namespace data_struct
+
+#endif // BACKGROUND_H
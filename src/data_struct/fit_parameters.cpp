@@ -57,6 +57,49 @@ namespace data_struct
 
 //-----------------------------------------------------------------------------
 
+// Must follow the order of Fit_Param_Id
+static const std::array<std::string, NUM_FIT_PARAM_IDS> Fit_Param_Id_Names = { {
+    STR_MIN_ENERGY_TO_FIT, STR_MAX_ENERGY_TO_FIT, STR_SI_ESCAPE, STR_GE_ESCAPE, STR_ESCAPE_LINEAR,
+    STR_ENERGY_OFFSET, STR_ENERGY_SLOPE, STR_ENERGY_QUADRATIC, STR_FWHM_OFFSET, STR_FWHM_FANOPRIME,
+    STR_COHERENT_SCT_ENERGY, STR_COHERENT_SCT_AMPLITUDE,
+    STR_COMPTON_ANGLE, STR_COMPTON_FWHM_CORR, STR_COMPTON_AMPLITUDE, STR_COMPTON_F_STEP, STR_COMPTON_F_TAIL, STR_COMPTON_GAMMA, STR_COMPTON_HI_F_TAIL, STR_COMPTON_HI_GAMMA,
+    STR_SNIP_WIDTH,
+    STR_F_STEP_OFFSET, STR_F_STEP_LINEAR, STR_F_STEP_QUADRATIC,
+    STR_F_TAIL_OFFSET, STR_F_TAIL_LINEAR, STR_F_TAIL_QUADRATIC,
+    STR_GAMMA_OFFSET, STR_GAMMA_LINEAR, STR_GAMMA_QUADRATIC,
+    STR_KB_F_TAIL_OFFSET, STR_KB_F_TAIL_LINEAR, STR_KB_F_TAIL_QUADRATIC } };
+
+//-----------------------------------------------------------------------------
+
+const std::string& fit_param_id_name(Fit_Param_Id id)
+{
+    return Fit_Param_Id_Names[static_cast<size_t>(id)];
+}
+
+//-----------------------------------------------------------------------------
+
+Fit_Param_Id fit_param_id(const std::string& name)
+{
+    static const std::unordered_map<std::string, Fit_Param_Id> name_to_id = []()
+    {
+        std::unordered_map<std::string, Fit_Param_Id> m;
+        for (size_t i = 0; i < NUM_FIT_PARAM_IDS; i++)
+        {
+            m[Fit_Param_Id_Names[i]] = static_cast<Fit_Param_Id>(i);
+        }
+        return m;
+    }();
+
+    const auto itr = name_to_id.find(name);
+    if (itr == name_to_id.end())
+    {
+        return Fit_Param_Id::COUNT;
+    }
+    return itr->second;
+}
+
+//-----------------------------------------------------------------------------
+
 template<typename T_real>
 const std::string Fit_Param<T_real>::bound_type_str() const
 {
@@ -87,13 +130,93 @@ const std::string Fit_Param<T_real>::bound_type_str() const
 //-----------------------------------------------------------------------------
 
 template<typename T_real>
-Fit_Parameters<T_real>::Fit_Parameters(const Fit_Parameters<T_real>& fit_pars)
+Fit_Parameters<T_real>::Fit_Parameters()
+{
+    _name_index = std::make_shared<Name_Index>();
+    _id_index.fill(-1);
+}
+
+//-----------------------------------------------------------------------------
+
+template<typename T_real>
+int Fit_Parameters<T_real>::_find(const std::string& name) const
+{
+    const auto itr = _name_index->find(name);
+    if (itr == _name_index->end())
+    {
+        return -1;
+    }
+    return static_cast<int>(itr->second);
+}
+
+//-----------------------------------------------------------------------------
+
+template<typename T_real>
+size_t Fit_Parameters<T_real>::_find_or_insert(const std::string& name)
+{
+    const int idx = _find(name);
+    if (idx > -1)
+    {
+        return static_cast<size_t>(idx);
+    }
+
+    if (_name_index.use_count() > 1)
+    {
+        _name_index = std::make_shared<Name_Index>(*_name_index);
+    }
+    const size_t new_idx = _params.size();
+    _params.emplace_back(name, Fit_Param<T_real>());
+    (*_name_index)[name] = new_idx;
+    const Fit_Param_Id id = fit_param_id(name);
+    if (id != Fit_Param_Id::COUNT)
+    {
+        _id_index[static_cast<size_t>(id)] = static_cast<int>(new_idx);
+    }
+    return new_idx;
+}
+
+//-----------------------------------------------------------------------------
+
+template<typename T_real>
+void Fit_Parameters<T_real>::_reindex()
+{
+    _name_index = std::make_shared<Name_Index>();
+    _id_index.fill(-1);
+    for (size_t i = 0; i < _params.size(); i++)
+    {
+        (*_name_index)[_params[i].first] = i;
+        const Fit_Param_Id id = fit_param_id(_params[i].first);
+        if (id != Fit_Param_Id::COUNT)
+        {
+            _id_index[static_cast<size_t>(id)] = static_cast<int>(i);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+template<typename T_real>
+Fit_Param<T_real>& Fit_Parameters<T_real>::operator [](Fit_Param_Id id)
+{
+    const int idx = _id_index[static_cast<size_t>(id)];
+    if (idx > -1)
+    {
+        return _params[idx].second;
+    }
+    return _params[_find_or_insert(fit_param_id_name(id))].second;
+}
+
+//-----------------------------------------------------------------------------
+
+template<typename T_real>
+const Fit_Param<T_real>& Fit_Parameters<T_real>::at(const std::string& name) const
 {
-    _params.clear();
-    for(const auto& itr : fit_pars._params)
+    const int idx = _find(name);
+    if (idx < 0)
     {
-        _params[itr.first] = itr.second;
+        throw std::out_of_range("Fit_Parameters::at " + name);
     }
+    return _params[idx].second;
 }
 
 //-----------------------------------------------------------------------------
@@ -101,7 +224,7 @@ Fit_Parameters<T_real>::Fit_Parameters(const Fit_Parameters<T_real>& fit_pars)
 template<typename T_real>
 void Fit_Parameters<T_real>::add_parameter(Fit_Param<T_real> param)
 {
-    _params[param.name] = param;
+    _params[_find_or_insert(param.name)].second = param;
 }
 
 //-----------------------------------------------------------------------------
@@ -109,9 +232,9 @@ void Fit_Parameters<T_real>::add_parameter(Fit_Param<T_real> param)
 template<typename T_real>
 void Fit_Parameters<T_real>::append_and_update(const Fit_Parameters& fit_params)
 {
-	for (typename std::unordered_map<std::string, Fit_Param<T_real>>::const_iterator itr = fit_params.begin(); itr != fit_params.end(); itr++ )
+	for (const auto& itr : fit_params)
 	{
-		_params[itr->first] = itr->second;	
+		_params[_find_or_insert(itr.first)].second = itr.second;
 	}
 }
 
@@ -121,11 +244,12 @@ template<typename T_real>
 std::vector<T_real> Fit_Parameters<T_real>::to_array()
 {
     std::vector<T_real> arr;
-    for(const auto& itr : _params)
+    arr.reserve(_params.size());
+    for(auto& itr : _params)
     {
         if (itr.second.bound_type != E_Bound_Type::FIXED)
         {
-            _params[itr.first].opt_array_index = arr.size();
+            itr.second.opt_array_index = static_cast<int>(arr.size());
             arr.push_back(itr.second.value);
         }
     }
@@ -138,9 +262,10 @@ template<typename T_real>
 std::vector<std::string> Fit_Parameters<T_real>::names_to_array()
 {
     std::vector<std::string> arr;
-    for(const auto& itr : _params)
+    arr.reserve(_params.size());
+    for(auto& itr : _params)
     {
-        _params[itr.first].opt_array_index = arr.size();
+        itr.second.opt_array_index = static_cast<int>(arr.size());
         arr.push_back(itr.first);
     }
     return arr;
@@ -151,11 +276,11 @@ std::vector<std::string> Fit_Parameters<T_real>::names_to_array()
 template<typename T_real>
 void Fit_Parameters<T_real>::sum_values(Fit_Parameters<T_real>  fit_params)
 {
-    for(const auto &itr : _params)
+    for(auto &itr : _params)
     {
-        if(fit_params.contains(itr.first) && itr.second.bound_type != E_Bound_Type::FIXED)
+        if(itr.second.bound_type != E_Bound_Type::FIXED && fit_params.contains(itr.first))
         {
-            _params[itr.first].value += fit_params[itr.first].value;
+            itr.second.value += fit_params.value(itr.first);
         }
     }
 }
@@ -165,11 +290,11 @@ void Fit_Parameters<T_real>::sum_values(Fit_Parameters<T_real>  fit_params)
 template<typename T_real>
 void Fit_Parameters<T_real>::divide_fit_values_by(T_real divisor)
 {
-    for(const auto &itr : _params)
+    for(auto &itr : _params)
     {
         if (itr.second.bound_type != E_Bound_Type::FIXED)
         {
-            _params[itr.first].value /= divisor;
+            itr.second.value /= divisor;
         }
     }
 
@@ -231,23 +356,25 @@ void Fit_Parameters<T_real>::update_values(const Fit_Parameters<T_real>  *overri
 {
     for(auto& itr : _params)
     {
-        if(override_fit_params->contains(itr.first))
+        const int idx = override_fit_params->_find(itr.first);
+        if(idx > -1)
         {
-            if( std::isfinite(override_fit_params->at(itr.first).value) )
+            const Fit_Param<T_real>& override_param = override_fit_params->_params[idx].second;
+            if( std::isfinite(override_param.value) )
             {
-                itr.second.value = override_fit_params->at(itr.first).value;
+                itr.second.value = override_param.value;
             }
-            if( std::isfinite(override_fit_params->at(itr.first).min_val) )
+            if( std::isfinite(override_param.min_val) )
             {
-                itr.second.min_val = override_fit_params->at(itr.first).min_val;
+                itr.second.min_val = override_param.min_val;
             }
-            if( std::isfinite(override_fit_params->at(itr.first).max_val) )
+            if( std::isfinite(override_param.max_val) )
             {
-                itr.second.max_val = override_fit_params->at(itr.first).max_val;
+                itr.second.max_val = override_param.max_val;
             }
-            if( override_fit_params->at(itr.first).bound_type != E_Bound_Type::NOT_INIT)
+            if( override_param.bound_type != E_Bound_Type::NOT_INIT)
             {
-                itr.second.bound_type = override_fit_params->at(itr.first).bound_type;
+                itr.second.bound_type = override_param.bound_type;
             }
         }
     }
@@ -258,9 +385,9 @@ void Fit_Parameters<T_real>::update_values(const Fit_Parameters<T_real>  *overri
 template<typename T_real>
 void Fit_Parameters<T_real>::update_and_add_values(Fit_Parameters<T_real>  *override_fit_params)
 {
-    for(auto& itr : *override_fit_params)
+    for(const auto& itr : *override_fit_params)
     {
-        _params[itr.first] = itr.second;
+        _params[_find_or_insert(itr.first)].second = itr.second;
     }
 }
 
@@ -269,11 +396,11 @@ void Fit_Parameters<T_real>::update_and_add_values(Fit_Parameters<T_real>  *over
 template<typename T_real>
 void Fit_Parameters<T_real>::update_and_add_values_gt_zero(Fit_Parameters<T_real>  *override_fit_params)
 {
-    for(auto& itr : *override_fit_params)
+    for(const auto& itr : *override_fit_params)
     {
         if(itr.second.value > 0.0)
         {
-            _params[itr.first] = itr.second;
+            _params[_find_or_insert(itr.first)].second = itr.second;
         }
     }
 }
@@ -312,12 +439,17 @@ void Fit_Parameters<T_real>::print_non_fixed()
 template<typename T_real>
 void Fit_Parameters<T_real>::remove(Fit_Parameters* override_fit_params)
 {
-    for (auto& itr : *override_fit_params)
+    if (override_fit_params == this)
     {
-        if (_params.count(itr.first) > 0)
-        {
-            _params.erase(itr.first);
-        }
+        _params.clear();
+        _reindex();
+        return;
+    }
+    const size_t old_size = _params.size();
+    _params.erase(std::remove_if(_params.begin(), _params.end(), [override_fit_params](const Entry& e) { return override_fit_params->contains(e.first); }), _params.end());
+    if (_params.size() != old_size)
+    {
+        _reindex();
     }
 }
 
@@ -326,9 +458,11 @@ void Fit_Parameters<T_real>::remove(Fit_Parameters* override_fit_params)
 template<typename T_real>
 void Fit_Parameters<T_real>::remove(std::string key)
 {
-    if (_params.count(key) > 0)
+    const int idx = _find(key);
+    if (idx > -1)
     {
-        _params.erase(key);
+        _params.erase(_params.begin() + idx);
+        _reindex();
     }
 
 }
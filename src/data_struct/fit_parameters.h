@@ -47,6 +47,9 @@
 #define Fit_Parameters_H
 
 #include <algorithm>
+#include <array>
+#include <memory>
+#include <stdexcept>
 #include <unordered_map>
 #include <string>
 #include <limits>
@@ -183,22 +186,63 @@ TEMPLATE_STRUCT_DLL_EXPORT Fit_Param<float>;
 TEMPLATE_STRUCT_DLL_EXPORT Fit_Param<double>;
 
 
+//-----------------------------------------------------------------------------
+/**
+ * @brief The Fit_Param_Id enum : Compile time ids for the parameters every model uses.
+ *                                Fit_Parameters keeps a direct slot for each so hot paths can skip the string hash.
+ */
+enum class Fit_Param_Id : int { MIN_ENERGY_TO_FIT=0, MAX_ENERGY_TO_FIT, SI_ESCAPE, GE_ESCAPE, ESCAPE_LINEAR,
+    ENERGY_OFFSET, ENERGY_SLOPE, ENERGY_QUADRATIC, FWHM_OFFSET, FWHM_FANOPRIME,
+    COHERENT_SCT_ENERGY, COHERENT_SCT_AMPLITUDE,
+    COMPTON_ANGLE, COMPTON_FWHM_CORR, COMPTON_AMPLITUDE, COMPTON_F_STEP, COMPTON_F_TAIL, COMPTON_GAMMA, COMPTON_HI_F_TAIL, COMPTON_HI_GAMMA,
+    SNIP_WIDTH,
+    F_STEP_OFFSET, F_STEP_LINEAR, F_STEP_QUADRATIC,
+    F_TAIL_OFFSET, F_TAIL_LINEAR, F_TAIL_QUADRATIC,
+    GAMMA_OFFSET, GAMMA_LINEAR, GAMMA_QUADRATIC,
+    KB_F_TAIL_OFFSET, KB_F_TAIL_LINEAR, KB_F_TAIL_QUADRATIC,
+    COUNT };
+
+constexpr size_t NUM_FIT_PARAM_IDS = static_cast<size_t>(Fit_Param_Id::COUNT);
+
+/**
+ * @brief fit_param_id_name : string name stored in Fit_Parameters for a core id
+ */
+DLL_EXPORT const std::string& fit_param_id_name(Fit_Param_Id id);
+
+/**
+ * @brief fit_param_id : core id for a parameter name, Fit_Param_Id::COUNT if it is not a core parameter (elements)
+ */
+DLL_EXPORT Fit_Param_Id fit_param_id(const std::string& name);
+
 //-----------------------------------------------------------------------------
 /**
  * @brief The Fit_Parameters class: Dictionary of fit parameters. Many fit routines use arrays so there are convert to and from array functions.
+ *                                   Parameters are stored densely in insertion order. Core parameters are also reachable by Fit_Param_Id
+ *                                   without hashing, all other names (elements) go through a name to index table that is shared between
+ *                                   copies until one of them adds or removes a parameter, so the per pixel copy is a flat vector copy.
  */
 template<typename T_real>
 class DLL_EXPORT Fit_Parameters
 {
 public:
 
-    Fit_Parameters(){}
+    typedef std::pair<std::string, Fit_Param<T_real> > Entry;
 
-    Fit_Parameters(const Fit_Parameters& fit_pars);
+    Fit_Parameters();
+
+    Fit_Parameters(const Fit_Parameters& fit_pars) = default;
+
+    Fit_Parameters(Fit_Parameters&& fit_pars) = default;
 
     ~Fit_Parameters(){_params.clear();}
 
-    Fit_Param<T_real>& operator [](std::string name) { return _params[name]; }
+    Fit_Parameters& operator=(const Fit_Parameters& fit_pars) = default;
+
+    Fit_Parameters& operator=(Fit_Parameters&& fit_pars) = default;
+
+    Fit_Param<T_real>& operator [](const std::string& name) { return _params[_find_or_insert(name)].second; }
+
+    Fit_Param<T_real>& operator [](Fit_Param_Id id);
 
     void add_parameter(Fit_Param<T_real> param);
 
@@ -212,7 +256,9 @@ public:
 
     void divide_fit_values_by(T_real divisor);
 
-    bool contains(std::string name) const { return ( _params.find(name) != _params.end()); }
+    bool contains(const std::string& name) const { return _find(name) > -1; }
+
+    bool contains(Fit_Param_Id id) const { return _id_index[static_cast<size_t>(id)] > -1; }
 
     std::vector<T_real> to_array();
 
@@ -236,19 +282,45 @@ public:
 
     void remove(std::string key);
 
-    inline const T_real& value(std::string key) const { return _params.at(key).value; }
+    inline const T_real& value(const std::string& key) const { return at(key).value; }
+
+    inline const T_real& value(Fit_Param_Id id) const { return at(id).value; }
 
     void print();
 
     void print_non_fixed();
 
-    const Fit_Param<T_real>& at(std::string name) const {return _params.at(name); }
+    const Fit_Param<T_real>& at(const std::string& name) const;
+
+    inline const Fit_Param<T_real>& at(Fit_Param_Id id) const
+    {
+        const int idx = _id_index[static_cast<size_t>(id)];
+        if (idx < 0)
+        {
+            throw std::out_of_range("Fit_Parameters::at " + fit_param_id_name(id));
+        }
+        return _params[idx].second;
+    }
 
     size_t size() const { return _params.size(); }
 
 private:
 
-    std::unordered_map<std::string, Fit_Param<T_real> > _params;
+    typedef std::unordered_map<std::string, size_t> Name_Index;
+
+    int _find(const std::string& name) const;
+
+    size_t _find_or_insert(const std::string& name);
+
+    void _reindex();
+
+    std::vector<Entry> _params;
+
+    // name -> index into _params, shared between copies and cloned before a copy changes it
+    std::shared_ptr<Name_Index> _name_index;
+
+    // index into _params for every core id, -1 if not added
+    std::array<int, NUM_FIT_PARAM_IDS> _id_index;
 
 };
 
@@ -290,11 +362,11 @@ DLL_EXPORT Range get_energy_range(T_real min_energy, T_real max_energy, size_t s
 template<typename T_real>
 DLL_EXPORT Range get_energy_range(size_t spectra_size, Fit_Parameters<T_real>* params)
 {
-    return get_energy_range(params->value(STR_MIN_ENERGY_TO_FIT),
-        params->value(STR_MAX_ENERGY_TO_FIT),
+    return get_energy_range(params->value(Fit_Param_Id::MIN_ENERGY_TO_FIT),
+        params->value(Fit_Param_Id::MAX_ENERGY_TO_FIT),
         spectra_size,
-        params->value(STR_ENERGY_OFFSET),
-        params->value(STR_ENERGY_SLOPE));
+        params->value(Fit_Param_Id::ENERGY_OFFSET),
+        params->value(Fit_Param_Id::ENERGY_SLOPE));
 }
 
 //-----------------------------------------------------------------------------
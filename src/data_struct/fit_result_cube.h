@@ -0,0 +1,253 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef Fit_Result_Cube_H
+#define Fit_Result_Cube_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/defines.h"
+#include "data_struct/fit_parameters.h"
+#include "data_struct/fit_element_map.h"
+
+namespace data_struct
+{
+
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief The Fit_Result_Layout class : Fixed slot for every value a fit reports for one pixel. The elements come
+ *        first in elements_to_fit order, followed by Num_Iter, Residual, total fluorescence yield and the elastic +
+ *        inelastic sum. Built once per run, after that a pixel's results are a plain T_real row of size() values.
+ */
+template<typename T_real>
+class Fit_Result_Layout
+{
+public:
+
+    explicit Fit_Result_Layout(const Fit_Element_Map_Dict<T_real>* const elements_to_fit)
+    {
+        _elements_to_fit = elements_to_fit;
+        for (const auto& itr : *elements_to_fit)
+        {
+            _add(itr.first);
+        }
+        _num_elements = _names.size();
+        _num_iter_slot = _add(STR_NUM_ITR);
+        _residual_slot = _add(STR_RESIDUAL);
+        _total_fluorescence_yield_slot = _add(STR_TOTAL_FLUORESCENCE_YIELD);
+        _sum_elastic_inelastic_slot = _add(STR_SUM_ELASTIC_INELASTIC_AMP);
+        _coherent_slot = slot(STR_COHERENT_SCT_AMPLITUDE);
+        _compton_slot = slot(STR_COMPTON_AMPLITUDE);
+    }
+
+    const Fit_Element_Map_Dict<T_real>* elements_to_fit() const { return _elements_to_fit; }
+
+    /**
+     * @brief same_elements : True if elements_to_fit holds exactly this layout's element names in the same order, so
+     *        every slot still applies. Compares names, not the pointer, a freed dict's address can come back for another.
+     */
+    bool same_elements(const Fit_Element_Map_Dict<T_real>* const elements_to_fit) const
+    {
+        if (elements_to_fit->size() != _num_elements)
+        {
+            return false;
+        }
+        size_t i = 0;
+        for (const auto& itr : *elements_to_fit)
+        {
+            if (itr.first != _names[i++])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // point at another dict that is same_elements(), the slots are unchanged
+    void rebind(const Fit_Element_Map_Dict<T_real>* const elements_to_fit) { _elements_to_fit = elements_to_fit; }
+
+    size_t size() const { return _names.size(); }
+
+    // slots [0, num_elements()) are the elements
+    size_t num_elements() const { return _num_elements; }
+
+    const std::string& name(size_t slot) const { return _names[slot]; }
+
+    // -1 if name has no slot
+    int slot(const std::string& name) const
+    {
+        const auto& itr = _slots.find(name);
+        return itr == _slots.end() ? -1 : (int)itr->second;
+    }
+
+    size_t num_iter_slot() const { return _num_iter_slot; }
+
+    size_t residual_slot() const { return _residual_slot; }
+
+    size_t total_fluorescence_yield_slot() const { return _total_fluorescence_yield_slot; }
+
+    size_t sum_elastic_inelastic_slot() const { return _sum_elastic_inelastic_slot; }
+
+    // -1 if the scatter amplitude is not fit
+    int coherent_slot() const { return _coherent_slot; }
+
+    int compton_slot() const { return _compton_slot; }
+
+    /**
+     * @brief assign_counts : Copy a named counts dict into a pixel's row, names without a slot are ignored.
+     */
+    void assign_counts(const std::unordered_map<std::string, T_real>& counts, T_real* const out_row) const
+    {
+        for (const auto& itr : counts)
+        {
+            const auto& slot_itr = _slots.find(itr.first);
+            if (slot_itr != _slots.end())
+            {
+                out_row[slot_itr->second] = itr.second;
+            }
+        }
+    }
+
+private:
+
+    size_t _add(const std::string& name)
+    {
+        const auto& itr = _slots.find(name);
+        if (itr != _slots.end())
+        {
+            return itr->second;
+        }
+        _slots[name] = _names.size();
+        _names.push_back(name);
+        return _names.size() - 1;
+    }
+
+    const Fit_Element_Map_Dict<T_real>* _elements_to_fit;
+
+    std::vector<std::string> _names;
+
+    std::unordered_map<std::string, size_t> _slots;
+
+    size_t _num_elements;
+
+    size_t _num_iter_slot;
+
+    size_t _residual_slot;
+
+    size_t _total_fluorescence_yield_slot;
+
+    size_t _sum_elastic_inelastic_slot;
+
+    int _coherent_slot;
+
+    int _compton_slot;
+};
+
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief The Fit_Result_Cube class : Results of a fit over a rows x cols scan, one contiguous row major plane per
+ *        layout slot (element major). Pixels are written by slot and position, names are only used again when the
+ *        cube is handed to the file writers.
+ */
+template<typename T_real>
+class Fit_Result_Cube
+{
+public:
+
+    typedef Eigen::Map<ArrayXXr<T_real> > Plane_Map;
+
+    Fit_Result_Cube(const Fit_Result_Layout<T_real>& layout, size_t rows, size_t cols) : _layout(layout)
+    {
+        _rows = rows;
+        _cols = cols;
+        _data.assign(layout.size() * rows * cols, (T_real)0.0);
+    }
+
+    const Fit_Result_Layout<T_real>& layout() const { return _layout; }
+
+    size_t rows() const { return _rows; }
+
+    size_t cols() const { return _cols; }
+
+    T_real& at(size_t slot, size_t row, size_t col) { return _data[(slot * _rows + row) * _cols + col]; }
+
+    T_real at(size_t slot, size_t row, size_t col) const { return _data[(slot * _rows + row) * _cols + col]; }
+
+    Plane_Map plane(size_t slot) { return Plane_Map(&_data[slot * _rows * _cols], _rows, _cols); }
+
+    /**
+     * @brief to_fit_count_dict : Copy each plane into a named dict for the writers that take one. Caller deletes it.
+     */
+    Fit_Count_Dict<T_real>* to_fit_count_dict()
+    {
+        Fit_Count_Dict<T_real>* counts_dict = new Fit_Count_Dict<T_real>();
+        for (size_t s = 0; s < _layout.size(); s++)
+        {
+            (*counts_dict)[_layout.name(s)] = plane(s);
+        }
+        return counts_dict;
+    }
+
+private:
+
+    Fit_Result_Layout<T_real> _layout;
+
+    size_t _rows;
+
+    size_t _cols;
+
+    std::vector<T_real> _data;
+};
+
+//-----------------------------------------------------------------------------
+
+} //namespace data_struct
+
+#endif // Fit_Result_Cube_H
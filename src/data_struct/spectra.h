@@ -53,6 +53,17 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <Eigen/Core>
 #include <vector>
 #include <functional>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <string>
+
+#if !defined _WIN32 && !defined __CYGWIN__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace data_struct
 {
@@ -67,126 +78,473 @@ using ArrayTr = Eigen::Array<_T, Eigen::Dynamic, Eigen::RowMajor>;
 template<typename _T>
 using VectorTr = Eigen::Vector<_T, Eigen::Dynamic>;
 
+#define SPECTRA_ALIGN_BYTES 64
+
+/**
+ * @brief The Spectra_Slab class : One 64 byte aligned block holding the samples of many spectra
+ *        (pixel major, each spectra padded to a multiple of SPECTRA_ALIGN_BYTES) followed by
+ *        elapsed livetime, elapsed realtime, input counts and output counts as parallel arrays.
+ *        The block is either heap memory or a shared mapping of a scratch file (alloc_mapped).
+ */
 template<typename _T>
-class Spectra : public ArrayTr<_T>
+class Spectra_Slab
 {
 public:
+    Spectra_Slab() : _buf(nullptr), _data(nullptr), _meta(nullptr), _num_spectra(0), _samples(0), _stride(0), _fd(-1), _map_bytes(0)
+    {
+
+    }
+
+    Spectra_Slab(const Spectra_Slab&) = delete;
+
+    Spectra_Slab& operator=(const Spectra_Slab&) = delete;
+
+    Spectra_Slab(Spectra_Slab&& slab) noexcept : Spectra_Slab()
+    {
+        _swap(slab);
+    }
+
+    Spectra_Slab& operator=(Spectra_Slab&& slab) noexcept
+    {
+        if (this != &slab)
+        {
+            release();
+            _swap(slab);
+        }
+        return *this;
+    }
+
+    ~Spectra_Slab()
+    {
+        release();
+    }
+
+    // bytes alloc() / alloc_mapped() need for num_spectra x samples
+    static size_t required_bytes(size_t num_spectra, size_t samples)
+    {
+        return (num_spectra * _padded(samples) + _padded(4 * num_spectra)) * sizeof(_T);
+    }
+
+    bool alloc(size_t num_spectra, size_t samples)
+    {
+        release();
+        const size_t align_elems = SPECTRA_ALIGN_BYTES / sizeof(_T);
+        // calloc lets the os hand back zeroed pages lazily so untouched pixels do not count against rss
+        _buf = std::calloc((required_bytes(num_spectra, samples) / sizeof(_T)) + align_elems, sizeof(_T));
+        if (_buf == nullptr)
+        {
+            logE << "Failed to allocate spectra slab of " << num_spectra << " x " << samples << "\n";
+            return false;
+        }
+        size_t addr = reinterpret_cast<size_t>(_buf);
+        addr = (addr + SPECTRA_ALIGN_BYTES - 1) & ~(size_t)(SPECTRA_ALIGN_BYTES - 1);
+        _init(reinterpret_cast<_T*>(addr), num_spectra, samples);
+        return true;
+    }
+
+    /**
+     * @brief alloc_mapped : Same layout as alloc() but backed by an unlinked scratch file in scratch_dir, so the os
+     *                       pages spectra out to disk instead of the whole block having to fit in memory.
+     *                       Falls back to alloc() where mmap is not available.
+     */
+    bool alloc_mapped(size_t num_spectra, size_t samples, const std::string& scratch_dir)
+    {
+#if defined _WIN32 || defined __CYGWIN__
+        logW << "Scratch file backed spectra are not supported on this platform, allocating in memory\n";
+        return alloc(num_spectra, samples);
+#else
+        release();
+        std::string path = scratch_dir;
+        if (path.length() > 0 && path.back() != '/')
+        {
+            path += '/';
+        }
+        path += "xrf_maps_spectra_XXXXXX";
+        std::vector<char> filename(path.begin(), path.end());
+        filename.push_back('\0');
+        int fd = mkstemp(filename.data());
+        if (fd < 0)
+        {
+            logE << "Failed to create scratch file " << path << "\n";
+            return false;
+        }
+        // only the mapping refers to the file, the os removes it once it is unmapped and closed
+        unlink(filename.data());
+
+        const size_t bytes = required_bytes(num_spectra, samples);
+        // reserve the blocks now. A sparse file on a full disk would fail later as SIGBUS in the middle of a load
+#if defined __APPLE__
+        int err = ENOTSUP;
+#else
+        int err = posix_fallocate(fd, 0, (off_t)bytes);
+#endif
+        if (err == EOPNOTSUPP || err == ENOTSUP)
+        {
+            // file system can not preallocate, sparse is all we get
+            err = (ftruncate(fd, (off_t)bytes) == 0) ? 0 : errno;
+        }
+        if (err != 0)
+        {
+            logE << "Failed to reserve " << bytes << " bytes of scratch file in " << scratch_dir << " : " << std::strerror(err) << "\n";
+            close(fd);
+            return false;
+        }
+        void* addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            logE << "Failed to map " << bytes << " bytes of scratch file in " << scratch_dir << "\n";
+            close(fd);
+            return false;
+        }
+        _buf = addr;
+        _fd = fd;
+        _map_bytes = bytes;
+        // page aligned, and the file starts out zeroed like calloc
+        _init(reinterpret_cast<_T*>(addr), num_spectra, samples);
+        return true;
+#endif
+    }
+
+    void release()
+    {
+#if !defined _WIN32 && !defined __CYGWIN__
+        if (_fd > -1)
+        {
+            munmap(_buf, _map_bytes);
+            close(_fd);
+            _buf = nullptr;
+        }
+#endif
+        if (_buf != nullptr)
+        {
+            std::free(_buf);
+        }
+        _fd = -1;
+        _map_bytes = 0;
+        _buf = nullptr;
+        _data = nullptr;
+        _meta = nullptr;
+        _num_spectra = 0;
+        _samples = 0;
+        _stride = 0;
+    }
+
+    _T* spectra_data(size_t idx) { return _data + (idx * _stride); }
+
+    // elapsed livetime of spectra idx, realtime, input and output counts follow at meta_stride() offsets
+    _T* meta(size_t idx) { return _meta + idx; }
+
+    _T* data() { return _data; }
+
+    size_t meta_stride() const { return _num_spectra; }
+
+    size_t num_spectra() const { return _num_spectra; }
+
+    size_t samples() const { return _samples; }
+
+    size_t stride() const { return _stride; }
+
+    bool is_mapped() const { return _fd > -1; }
+
+    /**
+     * @brief advise : Tell the os spectra [first, first + count) are needed soon (read ahead from the scratch file)
+     *                 or not needed anymore (drop them from memory, they stay in the file). No-op unless mapped.
+     */
+    void advise(size_t first, size_t count, bool will_need)
+    {
+#if !defined _WIN32 && !defined __CYGWIN__
+        if (_fd < 0 || count == 0)
+        {
+            return;
+        }
+        const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t begin = reinterpret_cast<size_t>(spectra_data(first));
+        size_t end = reinterpret_cast<size_t>(spectra_data(first + count));
+        begin &= ~(page - 1);
+        madvise(reinterpret_cast<void*>(begin), end - begin, will_need ? MADV_WILLNEED : MADV_DONTNEED);
+#endif
+    }
+
+private:
+
+    static size_t _padded(size_t elems)
+    {
+        const size_t align_elems = SPECTRA_ALIGN_BYTES / sizeof(_T);
+        return ((elems + align_elems - 1) / align_elems) * align_elems;
+    }
+
+    void _init(_T* data, size_t num_spectra, size_t samples)
+    {
+        _data = data;
+        _stride = _padded(samples);
+        _meta = _data + (num_spectra * _stride);
+        _num_spectra = num_spectra;
+        _samples = samples;
+        for (size_t i = 0; i < num_spectra; i++)
+        {
+            _meta[i] = (_T)default_time_and_io_counts;
+            _meta[num_spectra + i] = (_T)default_time_and_io_counts;
+        }
+    }
+
+    void _swap(Spectra_Slab& slab)
+    {
+        std::swap(_buf, slab._buf);
+        std::swap(_data, slab._data);
+        std::swap(_meta, slab._meta);
+        std::swap(_num_spectra, slab._num_spectra);
+        std::swap(_samples, slab._samples);
+        std::swap(_stride, slab._stride);
+        std::swap(_fd, slab._fd);
+        std::swap(_map_bytes, slab._map_bytes);
+    }
+
+    void* _buf;
+    _T* _data;
+    _T* _meta;
+    size_t _num_spectra;
+    size_t _samples;
+    size_t _stride;
+    // scratch file descriptor and mapping size, -1 / 0 for heap memory
+    int _fd;
+    size_t _map_bytes;
+};
+
+/**
+ * @brief The Spectra class : A single spectra. Either owns its samples or is a non owning view
+ *        into a Spectra_Slab (see Spectra_Line and Spectra_Volume). Copies always own their data.
+ */
+template<typename _T>
+class Spectra : public Eigen::Map<ArrayTr<_T>>
+{
+public:
+
+    typedef Eigen::Map<ArrayTr<_T>> Base;
+
     /**
      * @brief Spectra : Constructor
      */
-    Spectra() : ArrayTr<_T>()
+    Spectra() : Base(nullptr, 0)
 	{
-        _elapsed_livetime = default_time_and_io_counts;
-		_elapsed_realtime = default_time_and_io_counts;
-		_input_counts = 0.0;
-		_output_counts = 0.0;
+        _init_meta(default_time_and_io_counts, default_time_and_io_counts, 0.0, 0.0);
 	}
 
-    Spectra(const Spectra &spectra) : ArrayTr<_T>(spectra)
+    Spectra(const Spectra &spectra) : Base(nullptr, 0), _own(spectra)
 	{
-        _elapsed_livetime = spectra._elapsed_livetime;
-		_elapsed_realtime = spectra._elapsed_realtime;
-		_input_counts = spectra._input_counts;
-		_output_counts = spectra._output_counts;
+        _rebind();
+        _init_meta(spectra.elapsed_livetime(), spectra.elapsed_realtime(), spectra.input_counts(), spectra.output_counts());
 	}
 
-    Spectra(size_t sample_size) : ArrayTr<_T>(sample_size)
+    Spectra(Spectra &&spectra) noexcept : Base(nullptr, 0)
+    {
+        if (spectra._is_view)
+        {
+            // stays a view of the same slab, keeps std::vector reallocation from detaching a line
+            new (static_cast<Base*>(this)) Base(spectra.data(), spectra.size());
+            _is_view = true;
+            _meta = spectra._meta;
+            _meta_stride = spectra._meta_stride;
+        }
+        else
+        {
+            _own = std::move(spectra._own);
+            spectra._rebind();
+            _rebind();
+            _init_meta(spectra.elapsed_livetime(), spectra.elapsed_realtime(), spectra.input_counts(), spectra.output_counts());
+        }
+    }
+
+    Spectra(size_t sample_size) : Base(nullptr, 0), _own(sample_size)
 	{
+        _rebind();
 		this->setZero();
-        _elapsed_livetime = default_time_and_io_counts;
-		_elapsed_realtime = default_time_and_io_counts;
-		_input_counts = 0.0;
-		_output_counts = 0.0;
+        _init_meta(default_time_and_io_counts, default_time_and_io_counts, 0.0, 0.0);
 	}
 
-    Spectra(size_t sample_size, _T elt, _T ert, _T incnt, _T outcnt) : ArrayTr<_T>(sample_size)
+    Spectra(size_t sample_size, _T elt, _T ert, _T incnt, _T outcnt) : Base(nullptr, 0), _own(sample_size)
     {
+        _rebind();
         this->setZero();
-        _elapsed_livetime = elt;
-        _elapsed_realtime = ert;
-        _input_counts = incnt;
-        _output_counts = outcnt;
+        _init_meta(elt, ert, incnt, outcnt);
     }
 
-    Spectra(const ArrayTr<_T>& arr) : ArrayTr<_T>(arr)
+    Spectra(const ArrayTr<_T>& arr) : Base(nullptr, 0), _own(arr)
     {
-        _elapsed_livetime = default_time_and_io_counts;
-        _elapsed_realtime = default_time_and_io_counts;
-        _input_counts = 0.0;
-        _output_counts = 0.0;
+        _rebind();
+        _init_meta(default_time_and_io_counts, default_time_and_io_counts, 0.0, 0.0);
     }
 
-    Spectra(const ArrayTr<_T>& arr, _T livetime, _T realtime, _T incnt, _T outnt) : ArrayTr<_T>(arr)
+    Spectra(const ArrayTr<_T>& arr, _T livetime, _T realtime, _T incnt, _T outnt) : Base(nullptr, 0), _own(arr)
     {
-        _elapsed_livetime = livetime;
-        _elapsed_realtime = realtime;
-        _input_counts = incnt;
-        _output_counts = outnt;
+        _rebind();
+        _init_meta(livetime, realtime, incnt, outnt);
     }
 
-    Spectra(const ArrayTr<_T>&& arr) : ArrayTr<_T>(arr)
+    Spectra(ArrayTr<_T>&& arr) : Base(nullptr, 0), _own(std::move(arr))
     {
-        _elapsed_livetime = default_time_and_io_counts;
-        _elapsed_realtime = default_time_and_io_counts;
-        _input_counts = 0.0;
-        _output_counts = 0.0;
+        _rebind();
+        _init_meta(default_time_and_io_counts, default_time_and_io_counts, 0.0, 0.0);
     }
 
-    Spectra(const ArrayTr<_T>&& arr, _T livetime, _T realtime, _T incnt, _T outnt) : ArrayTr<_T>(arr)
+    Spectra(ArrayTr<_T>&& arr, _T livetime, _T realtime, _T incnt, _T outnt) : Base(nullptr, 0), _own(std::move(arr))
     {
-        _elapsed_livetime = livetime;
-        _elapsed_realtime = realtime;
-        _input_counts = incnt;
-        _output_counts = outnt;
+        _rebind();
+        _init_meta(livetime, realtime, incnt, outnt);
     }
 
-    Spectra(Eigen::Index& rows, Eigen::Index& cols) : ArrayTr<_T>(rows, cols)
+    Spectra(Eigen::Index& rows, Eigen::Index& cols) : Base(nullptr, 0), _own(rows, cols)
 	{
-        _elapsed_livetime = default_time_and_io_counts;
-        _elapsed_realtime = default_time_and_io_counts;
-        _input_counts = 0.0;
-        _output_counts = 0.0;
+        _rebind();
+        _init_meta(default_time_and_io_counts, default_time_and_io_counts, 0.0, 0.0);
 	}
 
+    /**
+     * @brief Spectra : Non owning view of samples and meta data stored in a slab.
+     * @param data : first sample
+     * @param sample_size : number of samples
+     * @param meta : elapsed livetime, realtime, input counts and output counts spaced meta_stride apart
+     * @param meta_stride : distance between the meta data arrays
+     */
+    Spectra(_T* data, size_t sample_size, _T* meta, size_t meta_stride) : Base(data, sample_size)
+    {
+        _is_view = true;
+        _meta = meta;
+        _meta_stride = meta_stride;
+    }
+
     virtual ~Spectra()
     {
 
     }
 
+    Spectra& operator=(const Spectra& spectra)
+    {
+        if (this != &spectra)
+        {
+            resize(spectra.size());
+            Base::operator=(spectra);
+            _set_meta(spectra.elapsed_livetime(), spectra.elapsed_realtime(), spectra.input_counts(), spectra.output_counts());
+        }
+        return *this;
+    }
+
+    Spectra& operator=(Spectra&& spectra)
+    {
+        if (_is_view || spectra._is_view)
+        {
+            return operator=((const Spectra&)spectra);
+        }
+        _own = std::move(spectra._own);
+        spectra._rebind();
+        _rebind();
+        _set_meta(spectra.elapsed_livetime(), spectra.elapsed_realtime(), spectra.input_counts(), spectra.output_counts());
+        return *this;
+    }
+
+    template<typename Derived>
+    Spectra& operator=(const Eigen::DenseBase<Derived>& other)
+    {
+        if (other.size() != this->size())
+        {
+            // evaluate first, other may reference our own samples
+            ArrayTr<_T> tmp = other;
+            resize(tmp.size());
+            Base::operator=(tmp);
+        }
+        else
+        {
+            Base::operator=(other);
+        }
+        return *this;
+    }
+
+    void resize(Eigen::Index sample_size)
+    {
+        if (sample_size == this->size())
+        {
+            return;
+        }
+        if (_is_view)
+        {
+            // can not grow a view in place, detach from the slab
+            logW << "Resizing spectra view from " << this->size() << " to " << sample_size << ", detaching from volume storage\n";
+            _T elt = elapsed_livetime();
+            _T ert = elapsed_realtime();
+            _T incnt = input_counts();
+            _T outcnt = output_counts();
+            _init_meta(elt, ert, incnt, outcnt);
+        }
+        _own.resize(sample_size);
+        _rebind();
+    }
+
+    void resize(Eigen::Index rows, Eigen::Index cols)
+    {
+        resize(rows * cols);
+    }
+
+    Spectra& setZero()
+    {
+        Base::setZero();
+        return *this;
+    }
+
+    Spectra& setZero(Eigen::Index sample_size)
+    {
+        resize(sample_size);
+        Base::setZero();
+        return *this;
+    }
+
+    Spectra& setConstant(const _T& val)
+    {
+        Base::setConstant(val);
+        return *this;
+    }
+
+    Spectra& setConstant(Eigen::Index sample_size, const _T& val)
+    {
+        resize(sample_size);
+        Base::setConstant(val);
+        return *this;
+    }
+
+    bool is_view() const { return _is_view; }
+
     void recalc_elapsed_livetime()
     {
-        if(_input_counts == 0 || _output_counts == 0)
+        if(input_counts() == 0 || output_counts() == 0)
         {
-            _elapsed_livetime = _elapsed_realtime;
+            elapsed_livetime(elapsed_realtime());
         }
         else
         {
-            _elapsed_livetime = _elapsed_realtime * _output_counts / _input_counts;
+            elapsed_livetime(elapsed_realtime() * output_counts() / input_counts());
         }
     }
 
     void add(const Spectra<_T>& spectra)
     {
-        *this += (ArrayTr<_T>)spectra;
+        *this += spectra;
         _T val = spectra.elapsed_livetime();
         if(std::isfinite(val))
         {
-            _elapsed_livetime += val;
+            _meta[0] += val;
         }
         val = spectra.elapsed_realtime();
         if(std::isfinite(val))
         {
-            _elapsed_realtime += val;
+            _meta[_meta_stride] += val;
         }
         val = spectra.input_counts();
         if(std::isfinite(val))
         {
-            _input_counts += val;
+            _meta[2 * _meta_stride] += val;
         }
         val = spectra.output_counts();
         if(std::isfinite(val))
         {
-            _output_counts += val;
+            _meta[3 * _meta_stride] += val;
         }
     }
 
@@ -203,221 +561,85 @@ public:
             _T val = spectra->elapsed_livetime();
             if (std::isfinite(val))
             {
-                _elapsed_livetime += val;
+                _meta[0] += val;
             }
             val = spectra->elapsed_realtime();
             if (std::isfinite(val))
             {
-                _elapsed_realtime += val;
+                _meta[_meta_stride] += val;
             }
             val = spectra->input_counts();
             if (std::isfinite(val))
             {
-                _input_counts += val;
+                _meta[2 * _meta_stride] += val;
             }
             val = spectra->output_counts();
             if (std::isfinite(val))
             {
-                _output_counts += val;
+                _meta[3 * _meta_stride] += val;
             }
         }
     }
 
-    void elapsed_livetime(_T val) { _elapsed_livetime = val; }
+    void elapsed_livetime(_T val) { _meta[0] = val; }
 
-    const _T elapsed_livetime() const { return _elapsed_livetime; }
+    const _T elapsed_livetime() const { return _meta[0]; }
 
-    void elapsed_realtime(_T val) { _elapsed_realtime = val; }
+    void elapsed_realtime(_T val) { _meta[_meta_stride] = val; }
 
-    const _T elapsed_realtime() const { return _elapsed_realtime; }
+    const _T elapsed_realtime() const { return _meta[_meta_stride]; }
 
-    void input_counts(_T val) { _input_counts = val; }
+    void input_counts(_T val) { _meta[2 * _meta_stride] = val; }
 
-    const _T input_counts() const { return _input_counts; }
+    const _T input_counts() const { return _meta[2 * _meta_stride]; }
 
-    void output_counts(_T val) { _output_counts = val; }
+    void output_counts(_T val) { _meta[3 * _meta_stride] = val; }
 
-    const _T output_counts() const { return _output_counts; }
+    const _T output_counts() const { return _meta[3 * _meta_stride]; }
 
     Spectra sub_spectra(size_t start, size_t count) const
 	{
-        return Spectra(this->segment(start, count), _elapsed_livetime, _elapsed_realtime, _input_counts, _output_counts);
+        return Spectra(ArrayTr<_T>(this->segment(start, count)), elapsed_livetime(), elapsed_realtime(), input_counts(), output_counts());
 	}
 
 private:
 
-    _T _elapsed_livetime;
-    _T _elapsed_realtime;
-    _T _input_counts;
-    _T _output_counts;
-
-};
-
-TEMPLATE_CLASS_DLL_EXPORT Spectra<float>;
-TEMPLATE_CLASS_DLL_EXPORT Spectra<double>;
-
-// ----------------------------------------------------------------------------
-
-template<typename T_real>
-DLL_EXPORT ArrayTr<T_real> convolve1d(const ArrayTr<T_real>& arr, const ArrayTr<T_real>& boxcar)
-{
-    ArrayTr<T_real> new_background(arr.size());
-    new_background.setZero(arr.size());
-    //convolve 1d
-
-    size_t const nf = arr.size();
-    size_t const ng = boxcar.size();
-    ArrayTr<T_real> const& min_v = (nf < ng) ? arr : boxcar;
-    ArrayTr<T_real> const& max_v = (nf < ng) ? boxcar : arr;
-    size_t const n = std::max(nf, ng) - std::min(nf, ng) + 1;
-    ArrayTr<T_real> out(n);
-    out.setZero(n);
-    for (size_t i = 0; i < n; ++i)
-    {
-        for (int j(min_v.size() - 1), k(i); j >= 0; --j)
-        {
-            out[i] += min_v[j] * max_v[k];
-            ++k;
-        }
-    }
-    T_real norm = 1 / T_real(boxcar.size());
-    int j = min_v.size() / 2;
-    for (size_t i = 0; i < n; i++)
+    void _rebind()
     {
-        new_background[j] = out[i] * norm;
-        j++;
+        // Eigen::Map can not be re-seated, construct it again over the owned buffer
+        new (static_cast<Base*>(this)) Base(_own.data(), _own.size());
     }
 
-    return new_background;
-}
-
-// ----------------------------------------------------------------------------
-
-template<typename T_real>
-DLL_EXPORT ArrayTr<T_real> convolve1d(const ArrayTr<T_real>& arr, size_t boxcar_size)
-{
-    ArrayTr<T_real> boxcar(boxcar_size);
-    boxcar.setConstant(boxcar_size, 1.0);
-    return convolve1d(arr, boxcar);
-}
-
-// ----------------------------------------------------------------------------
-
-template<typename T_real>
-DLL_EXPORT ArrayTr<T_real> snip_background(const Spectra<T_real> * const spectra, T_real energy_offset, T_real energy_linear, T_real energy_quadratic, T_real width, T_real xmin, T_real xmax)
-{
-    ArrayTr<T_real> energy = ArrayTr<T_real>::LinSpaced(spectra->size(), 0, spectra->size() - 1);
-
-    ArrayTr<T_real> background;
-
-    energy = energy_offset + (energy * energy_linear) + (Eigen::pow(energy, (T_real)2.0) * energy_quadratic);
-
-    ArrayTr<T_real> tmp = std::pow((energy_offset / (T_real)2.3548), (T_real)2.0) + energy * (T_real)2.96 * energy_linear;
-    tmp = tmp.unaryExpr([](T_real r) { return r < 0.0 ? (T_real)0.0 : r;  });
-
-    //ArrayTr<T_real> fwhm = 2.35 * std::sqrt(tmp);
-    ArrayTr<T_real> current_width = (T_real)2.35 * Eigen::sqrt(tmp);
-
-    ArrayTr<T_real> boxcar;
-    // smooth the background
-    boxcar.resize(5);
-    boxcar.setConstant(5, 1.0);
-
-
-    if (spectra != nullptr)
+    void _init_meta(_T elt, _T ert, _T incnt, _T outcnt)
     {
-        if (spectra->size() > 0)
-        {
-            //convolve 1d
-            background = convolve1d(*spectra, boxcar);
-        }
-        else
-        {
-            return background;
-        }
+        _is_view = false;
+        _meta = _own_meta;
+        _meta_stride = 1;
+        _set_meta(elt, ert, incnt, outcnt);
     }
-    else
+
+    void _set_meta(_T elt, _T ert, _T incnt, _T outcnt)
     {
-        return background;
+        _meta[0] = elt;
+        _meta[_meta_stride] = ert;
+        _meta[2 * _meta_stride] = incnt;
+        _meta[3 * _meta_stride] = outcnt;
     }
-    //fwhm
-    current_width = width * current_width / energy_linear;  // in channels
 
-    background = Eigen::log(Eigen::log(background + (T_real)1.0) + (T_real)1.0);
+    ArrayTr<_T> _own;
 
-    // FIRST SNIPPING
-    int no_iterations = 2;
+    _T _own_meta[4];
 
-    int max_of_xmin = (std::max)(xmin, (T_real)0.0);
-    int min_of_xmax = (std::min)(xmax, T_real(spectra->size() - 1));
-    for (int j = 0; j < no_iterations; j++)
-    {
-        for (long int k = 0; k < background.size(); k++)
-        {
-            long int lo_index = k - current_width[k];
-            long int hi_index = k + current_width[k];
-            if (lo_index < max_of_xmin)
-            {
-                lo_index = max_of_xmin;
-            }
-            if (lo_index > min_of_xmax)
-            {
-                lo_index = min_of_xmax;
-            }
-            if (hi_index > min_of_xmax)
-            {
-                hi_index = min_of_xmax;
-            }
-            if (hi_index < max_of_xmin)
-            {
-                hi_index = max_of_xmin;
-            }
-            T_real temp = (background[lo_index] + background[hi_index]) / (T_real)2.0;
-            if (background[k] > temp)
-            {
-                background[k] = temp;
-            }
-        }
-    }
+    _T* _meta;
 
-    while (current_width.maxCoeff() >= 0.5)
-    {
-        for (long int k = 0; k < background.size(); k++)
-        {
-            long int lo_index = k - current_width[k];
-            long int hi_index = k + current_width[k];
-            if (lo_index < max_of_xmin)
-            {
-                lo_index = max_of_xmin;
-            }
-            if (lo_index > min_of_xmax)
-            {
-                lo_index = min_of_xmax;
-            }
-            if (hi_index > min_of_xmax)
-            {
-                hi_index = min_of_xmax;
-            }
-            if (hi_index < max_of_xmin)
-            {
-                hi_index = max_of_xmin;
-            }
-            T_real temp = (background[lo_index] + background[hi_index]) / (T_real)2.0;
-            if (background[k] > temp)
-            {
-                background[k] = temp;
-            }
-        }
-
-        current_width = current_width / T_real(M_SQRT2); // window_rf
-    }
+    size_t _meta_stride;
 
-    background = Eigen::exp(Eigen::exp(background) - (T_real)1.0) - (T_real)1.0;
-    background = background.unaryExpr([](T_real v) { return std::isfinite(v) ? v : (T_real)0.0; });
+    bool _is_view;
 
-    return background;
+};
 
-}
+TEMPLATE_CLASS_DLL_EXPORT Spectra<float>;
+TEMPLATE_CLASS_DLL_EXPORT Spectra<double>;
 
 // ----------------------------------------------------------------------------
 
@@ -62,6 +62,44 @@ Spectra_Line<T_real>::Spectra_Line()
 
 // ----------------------------------------------------------------------------
 
+template<typename T_real>
+Spectra_Line<T_real>::Spectra_Line(const Spectra_Line& spectra_line)
+{
+    *this = spectra_line;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+Spectra_Line<T_real>& Spectra_Line<T_real>::operator=(const Spectra_Line& spectra_line)
+{
+    if (this != &spectra_line)
+    {
+        size_t samples = spectra_line.size() > 0 ? spectra_line[0].size() : 0;
+        bool same_size = true;
+        for (size_t i = 0; i < spectra_line.size(); i++)
+        {
+            same_size &= (spectra_line[i].size() == (Eigen::Index)samples);
+        }
+        if (same_size)
+        {
+            resize_and_zero(spectra_line.size(), samples);
+            for (size_t i = 0; i < _data_line.size(); i++)
+            {
+                _data_line[i] = spectra_line[i];
+            }
+        }
+        else
+        {
+            _data_line = spectra_line._data_line;
+            _slab.release();
+        }
+    }
+    return *this;
+}
+
+// ----------------------------------------------------------------------------
+
 template<typename T_real>
 Spectra_Line<T_real>::~Spectra_Line()
 {
@@ -88,8 +126,12 @@ void Spectra_Line<T_real>::append_spectra(Spectra* spectra)
 template<typename T_real>
 void Spectra_Line<T_real>::resize_and_zero(size_t cols, size_t samples)
 {
-    alloc_row_size(cols);
-    _alloc_spectra_size(samples);
+    _data_line.clear();
+    if (false == _slab.alloc(cols, samples))
+    {
+        return;
+    }
+    _bind(_slab, 0, cols);
 }
 
 // ----------------------------------------------------------------------------
@@ -97,25 +139,21 @@ void Spectra_Line<T_real>::resize_and_zero(size_t cols, size_t samples)
 template<typename T_real>
 void Spectra_Line<T_real>::alloc_row_size(size_t n)
 {
+    // new columns own their samples until resize_and_zero() packs the line into a slab
     _data_line.resize(n);
 }
 
 // ----------------------------------------------------------------------------
 
 template<typename T_real>
-void Spectra_Line<T_real>::_alloc_spectra_size(size_t n)
+void Spectra_Line<T_real>::_bind(Spectra_Slab<T_real>& slab, size_t start, size_t cols)
 {
-    for(size_t i=0; i<_data_line.size(); i++)
+    _data_line.clear();
+    _data_line.reserve(cols);
+    for (size_t i = start; i < start + cols; i++)
     {
-        _data_line[i].resize(n);
-        _data_line[i].setZero(n);
+        _data_line.emplace_back(slab.spectra_data(i), slab.samples(), slab.meta(i), slab.meta_stride());
     }
-    /*
-    for(Spectra s : _data_line)
-    {
-        s.alloc_buffer(n);
-    }*/
-    //_data_line.resize(n);
 }
 
 // ----------------------------------------------------------------------------
@@ -56,8 +56,12 @@ POSSIBILITY OF SUCH DAMAGE.
 namespace data_struct
 {
 
+template<typename T_real>
+class Spectra_Volume;
+
 /**
- * @brief The Spectra_Line class : A row of spectras
+ * @brief The Spectra_Line class : A row of spectras. The spectras are views into one slab that is
+ *        owned by the line, or by the Spectra_Volume the line belongs to.
  */
 template<typename T_real>
 class DLL_EXPORT Spectra_Line
@@ -65,8 +69,16 @@ class DLL_EXPORT Spectra_Line
 public:
     Spectra_Line();
 
+    Spectra_Line(const Spectra_Line& spectra_line);
+
+    Spectra_Line(Spectra_Line&& spectra_line) = default;
+
     ~Spectra_Line();
 
+    Spectra_Line& operator=(const Spectra_Line& spectra_line);
+
+    Spectra_Line& operator=(Spectra_Line&& spectra_line) = default;
+
     Spectra<T_real>& operator [](std::size_t row) { return _data_line[row]; }
 
     const Spectra<T_real>& operator [](std::size_t row) const { return _data_line[row]; }
@@ -81,11 +93,14 @@ public:
 
 private:
 
+    friend class Spectra_Volume<T_real>;
 
-    void _alloc_spectra_size(size_t n);
+    void _bind(Spectra_Slab<T_real>& slab, size_t start, size_t cols);
 
     std::vector<Spectra<T_real> > _data_line;
 
+    Spectra_Slab<T_real> _slab;
+
 };
 
 TEMPLATE_CLASS_DLL_EXPORT Spectra_Line<float>;
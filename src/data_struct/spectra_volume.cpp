@@ -49,6 +49,9 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "spectra_volume.h"
 
+#include <algorithm>
+#include <new>
+
 namespace data_struct
 {
 
@@ -57,7 +60,7 @@ namespace data_struct
 template<typename T_real>
 Spectra_Volume<T_real>::Spectra_Volume()
 {
-
+    _mem_limit = -1;
 }
 
 // ----------------------------------------------------------------------------
@@ -74,12 +77,80 @@ template<typename T_real>
 void Spectra_Volume<T_real>::resize_and_zero(size_t rows, size_t cols, size_t samples)
 {
 
+    _data_vol.clear();
+    const size_t bytes = Spectra_Slab<T_real>::required_bytes(rows * cols, samples);
+    if (_mem_limit > 0 && bytes > (size_t)_mem_limit)
+    {
+        logI << "Spectra volume " << rows << " x " << cols << " x " << samples << " (" << bytes / (1024 * 1024) << " MB) exceeds memory limit, mapping it from a scratch file in " << _scratch_dir << "\n";
+        if (false == _slab.alloc_mapped(rows * cols, samples, _scratch_dir))
+        {
+            // full disk or unwritable scratch dir, still try to hold it in memory
+            logW << "Could not map the spectra volume from " << _scratch_dir << ", allocating it in memory\n";
+            if (false == _slab.alloc(rows * cols, samples))
+            {
+                throw std::bad_alloc();
+            }
+        }
+    }
+    else if (false == _slab.alloc(rows * cols, samples))
+    {
+        // the loaders write into the volume right away, fail like the per spectra allocation used to
+        throw std::bad_alloc();
+    }
     _data_vol.resize(rows);
     for(size_t i=0; i<_data_vol.size(); i++)
     {
-        _data_vol[i].resize_and_zero(cols, samples);
+        _data_vol[i]._bind(_slab, i * cols, cols);
+    }
+
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Spectra_Volume<T_real>::set_out_of_core(long long mem_limit, const std::string& scratch_dir)
+{
+    _mem_limit = mem_limit;
+    _scratch_dir = scratch_dir;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+size_t Spectra_Volume<T_real>::block_rows() const
+{
+    if (is_resident() || _mem_limit < 1 || rows() == 0)
+    {
+        return rows();
+    }
+    // the block being fit, the one being read ahead, and the rest of the limit for everything else
+    const size_t row_bytes = cols() * _slab.stride() * sizeof(T_real);
+    const size_t block = ((size_t)_mem_limit / 4) / std::max(row_bytes, (size_t)1);
+    return std::min(std::max(block, (size_t)1), rows());
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Spectra_Volume<T_real>::prefetch_rows(size_t first_row, size_t last_row)
+{
+    last_row = std::min(last_row, rows());
+    if (first_row < last_row)
+    {
+        _slab.advise(first_row * cols(), (last_row - first_row) * cols(), true);
     }
+}
+
+// ----------------------------------------------------------------------------
 
+template<typename T_real>
+void Spectra_Volume<T_real>::release_rows(size_t first_row, size_t last_row)
+{
+    last_row = std::min(last_row, rows());
+    if (first_row < last_row)
+    {
+        _slab.advise(first_row * cols(), (last_row - first_row) * cols(), false);
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -176,4 +247,29 @@ void Spectra_Volume<T_real>::generate_scaler_maps(vector<Scaler_Map<T_real>> *sc
 
 // ----------------------------------------------------------------------------
 
+template<typename T_real>
+typename Spectra_Volume<T_real>::Pixel_Major_Map Spectra_Volume<T_real>::pixel_major()
+{
+    return Pixel_Major_Map(_slab.data(), _slab.num_spectra(), _slab.samples(), Eigen::OuterStride<>(_slab.stride()));
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+typename Spectra_Volume<T_real>::Channel_Major_Map Spectra_Volume<T_real>::channel_major()
+{
+    return Channel_Major_Map(_slab.data(), _slab.samples(), _slab.num_spectra(), Eigen::OuterStride<>(_slab.stride()));
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+typename Spectra_Volume<T_real>::Scaler_Array_Map Spectra_Volume<T_real>::_meta_map(size_t idx)
+{
+    T_real* meta = _slab.num_spectra() > 0 ? _slab.meta(0) + (idx * _slab.meta_stride()) : nullptr;
+    return Scaler_Array_Map(meta, rows(), cols());
+}
+
+// ----------------------------------------------------------------------------
+
 } //namespace data_struct
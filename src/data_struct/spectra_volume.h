@@ -57,14 +57,28 @@ namespace data_struct
 {
 
 /**
- * @brief The Spectra_Volume class : A volume of spectras
+ * @brief The Spectra_Volume class : A volume of spectras. All samples live in one 64 byte aligned slab,
+ *        the spectras returned by operator[] are views into it. Livetime, realtime, input and output counts
+ *        are stored as separate rows x cols arrays. A volume bigger than its memory limit is backed by a scratch
+ *        file instead (see set_out_of_core) and is walked in blocks of block_rows() rows.
  */
 template<typename T_real>
 class DLL_EXPORT Spectra_Volume
 {
 public:
+
+    typedef Eigen::Map<Eigen::Array<T_real, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>, Eigen::Unaligned, Eigen::OuterStride<> > Pixel_Major_Map;
+
+    typedef Eigen::Map<Eigen::Array<T_real, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>, Eigen::Unaligned, Eigen::OuterStride<> > Channel_Major_Map;
+
+    typedef Eigen::Map<Eigen::Array<T_real, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> > Scaler_Array_Map;
+
 	Spectra_Volume();
 
+    Spectra_Volume(const Spectra_Volume&) = delete;
+
+    Spectra_Volume& operator=(const Spectra_Volume&) = delete;
+
 	~Spectra_Volume();
 
     Spectra_Line<T_real>& operator [](std::size_t row) { return _data_vol[row]; }
@@ -73,6 +87,23 @@ public:
 
     void resize_and_zero(size_t rows, size_t cols, size_t samples);
 
+    /**
+     * @brief set_out_of_core : Volumes resized after this that need more than mem_limit bytes are mapped from a
+     *                          scratch file in scratch_dir. mem_limit < 1 keeps them in memory (default).
+     */
+    void set_out_of_core(long long mem_limit, const std::string& scratch_dir);
+
+    bool is_resident() const { return false == _slab.is_mapped(); }
+
+    // rows to work on at a time so two blocks stay well inside the memory limit, all rows if resident
+    size_t block_rows() const;
+
+    // page rows [first_row, last_row) in ahead of use, no-op if resident
+    void prefetch_rows(size_t first_row, size_t last_row);
+
+    // done with rows [first_row, last_row) for now, no-op if resident
+    void release_rows(size_t first_row, size_t last_row);
+
     Spectra<T_real> integrate();
 
     void generate_scaler_maps(vector<Scaler_Map<T_real>>* scaler_maps);
@@ -87,10 +118,32 @@ public:
 
     int rank() { return 3; }
 
+    // (rows * cols) x samples, one pixel per row
+    Pixel_Major_Map pixel_major();
+
+    // samples x (rows * cols), one pixel per column. Same memory as pixel_major()
+    Channel_Major_Map channel_major();
+
+    Scaler_Array_Map elapsed_livetime_map() { return _meta_map(0); }
+
+    Scaler_Array_Map elapsed_realtime_map() { return _meta_map(1); }
+
+    Scaler_Array_Map input_counts_map() { return _meta_map(2); }
+
+    Scaler_Array_Map output_counts_map() { return _meta_map(3); }
+
 private:
 
+    Scaler_Array_Map _meta_map(size_t idx);
+
     std::vector<Spectra_Line<T_real> > _data_vol;
 
+    Spectra_Slab<T_real> _slab;
+
+    long long _mem_limit;
+
+    std::string _scratch_dir;
+
 };
 
 TEMPLATE_CLASS_DLL_EXPORT Spectra_Volume<float>;
@@ -69,6 +69,9 @@ using namespace std;
  */
 enum class Fit_Params_Preset { MATRIX_BATCH_FIT, BATCH_FIT_NO_TAILS, BATCH_FIT_WITH_TAILS, BATCH_FIT_WITH_FREE_ENERGY };
 
+// groups of unit amplitude basis spectra used by the matrix fit routines, or'ed together as a mask
+enum Basis_Group { BASIS_NONE = 0, BASIS_ELEMENTS = 1, BASIS_ELASTIC = 2, BASIS_COMPTON = 4, BASIS_ALL = 7 };
+
 /**
  * @brief The Base_Model class: base class for modeling spectra and fitting elements
  */
@@ -117,6 +120,24 @@ public:
                                                  const ArrayTr<T_real>  &ev,
                                                  unordered_map<string, ArrayTr<T_real> >* labeled_spectras) = 0;
 
+    /**
+     * @brief model_spectrum_amplitude_terms : Same model as model_spectrum_mp but also returns the contribution of each
+     *                                         amplitude parameter keyed by its name. Every term scales with 10^amplitude
+     *                                         so d(model)/d(amplitude) = ln(10) * term, used for analytic jacobians.
+     *                                         Entries are assigned, never removed, callers may hold pointers to them.
+     *                                         Default leaves amplitude_terms as is, see supports_amplitude_terms().
+     */
+    virtual void model_spectrum_amplitude_terms(const Fit_Parameters<T_real> * const fit_params,
+                                                const Fit_Element_Map_Dict<T_real> * const elements_to_fit,
+                                                const struct Range energy_range,
+                                                Spectra<T_real>& spectra_model,
+                                                unordered_map<string, ArrayTr<T_real> >& )
+    {
+        spectra_model = model_spectrum_mp(fit_params, elements_to_fit, energy_range);
+    }
+
+    virtual bool supports_amplitude_terms() const { return false; }
+
     virtual const ArrayTr<T_real>  peak(T_real gain, T_real sigma, const ArrayTr<T_real> & delta_energy) const = 0;
 
     virtual const ArrayTr<T_real>  step(T_real gain, T_real sigma, const ArrayTr<T_real> & delta_energy, T_real peak_E) const = 0;
@@ -133,6 +154,19 @@ public:
 
     virtual void update_fit_params_values(const Fit_Parameters<T_real> *fit_params) = 0;
 
+    /**
+     * @brief basis_key_values : Model settings outside of the fit parameters that change the modeled spectra.
+     *                           Part of the Element_Model_Cache key, a model with such settings has to append them.
+     */
+    virtual void basis_key_values(std::vector<T_real>&) const {}
+
+    /**
+     * @brief basis_dependency : Basis_Group mask of the unit amplitude spectra (element, elastic, compton) that change
+     *                           when this parameter changes. Lets callers rebuild only part of a fit matrix.
+     *                           Default is BASIS_ALL, a model has to know better to return less.
+     */
+    virtual unsigned int basis_dependency(Fit_Param_Id) const { return BASIS_ALL; }
+
 protected:
 
 
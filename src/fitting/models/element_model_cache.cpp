@@ -0,0 +1,150 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#include "element_model_cache.h"
+
+namespace fitting
+{
+namespace models
+{
+
+// ----------------------------------------------------------------------------
+// -----------------------------Element_Model_Cache----------------------------
+// ----------------------------------------------------------------------------
+template<typename T_real>
+Element_Model_Cache<T_real>* Element_Model_Cache<T_real>::_this_inst(0);
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+Element_Model_Cache<T_real>* Element_Model_Cache<T_real>::inst()
+{
+    // detectors can be initialized from several threads, create under a lock
+    static std::mutex inst_mutex;
+    std::lock_guard<std::mutex> lock(inst_mutex);
+    if (_this_inst == nullptr)
+    {
+        _this_inst = new Element_Model_Cache();
+    }
+    return _this_inst;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+Element_Model_Cache<T_real>::Element_Model_Cache()
+{
+
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+Element_Model_Cache<T_real>::~Element_Model_Cache()
+{
+    clear();
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+std::shared_ptr<const Spectra<T_real>> Element_Model_Cache<T_real>::find(const Element_Model_Key& key)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto itr = _models.find(key);
+    if (itr != _models.end())
+    {
+        return itr->second;
+    }
+    return nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+std::shared_ptr<const Spectra<T_real>> Element_Model_Cache<T_real>::insert(const Element_Model_Key& key, const Spectra<T_real>& spectra)
+{
+    std::shared_ptr<const Spectra<T_real>> model = std::make_shared<const Spectra<T_real>>(spectra);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto itr = _models.find(key);
+    if (itr != _models.end())
+    {
+        return itr->second;
+    }
+    if (_order.size() >= ELEMENT_MODEL_CACHE_SIZE)
+    {
+        _models.erase(_order.front());
+        _order.pop_front();
+    }
+    _models[key] = model;
+    _order.push_back(key);
+    return model;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Element_Model_Cache<T_real>::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _models.clear();
+    _order.clear();
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+size_t Element_Model_Cache<T_real>::size()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _models.size();
+}
+
+// ----------------------------------------------------------------------------
+
+} //namespace models
+} //namespace fitting
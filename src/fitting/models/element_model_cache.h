@@ -0,0 +1,237 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef Element_Model_Cache_H
+#define Element_Model_Cache_H
+
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#include "fitting/models/base_model.h"
+
+namespace fitting
+{
+namespace models
+{
+
+using namespace data_struct;
+
+// number of basis spectra Element_Model_Cache keeps, oldest is dropped first
+#define ELEMENT_MODEL_CACHE_SIZE 1024
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief The Element_Model_Key class : Everything a unit amplitude basis spectra depends on, packed into bytes.
+ *        Two keys are equal only if their bytes are, the hash only picks the bucket.
+ */
+class DLL_EXPORT Element_Model_Key
+{
+public:
+    Element_Model_Key() : _hash(14695981039346656037ULL) {}
+
+    template<typename T>
+    void add(const T& value)
+    {
+        _append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void add(const std::string& value)
+    {
+        add(value.size());
+        _append(value.data(), value.size());
+    }
+
+    size_t hash() const { return static_cast<size_t>(_hash); }
+
+    bool operator==(const Element_Model_Key& other) const { return _hash == other._hash && _bytes == other._bytes; }
+
+private:
+
+    void _append(const char* data, size_t len)
+    {
+        // fnv-1a
+        for (size_t i = 0; i < len; i++)
+        {
+            _hash = (_hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+        }
+        _bytes.append(data, len);
+    }
+
+    std::string _bytes;
+
+    unsigned long long _hash;
+};
+
+struct Element_Model_Key_Hash
+{
+    size_t operator()(const Element_Model_Key& key) const { return key.hash(); }
+};
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief basis_key : Key part shared by every basis spectra of one model setup. Model type and settings, energy range
+ *                    and the value of every core fit parameter except the compton and elastic amplitudes.
+ */
+template<typename T_real>
+DLL_EXPORT Element_Model_Key basis_key(const Base_Model<T_real>* const model, const Fit_Parameters<T_real>& fit_params, const struct Range& energy_range)
+{
+    Element_Model_Key key;
+    key.add(typeid(*model).hash_code());
+    key.add(sizeof(T_real));
+
+    std::vector<T_real> model_values;
+    model->basis_key_values(model_values);
+    key.add(model_values.size());
+    for (const T_real& v : model_values)
+    {
+        key.add(v);
+    }
+
+    key.add(energy_range.min);
+    key.add(energy_range.max);
+
+    for (size_t i = 0; i < NUM_FIT_PARAM_IDS; i++)
+    {
+        Fit_Param_Id id = static_cast<Fit_Param_Id>(i);
+        if (id == Fit_Param_Id::COHERENT_SCT_AMPLITUDE || id == Fit_Param_Id::COMPTON_AMPLITUDE)
+        {
+            continue;
+        }
+        if (fit_params.contains(id))
+        {
+            key.add(fit_params.value(id));
+        }
+        else
+        {
+            key.add(std::numeric_limits<T_real>::quiet_NaN());
+        }
+    }
+    return key;
+}
+
+/**
+ * @brief element_basis_key : basis_key plus what model_spectrum_element reads from the element: name, width
+ *                            multiplier, energy ratios and which lines are above their binding energy.
+ */
+template<typename T_real>
+DLL_EXPORT Element_Model_Key element_basis_key(const Element_Model_Key& basis, const Fit_Element_Map<T_real>* const element, T_real incident_energy)
+{
+    Element_Model_Key key = basis;
+    key.add(element->full_name());
+    key.add(element->width_multi());
+    const std::vector<Element_Energy_Ratio<T_real>>& energy_ratios = element->energy_ratios();
+    key.add(energy_ratios.size());
+    for (size_t idx = 0; idx < energy_ratios.size(); idx++)
+    {
+        key.add(energy_ratios[idx].energy);
+        key.add(energy_ratios[idx].ratio);
+        key.add(energy_ratios[idx].mu_fraction);
+        key.add(static_cast<int>(energy_ratios[idx].ptype));
+        key.add(element->check_binding_energy(incident_energy, (int)idx));
+    }
+    return key;
+}
+
+// ----------------------------------------------------------------------------
+
+//singleton
+/**
+ * @brief The Element_Model_Cache class : Process wide cache of unit amplitude element, elastic and compton spectra
+ *        keyed by content, so matrix fit routines initialized again with the same calibration (next dataset, other
+ *        detector with the same override) copy their basis instead of modeling it. Spectra are handed out as
+ *        shared_ptr so clear() never pulls one out from under a thread that is still copying it.
+ */
+template<typename T_real>
+class DLL_EXPORT Element_Model_Cache
+{
+public:
+
+    static Element_Model_Cache* inst();
+
+    ~Element_Model_Cache();
+
+    // nullptr if the key is not cached
+    std::shared_ptr<const Spectra<T_real>> find(const Element_Model_Key& key);
+
+    // returns the cached spectra if another thread inserted the same key first
+    std::shared_ptr<const Spectra<T_real>> insert(const Element_Model_Key& key, const Spectra<T_real>& spectra);
+
+    void clear();
+
+    size_t size();
+
+private:
+
+    Element_Model_Cache();
+
+    static Element_Model_Cache *_this_inst;
+
+    std::mutex _mutex;
+
+    std::unordered_map<Element_Model_Key, std::shared_ptr<const Spectra<T_real>>, Element_Model_Key_Hash> _models;
+
+    // insertion order for eviction
+    std::deque<Element_Model_Key> _order;
+};
+
+TEMPLATE_CLASS_DLL_EXPORT Element_Model_Cache<float>;
+TEMPLATE_CLASS_DLL_EXPORT Element_Model_Cache<double>;
+
+// ----------------------------------------------------------------------------
+
+} //namespace models
+
+} //namespace fitting
+
+#endif // Element_Model_Cache_H
@@ -48,6 +48,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "gaussian_model.h"
+#include "core/simd_math.h"
 
 #include <iostream>
 #include <algorithm>
@@ -73,6 +74,7 @@ template<typename T_real>
 Gaussian_Model<T_real>::Gaussian_Model() : Base_Model<T_real>()
 {
     _fit_parameters = _generate_default_fit_parameters();
+    set_window_tolerance(DEFAULT_PEAK_WINDOW_TOLERANCE);
 }
 
 // ----------------------------------------------------------------------------
@@ -324,9 +326,9 @@ const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum(const Fit_Parameter
     Spectra<T_real> agr_spectra(energy_range.count());
     Spectra<T_real> tmp_spec(energy_range.count());
 
-    T_real energy_offset = fit_params->value(STR_ENERGY_OFFSET);
-    T_real energy_slope = fit_params->value(STR_ENERGY_SLOPE);
-    T_real energy_quad = fit_params->value(STR_ENERGY_QUADRATIC);
+    T_real energy_offset = fit_params->value(Fit_Param_Id::ENERGY_OFFSET);
+    T_real energy_slope = fit_params->value(Fit_Param_Id::ENERGY_SLOPE);
+    T_real energy_quad = fit_params->value(Fit_Param_Id::ENERGY_QUADRATIC);
 
 	ArrayTr<T_real> energy = ArrayTr<T_real>::LinSpaced(energy_range.count(), energy_range.min, energy_range.max);
     ArrayTr<T_real> ev = energy_offset + (energy * energy_slope) + (pow(energy, (T_real)2.0) * energy_quad);
@@ -345,24 +347,24 @@ const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum(const Fit_Parameter
 
     if (labeled_spectras != nullptr)
     {
-        tmp_spec = elastic_peak(fit_params, ev, fit_params->at(STR_ENERGY_SLOPE).value);
+        tmp_spec = elastic_peak(fit_params, ev, fit_params->at(Fit_Param_Id::ENERGY_SLOPE).value);
         (*labeled_spectras)[STR_ELASTIC_LINES] += tmp_spec;
         agr_spectra += tmp_spec;
     }
     else
     {
-        agr_spectra += elastic_peak(fit_params, ev, fit_params->at(STR_ENERGY_SLOPE).value);
+        agr_spectra += elastic_peak(fit_params, ev, fit_params->at(Fit_Param_Id::ENERGY_SLOPE).value);
     }
 
     if (labeled_spectras != nullptr)
     {
-        tmp_spec = compton_peak(fit_params, ev, fit_params->at(STR_ENERGY_SLOPE).value);
+        tmp_spec = compton_peak(fit_params, ev, fit_params->at(Fit_Param_Id::ENERGY_SLOPE).value);
         (*labeled_spectras)[STR_COMPTON_LINES] += tmp_spec;
         agr_spectra += tmp_spec;
     }
     else
     {
-        agr_spectra += compton_peak(fit_params, ev, fit_params->at(STR_ENERGY_SLOPE).value);
+        agr_spectra += compton_peak(fit_params, ev, fit_params->at(Fit_Param_Id::ENERGY_SLOPE).value);
     }
 
  //   agr_spectra += escape_peak(fit_params, ev, fit_params->at(STR_ENERGY_SLOPE).value);
@@ -380,9 +382,9 @@ const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum_mp(const Fit_Parame
 
     Spectra<T_real> agr_spectra(energy_range.count());
 
-    T_real energy_offset = fit_params->value(STR_ENERGY_OFFSET);
-    T_real energy_slope = fit_params->value(STR_ENERGY_SLOPE);
-    T_real energy_quad = fit_params->value(STR_ENERGY_QUADRATIC);
+    T_real energy_offset = fit_params->value(Fit_Param_Id::ENERGY_OFFSET);
+    T_real energy_slope = fit_params->value(Fit_Param_Id::ENERGY_SLOPE);
+    T_real energy_quad = fit_params->value(Fit_Param_Id::ENERGY_QUADRATIC);
 
     ArrayTr<T_real> energy = ArrayTr<T_real>::LinSpaced(energy_range.count(), energy_range.min, energy_range.max);
     ArrayTr<T_real> ev = energy_offset + (energy * energy_slope) + (pow(energy, (T_real)2.0) * energy_quad);
@@ -409,8 +411,8 @@ const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum_mp(const Fit_Parame
         }
     }
 
-    agr_spectra += elastic_peak(fit_params, ev, fit_params->at(STR_ENERGY_SLOPE).value);
-    agr_spectra += compton_peak(fit_params, ev, fit_params->at(STR_ENERGY_SLOPE).value);
+    agr_spectra += elastic_peak(fit_params, ev, fit_params->at(Fit_Param_Id::ENERGY_SLOPE).value);
+    agr_spectra += compton_peak(fit_params, ev, fit_params->at(Fit_Param_Id::ENERGY_SLOPE).value);
 
     //   agr_spectra += escape_peak(fit_params, ev, fit_params->at(STR_ENERGY_SLOPE).value);
 
@@ -419,6 +421,58 @@ const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum_mp(const Fit_Parame
 
 // ----------------------------------------------------------------------------
 
+template<typename T_real>
+void Gaussian_Model<T_real>::model_spectrum_amplitude_terms(const Fit_Parameters<T_real> * const fit_params,
+                                                            const unordered_map<string, Fit_Element_Map<T_real>*> * const elements_to_fit,
+                                                            const struct Range energy_range,
+                                                            Spectra<T_real>& spectra_model,
+                                                            unordered_map<string, ArrayTr<T_real> >& amplitude_terms)
+{
+
+    T_real energy_offset = fit_params->value(Fit_Param_Id::ENERGY_OFFSET);
+    T_real energy_slope = fit_params->value(Fit_Param_Id::ENERGY_SLOPE);
+    T_real energy_quad = fit_params->value(Fit_Param_Id::ENERGY_QUADRATIC);
+
+    ArrayTr<T_real> energy = ArrayTr<T_real>::LinSpaced(energy_range.count(), energy_range.min, energy_range.max);
+    ArrayTr<T_real> ev = energy_offset + (energy * energy_slope) + (pow(energy, (T_real)2.0) * energy_quad);
+
+    std::vector<const Fit_Element_Map<T_real>*> elements;
+    for (const auto& itr : (*elements_to_fit))
+    {
+        if(itr.first != STR_COHERENT_SCT_AMPLITUDE && itr.first != STR_COMPTON_AMPLITUDE && itr.second != nullptr)
+        {
+            elements.push_back(itr.second);
+        }
+    }
+
+    // each element term is pre_faktor = 10^amplitude times a shape that does not depend on the amplitude
+    std::vector<ArrayTr<T_real> > element_terms(elements.size());
+#pragma omp parallel for
+    for (int i=0; i < (int)elements.size(); i++)
+    {
+        element_terms[i] = model_spectrum_element(fit_params, elements[i], ev, nullptr);
+    }
+
+    spectra_model.resize(energy_range.count());
+    spectra_model.setZero();
+    // assign over the entries, the optimizers keep pointers to them
+    for (size_t i=0; i < elements.size(); i++)
+    {
+        spectra_model += element_terms[i];
+        amplitude_terms[elements[i]->full_name()] = std::move(element_terms[i]);
+    }
+
+    ArrayTr<T_real> term = elastic_peak(fit_params, ev, energy_slope);
+    spectra_model += term;
+    amplitude_terms[STR_COHERENT_SCT_AMPLITUDE] = std::move(term);
+
+    term = compton_peak(fit_params, ev, energy_slope);
+    spectra_model += term;
+    amplitude_terms[STR_COMPTON_AMPLITUDE] = std::move(term);
+}
+
+// ----------------------------------------------------------------------------
+
 template<typename T_real>
 const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum_element(const Fit_Parameters<T_real> * const fitp,
                                                      const Fit_Element_Map<T_real>* const element_to_fit,
@@ -444,10 +498,10 @@ const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum_element(const Fit_P
     for (int idx = 0; idx < energy_ratios.size(); idx++)
     {
         const Element_Energy_Ratio<T_real>& er_struct = energy_ratios.at(idx);
-        T_real sigma = std::sqrt(std::pow((fitp->at(STR_FWHM_OFFSET).value / (T_real)2.3548), (T_real)2.0) + (er_struct.energy) * (T_real)2.96 * fitp->at(STR_FWHM_FANOPRIME).value);
-        T_real f_step =  std::abs<T_real>( er_struct.mu_fraction * ( fitp->at(STR_F_STEP_OFFSET).value + (fitp->at(STR_F_STEP_LINEAR).value * er_struct.energy)));
-        T_real f_tail = std::abs<T_real>( fitp->at(STR_F_TAIL_OFFSET).value + (fitp->at(STR_F_TAIL_LINEAR).value * er_struct.mu_fraction));
-        T_real kb_f_tail = std::abs<T_real>(  fitp->at(STR_KB_F_TAIL_OFFSET).value + (fitp->at(STR_KB_F_TAIL_LINEAR).value * er_struct.mu_fraction));
+        T_real sigma = std::sqrt(std::pow((fitp->at(Fit_Param_Id::FWHM_OFFSET).value / (T_real)2.3548), (T_real)2.0) + (er_struct.energy) * (T_real)2.96 * fitp->at(Fit_Param_Id::FWHM_FANOPRIME).value);
+        T_real f_step =  std::abs<T_real>( er_struct.mu_fraction * ( fitp->at(Fit_Param_Id::F_STEP_OFFSET).value + (fitp->at(Fit_Param_Id::F_STEP_LINEAR).value * er_struct.energy)));
+        T_real f_tail = std::abs<T_real>( fitp->at(Fit_Param_Id::F_TAIL_OFFSET).value + (fitp->at(Fit_Param_Id::F_TAIL_LINEAR).value * er_struct.mu_fraction));
+        T_real kb_f_tail = std::abs<T_real>(  fitp->at(Fit_Param_Id::KB_F_TAIL_OFFSET).value + (fitp->at(Fit_Param_Id::KB_F_TAIL_LINEAR).value * er_struct.mu_fraction));
         T_real value = 1.0;
 
         //don't process if energy is 0
@@ -456,12 +510,11 @@ const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum_element(const Fit_P
         if (er_struct.energy <= 0.0)
             continue;
 
-        // gaussian peak shape
-		ArrayTr<T_real> delta_energy = ev - er_struct.energy;
+        T_real gain = fitp->at(Fit_Param_Id::ENERGY_SLOPE).value;
 
         string label = "";
 
-        T_real incident_energy = fitp->at(STR_COHERENT_SCT_ENERGY).value;
+        T_real incident_energy = fitp->at(Fit_Param_Id::COHERENT_SCT_ENERGY).value;
 
         T_real faktor = T_real(er_struct.ratio * pre_faktor);
 		if (element_to_fit->check_binding_energy(incident_energy, idx))
@@ -508,7 +561,7 @@ const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum_element(const Fit_P
         {
             Spectra<T_real> tmp_spec(ev.size());
             // peak, gauss
-            tmp_spec += faktor * this->peak(fitp->at(STR_ENERGY_SLOPE).value, sigma, delta_energy);
+            _add_peak(tmp_spec, faktor, gain, sigma, ev, er_struct.energy);
             ////spectra_model += faktor * (fitp->at(STR_ENERGY_SLOPE).value / ( sigma * SQRT_2xPI ) *  Eigen::exp((T_real)-0.5 * Eigen::pow((delta_energy / sigma), (T_real)2.0) ) );
 
             //  peak, step
@@ -516,15 +569,15 @@ const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum_element(const Fit_P
             {
                 value = faktor * f_step;
                 //value = value * this->step(gain, sigma, delta_energy, er_struct.energy);
-                tmp_spec += value * this->step(fitp->at(STR_ENERGY_SLOPE).value, sigma, delta_energy, er_struct.energy);
+                _add_step(tmp_spec, value, gain, sigma, ev, er_struct.energy);
                 //counts_arr->step = fit_counts.step + value;
             }
             //  peak, tail;; use different tail for K beta vs K alpha lines
             if (er_struct.ptype == Element_Param_Type::Kb1_Line || er_struct.ptype == Element_Param_Type::Kb2_Line)
             {
-                T_real gamma = std::abs(fitp->at(STR_GAMMA_OFFSET).value + fitp->at(STR_GAMMA_LINEAR).value * (er_struct.energy)) * element_to_fit->width_multi();
+                T_real gamma = std::abs(fitp->at(Fit_Param_Id::GAMMA_OFFSET).value + fitp->at(Fit_Param_Id::GAMMA_LINEAR).value * (er_struct.energy)) * element_to_fit->width_multi();
                 value = faktor * kb_f_tail;
-                tmp_spec += value * this->tail(fitp->at(STR_ENERGY_SLOPE).value, sigma, delta_energy, gamma);
+                _add_tail(tmp_spec, value, gain, sigma, ev, er_struct.energy, gamma, false);
                 //fit_counts.tail = fit_counts.tail + value;
             }
 
@@ -542,7 +595,7 @@ const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum_element(const Fit_P
         else
         {
             // peak, gauss
-            spectra_model += faktor * this->peak(fitp->at(STR_ENERGY_SLOPE).value, sigma, delta_energy);
+            _add_peak(spectra_model, faktor, gain, sigma, ev, er_struct.energy);
             ////spectra_model += faktor * (fitp->at(STR_ENERGY_SLOPE).value / ( sigma * SQRT_2xPI ) *  Eigen::exp((T_real)-0.5 * Eigen::pow((delta_energy / sigma), (T_real)2.0) ) );
 
             //  peak, step
@@ -550,15 +603,15 @@ const Spectra<T_real> Gaussian_Model<T_real>::model_spectrum_element(const Fit_P
             {
                 value = faktor * f_step;
                 //value = value * this->step(gain, sigma, delta_energy, er_struct.energy);
-                spectra_model += value * this->step(fitp->at(STR_ENERGY_SLOPE).value, sigma, delta_energy, er_struct.energy);
+                _add_step(spectra_model, value, gain, sigma, ev, er_struct.energy);
                 //counts_arr->step = fit_counts.step + value;
             }
             //  peak, tail;; use different tail for K beta vs K alpha lines
             if (er_struct.ptype == Element_Param_Type::Kb1_Line || er_struct.ptype == Element_Param_Type::Kb2_Line)
             {
-                T_real gamma = std::abs(fitp->at(STR_GAMMA_OFFSET).value + fitp->at(STR_GAMMA_LINEAR).value * (er_struct.energy)) * element_to_fit->width_multi();
+                T_real gamma = std::abs(fitp->at(Fit_Param_Id::GAMMA_OFFSET).value + fitp->at(Fit_Param_Id::GAMMA_LINEAR).value * (er_struct.energy)) * element_to_fit->width_multi();
                 value = faktor * kb_f_tail;
-                spectra_model += value * this->tail(fitp->at(STR_ENERGY_SLOPE).value, sigma, delta_energy, gamma);
+                _add_tail(spectra_model, value, gain, sigma, ev, er_struct.energy, gamma, false);
                 //fit_counts.tail = fit_counts.tail + value;
             }
         }
@@ -572,7 +625,9 @@ template<typename T_real>
 const ArrayTr<T_real> Gaussian_Model<T_real>::peak(T_real gain, T_real sigma, const ArrayTr<T_real>& delta_energy) const
 {
     // gain / (sigma * sqrt( 2.0 * M_PI) ) * exp( -0.5 * ( (delta_energy / sigma) ** 2 )
-    return gain / ( sigma * (T_real)(SQRT_2xPI) ) *  Eigen::exp((T_real)-0.5 * Eigen::pow((delta_energy / sigma), (T_real)2.0) );
+    ArrayTr<T_real> counts = (T_real)-0.5 * (delta_energy / sigma).square();
+    simd_math::exp(counts.data(), counts.data(), counts.size());
+    return gain / ( sigma * (T_real)(SQRT_2xPI) ) * counts;
 }
 
 // ----------------------------------------------------------------------------
@@ -580,15 +635,10 @@ const ArrayTr<T_real> Gaussian_Model<T_real>::peak(T_real gain, T_real sigma, co
 template<typename T_real>
 const ArrayTr<T_real> Gaussian_Model<T_real>::step(T_real gain, T_real sigma, const ArrayTr<T_real>& delta_energy, T_real peak_E) const
 {
-    //delta_energy = delta_energy.unaryExpr([sigma](T_real v) { return  (T_real)std::erfc(v  /( M_SQRT2*sigma)); } );
-    //return (gain / (T_real)2.0 / peak_E * delta_energy );
-    ArrayTr<T_real>counts(delta_energy.size());
-	for (unsigned int i = 0; i < delta_energy.size(); i++)
-	{
-        counts[i] = gain / (T_real)2.0 / peak_E * std::erfc((T_real)delta_energy[i] / ((T_real)(M_SQRT2) * sigma));
-	}
-    return counts;
-
+    // gain / 2.0 / peak_E * erfc( delta_energy / ( sqrt(2) * sigma ) )
+    ArrayTr<T_real> counts = delta_energy / ((T_real)(M_SQRT2) * sigma);
+    simd_math::erfc(counts.data(), counts.data(), counts.size());
+    return gain / (T_real)2.0 / peak_E * counts;
 }
 
 // ----------------------------------------------------------------------------
@@ -596,7 +646,10 @@ const ArrayTr<T_real> Gaussian_Model<T_real>::step(T_real gain, T_real sigma, co
 template<typename T_real>
 const ArrayTr<T_real> Gaussian_Model<T_real>::tail(T_real gain, T_real sigma, ArrayTr<T_real> delta_energy, T_real gamma) const
 {
-    delta_energy = delta_energy.unaryExpr([sigma,gamma](T_real v) { return  (v < (T_real)0.0) ? std::exp(v/ (gamma * sigma)) * std::erfc(v / ((T_real)(M_SQRT2)*sigma) + ((T_real)1.0/(gamma*(T_real)(M_SQRT2)))) : std::erfc(v / ((T_real)(M_SQRT2)*sigma) + ((T_real)1.0/(gamma*(T_real)(M_SQRT2)))); } );
+    // exp( delta_energy / (gamma * sigma) ) on the low side only, times erfc( delta_energy / (sqrt(2) * sigma) + 1 / (gamma * sqrt(2)) )
+    ArrayTr<T_real> exp_arg = (delta_energy < (T_real)0.0).select(delta_energy / (gamma * sigma), (T_real)0.0);
+    delta_energy = delta_energy / ((T_real)(M_SQRT2) * sigma) + ((T_real)1.0 / (gamma * (T_real)(M_SQRT2)));
+    simd_math::exp_erfc(exp_arg.data(), delta_energy.data(), delta_energy.data(), delta_energy.size());
     return( gain / (T_real)2.0 / gamma / sigma / exp((T_real)-0.5/pow(gamma, (T_real)2.0)) * delta_energy);
 }
 
@@ -607,22 +660,19 @@ const ArrayTr<T_real> Gaussian_Model<T_real>::elastic_peak(const Fit_Parameters<
 {
     Spectra<T_real> counts(ev.size());
 	counts.setZero();
-    T_real sigma = std::sqrt( std::pow( (fitp->at(STR_FWHM_OFFSET).value / (T_real)2.3548), (T_real)2.0 ) + fitp->at(STR_COHERENT_SCT_ENERGY).value * (T_real)2.96 * fitp->at(STR_FWHM_FANOPRIME).value  );
+    T_real sigma = std::sqrt( std::pow( (fitp->at(Fit_Param_Id::FWHM_OFFSET).value / (T_real)2.3548), (T_real)2.0 ) + fitp->at(Fit_Param_Id::COHERENT_SCT_ENERGY).value * (T_real)2.96 * fitp->at(Fit_Param_Id::FWHM_FANOPRIME).value  );
     if(false == std::isfinite(sigma))
     {
         return counts;
     }
-	ArrayTr<T_real>delta_energy = ev - fitp->at(STR_COHERENT_SCT_ENERGY).value;
-
-
     // elastic peak, gaussian
     T_real fvalue = (T_real)1.0;
 
-    fvalue = fvalue * std::pow((T_real)10.0, fitp->at(STR_COHERENT_SCT_AMPLITUDE).value);
+    fvalue = fvalue * std::pow((T_real)10.0, fitp->at(Fit_Param_Id::COHERENT_SCT_AMPLITUDE).value);
 
     //Spectra value = fvalue * this->peak(gain, *sigma, delta_energy);
     //counts = counts + value;
-    counts += ( fvalue * this->peak(gain, sigma, delta_energy) );
+    _add_peak(counts, fvalue, gain, sigma, ev, fitp->at(Fit_Param_Id::COHERENT_SCT_ENERGY).value);
     ////counts += fvalue * (gain / ( sigma * (T_real)(SQRT_2xPI) ) * Eigen::exp((T_real)-0.5 * Eigen::pow((delta_energy / sigma), (T_real)2.0) ) );
 
     return counts;
@@ -636,44 +686,200 @@ const ArrayTr<T_real> Gaussian_Model<T_real>::compton_peak(const Fit_Parameters<
 	ArrayTr<T_real>counts(ev.size());
 	counts.setZero();
 
-    T_real compton_E = fitp->at(STR_COHERENT_SCT_ENERGY).value/((T_real)1.0 +(fitp->at(STR_COHERENT_SCT_ENERGY).value / (T_real)511.0 ) * ((T_real)1.0 -std::cos( fitp->at(STR_COMPTON_ANGLE).value * (T_real)2.0 * (T_real)(M_PI) / (T_real)360.0 )));
+    T_real compton_E = fitp->at(Fit_Param_Id::COHERENT_SCT_ENERGY).value/((T_real)1.0 +(fitp->at(Fit_Param_Id::COHERENT_SCT_ENERGY).value / (T_real)511.0 ) * ((T_real)1.0 -std::cos( fitp->at(Fit_Param_Id::COMPTON_ANGLE).value * (T_real)2.0 * (T_real)(M_PI) / (T_real)360.0 )));
 
-    T_real sigma = std::sqrt( std::pow( (fitp->at(STR_FWHM_OFFSET).value/(T_real)2.3548), (T_real)62.0) + compton_E * (T_real)2.96 * fitp->at(STR_FWHM_FANOPRIME).value );
+    T_real sigma = std::sqrt( std::pow( (fitp->at(Fit_Param_Id::FWHM_OFFSET).value/(T_real)2.3548), (T_real)62.0) + compton_E * (T_real)2.96 * fitp->at(Fit_Param_Id::FWHM_FANOPRIME).value );
     if(false == std::isfinite(sigma))
     {
         return counts;
     }
     //T_real local_sigma = (*sigma) * p[14];
 
-	ArrayTr<T_real>delta_energy = ev - compton_E;
-
     // compton peak, gaussian
-    T_real faktor = (T_real)1.0 / ((T_real)1.0 + fitp->at(STR_COMPTON_F_STEP).value + fitp->at(STR_COMPTON_F_TAIL).value + fitp->at(STR_COMPTON_HI_F_TAIL).value);
+    T_real faktor = (T_real)1.0 / ((T_real)1.0 + fitp->at(Fit_Param_Id::COMPTON_F_STEP).value + fitp->at(Fit_Param_Id::COMPTON_F_TAIL).value + fitp->at(Fit_Param_Id::COMPTON_HI_F_TAIL).value);
 
-    faktor = faktor * std::pow((T_real)10.0, fitp->at(STR_COMPTON_AMPLITUDE).value) ;
+    faktor = faktor * std::pow((T_real)10.0, fitp->at(Fit_Param_Id::COMPTON_AMPLITUDE).value) ;
 
-    counts += faktor * this->peak(gain, sigma * fitp->at(STR_COMPTON_FWHM_CORR).value, delta_energy);
+    _add_peak(counts, faktor, gain, sigma * fitp->at(Fit_Param_Id::COMPTON_FWHM_CORR).value, ev, compton_E);
     ////counts += faktor * (gain / ( (sigma * fitp->at(STR_COMPTON_FWHM_CORR).value) * (T_real)(SQRT_2xPI) ) *  Eigen::exp((T_real)-0.5 * Eigen::pow((delta_energy / (sigma*fitp->at(STR_COMPTON_FWHM_CORR).value)), (T_real)2.0) ) );
 
     // compton peak, step
-    if ( fitp->at(STR_COMPTON_F_STEP).value > 0.0 )
+    if ( fitp->at(Fit_Param_Id::COMPTON_F_STEP).value > 0.0 )
     {
-        T_real fvalue = faktor * fitp->at(STR_COMPTON_F_STEP).value;
-		counts += fvalue * this->step(gain, sigma, delta_energy, compton_E);
+        T_real fvalue = faktor * fitp->at(Fit_Param_Id::COMPTON_F_STEP).value;
+		_add_step(counts, fvalue, gain, sigma, ev, compton_E);
     }
     // compton peak, tail on the low side
-    T_real fvalue = faktor * fitp->at(STR_COMPTON_F_TAIL).value;
-    counts += fvalue * this->tail(gain, sigma, delta_energy, fitp->at(STR_COMPTON_GAMMA).value);
+    T_real fvalue = faktor * fitp->at(Fit_Param_Id::COMPTON_F_TAIL).value;
+    _add_tail(counts, fvalue, gain, sigma, ev, compton_E, fitp->at(Fit_Param_Id::COMPTON_GAMMA).value, false);
 
     // compton peak, tail on the high side
-    fvalue = faktor * fitp->at(STR_COMPTON_HI_F_TAIL).value;
-    delta_energy *= (T_real)-1.0;
-    counts += ( fvalue * this->tail(gain, sigma, delta_energy, fitp->at(STR_COMPTON_HI_GAMMA).value) );
+    fvalue = faktor * fitp->at(Fit_Param_Id::COMPTON_HI_F_TAIL).value;
+    _add_tail(counts, fvalue, gain, sigma, ev, compton_E, fitp->at(Fit_Param_Id::COMPTON_HI_GAMMA).value, true);
     return counts;
 }
 
 // ----------------------------------------------------------------------------
 
+template<typename T_real>
+void Gaussian_Model<T_real>::set_window_tolerance(T_real tolerance)
+{
+    _window_tolerance = tolerance;
+    if (tolerance > (T_real)0.0 && tolerance < (T_real)1.0)
+    {
+        // exp(-0.5 * k^2) = tolerance
+        _window_sigmas = std::sqrt((T_real)-2.0 * std::log(tolerance));
+    }
+    else
+    {
+        _window_sigmas = (T_real)0.0;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+unsigned int Gaussian_Model<T_real>::basis_dependency(Fit_Param_Id id) const
+{
+    switch (id)
+    {
+    // energy axis, gain and peak width
+    case Fit_Param_Id::ENERGY_OFFSET:
+    case Fit_Param_Id::ENERGY_SLOPE:
+    case Fit_Param_Id::ENERGY_QUADRATIC:
+    case Fit_Param_Id::FWHM_OFFSET:
+    case Fit_Param_Id::FWHM_FANOPRIME:
+    // elastic and compton position, element lines above binding energy
+    case Fit_Param_Id::COHERENT_SCT_ENERGY:
+        return BASIS_ALL;
+    case Fit_Param_Id::COMPTON_ANGLE:
+    case Fit_Param_Id::COMPTON_FWHM_CORR:
+    case Fit_Param_Id::COMPTON_F_STEP:
+    case Fit_Param_Id::COMPTON_F_TAIL:
+    case Fit_Param_Id::COMPTON_GAMMA:
+    case Fit_Param_Id::COMPTON_HI_F_TAIL:
+    case Fit_Param_Id::COMPTON_HI_GAMMA:
+        return BASIS_COMPTON;
+    case Fit_Param_Id::F_STEP_OFFSET:
+    case Fit_Param_Id::F_STEP_LINEAR:
+    case Fit_Param_Id::F_STEP_QUADRATIC:
+    case Fit_Param_Id::F_TAIL_OFFSET:
+    case Fit_Param_Id::F_TAIL_LINEAR:
+    case Fit_Param_Id::F_TAIL_QUADRATIC:
+    case Fit_Param_Id::GAMMA_OFFSET:
+    case Fit_Param_Id::GAMMA_LINEAR:
+    case Fit_Param_Id::GAMMA_QUADRATIC:
+    case Fit_Param_Id::KB_F_TAIL_OFFSET:
+    case Fit_Param_Id::KB_F_TAIL_LINEAR:
+    case Fit_Param_Id::KB_F_TAIL_QUADRATIC:
+        return BASIS_ELEMENTS;
+    // amplitudes are 0 in a basis, background and fit range are handled by the routine, escape is not modeled
+    case Fit_Param_Id::COHERENT_SCT_AMPLITUDE:
+    case Fit_Param_Id::COMPTON_AMPLITUDE:
+    case Fit_Param_Id::SNIP_WIDTH:
+    case Fit_Param_Id::MIN_ENERGY_TO_FIT:
+    case Fit_Param_Id::MAX_ENERGY_TO_FIT:
+    case Fit_Param_Id::SI_ESCAPE:
+    case Fit_Param_Id::GE_ESCAPE:
+    case Fit_Param_Id::ESCAPE_LINEAR:
+        return BASIS_NONE;
+    default:
+        return BASIS_ALL;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Gaussian_Model<T_real>::_energy_window(const ArrayTr<T_real>& ev, T_real min_e, T_real max_e, Eigen::Index& start, Eigen::Index& count) const
+{
+    const Eigen::Index n = ev.size();
+    start = 0;
+    count = n;
+    // windowing disabled, or ev not increasing (bad calibration) so evaluate everything
+    if (_window_sigmas <= (T_real)0.0 || n < 2 || ev[n - 1] <= ev[0])
+    {
+        return;
+    }
+    const T_real* first = ev.data();
+    const T_real* last = ev.data() + n;
+    // NaN bounds compare false and leave the full range
+    start = std::lower_bound(first, last, min_e) - first;
+    count = (std::upper_bound(first, last, max_e) - first) - start;
+    if (count < 0)
+    {
+        count = 0;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Gaussian_Model<T_real>::_add_peak(Eigen::Ref<ArrayTr<T_real> > counts, T_real scale, T_real gain, T_real sigma, const ArrayTr<T_real>& ev, T_real center) const
+{
+    Eigen::Index start, count;
+    T_real extent = _window_sigmas * sigma;
+    _energy_window(ev, center - extent, center + extent, start, count);
+    if (count > 0)
+    {
+        counts.segment(start, count) += scale * this->peak(gain, sigma, ev.segment(start, count) - center);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Gaussian_Model<T_real>::_add_step(Eigen::Ref<ArrayTr<T_real> > counts, T_real scale, T_real gain, T_real sigma, const ArrayTr<T_real>& ev, T_real center) const
+{
+    Eigen::Index start, count;
+    T_real extent = _window_sigmas * sigma;
+    _energy_window(ev, center - extent, center + extent, start, count);
+    // below the window erfc() has saturated at 2
+    if (start > 0)
+    {
+        counts.head(start) += scale * gain / center;
+    }
+    if (count > 0)
+    {
+        counts.segment(start, count) += scale * this->step(gain, sigma, ev.segment(start, count) - center, center);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Gaussian_Model<T_real>::_add_tail(Eigen::Ref<ArrayTr<T_real> > counts, T_real scale, T_real gain, T_real sigma, const ArrayTr<T_real>& ev, T_real center, T_real gamma, bool high_side) const
+{
+    Eigen::Index start = 0, count = ev.size();
+    if (gamma > (T_real)0.0 && std::isfinite(gamma))
+    {
+        // the long side falls off as exp(delta / (gamma * sigma)), the short side like the gaussian
+        T_real long_extent = gamma * sigma * (T_real)0.5 * _window_sigmas * _window_sigmas;
+        T_real short_extent = _window_sigmas * sigma;
+        if (high_side)
+        {
+            _energy_window(ev, center - short_extent, center + long_extent, start, count);
+        }
+        else
+        {
+            _energy_window(ev, center - long_extent, center + short_extent, start, count);
+        }
+    }
+    if (count > 0)
+    {
+        if (high_side)
+        {
+            counts.segment(start, count) += scale * this->tail(gain, sigma, center - ev.segment(start, count), gamma);
+        }
+        else
+        {
+            counts.segment(start, count) += scale * this->tail(gain, sigma, ev.segment(start, count) - center, gamma);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 template<typename T_real>
 const ArrayTr<T_real> Gaussian_Model<T_real>::escape_peak(const Fit_Parameters<T_real>* const fitp, const ArrayTr<T_real>& ev, T_real  gain) const
 {
@@ -684,7 +890,7 @@ const ArrayTr<T_real> Gaussian_Model<T_real>::escape_peak(const Fit_Parameters<T
     //if (np.sum(np.abs(pall[keywords.added_params[1:4]])) >= 0.0)
     {
         // si escape
-        if (fit_params->at(STR_SI_ESCAPE).value > 0.0)
+        if (fit_params->at(Fit_Param_Id::SI_ESCAPE).value > 0.0)
             //if (pall[keywords.added_params[1]] > 0.0)
         {
             T_real escape_E = (T_real)1.73998;
@@ -715,17 +921,17 @@ ArrayTr<T_real> generate_ev_array(Range energy_range, Fit_Parameters<T_real>& fi
     T_real energy_offset = 0.0;
     T_real energy_slope = 0.0;
     T_real energy_quad = 0.0;
-    if (fit_params.contains(STR_ENERGY_OFFSET))
+    if (fit_params.contains(Fit_Param_Id::ENERGY_OFFSET))
     {
-        energy_offset = fit_params.at(STR_ENERGY_OFFSET).value;
+        energy_offset = fit_params.at(Fit_Param_Id::ENERGY_OFFSET).value;
     }
-    if (fit_params.contains(STR_ENERGY_SLOPE))
+    if (fit_params.contains(Fit_Param_Id::ENERGY_SLOPE))
     {
-        energy_slope = fit_params.at(STR_ENERGY_SLOPE).value;
+        energy_slope = fit_params.at(Fit_Param_Id::ENERGY_SLOPE).value;
     }
-    if (fit_params.contains(STR_ENERGY_QUADRATIC))
+    if (fit_params.contains(Fit_Param_Id::ENERGY_QUADRATIC))
     {
-        energy_quad = fit_params.at(STR_ENERGY_QUADRATIC).value;
+        energy_quad = fit_params.at(Fit_Param_Id::ENERGY_QUADRATIC).value;
     }
 
 
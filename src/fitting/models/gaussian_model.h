@@ -60,6 +60,9 @@ namespace models
 
 using namespace data_struct;
 
+// peaks are only evaluated over the channels where they are above this fraction of their maximum
+#define DEFAULT_PEAK_WINDOW_TOLERANCE 1.0e-7
+
 template<typename T_real>
 class DLL_EXPORT Gaussian_Model: public Base_Model<T_real>
 {
@@ -86,6 +89,15 @@ public:
                                                             const ArrayTr<T_real> &ev,
                                                             unordered_map<string, ArrayTr<T_real>>* labeled_spectras);
 
+    // multi threaded, model plus per amplitude parameter terms
+    virtual void model_spectrum_amplitude_terms(const Fit_Parameters<T_real>* const fit_params,
+                                                const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
+                                                const struct Range energy_range,
+                                                Spectra<T_real>& spectra_model,
+                                                unordered_map<string, ArrayTr<T_real>>& amplitude_terms);
+
+    virtual bool supports_amplitude_terms() const { return true; }
+
     void set_fit_params_preset(Fit_Params_Preset lock_macro);
 
     /**
@@ -123,12 +135,37 @@ public:
 
     void update_and_add_fit_params_values_gt_zero(Fit_Parameters<T_real>* fit_params) { _fit_parameters.update_and_add_values_gt_zero(fit_params); }
 
+    /**
+     * @brief set_window_tolerance : Truncation tolerance for peak, step and tail windows, relative to the peak maximum.
+     *                               0 disables windowing and evaluates every line over the whole spectra.
+     * @param tolerance
+     */
+    void set_window_tolerance(T_real tolerance);
+
+    T_real window_tolerance() const { return _window_tolerance; }
+
+    virtual void basis_key_values(std::vector<T_real>& values) const { values.push_back(_window_tolerance); }
+
+    virtual unsigned int basis_dependency(Fit_Param_Id id) const;
+
 protected:
 
+    void _energy_window(const ArrayTr<T_real>& ev, T_real min_e, T_real max_e, Eigen::Index& start, Eigen::Index& count) const;
+
+    void _add_peak(Eigen::Ref<ArrayTr<T_real> > counts, T_real scale, T_real gain, T_real sigma, const ArrayTr<T_real>& ev, T_real center) const;
+
+    void _add_step(Eigen::Ref<ArrayTr<T_real> > counts, T_real scale, T_real gain, T_real sigma, const ArrayTr<T_real>& ev, T_real center) const;
+
+    void _add_tail(Eigen::Ref<ArrayTr<T_real> > counts, T_real scale, T_real gain, T_real sigma, const ArrayTr<T_real>& ev, T_real center, T_real gamma, bool high_side) const;
+
     Fit_Parameters<T_real> _generate_default_fit_parameters();
 
     Fit_Parameters<T_real> _fit_parameters;
 
+    T_real _window_tolerance;
+
+    T_real _window_sigmas;
+
 };
 
 TEMPLATE_CLASS_DLL_EXPORT Gaussian_Model<float>;
@@ -97,6 +97,27 @@ void residuals_lmfit( const T_real *par, int m_dat, const void *data, T_real *fv
 
 // ----------------------------------------------------------------------------
 
+// Amplitude columns only, see is_amplitude_param(). Every other column is left to lmmin's forward differences
+template<typename T_real>
+void amplitude_jacobian_lmfit( const T_real *par, const int m_dat, const int n_par, const void *data, T_real *fjac, int *analytic, int * )
+{
+    User_Data<T_real>* ud = (User_Data<T_real>*)(data);
+
+    // Update fit parameters from optimizer, background does not depend on the amplitudes
+    ud->fit_parameters->from_array(par, n_par);
+    ud->fit_model->model_spectrum_amplitude_terms(ud->fit_parameters, ud->elements, ud->energy_range, ud->spectra_model, ud->amplitude_terms);
+
+    // columns were found once in minimize(), see init_amplitude_columns()
+    for (size_t c = 0; c < ud->amplitude_cols.size(); c++)
+    {
+        int idx = ud->amplitude_cols[c];
+        analytic[idx] = 1;
+        fill_amplitude_column(*ud, c, fjac + (size_t)idx * m_dat);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 template<typename T_real>
 void general_residuals_lmfit( const T_real *par, int m_dat, const void *data, T_real *fvec, int *userbreak )
 {
@@ -273,9 +294,12 @@ OPTIMIZER_OUTCOME LMFit_Optimizer<T_real>::minimize(Fit_Parameters<T_real> *fit_
     User_Data<T_real> ud;
     std::vector<T_real> fitp_arr = fit_params->to_array();
     std::vector<T_real> perror(fitp_arr.size());
+    // local copy, lmmin gets a pointer and the shared optimizer stays untouched
+    lm_control_struct<T_real> options = _options;
 
-    size_t total_itr = _options.patience * (fitp_arr.size() + 1);
+    size_t total_itr = options.patience * (fitp_arr.size() + 1);
     fill_user_data(ud, fit_params, spectra, elements_to_fit, model, energy_range, status_callback, total_itr);
+    init_amplitude_columns(ud);
 
     lm_status_struct<T_real> status;
 
@@ -320,7 +344,12 @@ OPTIMIZER_OUTCOME LMFit_Optimizer<T_real>::minimize(Fit_Parameters<T_real> *fit_
     //control.verbosity = 3;
 
     /* perform the fit */
-    lmmin( fitp_arr.size(), &fitp_arr[0], energy_range.count(), (const void*) &ud, residuals_lmfit, &_options, &status );
+    decltype(&amplitude_jacobian_lmfit<T_real>) jacobian = nullptr;
+    if (ud.amplitude_cols.size() > 0)
+    {
+        jacobian = amplitude_jacobian_lmfit<T_real>;
+    }
+    lmmin( fitp_arr.size(), &fitp_arr[0], energy_range.count(), (const void*) &ud, residuals_lmfit, &options, &status, jacobian );
     logI<< "Outcome: "<<lm_infmsg[status.outcome]<<"\nNum iter: "<<status.nfev<<"\n Norm of the residue vector: "<<status.fnorm<<"\n";
 
     fit_params->from_array(fitp_arr);
@@ -336,11 +365,11 @@ OPTIMIZER_OUTCOME LMFit_Optimizer<T_real>::minimize(Fit_Parameters<T_real> *fit_
     if (fit_params->contains(STR_OUTCOME))
     {
         if (this->_outcome_map.count(status.outcome) > 0)
-            (*fit_params)[STR_OUTCOME].value = (T_real)(this->_outcome_map[status.outcome]);
+            (*fit_params)[STR_OUTCOME].value = (T_real)(this->_outcome_map.at(status.outcome));
     }
 
     if(this->_outcome_map.count(status.outcome)>0)
-        return this->_outcome_map[status.outcome];
+        return this->_outcome_map.at(status.outcome);
 
     return OPTIMIZER_OUTCOME::FAILED;
 
@@ -353,7 +382,8 @@ OPTIMIZER_OUTCOME LMFit_Optimizer<T_real>::minimize_func(Fit_Parameters<T_real>*
                                                 const Spectra<T_real>* const spectra,
                                                 const Range energy_range,
                                                 const ArrayTr<T_real>*background,
-                                                Gen_Func_Def<T_real> gen_func)
+                                                Gen_Func_Def<T_real> gen_func,
+                                                const Optimizer_Overrides<T_real>* overrides)
 {
 
     Gen_User_Data<T_real> ud;
@@ -363,9 +393,30 @@ OPTIMIZER_OUTCOME LMFit_Optimizer<T_real>::minimize_func(Fit_Parameters<T_real>*
     std::vector<T_real> fitp_arr = fit_params->to_array();
     std::vector<T_real> perror(fitp_arr.size());
 
+    lm_control_struct<T_real> options = _options;
+    if (overrides != nullptr)
+    {
+        if (overrides->max_iter > -1)
+        {
+            options.patience = overrides->max_iter;
+        }
+        if (std::isfinite(overrides->ftol))
+        {
+            options.ftol = overrides->ftol;
+        }
+        if (std::isfinite(overrides->gtol))
+        {
+            options.gtol = overrides->gtol;
+        }
+        if (std::isfinite(overrides->xtol))
+        {
+            options.xtol = overrides->xtol;
+        }
+    }
+
     lm_status_struct<T_real> status;
 
-    lmmin( fitp_arr.size(), &fitp_arr[0], energy_range.count(), (const void*) &ud, general_residuals_lmfit, &_options, &status );
+    lmmin( fitp_arr.size(), &fitp_arr[0], energy_range.count(), (const void*) &ud, general_residuals_lmfit, &options, &status );
 
     fit_params->from_array(fitp_arr);
 
@@ -382,7 +433,7 @@ OPTIMIZER_OUTCOME LMFit_Optimizer<T_real>::minimize_func(Fit_Parameters<T_real>*
     }
 
     if (this->_outcome_map.count(status.outcome) > 0)
-        return this->_outcome_map[status.outcome];
+        return this->_outcome_map.at(status.outcome);
 
     return OPTIMIZER_OUTCOME::FAILED;
 
@@ -410,8 +461,9 @@ OPTIMIZER_OUTCOME LMFit_Optimizer<T_real>::minimize_quantification(Fit_Parameter
     std::vector<T_real> fitp_arr = fit_params->to_array();
     std::vector<T_real> perror(fitp_arr.size());
 
+    lm_control_struct<T_real> options = _options;
     lm_status_struct<T_real> status;
-    lmmin( fitp_arr.size(), &fitp_arr[0], quant_map->size(), (const void*) &ud, quantification_residuals_lmfit, &_options, &status );
+    lmmin( fitp_arr.size(), &fitp_arr[0], quant_map->size(), (const void*) &ud, quantification_residuals_lmfit, &options, &status );
     logI << "\nOutcome: " << lm_infmsg[status.outcome] << "\nNum iter: " << status.nfev << "\nNorm of the residue vector: " << status.fnorm << "\n";
 
     fit_params->from_array(fitp_arr);
@@ -426,7 +478,7 @@ OPTIMIZER_OUTCOME LMFit_Optimizer<T_real>::minimize_quantification(Fit_Parameter
     }
 
     if (this->_outcome_map.count(status.outcome) > 0)
-        return this->_outcome_map[status.outcome];
+        return this->_outcome_map.at(status.outcome);
 
     return OPTIMIZER_OUTCOME::FAILED;
 }
@@ -84,7 +84,8 @@ public:
                                            const Spectra<T_real>* const spectra,
                                            const Range energy_range,
                                            const ArrayTr<T_real>* background,
-                                           Gen_Func_Def<T_real> gen_func);
+                                           Gen_Func_Def<T_real> gen_func,
+                                           const Optimizer_Overrides<T_real>* overrides = nullptr);
 
     virtual OPTIMIZER_OUTCOME minimize_quantification(Fit_Parameters<T_real>*fit_params,
                                                     std::unordered_map<std::string, Element_Quant<T_real>*> * quant_map,
@@ -74,7 +74,15 @@ int residuals_mpfit(int m, int params_size, T_real *params, T_real *dy, T_real *
     // Update background if fit_snip_width is set to fit
     update_background_user_data(ud);
     // Model spectra based on new fit parameters
-    ud->spectra_model = ud->fit_model->model_spectrum_mp(ud->fit_parameters, ud->elements, ud->energy_range);
+    // dvec is only passed in when mpfit wants the analytic (side = 3) amplitude columns of the jacobian
+    if (dvec != nullptr)
+    {
+        ud->fit_model->model_spectrum_amplitude_terms(ud->fit_parameters, ud->elements, ud->energy_range, ud->spectra_model, ud->amplitude_terms);
+    }
+    else
+    {
+        ud->spectra_model = ud->fit_model->model_spectrum_mp(ud->fit_parameters, ud->elements, ud->energy_range);
+    }
     // Add background
     ud->spectra_model += ud->spectra_background;
     // Remove nan's and inf's
@@ -92,6 +100,19 @@ int residuals_mpfit(int m, int params_size, T_real *params, T_real *dy, T_real *
 			dy[i] = ud->spectra[i];
 		}
     }
+
+    if (dvec != nullptr)
+    {
+        // columns were found once in minimize(), see init_amplitude_columns()
+        for (size_t c = 0; c < ud->amplitude_cols.size(); c++)
+        {
+            int idx = ud->amplitude_cols[c];
+            if (idx < params_size && dvec[idx] != nullptr)
+            {
+                fill_amplitude_column(*ud, c, dvec[idx]);
+            }
+        }
+    }
 	
     ud->cur_itr++;
     if (ud->status_callback != nullptr)
@@ -281,7 +302,7 @@ void MPFit_Optimizer<T_real>::set_options(unordered_map<string, T_real> opt)
 
 
 template<typename T_real>
-void MPFit_Optimizer<T_real>::_fill_limits(Fit_Parameters<T_real> *fit_params , vector<struct mp_par<T_real> > &par)
+void MPFit_Optimizer<T_real>::_fill_limits(Fit_Parameters<T_real> *fit_params , vector<struct mp_par<T_real> > &par, const User_Data<T_real>* ud)
 {
 	for (auto itr = fit_params->begin(); itr != fit_params->end(); itr++)
 	{
@@ -345,7 +366,8 @@ void MPFit_Optimizer<T_real>::_fill_limits(Fit_Parameters<T_real> *fit_params ,
 			par[fit.opt_array_index].step = 0;      // 0 = auto ,Step size for finite difference
 			par[fit.opt_array_index].parname = 0;
 			par[fit.opt_array_index].relstep = 0;   // Relative step size for finite difference
-			par[fit.opt_array_index].side = 0;         // Sidedness of finite difference derivative
+			// amplitudes only scale their own term of the model, mpfit gets those columns from residuals_mpfit
+			par[fit.opt_array_index].side = (ud != nullptr && std::find(ud->amplitude_cols.begin(), ud->amplitude_cols.end(), fit.opt_array_index) != ud->amplitude_cols.end()) ? 3 : 0;         // Sidedness of finite difference derivative
 					 //     0 - one-sided derivative computed automatically
 					 //     1 - one-sided derivative (f(x+h) - f(x)  )/h
 					 //    -1 - one-sided derivative (f(x)   - f(x-h))/h
@@ -428,6 +450,7 @@ OPTIMIZER_OUTCOME MPFit_Optimizer<T_real>::minimize(Fit_Parameters<T_real>*fit_p
 
     size_t total_itr = num_itr * (fitp_arr.size() + 1);
     fill_user_data(ud, fit_params, spectra, elements_to_fit, model, energy_range, status_callback, total_itr);
+    init_amplitude_columns(ud);
 
     int info;
     /*
@@ -463,16 +486,18 @@ OPTIMIZER_OUTCOME MPFit_Optimizer<T_real>::minimize(Fit_Parameters<T_real>*fit_p
 	vector<struct mp_par<T_real> > par;
 	par.resize(fitp_arr.size());
 
-    _options.maxfev = _options.maxiter * (fitp_arr.size() + 1);
+    // local copy, mpfit gets a pointer and the shared optimizer stays untouched
+    mp_config<T_real> options = _options;
+    options.maxfev = options.maxiter * (fitp_arr.size() + 1);
 
-	_fill_limits(fit_params, par);
+	_fill_limits(fit_params, par, &ud);
 
     mp_result<T_real> result;
     memset(&result,0,sizeof(result));
     result.xerror = &perror[0];
     result.resid = &resid[0];
 
-    info = mpfit(residuals_mpfit<T_real>, energy_range.count(), fitp_arr.size(), &fitp_arr[0], &par[0], &_options, (void *) &ud, &result);
+    info = mpfit(residuals_mpfit<T_real>, energy_range.count(), fitp_arr.size(), &fitp_arr[0], &par[0], &options, (void *) &ud, &result);
 
 	_print_info(info);
 
@@ -504,7 +529,7 @@ OPTIMIZER_OUTCOME MPFit_Optimizer<T_real>::minimize(Fit_Parameters<T_real>*fit_p
     }
     // add perror_ fit params
     Fit_Parameters<T_real> error_params;
-    for (typename std::unordered_map<std::string, Fit_Param<T_real>>::const_iterator itr = fit_params->begin(); itr != fit_params->end(); itr++)
+    for (auto itr = fit_params->begin(); itr != fit_params->end(); itr++)
     {
         if (itr->second.opt_array_index > -1)
         {
@@ -518,7 +543,7 @@ OPTIMIZER_OUTCOME MPFit_Optimizer<T_real>::minimize(Fit_Parameters<T_real>*fit_p
     fit_params->append_and_update(error_params);
 
     if (this->_outcome_map.count(info) > 0)
-        return this->_outcome_map[info];
+        return this->_outcome_map.at(info);
 
     return OPTIMIZER_OUTCOME::FAILED;
 }
@@ -530,7 +555,8 @@ OPTIMIZER_OUTCOME MPFit_Optimizer<T_real>::minimize_func(Fit_Parameters<T_real>
                                                 const Spectra<T_real>* const spectra,
                                                 const Range energy_range,
                                                 const ArrayTr<T_real>* background,
-									            Gen_Func_Def<T_real> gen_func)
+									            Gen_Func_Def<T_real> gen_func,
+                                                const Optimizer_Overrides<T_real>* overrides)
 {
     Gen_User_Data<T_real> ud;
     fill_gen_user_data(ud, fit_params, spectra, energy_range, background, gen_func);
@@ -569,7 +595,28 @@ OPTIMIZER_OUTCOME MPFit_Optimizer<T_real>::minimize_func(Fit_Parameters<T_real>
     mp_config.iterproc = 0;         // Placeholder pointer - must set to 0
     */
 
-    _options.maxfev = _options.maxiter * (fitp_arr.size() + 1);
+    // local copy, mpfit gets a pointer and the shared optimizer stays untouched
+    mp_config<T_real> options = _options;
+    if (overrides != nullptr)
+    {
+        if (overrides->max_iter > -1)
+        {
+            options.maxiter = overrides->max_iter;
+        }
+        if (std::isfinite(overrides->ftol))
+        {
+            options.ftol = overrides->ftol;
+        }
+        if (std::isfinite(overrides->gtol))
+        {
+            options.gtol = overrides->gtol;
+        }
+        if (std::isfinite(overrides->xtol))
+        {
+            options.xtol = overrides->xtol;
+        }
+    }
+    options.maxfev = options.maxiter * (fitp_arr.size() + 1);
 
 	vector<struct mp_par<T_real> > par;
 	par.resize(fitp_arr.size());
@@ -580,7 +627,7 @@ OPTIMIZER_OUTCOME MPFit_Optimizer<T_real>::minimize_func(Fit_Parameters<T_real>
     result.xerror = &perror[0];
     result.resid = &resid[0];
 
-    info = mpfit(gen_residuals_mpfit<T_real>, energy_range.count(), fitp_arr.size(), &fitp_arr[0], &par[0], &_options, (void*)&ud, &result);
+    info = mpfit(gen_residuals_mpfit<T_real>, energy_range.count(), fitp_arr.size(), &fitp_arr[0], &par[0], &options, (void*)&ud, &result);
 
     fit_params->from_array(fitp_arr);
 
@@ -603,7 +650,7 @@ OPTIMIZER_OUTCOME MPFit_Optimizer<T_real>::minimize_func(Fit_Parameters<T_real>
     }
 
     if (this->_outcome_map.count(info) > 0)
-        return this->_outcome_map[info];
+        return this->_outcome_map.at(info);
 
     return OPTIMIZER_OUTCOME::FAILED;
 }
@@ -662,7 +709,9 @@ OPTIMIZER_OUTCOME MPFit_Optimizer<T_real>::minimize_quantification(Fit_Parameter
     mp_config.iterproc = 0;         // Placeholder pointer - must set to 0
     */
 
-    _options.maxfev = _options.maxiter * (fitp_arr.size() + 1);
+    // local copy, mpfit gets a pointer and the shared optimizer stays untouched
+    mp_config<T_real> options = _options;
+    options.maxfev = options.maxiter * (fitp_arr.size() + 1);
 
     mp_result<T_real> result;
     memset(&result,0,sizeof(result));
@@ -676,7 +725,7 @@ OPTIMIZER_OUTCOME MPFit_Optimizer<T_real>::minimize_quantification(Fit_Parameter
 	par.resize(fitp_arr.size());
 	_fill_limits(fit_params, par);
 
-    info = mpfit(quantification_residuals_mpfit<T_real>, quant_map->size(), fitp_arr.size(), &fitp_arr[0], &par[0], &_options, (void *) &ud, &result);
+    info = mpfit(quantification_residuals_mpfit<T_real>, quant_map->size(), fitp_arr.size(), &fitp_arr[0], &par[0], &options, (void *) &ud, &result);
     logI << "\nOutcome: " << optimizer_outcome_to_str(this->_outcome_map[info]) << "\nNum iter: " << result.niter << "\n Norm of the residue vector: " << *result.resid << "\n";
 
 	_print_info(info);
@@ -712,7 +761,7 @@ OPTIMIZER_OUTCOME MPFit_Optimizer<T_real>::minimize_quantification(Fit_Parameter
     }    
 
     if (this->_outcome_map.count(info) > 0)
-        return this->_outcome_map[info];
+        return this->_outcome_map.at(info);
 
     return OPTIMIZER_OUTCOME::FAILED;
 
@@ -81,7 +81,8 @@ public:
                                             const Spectra<T_real>* const spectra,
                                             const Range energy_range,
                                             const ArrayTr<T_real>* background,
-                                            Gen_Func_Def<T_real> gen_func);
+                                            Gen_Func_Def<T_real> gen_func,
+                                            const Optimizer_Overrides<T_real>* overrides = nullptr);
 
     virtual OPTIMIZER_OUTCOME minimize_quantification(Fit_Parameters<T_real>*fit_params,
                                                      std::unordered_map<std::string, Element_Quant<T_real>*> * quant_map,
@@ -93,7 +94,7 @@ public:
 
 private:
 
-	void _fill_limits(Fit_Parameters<T_real> *fit_params, vector<struct mp_par<T_real> > &par);
+	void _fill_limits(Fit_Parameters<T_real> *fit_params, vector<struct mp_par<T_real> > &par, const User_Data<T_real>* ud = nullptr);
 	
     inline void _print_info(int info);
 
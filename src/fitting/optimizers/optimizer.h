@@ -50,7 +50,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef Optimizer_H
 #define Optimizer_H
 
+#include <algorithm>
 #include <functional>
+#include "data_struct/background.h"
 #include "data_struct/fit_parameters.h"
 #include "fitting/models/base_model.h"
 #include "quantification/models/quantification_model.h"
@@ -106,6 +108,10 @@ struct User_Data
     Callback_Func_Status_Def* status_callback;
     size_t cur_itr;
     size_t total_itr;
+    // analytic jacobian columns, set once per minimize by init_amplitude_columns()
+    unordered_map<string, ArrayTr<T_real> > amplitude_terms;
+    std::vector<int> amplitude_cols;
+    std::vector<ArrayTr<T_real>*> amplitude_col_terms;
 };
 
 TEMPLATE_STRUCT_DLL_EXPORT User_Data<float>;
@@ -181,17 +187,22 @@ void fill_user_data(User_Data<T_real> &ud,
         ud.weights.fill(1.0);
     }
 
-    ArrayTr<T_real> background(spectra->size());
-    background.setZero(spectra->size());
-    if (fit_params->contains(STR_SNIP_WIDTH))
+    // per thread buffer, the segment below copies out of it
+    thread_local ArrayTr<T_real> background;
+    if (fit_params->contains(Fit_Param_Id::SNIP_WIDTH))
     {
-        background = snip_background<T_real>(spectra,
-            fit_params->value(STR_ENERGY_OFFSET),
-            fit_params->value(STR_ENERGY_SLOPE),
-            fit_params->value(STR_ENERGY_QUADRATIC),
-            fit_params->value(STR_SNIP_WIDTH),
+        std::shared_ptr<const Snip_Schedule<T_real>> schedule = get_snip_schedule<T_real>(spectra->size(),
+            fit_params->value(Fit_Param_Id::ENERGY_OFFSET),
+            fit_params->value(Fit_Param_Id::ENERGY_SLOPE),
+            fit_params->value(Fit_Param_Id::ENERGY_QUADRATIC),
+            fit_params->value(Fit_Param_Id::SNIP_WIDTH),
             energy_range.min,
             energy_range.max);
+        snip_background<T_real>(*spectra, *schedule, background);
+    }
+    else
+    {
+        background.setZero(spectra->size());
     }
     ud.spectra_background = background.segment(energy_range.min, energy_range.count());
     ud.spectra_background = ud.spectra_background.unaryExpr([](T_real v) { return std::isfinite(v) ? v : (T_real)0.0; });
@@ -242,19 +253,21 @@ void fill_gen_user_data(Gen_User_Data<T_real>& ud,
 template<typename T_real>
 void update_background_user_data(User_Data<T_real> *ud)
 {
-    if (ud->fit_parameters->contains(STR_SNIP_WIDTH))
+    if (ud->fit_parameters->contains(Fit_Param_Id::SNIP_WIDTH))
     {
-        Fit_Param<T_real> fit_snip_width = ud->fit_parameters->at(STR_SNIP_WIDTH);
+        const Fit_Param<T_real>& fit_snip_width = ud->fit_parameters->at(Fit_Param_Id::SNIP_WIDTH);
         if (fit_snip_width.bound_type != E_Bound_Type::FIXED && ud->orig_spectra != nullptr)
         {
-            //ud->spectra_background = snip_background(ud->orig_spectra,
-            ArrayTr<T_real> background = snip_background<T_real>(ud->orig_spectra,
-                ud->fit_parameters->value(STR_ENERGY_OFFSET),
-                ud->fit_parameters->value(STR_ENERGY_SLOPE),
-                ud->fit_parameters->value(STR_ENERGY_QUADRATIC),
+            // runs every residual evaluation, the schedule only changes when a calibration parameter or the width moves
+            thread_local ArrayTr<T_real> background;
+            std::shared_ptr<const Snip_Schedule<T_real>> schedule = get_snip_schedule<T_real>(ud->orig_spectra->size(),
+                ud->fit_parameters->value(Fit_Param_Id::ENERGY_OFFSET),
+                ud->fit_parameters->value(Fit_Param_Id::ENERGY_SLOPE),
+                ud->fit_parameters->value(Fit_Param_Id::ENERGY_QUADRATIC),
                 fit_snip_width.value,
                 ud->energy_range.min,
                 ud->energy_range.max);
+            snip_background<T_real>(*ud->orig_spectra, *schedule, background);
 
             ud->spectra_background = background.segment(ud->energy_range.min, ud->energy_range.count());
             ud->spectra_background = ud->spectra_background.unaryExpr([](T_real v) { return std::isfinite(v) ? v : (T_real)0.0; });
@@ -263,6 +276,113 @@ void update_background_user_data(User_Data<T_real> *ud)
     }
 }
 
+//----------------------------------------------------------------------------
+
+/**
+ * @brief is_amplitude_param : True if the model can give d(model)/d(param) analytically, i.e. param is an element,
+ *                             coherent or compton amplitude and the model returns amplitude terms.
+ *                             Only the amplitude columns of the jacobian are analytic. FWHM offset / fanoprime, energy
+ *                             offset / slope / quadratic and the tail / step parameters stay finite differences in
+ *                             lmmin and mpfit.
+ */
+template<typename T_real>
+bool is_amplitude_param(const User_Data<T_real> &ud, const std::string& param_name)
+{
+    if (ud.fit_model == nullptr || false == ud.fit_model->supports_amplitude_terms())
+    {
+        return false;
+    }
+    if (param_name == STR_COHERENT_SCT_AMPLITUDE || param_name == STR_COMPTON_AMPLITUDE)
+    {
+        return true;
+    }
+    if (ud.elements != nullptr)
+    {
+        for (const auto& itr : *(ud.elements))
+        {
+            if (itr.second != nullptr && itr.second->full_name() == param_name)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * @brief init_amplitude_columns : Call after fit_params->to_array() and fill_user_data(). Finds the amplitude params
+ *                                 that are fit and points each column at its entry in ud.amplitude_terms.
+ *                                 model_spectrum_amplitude_terms() only assigns to entries, it never removes them, so
+ *                                 the pointers stay valid for the whole minimize. ud must not be copied afterwards.
+ */
+template<typename T_real>
+void init_amplitude_columns(User_Data<T_real> &ud)
+{
+    ud.amplitude_terms.clear();
+    ud.amplitude_cols.clear();
+    ud.amplitude_col_terms.clear();
+    if (ud.fit_model == nullptr || false == ud.fit_model->supports_amplitude_terms())
+    {
+        return;
+    }
+    for (const auto& itr : *(ud.fit_parameters))
+    {
+        if (itr.second.bound_type != E_Bound_Type::FIXED && itr.second.opt_array_index > -1 && is_amplitude_param(ud, itr.first))
+        {
+            ud.amplitude_cols.push_back(itr.second.opt_array_index);
+            ud.amplitude_col_terms.push_back(&(ud.amplitude_terms[itr.first]));
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * @brief fill_amplitude_column : residual = (spectra - model) * weight and model term = 10^amplitude * shape so
+ *                                d(residual)/d(amplitude) = -weight * ln(10) * term. Fills col with amplitude column c
+ *                                from the terms of the last model_spectrum_amplitude_terms() call.
+ */
+template<typename T_real>
+void fill_amplitude_column(const User_Data<T_real> &ud, size_t c, T_real* col)
+{
+    const T_real ln10 = std::log((T_real)10.0);
+    const Eigen::Index m = ud.weights.size();
+    const ArrayTr<T_real>& term = *(ud.amplitude_col_terms[c]);
+    if (term.size() != m)
+    {
+        std::fill(col, col + m, (T_real)0.0);
+        return;
+    }
+    for (Eigen::Index i = 0; i < m; i++)
+    {
+        T_real d = -ud.weights[i] * ln10 * term[i];
+        col[i] = std::isfinite(d) ? d : (T_real)0.0;
+    }
+}
+
+//----------------------------------------------------------------------------
+
+/**
+ * @brief The Optimizer_Overrides struct : Read only option overrides for a single minimize call. Fields left at
+ *                                        -1 / NaN keep the optimizer's configured value. Routines pass these instead of
+ *                                        set_options() so the optimizer shared by all fitting threads is never modified.
+ */
+template<typename T_real>
+struct Optimizer_Overrides
+{
+    Optimizer_Overrides(int max_iter_ = -1,
+                        T_real ftol_ = std::numeric_limits<T_real>::quiet_NaN(),
+                        T_real gtol_ = std::numeric_limits<T_real>::quiet_NaN(),
+                        T_real xtol_ = std::numeric_limits<T_real>::quiet_NaN()) : max_iter(max_iter_), ftol(ftol_), gtol(gtol_), xtol(xtol_) {}
+
+    const int max_iter;
+    const T_real ftol;
+    const T_real gtol;
+    const T_real xtol;
+};
+
 //----------------------------------------------------------------------------
 //----------------------------------------------------------------------------
 
@@ -288,7 +408,8 @@ public:
                                const Spectra<T_real>* const spectra,
                                const Range energy_range,
                                const ArrayTr<T_real>* background,
-                               Gen_Func_Def<T_real> gen_func) = 0;
+                               Gen_Func_Def<T_real> gen_func,
+                               const Optimizer_Overrides<T_real>* overrides = nullptr) = 0;
 
 
     virtual OPTIMIZER_OUTCOME minimize_quantification(Fit_Parameters<T_real>*fit_params,
@@ -297,6 +418,7 @@ public:
 
     virtual unordered_map<string, T_real> get_options() = 0;
 
+    // Configuration only, not safe to call while fits are running. Use Optimizer_Overrides for per fit changes.
     virtual void set_options(unordered_map<string, T_real> opt) = 0;
 
 protected:
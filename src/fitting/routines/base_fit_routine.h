@@ -50,11 +50,13 @@ POSSIBILITY OF SUCH DAMAGE.
 #define Base_Fit_Routine_H
 
 #include <unordered_map>
+#include <vector>
 
 #include "fitting/optimizers/optimizer.h"
 #include "data_struct/spectra.h"
 #include "fitting/models/base_model.h"
 #include "data_struct/fit_element_map.h"
+#include "data_struct/fit_result_cube.h"
 
 namespace fitting
 {
@@ -75,7 +77,7 @@ public:
     /**
      * @brief Base_Fit_Routine : Constructor
      */
-    Base_Fit_Routine() {}
+    Base_Fit_Routine() { _neighbor_warm_start = false; }
 
     /**
      * @brief ~Base_Fit_Routine : Destructor
@@ -96,6 +98,29 @@ public:
                                                       const Fit_Element_Map_Dict<T_real> * const elements_to_fit,
                                                       std::unordered_map<std::string, T_real>& out_counts) = 0;
 
+    /**
+     * @brief fit_spectra_batch : Fit a block of spectra (a row or tile of pixels). Routines that can solve many
+     *                            spectra at once override this, default fits them one at a time.
+     * @param model : Model used to generate the fit
+     * @param spectras : Pointers to the spectra we are fitting to
+     * @param layout : Slot of each result, its elements_to_fit are the elements fit
+     * @param out_results : spectras.size() rows of layout.size() values. Slots a routine does not report are not
+     *                      written so the caller zeroes it first.
+     */
+    virtual void fit_spectra_batch(const models::Base_Model<T_real> * const model,
+                                   const std::vector<const Spectra<T_real>*>& spectras,
+                                   const Fit_Result_Layout<T_real>& layout,
+                                   T_real* const out_results)
+    {
+        std::unordered_map<std::string, T_real> counts;
+        for (size_t i = 0; i < spectras.size(); i++)
+        {
+            counts.clear();
+            fit_spectra(model, spectras[i], layout.elements_to_fit(), counts);
+            layout.assign_counts(counts, out_results + i * layout.size());
+        }
+    }
+
     /**
      * @brief get_name : Returns fit routine name
      * @return
@@ -113,9 +138,18 @@ public:
                             const Fit_Element_Map_Dict<T_real> * const elements_to_fit,
                             const struct Range energy_range) = 0;
 
+    /**
+     * @brief set_neighbor_warm_start : When true fit_spectra_batch starts each spectra from the solution of the one
+     *                                  before it (neighboring pixels of a row or tile) instead of a cold guess.
+     *                                  Routines that fit iteratively fall back to a cold start if it diverges.
+     */
+    void set_neighbor_warm_start(bool val) { _neighbor_warm_start = val; }
+
+    bool neighbor_warm_start() const { return _neighbor_warm_start; }
 
 protected:
 
+    bool _neighbor_warm_start;
 
 private:
 
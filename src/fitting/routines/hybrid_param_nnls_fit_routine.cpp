@@ -70,7 +70,10 @@ Hybrid_Param_NNLS_Fit_Routine<T_real>::Hybrid_Param_NNLS_Fit_Routine() : NNLS_Fi
     _model = nullptr;
     _elements_to_fit = nullptr;
     _spectra = nullptr;
+    _basis_valid = false;
     this->_max_iter = 4000;
+    // every optimizer step re-initializes with a new calibration
+    this->_use_element_model_cache = false;
 }
 
 // ----------------------------------------------------------------------------
@@ -91,8 +94,48 @@ void Hybrid_Param_NNLS_Fit_Routine<T_real>::model_spectrum(const Fit_Parameters<
     if (_model != nullptr && _elements_to_fit != nullptr)
     {
         _model->update_fit_params_values(fit_params);
-        this->initialize(_model, _elements_to_fit, *energy_range);
-        this->fit_spectrum_model(_spectra, &_background, _elements_to_fit, spectra_model);
+        _update_basis(*energy_range);
+        this->fit_spectrum_model(_spectra, &_background, _elements_to_fit, spectra_model, &_warm_start);
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Hybrid_Param_NNLS_Fit_Routine<T_real>::_update_basis(const struct Range& energy_range)
+{
+    const Fit_Parameters<T_real>& params = _model->fit_parameters();
+
+    unsigned int groups = models::BASIS_NONE;
+    if (false == _basis_valid || _basis_values.size() != NUM_FIT_PARAM_IDS || energy_range.min != _basis_range.min || energy_range.max != _basis_range.max)
+    {
+        groups = models::BASIS_ALL;
+        _basis_values.resize(NUM_FIT_PARAM_IDS);
+    }
+
+    for (size_t i = 0; i < NUM_FIT_PARAM_IDS; i++)
+    {
+        Fit_Param_Id id = static_cast<Fit_Param_Id>(i);
+        T_real value = params.contains(id) ? params.value(id) : std::numeric_limits<T_real>::quiet_NaN();
+        // nan != nan, compare the missing case explicitly
+        bool same = (value == _basis_values[i]) || (std::isnan(value) && std::isnan(_basis_values[i]));
+        if (false == same)
+        {
+            groups |= _model->basis_dependency(id);
+            _basis_values[i] = value;
+        }
+    }
+
+    if (groups == models::BASIS_ALL)
+    {
+        this->initialize(_model, _elements_to_fit, energy_range);
+        _basis_range.min = energy_range.min;
+        _basis_range.max = energy_range.max;
+        _basis_valid = true;
+    }
+    else if (groups != models::BASIS_NONE)
+    {
+        this->_update_fitmatrix_columns(this->_generate_element_models(_model, _elements_to_fit, energy_range, groups));
     }
 }
 
@@ -115,11 +158,11 @@ OPTIMIZER_OUTCOME Hybrid_Param_NNLS_Fit_Routine<T_real>::fit_spectra_parameters(
     fit_params.add_parameter(Fit_Param<T_real>(STR_CHISQRED, 0.0));
     fit_params.add_parameter(Fit_Param<T_real>(STR_FREE_PARS, 0.0));
 
-    if (fit_params.contains(STR_COMPTON_AMPLITUDE))
+    if (fit_params.contains(Fit_Param_Id::COMPTON_AMPLITUDE))
     {
         fit_params[STR_COMPTON_AMPLITUDE].bound_type = E_Bound_Type::FIXED;
     }
-    if (fit_params.contains(STR_COHERENT_SCT_AMPLITUDE))
+    if (fit_params.contains(Fit_Param_Id::COHERENT_SCT_AMPLITUDE))
     {
         fit_params[STR_COHERENT_SCT_AMPLITUDE].bound_type = E_Bound_Type::FIXED;
     }
@@ -139,15 +182,17 @@ OPTIMIZER_OUTCOME Hybrid_Param_NNLS_Fit_Routine<T_real>::fit_spectra_parameters(
             //ret_val = _optimizer->minimize(&fit_params, spectra, elements_to_fit, model, _energy_range, status_callback);
             std::function<void(const Fit_Parameters<T_real>* const, const  Range* const, Spectra<T_real>*)> gen_func = std::bind(&Hybrid_Param_NNLS_Fit_Routine<T_real>::model_spectrum, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 
-            if (fit_params.contains(STR_SNIP_WIDTH))
+            if (fit_params.contains(Fit_Param_Id::SNIP_WIDTH))
             {
-                ArrayTr<T_real> bkg = snip_background<T_real>(spectra,
-                    fit_params.value(STR_ENERGY_OFFSET),
-                    fit_params.value(STR_ENERGY_SLOPE),
-                    fit_params.value(STR_ENERGY_QUADRATIC),
-                    fit_params.value(STR_SNIP_WIDTH),
+                thread_local ArrayTr<T_real> bkg;
+                std::shared_ptr<const Snip_Schedule<T_real>> schedule = get_snip_schedule<T_real>(spectra->size(),
+                    fit_params.value(Fit_Param_Id::ENERGY_OFFSET),
+                    fit_params.value(Fit_Param_Id::ENERGY_SLOPE),
+                    fit_params.value(Fit_Param_Id::ENERGY_QUADRATIC),
+                    fit_params.value(Fit_Param_Id::SNIP_WIDTH),
                     this->_energy_range.min,
                     this->_energy_range.max);
+                snip_background<T_real>(*spectra, *schedule, bkg);
 
                 _background = bkg.segment(this->_energy_range.min, this->_energy_range.count());
             }
@@ -158,11 +203,17 @@ OPTIMIZER_OUTCOME Hybrid_Param_NNLS_Fit_Routine<T_real>::fit_spectra_parameters(
             _model = (models::Base_Model<T_real>*)model;
             _elements_to_fit = elements_to_fit;
             _spectra = spectra;
+            // new spectra, elements or model: rebuild the basis and solve cold on the first evaluation
+            _basis_valid = false;
+            _warm_start.resize(0);
 
-            ret_val = this->_optimizer->minimize_func(&fit_params, spectra, this->_energy_range, &_background, gen_func);
+            // the warm started NNLS moves the residual a little every evaluation, so the default tolerances
+            // (a few machine eps) are never met and LM ran to maxfev. Stop on relative residual / parameter change.
+            static const optimizers::Optimizer_Overrides<T_real> opt_overrides(-1, (T_real)1.0e-6, std::numeric_limits<T_real>::quiet_NaN(), (T_real)1.0e-6);
+            ret_val = this->_optimizer->minimize_func(&fit_params, spectra, this->_energy_range, &_background, gen_func, &opt_overrides);
 
             _model->update_fit_params_values(&fit_params);
-            this->initialize(_model, elements_to_fit, this->_energy_range);
+            _update_basis(this->_energy_range);
             std::unordered_map<std::string, T_real> out_counts;
             this->fit_spectra(_model, spectra, elements_to_fit, out_counts);
 
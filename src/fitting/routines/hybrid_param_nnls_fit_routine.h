@@ -83,12 +83,23 @@ public:
 
 protected:
 
+    // bring the fit matrix up to date with the model's parameters, only rebuilding basis groups whose inputs changed
+    void _update_basis(const struct Range& energy_range);
+
 private:
     models::Base_Model<T_real>* _model;
     ArrayTr<T_real> _background;
     const Fit_Element_Map_Dict<T_real>* _elements_to_fit;
     const data_struct::Spectra<T_real>* _spectra;
-    
+
+    // core parameter values (NaN if missing) and range the current fit matrix was built with
+    std::vector<T_real> _basis_values;
+    struct Range _basis_range;
+    bool _basis_valid;
+
+    // last nnls solution, seeds the next solve of the same spectra
+    ArrayTr<T_real> _warm_start;
+
 };
 
 TEMPLATE_CLASS_DLL_EXPORT Hybrid_Param_NNLS_Fit_Routine<float>;
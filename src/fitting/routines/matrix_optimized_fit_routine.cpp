@@ -47,21 +47,19 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "matrix_optimized_fit_routine.h"
+#include "workflow/threadpool.h"
 
 namespace fitting
 {
 namespace routines
 {
 
-template<typename T_real>
-std::mutex Matrix_Optimized_Fit_Routine<T_real>::_int_spec_mutex;
-
-// ----------------------------------------------------------------------------
-
 template<typename T_real>
 Matrix_Optimized_Fit_Routine<T_real>::Matrix_Optimized_Fit_Routine() : Param_Optimized_Fit_Routine<T_real>()
 {
-
+    _use_element_model_cache = true;
+    _slot_tables.emplace_back(new Accumulator_Slots(std::max<size_t>(std::thread::hardware_concurrency(), 1) + 1));
+    _slots.store(_slot_tables.back().get());
 }
 
 // ----------------------------------------------------------------------------
@@ -124,7 +122,8 @@ void Matrix_Optimized_Fit_Routine<T_real>::model_spectrum(const Fit_Parameters<T
 template<typename T_real>
 unordered_map<string, Spectra<T_real>> Matrix_Optimized_Fit_Routine<T_real>::_generate_element_models(models::Base_Model<T_real>* const model,
                                                                                       const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
-                                                                                      struct Range energy_range)
+                                                                                      struct Range energy_range,
+                                                                                      unsigned int basis_groups)
 {
     // fitmatrix(energy_range.count(), elements_to_fit->size()+2); //+2 for compton and elastic //n_pileup)
     unordered_map<string, Spectra<T_real>> element_spectra;
@@ -138,13 +137,21 @@ unordered_map<string, Spectra<T_real>> Matrix_Optimized_Fit_Routine<T_real>::_ge
     //set all fit parameters to be fixed. We only want to fit element counts
     fit_parameters.set_all(E_Bound_Type::FIXED);
 
-    T_real energy_offset = fit_parameters.value(STR_ENERGY_OFFSET);
-    T_real energy_slope = fit_parameters.value(STR_ENERGY_SLOPE);
-    T_real energy_quad = fit_parameters.value(STR_ENERGY_QUADRATIC);
+    T_real energy_offset = fit_parameters.value(Fit_Param_Id::ENERGY_OFFSET);
+    T_real energy_slope = fit_parameters.value(Fit_Param_Id::ENERGY_SLOPE);
+    T_real energy_quad = fit_parameters.value(Fit_Param_Id::ENERGY_QUADRATIC);
 
     ArrayTr<T_real> energy = ArrayTr<T_real>::LinSpaced(energy_range.count(), energy_range.min, energy_range.max);
     ArrayTr<T_real> ev = energy_offset + (energy * energy_slope) + (pow(energy, (T_real)2.0) * energy_quad);
 
+    models::Element_Model_Cache<T_real>* cache = models::Element_Model_Cache<T_real>::inst();
+    models::Element_Model_Key basis;
+    if (_use_element_model_cache)
+    {
+        basis = models::basis_key(model, fit_parameters, energy_range);
+    }
+    T_real incident_energy = fit_parameters.value(Fit_Param_Id::COHERENT_SCT_ENERGY);
+
     for(const auto& itr : (*elements_to_fit))
     {
         Fit_Element_Map<T_real>* element = itr.second;
@@ -158,28 +165,79 @@ unordered_map<string, Spectra<T_real>> Matrix_Optimized_Fit_Routine<T_real>::_ge
         {
             fit_parameters[itr.first].value = 0.0;
         }
-        element_spectra[itr.first] = model->model_spectrum_element(&fit_parameters, element, ev, nullptr);
+        // elastic and compton are modeled below
+        if (itr.first == STR_COHERENT_SCT_AMPLITUDE || itr.first == STR_COMPTON_AMPLITUDE || (basis_groups & models::BASIS_ELEMENTS) == 0)
+        {
+            continue;
+        }
+        if (_use_element_model_cache)
+        {
+            models::Element_Model_Key key = models::element_basis_key(basis, element, incident_energy);
+            std::shared_ptr<const Spectra<T_real>> cached = cache->find(key);
+            if (cached == nullptr)
+            {
+                cached = cache->insert(key, model->model_spectrum_element(&fit_parameters, element, ev, nullptr));
+            }
+            element_spectra[itr.first] = *cached;
+        }
+        else
+        {
+            element_spectra[itr.first] = model->model_spectrum_element(&fit_parameters, element, ev, nullptr);
+        }
     }
 
     //i = elements_to_fit->size();
     // scattering:
     // elastic peak
-
-    Spectra<T_real> elastic_model(energy_range.count());
     // Set value to 0 because log10(0) = 1.0
     fit_parameters[STR_COHERENT_SCT_AMPLITUDE].value = 0.0;
-    elastic_model += model->elastic_peak(&fit_parameters, ev, fit_parameters.at(STR_ENERGY_SLOPE).value);
-    element_spectra[STR_COHERENT_SCT_AMPLITUDE] = elastic_model;
+    fit_parameters[STR_COMPTON_AMPLITUDE].value = 0.0;
+
+    if (basis_groups & models::BASIS_ELASTIC)
+    {
+        models::Element_Model_Key elastic_key = basis;
+        elastic_key.add(std::string(STR_COHERENT_SCT_AMPLITUDE));
+        std::shared_ptr<const Spectra<T_real>> elastic_cached = _use_element_model_cache ? cache->find(elastic_key) : nullptr;
+        if (elastic_cached != nullptr)
+        {
+            element_spectra[STR_COHERENT_SCT_AMPLITUDE] = *elastic_cached;
+        }
+        else
+        {
+            Spectra<T_real> elastic_model(energy_range.count());
+            elastic_model += model->elastic_peak(&fit_parameters, ev, fit_parameters.at(Fit_Param_Id::ENERGY_SLOPE).value);
+            if (_use_element_model_cache)
+            {
+                cache->insert(elastic_key, elastic_model);
+            }
+            element_spectra[STR_COHERENT_SCT_AMPLITUDE] = elastic_model;
+        }
+    }
     //Set it so we fit coherent amp in fit params
     ///(*fit_params)[STR_COHERENT_SCT_AMPLITUDE].bound_type = data_struct::E_Bound_Type::FIT;
 
 
     // compton peak
-    Spectra<T_real> compton_model(energy_range.count());
-    // Set value to 0 because log10(0) = 1.0
-    fit_parameters[STR_COMPTON_AMPLITUDE].value = 0.0;
-    compton_model += model->compton_peak(&fit_parameters, ev, fit_parameters.at(STR_ENERGY_SLOPE).value);
-    element_spectra[STR_COMPTON_AMPLITUDE] = compton_model;
+    if (basis_groups & models::BASIS_COMPTON)
+    {
+        models::Element_Model_Key compton_key = basis;
+        compton_key.add(std::string(STR_COMPTON_AMPLITUDE));
+        std::shared_ptr<const Spectra<T_real>> compton_cached = _use_element_model_cache ? cache->find(compton_key) : nullptr;
+        if (compton_cached != nullptr)
+        {
+            element_spectra[STR_COMPTON_AMPLITUDE] = *compton_cached;
+        }
+        else
+        {
+            Spectra<T_real> compton_model(energy_range.count());
+            compton_model += model->compton_peak(&fit_parameters, ev, fit_parameters.at(Fit_Param_Id::ENERGY_SLOPE).value);
+            if (_use_element_model_cache)
+            {
+                cache->insert(compton_key, compton_model);
+            }
+            element_spectra[STR_COMPTON_AMPLITUDE] = compton_model;
+        }
+    }
     //Set it so we fit STR_COMPTON_AMPLITUDE  in fit params
     ///(*fit_params)[STR_COMPTON_AMPLITUDE].bound_type = data_struct::FIT;
 
@@ -192,7 +250,7 @@ unordered_map<string, Spectra<T_real>> Matrix_Optimized_Fit_Routine<T_real>::_ge
         }
         delta_energy = ev.copy() - (add_pars[i, j].energy);
         faktor = add_pars[i, j].ratio;
-        counts = faktor * this->model_gauss_peak(fit_parameters.at(STR_ENERGY_SLOPE).value, sigma[i, j], delta_energy);
+        counts = faktor * this->model_gauss_peak(fit_parameters.at(Fit_Param_Id::ENERGY_SLOPE).value, sigma[i, j], delta_energy);
 
         //fitmatrix[:, this_i+ii] = fitmatrix[:, this_i+ii]+counts[:];
         fitmatrix.row(this_i + ii) = fitmatrix.row(this_i + ii) + counts;
@@ -218,15 +276,156 @@ void Matrix_Optimized_Fit_Routine<T_real>::initialize(models::Base_Model<T_real>
     _element_models = _generate_element_models(model, elements_to_fit, energy_range);
 
     {
-        std::lock_guard<std::mutex> lock(_int_spec_mutex);
+        std::lock_guard<std::mutex> lock(_accumulators_mutex);
         _integrated_fitted_spectra.setZero(energy_range.count());
         _integrated_background.setZero(energy_range.count());
+        for (auto& acc : _accumulators)
+        {
+            acc->fitted_spectra.resize(0);
+            acc->background.resize(0);
+            acc->max_channels.resize(0);
+            acc->max_10_channels.resize(0);
+            acc->dirty = false;
+        }
     }
 
 }
 
 // ----------------------------------------------------------------------------
 
+template<typename T_real>
+typename Matrix_Optimized_Fit_Routine<T_real>::Integrated_Accumulator& Matrix_Optimized_Fit_Routine<T_real>::_thread_accumulator()
+{
+    const size_t slot = ThreadPool::worker_slot();
+    Accumulator_Slots* slots = _slots.load(std::memory_order_acquire);
+    if (slot < slots->size && slots->acc[slot] != nullptr)
+    {
+        return *(slots->acc[slot]);
+    }
+
+    std::lock_guard<std::mutex> lock(_accumulators_mutex);
+    slots = _slots.load(std::memory_order_relaxed);
+    if (slot >= slots->size)
+    {
+        Accumulator_Slots* grown = new Accumulator_Slots(std::max(slots->size * 2, slot + 1));
+        std::copy(slots->acc.get(), slots->acc.get() + slots->size, grown->acc.get());
+        _slot_tables.emplace_back(grown);
+        _slots.store(grown, std::memory_order_release);
+        slots = grown;
+    }
+    _accumulators.emplace_back(new Integrated_Accumulator());
+    slots->acc[slot] = _accumulators.back().get();
+    return *(_accumulators.back());
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Matrix_Optimized_Fit_Routine<T_real>::_integrate_fit(const Eigen::Ref<const ArrayTr<T_real> >& model_spectra)
+{
+    Integrated_Accumulator& acc = _thread_accumulator();
+    if (acc.fitted_spectra.size() != model_spectra.size())
+    {
+        acc.fitted_spectra = Spectra<T_real>(model_spectra.size(), 0.0, 0.0, 0.0, 0.0);
+    }
+    acc.fitted_spectra += model_spectra;
+    acc.dirty = true;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Matrix_Optimized_Fit_Routine<T_real>::_integrate_fit(const Eigen::Ref<const ArrayTr<T_real> >& model_spectra, const Eigen::Ref<const ArrayTr<T_real> >& background)
+{
+    _integrate_fit(model_spectra);
+    Integrated_Accumulator& acc = _thread_accumulator();
+    if (acc.background.size() != background.size())
+    {
+        acc.background = Spectra<T_real>(background.size(), 0.0, 0.0, 0.0, 0.0);
+    }
+    acc.background += background;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Matrix_Optimized_Fit_Routine<T_real>::_integrate_max_channels(const vector<pair<int, T_real> >& max_map, size_t spectra_size)
+{
+    Integrated_Accumulator& acc = _thread_accumulator();
+    //we don't know the spectra size during initlaize() will have to resize here
+    if (acc.max_channels.size() < (Eigen::Index)spectra_size)
+    {
+        acc.max_channels.setZero(spectra_size);
+    }
+    if (acc.max_10_channels.size() < (Eigen::Index)spectra_size)
+    {
+        acc.max_10_channels.setZero(spectra_size);
+    }
+    if (max_map.size() > 0)
+    {
+        acc.max_channels[max_map[0].first] += max_map[0].second;
+    }
+    for (auto &itr : max_map)
+    {
+        acc.max_10_channels[itr.first] += itr.second;
+    }
+    acc.dirty = true;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Matrix_Optimized_Fit_Routine<T_real>::reduce_integrated_spectra()
+{
+    std::lock_guard<std::mutex> lock(_accumulators_mutex);
+    for (auto& acc : _accumulators)
+    {
+        if (false == acc->dirty)
+        {
+            continue;
+        }
+        if (acc->fitted_spectra.size() > 0)
+        {
+            if (_integrated_fitted_spectra.size() != acc->fitted_spectra.size())
+            {
+                _integrated_fitted_spectra.setZero(acc->fitted_spectra.size());
+            }
+            _integrated_fitted_spectra.add(acc->fitted_spectra);
+        }
+        if (acc->background.size() > 0)
+        {
+            if (_integrated_background.size() != acc->background.size())
+            {
+                _integrated_background.setZero(acc->background.size());
+            }
+            _integrated_background.add(acc->background);
+        }
+        if (acc->max_channels.size() > 0)
+        {
+            if (_max_channels_spectra.size() < acc->max_channels.size())
+            {
+                _max_channels_spectra.setZero(acc->max_channels.size());
+            }
+            _max_channels_spectra.head(acc->max_channels.size()) += acc->max_channels;
+        }
+        if (acc->max_10_channels.size() > 0)
+        {
+            if (_max_10_channels_spectra.size() < acc->max_10_channels.size())
+            {
+                _max_10_channels_spectra.setZero(acc->max_10_channels.size());
+            }
+            _max_10_channels_spectra.head(acc->max_10_channels.size()) += acc->max_10_channels;
+        }
+        acc->fitted_spectra.resize(0);
+        acc->background.resize(0);
+        acc->max_channels.resize(0);
+        acc->max_10_channels.resize(0);
+        acc->dirty = false;
+    }
+}
+
+// ----------------------------------------------------------------------------
+
 template<typename T_real>
 OPTIMIZER_OUTCOME Matrix_Optimized_Fit_Routine<T_real>:: fit_spectra(const models::Base_Model<T_real>* const model,
                                                             const Spectra<T_real>* const spectra,
@@ -249,16 +448,18 @@ OPTIMIZER_OUTCOME Matrix_Optimized_Fit_Routine<T_real>:: fit_spectra(const model
         ArrayTr<T_real> background;
         
         
-        if(fit_params.contains(STR_SNIP_WIDTH))
+        if(fit_params.contains(Fit_Param_Id::SNIP_WIDTH))
         {
-            ArrayTr<T_real> bkg = snip_background<T_real>(spectra,
-                                         fit_params.value(STR_ENERGY_OFFSET),
-                                         fit_params.value(STR_ENERGY_SLOPE),
-                                         fit_params.value(STR_ENERGY_QUADRATIC),
-                                         fit_params.value(STR_SNIP_WIDTH),
+            thread_local ArrayTr<T_real> bkg;
+            std::shared_ptr<const Snip_Schedule<T_real>> schedule = get_snip_schedule<T_real>(spectra->size(),
+                                         fit_params.value(Fit_Param_Id::ENERGY_OFFSET),
+                                         fit_params.value(Fit_Param_Id::ENERGY_SLOPE),
+                                         fit_params.value(Fit_Param_Id::ENERGY_QUADRATIC),
+                                         fit_params.value(Fit_Param_Id::SNIP_WIDTH),
                                          this->_energy_range.min,
                                          this->_energy_range.max);
-            background = bkg.segment(this->_energy_range.min, this->_energy_range.count());
+            const ArrayTr<T_real>& full_background = shared_snip_background<T_real>(*spectra, schedule, bkg);
+            background = full_background.segment(this->_energy_range.min, this->_energy_range.count());
         }
         else
         {
@@ -267,15 +468,12 @@ OPTIMIZER_OUTCOME Matrix_Optimized_Fit_Routine<T_real>:: fit_spectra(const model
 
         std::function<void(const Fit_Parameters<T_real>* const, const  Range* const, Spectra<T_real>*)> gen_func = std::bind(&Matrix_Optimized_Fit_Routine<T_real>::model_spectrum, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 
-        //set num iter to 300;
-        unordered_map<string, T_real> opt_options{ {STR_OPT_MAXITER, 300.}, {STR_OPT_FTOL, 1.0e-11 }, {STR_OPT_GTOL, 1.0e-11 } };
-        unordered_map<string, T_real> saved_options = this->_optimizer->get_options();        
-        this->_optimizer->set_options(opt_options);
-
+        //set num iter to 300, the shared optimizer options are left alone
+        static const optimizers::Optimizer_Overrides<T_real> opt_overrides(300, (T_real)1.0e-11, (T_real)1.0e-11);
 
-        ret_val = this->_optimizer->minimize_func(&fit_params, spectra, this->_energy_range, &background, gen_func);
+        ret_val = this->_optimizer->minimize_func(&fit_params, spectra, this->_energy_range, &background, gen_func, &opt_overrides);
         //Save the counts from fit parameters into fit count dict for each element
-        for (auto el_itr : *elements_to_fit)
+        for (const auto& el_itr : *elements_to_fit)
         {
             T_real value =  fit_params.at(el_itr.first).value;
             //convert from log10
@@ -304,31 +502,9 @@ OPTIMIZER_OUTCOME Matrix_Optimized_Fit_Routine<T_real>:: fit_spectra(const model
         model_spectra += background;
         model_spectra = (ArrayTr<T_real>)model_spectra.unaryExpr([](T_real v) { return std::isfinite(v) ? v : (T_real)0.0; });
 
-		//lock and integrate results
-		{
-            std::lock_guard<std::mutex> lock(_int_spec_mutex);
-            _integrated_fitted_spectra.add(model_spectra);
-            _integrated_background.add(background);
-
-			//we don't know the spectra size during initlaize() will have to resize here
-			if (_max_channels_spectra.size() < spectra->size())
-			{
-				_max_channels_spectra.setZero(spectra->size());
-			}
-			if (_max_10_channels_spectra.size() < spectra->size())
-			{
-				_max_10_channels_spectra.setZero(spectra->size());
-			}
-
-			_max_channels_spectra[max_map[0].first] += max_map[0].second;
-
-			for (auto &itr : max_map)
-			{
-				_max_10_channels_spectra[itr.first] += itr.second;
-			}
-        }
-
-        this->_optimizer->set_options(saved_options);
+		//integrate results into this thread's buffers
+        _integrate_fit(model_spectra, background);
+        _integrate_max_channels(max_map, spectra->size());
     }
 
     return ret_val;
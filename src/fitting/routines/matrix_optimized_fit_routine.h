@@ -50,10 +50,14 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef Matrix_Optimized_Fit_Routine_H
 #define Matrix_Optimized_Fit_Routine_H
 
+#include <atomic>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 #include "fitting/routines/param_optimized_fit_routine.h"
 #include "data_struct/fit_parameters.h"
+#include "fitting/models/element_model_cache.h"
 
 namespace fitting
 {
@@ -79,6 +83,15 @@ public:
                                           const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
                                           std::unordered_map<std::string, T_real>& out_counts);
 
+    // one fit_spectra per pixel, Param_Optimized_Fit_Routine's batch would skip this class's fit_spectra
+    virtual void fit_spectra_batch(const models::Base_Model<T_real>* const model,
+                                   const std::vector<const Spectra<T_real>*>& spectras,
+                                   const Fit_Result_Layout<T_real>& layout,
+                                   T_real* const out_results)
+    {
+        Base_Fit_Routine<T_real>::fit_spectra_batch(model, spectras, layout, out_results);
+    }
+
     virtual std::string get_name() { return STR_FIT_GAUSS_MATRIX; }
 
     virtual void initialize(models::Base_Model<T_real>* const model,
@@ -89,19 +102,50 @@ public:
                         const struct Range * const energy_range,
 					    Spectra<T_real>* spectra_model);
 
-    const Spectra<T_real>& fitted_integrated_spectra() {return _integrated_fitted_spectra;}
+    /**
+     * @brief reduce_integrated_spectra : Sum the per thread integration buffers into the integrated spectra.
+     *                                    Only call when no fit is running, the accessors below call it.
+     */
+    void reduce_integrated_spectra();
+
+    const Spectra<T_real>& fitted_integrated_spectra() { reduce_integrated_spectra(); return _integrated_fitted_spectra; }
 
-    const Spectra<T_real>& fitted_integrated_background() { return _integrated_background; }
+    const Spectra<T_real>& fitted_integrated_background() { reduce_integrated_spectra(); return _integrated_background; }
 
-	const Spectra<T_real>& max_integrated_spectra() { return _max_channels_spectra; }
+	const Spectra<T_real>& max_integrated_spectra() { reduce_integrated_spectra(); return _max_channels_spectra; }
 
-	const Spectra<T_real>& max_10_integrated_spectra() { return _max_10_channels_spectra; }
+	const Spectra<T_real>& max_10_integrated_spectra() { reduce_integrated_spectra(); return _max_10_channels_spectra; }
 
 protected:
 
+    // basis_groups is a models::Basis_Group mask, only those spectra are generated
     unordered_map<string, Spectra<T_real>> _generate_element_models(models::Base_Model<T_real>* const model,
                                                             const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
-                                                            struct Range energy_range);
+                                                            struct Range energy_range,
+                                                            unsigned int basis_groups = models::BASIS_ALL);
+
+    /**
+     * @brief The Integrated_Accumulator struct : One per fitting thread so pixels integrate without a lock
+     */
+    struct Integrated_Accumulator
+    {
+        data_struct::Spectra<T_real> fitted_spectra;
+        data_struct::Spectra<T_real> background;
+        data_struct::Spectra<T_real> max_channels;
+        data_struct::Spectra<T_real> max_10_channels;
+        bool dirty = false;
+    };
+
+    // add a fitted model to the calling thread's buffer
+    void _integrate_fit(const Eigen::Ref<const ArrayTr<T_real> >& model_spectra);
+
+    // add a fitted model and its background to the calling thread's buffer
+    void _integrate_fit(const Eigen::Ref<const ArrayTr<T_real> >& model_spectra, const Eigen::Ref<const ArrayTr<T_real> >& background);
+
+    // add the max and top 10 channels of a spectra to the calling thread's buffer
+    void _integrate_max_channels(const vector<pair<int, T_real> >& max_map, size_t spectra_size);
+
+    Integrated_Accumulator& _thread_accumulator();
 
 	data_struct::Spectra<T_real> _integrated_fitted_spectra;
     data_struct::Spectra<T_real> _integrated_background;
@@ -110,7 +154,30 @@ protected:
 
     unordered_map<string, Spectra<T_real>> _element_models;
 
-    static std::mutex _int_spec_mutex;
+    // look up / store the basis spectra in Element_Model_Cache. Off for callers that re-initialize with a new
+    // calibration every iteration, their keys would never hit and only push useful ones out
+    bool _use_element_model_cache;
+
+    // guards _accumulators and the integrated spectra, only taken when a thread first fits with this routine and on reduce
+    std::mutex _accumulators_mutex;
+
+    std::vector<std::unique_ptr<Integrated_Accumulator> > _accumulators;
+
+    /**
+     * @brief The Accumulator_Slots struct : Accumulator per ThreadPool::worker_slot(), null until that thread first fits
+     */
+    struct Accumulator_Slots
+    {
+        explicit Accumulator_Slots(size_t n) : size(n), acc(new Integrated_Accumulator*[n]()) {}
+        size_t size;
+        std::unique_ptr<Integrated_Accumulator*[]> acc;
+    };
+
+    // read without the lock, replaced by a bigger copy under the lock when a new slot does not fit
+    std::atomic<Accumulator_Slots*> _slots;
+
+    // every table ever published, a thread may still be reading an old one
+    std::vector<std::unique_ptr<Accumulator_Slots> > _slot_tables;
 
 };
 
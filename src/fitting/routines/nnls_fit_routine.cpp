@@ -48,6 +48,8 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "nnls_fit_routine.h"
 
+#include <Eigen/Cholesky>
+
 //debug
 #include <iostream>
 
@@ -104,6 +106,128 @@ void NNLS_Fit_Routine<T_real>::_generate_fitmatrix()
         i++;
     }
 
+    _gram_matrix = _fitmatrix.transpose() * _fitmatrix;
+
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void NNLS_Fit_Routine<T_real>::_update_fitmatrix_columns(const unordered_map<string, Spectra<T_real>>& element_models)
+{
+    std::vector<int> cols;
+    for (const auto& itr : element_models)
+    {
+        const auto& idx_itr = _element_row_index.find(itr.first);
+        if (idx_itr == _element_row_index.end() || itr.second.size() != _fitmatrix.rows())
+        {
+            // basis layout changed, start over
+            for (const auto& m_itr : element_models)
+            {
+                this->_element_models[m_itr.first] = m_itr.second;
+            }
+            _generate_fitmatrix();
+            return;
+        }
+        this->_element_models[itr.first] = itr.second;
+        _fitmatrix.col(idx_itr->second) = itr.second.matrix();
+        cols.push_back(idx_itr->second);
+    }
+
+    // G = A'A, a changed column c only changes row and column c: G(:, c) = A' * A(:, c)
+    for (int c : cols)
+    {
+        VectorTr<T_real> g = _fitmatrix.transpose() * _fitmatrix.col(c);
+        _gram_matrix.col(c) = g;
+        _gram_matrix.row(c) = g.transpose();
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+bool NNLS_Fit_Routine<T_real>::_polish_solution(ArrayTr<T_real>& x, const ArrayTr<T_real>& atb) const
+{
+    std::vector<Eigen::Index> free_idx;
+    for (Eigen::Index i = 0; i < x.size(); i++)
+    {
+        if (x[i] > (T_real)0.0)
+        {
+            free_idx.push_back(i);
+        }
+    }
+    const Eigen::Index n_free = (Eigen::Index)free_idx.size();
+    if (n_free == 0)
+    {
+        return false;
+    }
+
+    Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> gram_ff(n_free, n_free);
+    VectorTr<T_real> atb_f(n_free);
+    for (Eigen::Index r = 0; r < n_free; r++)
+    {
+        atb_f[r] = atb[free_idx[r]];
+        for (Eigen::Index c = 0; c < n_free; c++)
+        {
+            gram_ff(r, c) = _gram_matrix(free_idx[r], free_idx[c]);
+        }
+    }
+    Eigen::LDLT<Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> > ldlt(gram_ff);
+    if (ldlt.info() != Eigen::Success)
+    {
+        return false;
+    }
+    VectorTr<T_real> x_f = ldlt.solve(atb_f);
+    if (false == x_f.allFinite() || x_f.minCoeff() <= (T_real)0.0)
+    {
+        return false;
+    }
+
+    VectorTr<T_real> new_x = VectorTr<T_real>::Zero(x.size());
+    for (Eigen::Index r = 0; r < n_free; r++)
+    {
+        new_x[free_idx[r]] = x_f[r];
+    }
+    // kkt: the gradient may not point into the feasible side for any variable held at 0
+    VectorTr<T_real> gradient = _gram_matrix * new_x - atb.matrix();
+    const T_real tol = std::sqrt(std::numeric_limits<T_real>::epsilon()) * atb.abs().maxCoeff();
+    for (Eigen::Index i = 0; i < x.size(); i++)
+    {
+        if (new_x[i] == (T_real)0.0 && gradient[i] < -tol)
+        {
+            return false;
+        }
+    }
+    x = new_x.array();
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+ArrayTr<T_real> NNLS_Fit_Routine<T_real>::_get_background(const Fit_Parameters<T_real>& fit_params, const Spectra<T_real>* const spectra)
+{
+    ArrayTr<T_real> background;
+    if (fit_params.contains(Fit_Param_Id::SNIP_WIDTH))
+    {
+        thread_local ArrayTr<T_real> bkg;
+        std::shared_ptr<const Snip_Schedule<T_real>> schedule = get_snip_schedule<T_real>(spectra->size(),
+            fit_params.value(Fit_Param_Id::ENERGY_OFFSET),
+            fit_params.value(Fit_Param_Id::ENERGY_SLOPE),
+            fit_params.value(Fit_Param_Id::ENERGY_QUADRATIC),
+            fit_params.value(Fit_Param_Id::SNIP_WIDTH),
+            this->_energy_range.min,
+            this->_energy_range.max);
+        // shared with the other routines fitting this block when a Snip_Background_Scope is open
+        const ArrayTr<T_real>& full_background = shared_snip_background<T_real>(*spectra, schedule, bkg);
+
+        background = full_background.segment(this->_energy_range.min, this->_energy_range.count());
+    }
+    else
+    {
+        background.setZero(this->_energy_range.count());
+    }
+    return background;
 }
 
 // ----------------------------------------------------------------------------
@@ -112,7 +236,8 @@ template<typename T_real>
 void NNLS_Fit_Routine<T_real>::fit_spectrum_model(const Spectra<T_real>* const spectra,
                                           const ArrayTr<T_real>* const background,
                                           const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
-                                          Spectra<T_real>* spectra_model)
+                                          Spectra<T_real>* spectra_model,
+                                          ArrayTr<T_real>* warm_start)
 {
     //spectra_model->setZero(this->_energy_range.count());
     spectra_model->setZero();
@@ -124,7 +249,12 @@ void NNLS_Fit_Routine<T_real>::fit_spectrum_model(const Spectra<T_real>* const s
     ArrayTr<T_real> spectra_sub_background = spectra->segment(this->_energy_range.min, this->_energy_range.count());
     spectra_sub_background -= *background;
     spectra_sub_background = spectra_sub_background.unaryExpr([](T_real v) { return v > 0.0 ? v : (T_real)0.0; });
-    nsNNLS::nnls<T_real> solver(&_fitmatrix, &spectra_sub_background, _max_iter);
+    ArrayTr<T_real> atb = _fitmatrix.transpose() * spectra_sub_background.matrix();
+    nsNNLS::nnls<T_real> solver(&_gram_matrix, &atb, spectra_sub_background.square().sum(), _max_iter);
+    if (warm_start != nullptr)
+    {
+        solver.setX0(warm_start);
+    }
 
     solver.optimize(num_iter, npg);
     //logI << "NNLS num iter: " << num_iter << " : npg : " << npg << "\n";
@@ -135,6 +265,26 @@ void NNLS_Fit_Routine<T_real>::fit_spectrum_model(const Spectra<T_real>* const s
 
     result = solver.getSolution();
 
+    ArrayTr<T_real> polished;
+    if (warm_start != nullptr)
+    {
+        // the projected gradient stops within pgtol, which depends on where it started. Solving the active set
+        // exactly makes the model the same for any start so an outer optimizer sees a smooth function
+        polished = *result;
+        if (_polish_solution(polished, atb))
+        {
+            result = &polished;
+        }
+        if (result->allFinite())
+        {
+            *warm_start = *result;
+        }
+        else
+        {
+            warm_start->resize(0);
+        }
+    }
+
     for (const auto& itr : *elements_to_fit)
     {
         if (std::isfinite((*result)[_element_row_index[itr.first]]))
@@ -183,30 +333,15 @@ OPTIMIZER_OUTCOME NNLS_Fit_Routine<T_real>::fit_spectra(const models::Base_Model
 	data_struct::ArrayTr<T_real>* result;
     int num_iter;
     T_real npg;
-    Fit_Parameters<T_real> fit_params = model->fit_parameters();
-    fit_params.add_parameter(Fit_Param<T_real>(STR_RESIDUAL, 0.0));
-    ArrayTr<T_real> background;
-    if (fit_params.contains(STR_SNIP_WIDTH))
-    {        
-        ArrayTr<T_real> bkg = snip_background<T_real>(spectra,
-            fit_params.value(STR_ENERGY_OFFSET),
-            fit_params.value(STR_ENERGY_SLOPE),
-            fit_params.value(STR_ENERGY_QUADRATIC),
-            fit_params.value(STR_SNIP_WIDTH),
-            this->_energy_range.min,
-            this->_energy_range.max);
-
-        background = bkg.segment(this->_energy_range.min, this->_energy_range.count());
-    }
-    else
-    {
-        background.setZero(this->_energy_range.count());
-    }
+    // only read for the background, the residual goes straight to out_counts. No per pixel copy of the parameters
+    const Fit_Parameters<T_real>& fit_params = model->fit_parameters();
+    ArrayTr<T_real> background = _get_background(fit_params, spectra);
 
     ArrayTr<T_real> spectra_sub_background = spectra->segment(this->_energy_range.min, this->_energy_range.count());
     spectra_sub_background -= background;
     spectra_sub_background = spectra_sub_background.unaryExpr([](T_real v) { return v>0.0 ? v : (T_real)0.0; });
-    nsNNLS::nnls<T_real> solver(&_fitmatrix, &spectra_sub_background, _max_iter);
+    ArrayTr<T_real> atb = _fitmatrix.transpose() * spectra_sub_background.matrix();
+    nsNNLS::nnls<T_real> solver(&_gram_matrix, &atb, spectra_sub_background.square().sum(), _max_iter);
 
     Spectra<T_real> spectra_model = background;
 
@@ -246,12 +381,8 @@ OPTIMIZER_OUTCOME NNLS_Fit_Routine<T_real>::fit_spectra(const models::Base_Model
     out_counts[STR_NUM_ITR] = static_cast<T_real>(num_iter);
     out_counts[STR_RESIDUAL] = npg;
 
-	//lock and integrate results
-	{
-		std::lock_guard<std::mutex> lock(this->_int_spec_mutex);
-		this->_integrated_fitted_spectra.add(spectra_model);
-        this->_integrated_background.add(background);
-	}
+	//integrate results into this thread's buffers
+	this->_integrate_fit(spectra_model, background);
 
     if (num_iter == solver.getMaxit())
     {
@@ -263,6 +394,114 @@ OPTIMIZER_OUTCOME NNLS_Fit_Routine<T_real>::fit_spectra(const models::Base_Model
 
 // ----------------------------------------------------------------------------
 
+template<typename T_real>
+void NNLS_Fit_Routine<T_real>::fit_spectra_batch(const models::Base_Model<T_real>* const model,
+                                                 const std::vector<const Spectra<T_real>*>& spectras,
+                                                 const Fit_Result_Layout<T_real>& layout,
+                                                 T_real* const out_results)
+{
+    const Eigen::Index n_channels = this->_energy_range.count();
+    const Eigen::Index n_spectra = (Eigen::Index)spectras.size();
+    if (n_spectra == 0)
+    {
+        return;
+    }
+
+    Fit_Parameters<T_real> fit_params = model->fit_parameters();
+
+    // (result slot, fit matrix row) of every element fit, looked up once for the block
+    std::vector<std::pair<size_t, int> > element_rows;
+    for (size_t s = 0; s < layout.num_elements(); s++)
+    {
+        const auto& idx_itr = _element_row_index.find(layout.name(s));
+        if (idx_itr != _element_row_index.end())
+        {
+            element_rows.emplace_back(s, idx_itr->second);
+        }
+    }
+
+    Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> rhs(n_channels, n_spectra);
+    ArrayTr<T_real> background_sum = ArrayTr<T_real>::Zero(n_channels);
+    for (Eigen::Index p = 0; p < n_spectra; p++)
+    {
+        ArrayTr<T_real> background = _get_background(fit_params, spectras[p]);
+        background_sum += background;
+        rhs.col(p) = (spectras[p]->segment(this->_energy_range.min, n_channels) - background).unaryExpr([](T_real v) { return v > 0.0 ? v : (T_real)0.0; }).matrix();
+    }
+
+    // A'b for the whole block in one product, after this the solver never touches the channel dimension
+    Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> atb_block = _fitmatrix.transpose() * rhs;
+    ArrayTr<T_real> btb_block = rhs.colwise().squaredNorm().transpose().array();
+
+    // one solver for the block so its scratch arrays are sized once
+    ArrayTr<T_real> atb(atb_block.rows());
+    nsNNLS::nnls<T_real> solver(&_gram_matrix, &atb, (T_real)0.0, _max_iter);
+    VectorTr<T_real> model_counts = VectorTr<T_real>::Zero(_fitmatrix.cols());
+    int num_iter;
+    T_real npg;
+
+    // previous pixel's solution, empty until there is a finite one to start from
+    ArrayTr<T_real> seed;
+
+    for (Eigen::Index p = 0; p < n_spectra; p++)
+    {
+        atb = atb_block.col(p).array();
+        solver.setGramData(&_gram_matrix, &atb, btb_block[p]);
+        solver.setX0((this->_neighbor_warm_start && seed.size() > 0) ? &seed : nullptr);
+        solver.optimize(num_iter, npg);
+        if (num_iter < 0)
+        {
+            logE << "num_iter < 0" << "\n";
+        }
+
+        if (seed.size() > 0 && this->_neighbor_warm_start && (num_iter >= (int)solver.getMaxit() || false == solver.getSolution()->allFinite()))
+        {
+            // diverged from the neighbor's solution, solve again from the cold start. Num_Iter counts both
+            int warm_iter = num_iter;
+            solver.setX0(nullptr);
+            solver.optimize(num_iter, npg);
+            num_iter += warm_iter;
+        }
+
+        const ArrayTr<T_real>& result = *(solver.getSolution());
+        if (this->_neighbor_warm_start)
+        {
+            if (result.allFinite())
+            {
+                seed = result;
+            }
+            else
+            {
+                seed.resize(0);
+            }
+        }
+
+        T_real* const row = out_results + p * layout.size();
+        for (const auto& er : element_rows)
+        {
+            if (std::isfinite(result[er.second]))
+            {
+                row[er.first] = result[er.second];
+                model_counts[er.second] += result[er.second];
+            }
+            else
+            {
+                row[er.first] = 0.;
+            }
+        }
+        row[layout.num_iter_slot()] = static_cast<T_real>(num_iter);
+        row[layout.residual_slot()] = npg;
+    }
+
+    // the model is linear in the counts so the block sum is one matrix-vector product
+    ArrayTr<T_real> spectra_model = background_sum + (_fitmatrix * model_counts).array();
+
+    //integrate results into this thread's buffers once for the whole block
+    this->_integrate_fit(spectra_model, background_sum);
+}
+
+// ----------------------------------------------------------------------------
+
 template<typename T_real>
 void NNLS_Fit_Routine<T_real>::initialize(models::Base_Model<T_real>* const model,
                                   const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
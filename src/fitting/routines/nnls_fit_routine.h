@@ -77,11 +77,19 @@ public:
                                         const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
                                         std::unordered_map<std::string, T_real>& out_counts);
 
-    // similar to fit_spectra but want to return model instead of counts
+    virtual void fit_spectra_batch(const models::Base_Model<T_real>* const model,
+                                   const std::vector<const Spectra<T_real>*>& spectras,
+                                   const Fit_Result_Layout<T_real>& layout,
+                                   T_real* const out_results);
+
+    // similar to fit_spectra but want to return model instead of counts.
+    // warm_start : if not null the solve starts from it when it has one entry per basis spectra and the solution is
+    //              written back, left empty after a non finite solution so the next call starts cold
     void fit_spectrum_model(const Spectra<T_real>* const spectra,
                             const ArrayTr<T_real>* const background,
                             const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
-                            Spectra<T_real>* spectra_model);
+                            Spectra<T_real>* spectra_model,
+                            ArrayTr<T_real>* warm_start = nullptr);
 
     virtual std::string get_name() { return STR_FIT_NNLS; }
 
@@ -93,12 +101,23 @@ protected:
 
     void _generate_fitmatrix();
 
+    // replace some basis spectra, only their fit matrix columns and gram matrix rows / columns are recomputed
+    void _update_fitmatrix_columns(const unordered_map<string, Spectra<T_real>>& element_models);
+
+    // exact least squares on the variables x keeps above 0, kept only if it is positive and meets the kkt conditions
+    bool _polish_solution(ArrayTr<T_real>& x, const ArrayTr<T_real>& atb) const;
+
+    ArrayTr<T_real> _get_background(const Fit_Parameters<T_real>& fit_params, const Spectra<T_real>* const spectra);
+
     size_t _max_iter;
 
 private:
 
     Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> _fitmatrix;
 
+    // _fitmatrix' * _fitmatrix, the solver works in element space so this is shared by every pixel
+    Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> _gram_matrix;
+
     std::unordered_map<std::string, int> _element_row_index;
 
 };
@@ -94,28 +94,27 @@ void Param_Optimized_Fit_Routine<T_real>::_add_elements_to_fit_parameters(Fit_Pa
 {
 
     T_real this_factor = (T_real)8.0;
+    const T_real energy_offset = fit_params->value(Fit_Param_Id::ENERGY_OFFSET);
+    const T_real energy_slope = fit_params->value(Fit_Param_Id::ENERGY_SLOPE);
 
-    for (auto el_itr : *elements_to_fit)
+    for (const auto& el_itr : *elements_to_fit)
     {
         if( false == fit_params->contains(el_itr.first) )
         {
             T_real e_guess = (T_real)1.0e-10;
 
             Fit_Element_Map<T_real>* element = el_itr.second;
-            std::vector<Element_Energy_Ratio<T_real>> energies = element->energy_ratios();
+            const std::vector<Element_Energy_Ratio<T_real>>& energies = element->energy_ratios();
             //if element counts is not in fit params structure, add it
-            if( false == fit_params->contains(el_itr.first) )
-            {
-                Fit_Param<T_real> fp(element->full_name(), (T_real)-11.0, 300, e_guess, (T_real)0.1, E_Bound_Type::FIT);
-                (*fit_params)[el_itr.first] = fp;
-            }
+            Fit_Param<T_real>& fp = (*fit_params)[el_itr.first];
+            fp = Fit_Param<T_real>(element->full_name(), (T_real)-11.0, 300, e_guess, (T_real)0.1, E_Bound_Type::FIT);
             if(spectra != nullptr  && energies.size() > 0)
             {
-                T_real e_energy = element->energy_ratios()[0].energy;
+                T_real e_energy = energies[0].energy;
                 T_real min_e =  e_energy - (T_real)0.1;
                 T_real max_e =  e_energy + (T_real)0.1;
 
-                struct Range energy_range = get_energy_range(min_e, max_e, spectra->size(), fit_params->at(STR_ENERGY_OFFSET).value, fit_params->at(STR_ENERGY_SLOPE).value);
+                struct Range energy_range = get_energy_range(min_e, max_e, spectra->size(), energy_offset, energy_slope);
 
                 T_real sum = spectra->segment(energy_range.min, energy_range.count()).sum();
                 sum /= energy_range.count();
@@ -123,12 +122,12 @@ void Param_Optimized_Fit_Routine<T_real>::_add_elements_to_fit_parameters(Fit_Pa
                 //e_guess = std::max( (spectra->mean(energy_range.min, energy_range.max + 1) * this_factor + (T_real)0.01), 1.0);
                 e_guess = std::log10(e_guess);
 
-                (*fit_params)[el_itr.first].value = e_guess;
+                fp.value = e_guess;
             }
             else
             {
                 e_guess = std::log10(e_guess);
-                (*fit_params)[el_itr.first].value = e_guess;
+                fp.value = e_guess;
             }
         }
     }
@@ -157,10 +156,10 @@ void Param_Optimized_Fit_Routine<T_real>::_calc_and_update_coherent_amplitude(Fi
 {
     //STR_COHERENT_SCT_ENERGY
     //STR_COHERENT_SCT_AMPLITUDE
-    T_real min_e = fitp->at(STR_COHERENT_SCT_ENERGY).value - (T_real)0.4;
-    T_real max_e = fitp->at(STR_COHERENT_SCT_ENERGY).value + (T_real)0.4;
+    T_real min_e = fitp->at(Fit_Param_Id::COHERENT_SCT_ENERGY).value - (T_real)0.4;
+    T_real max_e = fitp->at(Fit_Param_Id::COHERENT_SCT_ENERGY).value + (T_real)0.4;
     T_real this_factor = (T_real)8.0;
-    fitting::models::Range energy_range = fitting::models::get_energy_range(min_e, max_e, spectra->size(), fitp->value(STR_ENERGY_OFFSET), fitp->value(STR_ENERGY_SLOPE));
+    fitting::models::Range energy_range = fitting::models::get_energy_range(min_e, max_e, spectra->size(), fitp->value(Fit_Param_Id::ENERGY_OFFSET), fitp->value(Fit_Param_Id::ENERGY_SLOPE));
     size_t e_size = (energy_range.max + 1) - energy_range.min;
     T_real sum = spectra->segment(energy_range.min, e_size).sum();
     sum /= energy_range.count();
@@ -178,6 +177,108 @@ OPTIMIZER_OUTCOME Param_Optimized_Fit_Routine<T_real>::fit_spectra(const models:
                                                            const Spectra<T_real>* const spectra,
                                                            const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
                                                            std::unordered_map<std::string, T_real>& out_counts)
+{
+    Fit_Parameters<T_real> fit_params;
+    OPTIMIZER_OUTCOME ret_val = _fit_spectra(model, spectra, elements_to_fit, fit_params, nullptr);
+    if (ret_val == OPTIMIZER_OUTCOME::FOUND_ZERO || _optimizer != nullptr)
+    {
+        for (const auto& el_itr : *elements_to_fit)
+        {
+            out_counts[el_itr.first] = _element_counts(ret_val, fit_params, el_itr.first);
+        }
+    }
+    if (_optimizer != nullptr)
+    {
+        //check if we are saving the number of iterations and save if so
+        if (fit_params.contains(STR_NUM_ITR))
+        {
+            out_counts[STR_NUM_ITR] = fit_params.at(STR_NUM_ITR).value;
+        }
+        if (fit_params.contains(STR_RESIDUAL))
+        {
+            out_counts[STR_RESIDUAL] = fit_params.at(STR_RESIDUAL).value;
+        }
+    }
+    return ret_val;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+void Param_Optimized_Fit_Routine<T_real>::fit_spectra_batch(const models::Base_Model<T_real>* const model,
+                                                            const std::vector<const Spectra<T_real>*>& spectras,
+                                                            const Fit_Result_Layout<T_real>& layout,
+                                                            T_real* const out_results)
+{
+    // fitted amplitudes of the previous pixel, empty until one converges
+    Fit_Parameters<T_real> seed;
+    Fit_Parameters<T_real> fit_params;
+    for (size_t i = 0; i < spectras.size(); i++)
+    {
+        OPTIMIZER_OUTCOME ret_val = _fit_spectra(model, spectras[i], layout.elements_to_fit(), fit_params, this->_neighbor_warm_start ? &seed : nullptr);
+        T_real* const row = out_results + i * layout.size();
+        if (ret_val == OPTIMIZER_OUTCOME::FOUND_ZERO || _optimizer != nullptr)
+        {
+            for (size_t s = 0; s < layout.num_elements(); s++)
+            {
+                row[s] = _element_counts(ret_val, fit_params, layout.name(s));
+            }
+        }
+        if (_optimizer != nullptr)
+        {
+            if (fit_params.contains(STR_NUM_ITR))
+            {
+                row[layout.num_iter_slot()] = fit_params.at(STR_NUM_ITR).value;
+            }
+            if (fit_params.contains(STR_RESIDUAL))
+            {
+                row[layout.residual_slot()] = fit_params.at(STR_RESIDUAL).value;
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+T_real Param_Optimized_Fit_Routine<T_real>::_element_counts(OPTIMIZER_OUTCOME outcome, const Fit_Parameters<T_real>& fit_params, const std::string& name) const
+{
+    //If the sum of the spectra we are trying to fit to is zero then set out counts to -10.0 == log(0.0000000001)
+    if (outcome == OPTIMIZER_OUTCOME::FOUND_ZERO)
+    {
+        return -10.0;
+    }
+    //convert from log10
+    return std::pow((T_real)10.0, fit_params.at(name).value);
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+bool Param_Optimized_Fit_Routine<T_real>::_diverged(OPTIMIZER_OUTCOME outcome, const Fit_Parameters<T_real>& fit_params) const
+{
+    // EXHAUSTED is not on the list, cold starts run out of evaluations on flat directions just as often
+    switch (outcome)
+    {
+    case OPTIMIZER_OUTCOME::FAILED:
+    case OPTIMIZER_OUTCOME::CRASHED:
+    case OPTIMIZER_OUTCOME::EXPLODED:
+    case OPTIMIZER_OUTCOME::FOUND_NAN:
+        return true;
+    default:
+        break;
+    }
+    return fit_params.contains(STR_RESIDUAL) && false == std::isfinite(fit_params.at(STR_RESIDUAL).value);
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+OPTIMIZER_OUTCOME Param_Optimized_Fit_Routine<T_real>::_fit_spectra(const models::Base_Model<T_real>* const model,
+                                                            const Spectra<T_real>* const spectra,
+                                                            const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
+                                                            Fit_Parameters<T_real>& fit_params,
+                                                            Fit_Parameters<T_real>* seed)
 {
     //int xmin = np.argmin(abs(x - (fitp.g.xmin - fitp.s.val[keywords.energy_pos[0]]) / fitp.s.val[keywords.energy_pos[1]]));
     //int xmax = np.argmin(abs(x - (fitp.g.xmax - fitp.s.val[keywords.energy_pos[0]]) / fitp.s.val[keywords.energy_pos[1]]));
@@ -185,7 +286,7 @@ OPTIMIZER_OUTCOME Param_Optimized_Fit_Routine<T_real>::fit_spectra(const models:
     // fitp.g.xmax = MAX_ENERGY_TO_FIT
 
     OPTIMIZER_OUTCOME ret_val = OPTIMIZER_OUTCOME::FAILED;
-    Fit_Parameters<T_real> fit_params = model->fit_parameters();
+    fit_params = model->fit_parameters();
     //Add fit param for number of iterations
     fit_params.add_parameter(Fit_Param<T_real>(STR_NUM_ITR));
     _add_elements_to_fit_parameters(&fit_params, spectra, elements_to_fit);
@@ -194,42 +295,63 @@ OPTIMIZER_OUTCOME Param_Optimized_Fit_Routine<T_real>::fit_spectra(const models:
         _calc_and_update_coherent_amplitude(&fit_params, spectra);
     }
 
-    //If the sum of the spectra we are trying to fit to is zero then set out counts to -10.0 == log(0.0000000001)
+    //Nothing to fit if the sum of the spectra is zero, the counts are stored as -10.0
     if(spectra->sum() == 0)
     {
 
         fit_params.set_all_value(-10.0, E_Bound_Type::FIT);
-
-        for (auto el_itr : *elements_to_fit)
-        {
-            out_counts[el_itr.first] = -10.0;
-        }
         return OPTIMIZER_OUTCOME::FOUND_ZERO;
     }
 
     if(_optimizer != nullptr)
     {
-        ret_val = _optimizer->minimize(&fit_params, spectra, elements_to_fit, model, _energy_range);
-
-        //Save the counts from fit parameters into fit count dict for each element
-        for (auto el_itr : *elements_to_fit)
+        if (seed != nullptr && seed->size() > 0)
         {
-            T_real value =  fit_params.at(el_itr.first).value;
-            //convert from log10
-            value = std::pow((T_real)10.0, value);
-            out_counts[el_itr.first] = value;
-        }
-
-        //model->update_fit_params_values(fit_params);
+            Fit_Parameters<T_real> cold_params = fit_params;
+            // start the amplitudes from the neighboring pixel, the rest of the parameters are the model's
+            for (const auto& el_itr : *elements_to_fit)
+            {
+                if (seed->contains(el_itr.first) && fit_params.contains(el_itr.first))
+                {
+                    fit_params[el_itr.first].value = seed->at(el_itr.first).value;
+                }
+            }
+            for (const std::string& amp_name : {STR_COMPTON_AMPLITUDE, STR_COHERENT_SCT_AMPLITUDE})
+            {
+                if (seed->contains(amp_name) && fit_params.contains(amp_name))
+                {
+                    fit_params[amp_name].value = seed->at(amp_name).value;
+                }
+            }
 
-        //check if we are saving the number of iterations and save if so
-        if(fit_params.contains(STR_NUM_ITR))
+            ret_val = _optimizer->minimize(&fit_params, spectra, elements_to_fit, model, _energy_range);
+            if (_diverged(ret_val, fit_params))
+            {
+                // fall back to the cold guess, Num_Iter counts both attempts
+                T_real warm_iter = fit_params.contains(STR_NUM_ITR) ? fit_params.at(STR_NUM_ITR).value : (T_real)0.0;
+                fit_params = cold_params;
+                ret_val = _optimizer->minimize(&fit_params, spectra, elements_to_fit, model, _energy_range);
+                if (fit_params.contains(STR_NUM_ITR))
+                {
+                    fit_params[STR_NUM_ITR].value += warm_iter;
+                }
+            }
+        }
+        else
         {
-            out_counts[STR_NUM_ITR] = fit_params.at(STR_NUM_ITR).value;
+            ret_val = _optimizer->minimize(&fit_params, spectra, elements_to_fit, model, _energy_range);
         }
-        if (fit_params.contains(STR_RESIDUAL))
+
+        if (seed != nullptr)
         {
-            out_counts[STR_RESIDUAL] = fit_params.at(STR_RESIDUAL).value;
+            if (_diverged(ret_val, fit_params))
+            {
+                *seed = Fit_Parameters<T_real>();
+            }
+            else
+            {
+                *seed = fit_params;
+            }
         }
     }
 
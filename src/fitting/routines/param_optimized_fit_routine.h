@@ -76,6 +76,11 @@ public:
                                           const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
                                           std::unordered_map<std::string, T_real>& out_counts);
 
+    virtual void fit_spectra_batch(const models::Base_Model<T_real>* const model,
+                                   const std::vector<const Spectra<T_real>*>& spectras,
+                                   const Fit_Result_Layout<T_real>& layout,
+                                   T_real* const out_results);
+
     virtual OPTIMIZER_OUTCOME fit_spectra_parameters(const models::Base_Model<T_real>* const model,
                                           const Spectra<T_real>* const spectra,
                                           const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
@@ -96,6 +101,20 @@ public:
 
 protected:
 
+    // fit_params : out, the fitted parameters. Element counts come from _element_counts()
+    // seed : if not null and not empty the element amplitudes start from it, it is replaced by the fitted
+    //        parameters or cleared if the fit diverged
+    OPTIMIZER_OUTCOME _fit_spectra(const models::Base_Model<T_real>* const model,
+                                   const Spectra<T_real>* const spectra,
+                                   const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
+                                   Fit_Parameters<T_real>& fit_params,
+                                   Fit_Parameters<T_real>* seed);
+
+    // counts of element name from a fit's outcome and parameters
+    T_real _element_counts(OPTIMIZER_OUTCOME outcome, const Fit_Parameters<T_real>& fit_params, const std::string& name) const;
+
+    bool _diverged(OPTIMIZER_OUTCOME outcome, const Fit_Parameters<T_real>& fit_params) const;
+
     void _add_elements_to_fit_parameters(Fit_Parameters<T_real>* fit_params,
                                          const Spectra<T_real>* const spectra,
                                          const Fit_Element_Map_Dict<T_real>* const elements_to_fit);
@@ -49,6 +49,8 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "roi_fit_routine.h"
 
+#include <algorithm>
+
 namespace fitting
 {
 namespace routines
@@ -59,7 +61,10 @@ namespace routines
 template<typename T_real>
 ROI_Fit_Routine<T_real>::ROI_Fit_Routine() : Base_Fit_Routine<T_real>()
 {
-
+    _roi_elements = nullptr;
+    _roi_num_elements = 0;
+    _roi_energy_offset = 0.0;
+    _roi_energy_slope = 0.0;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -72,41 +77,164 @@ ROI_Fit_Routine<T_real>::~ROI_Fit_Routine()
 
 // --------------------------------------------------------------------------------------------------------------------
 
+template<typename T_real>
+void ROI_Fit_Routine<T_real>::_calc_element_rois(const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
+                                                 T_real energy_offset,
+                                                 T_real energy_slope,
+                                                 std::vector<Element_ROI>& rois)
+{
+    rois.clear();
+    rois.reserve(elements_to_fit->size());
+    for (const auto& e_itr : *elements_to_fit)
+    {
+        Fit_Element_Map<T_real>* element = e_itr.second;
+        if (element != nullptr)
+        {
+            Element_ROI roi;
+            roi.name = e_itr.first;
+            roi.left = std::lround(((element->center() - element->width()) - energy_offset) / energy_slope);
+            roi.right = std::lround(((element->center() + element->width()) - energy_offset) / energy_slope);
+            rois.push_back(roi);
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+template<typename T_real>
+void ROI_Fit_Routine<T_real>::_clip_roi(const Element_ROI& roi, size_t num_channels, size_t& left, size_t& right)
+{
+    // same as the per pixel sum always did: an roi ending on the last channel keeps it, one past the end stops 2 short
+    long r = roi.right;
+    long l = std::max(roi.left, 0L);
+    if (r >= (long)num_channels)
+    {
+        r = (long)num_channels - 2;
+    }
+    if (l > r)
+    {
+        l = r - 1;
+    }
+    left = (size_t)std::max(l, 0L);
+    right = (size_t)std::max(r, 0L);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+template<typename T_real>
+const std::vector<typename ROI_Fit_Routine<T_real>::Element_ROI>& ROI_Fit_Routine<T_real>::_element_rois(const models::Base_Model<T_real>* const model,
+                                                                                                        const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
+                                                                                                        std::vector<Element_ROI>& scratch) const
+{
+    const Fit_Parameters<T_real>& fitp = model->fit_parameters();
+    T_real energy_offset = fitp.value(Fit_Param_Id::ENERGY_OFFSET);
+    T_real energy_slope = fitp.value(Fit_Param_Id::ENERGY_SLOPE);
+
+    if (elements_to_fit == _roi_elements && elements_to_fit->size() == _roi_num_elements && energy_offset == _roi_energy_offset && energy_slope == _roi_energy_slope)
+    {
+        return _rois;
+    }
+    _calc_element_rois(elements_to_fit, energy_offset, energy_slope, scratch);
+    return scratch;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
 template<typename T_real>
 optimizers::OPTIMIZER_OUTCOME ROI_Fit_Routine<T_real>::fit_spectra(const models::Base_Model<T_real>* const model,
                                                             const Spectra<T_real>* const spectra,
                                                             const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
                                                             std::unordered_map<std::string, T_real>& out_counts)
  {    
-    Fit_Parameters<T_real> fitp = model->fit_parameters();
-    unsigned int n_mca_channels = spectra->size();
+    std::vector<Element_ROI> scratch;
+    const std::vector<Element_ROI>& rois = _element_rois(model, elements_to_fit, scratch);
+    size_t n_mca_channels = spectra->size();
 
-    T_real energy_offset = fitp.value(STR_ENERGY_OFFSET);
-    T_real energy_slope = fitp.value(STR_ENERGY_SLOPE);
-    for(const auto& e_itr : *elements_to_fit)
+    for (const Element_ROI& roi : rois)
     {
-        unsigned int left_roi = 0;
-        unsigned int right_roi = 0;
-        Fit_Element_Map<T_real>* element = e_itr.second;
-        if (element != nullptr)
-        {
-            left_roi = static_cast<unsigned int>(std::round(((element->center() - element->width()) - energy_offset) / energy_slope));
-            right_roi = static_cast<unsigned int>(std::round(((element->center() + element->width()) - energy_offset) / energy_slope));
+        size_t left_roi;
+        size_t right_roi;
+        _clip_roi(roi, n_mca_channels, left_roi, right_roi);
+        size_t spec_size = (right_roi - left_roi) + 1;
+        out_counts[roi.name] = spectra->segment(left_roi, spec_size).sum();
+    }
+    return optimizers::OPTIMIZER_OUTCOME::CONVERGED;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+template<typename T_real>
+void ROI_Fit_Routine<T_real>::fit_spectra_batch(const models::Base_Model<T_real>* const model,
+                                                const std::vector<const Spectra<T_real>*>& spectras,
+                                                const Fit_Result_Layout<T_real>& layout,
+                                                T_real* const out_results)
+{
+    if (spectras.size() == 0)
+    {
+        return;
+    }
+
+    std::vector<Element_ROI> scratch;
+    const std::vector<Element_ROI>& rois = _element_rois(model, layout.elements_to_fit(), scratch);
+    std::vector<int> slots(rois.size());
+    for (size_t i = 0; i < rois.size(); i++)
+    {
+        slots[i] = layout.slot(rois[i].name);
+    }
 
-            if (right_roi >= n_mca_channels)
+    // Each roi sum is prefix(right + 1) - prefix(left), so the prefix is only needed at the sorted set of roi
+    // boundaries. One pass over the spectra sums the channels between consecutive boundaries.
+    size_t clipped_size = 0;
+    std::vector<size_t> boundaries;
+    std::vector<size_t> left_idx(rois.size());
+    std::vector<size_t> right_idx(rois.size());
+    // accumulated in double so subtracting two large prefixes keeps float precision
+    std::vector<double> prefix;
+
+    for (size_t p = 0; p < spectras.size(); p++)
+    {
+        const Spectra<T_real>& spectra = *spectras[p];
+        // clip once per spectra size, pixels of a block almost always share it
+        if (spectra.size() != (Eigen::Index)clipped_size)
+        {
+            clipped_size = spectra.size();
+            std::vector<size_t> lefts(rois.size());
+            std::vector<size_t> rights(rois.size());
+            boundaries.clear();
+            for (size_t i = 0; i < rois.size(); i++)
             {
-                right_roi = n_mca_channels - 2;
+                _clip_roi(rois[i], clipped_size, lefts[i], rights[i]);
+                boundaries.push_back(lefts[i]);
+                boundaries.push_back(rights[i] + 1);
             }
-            if (left_roi > right_roi)
+            std::sort(boundaries.begin(), boundaries.end());
+            boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+            for (size_t i = 0; i < rois.size(); i++)
             {
-                left_roi = right_roi - 1;
+                left_idx[i] = std::lower_bound(boundaries.begin(), boundaries.end(), lefts[i]) - boundaries.begin();
+                right_idx[i] = std::lower_bound(boundaries.begin(), boundaries.end(), rights[i] + 1) - boundaries.begin();
             }
+            prefix.resize(boundaries.size());
+        }
 
-            size_t spec_size = (right_roi - left_roi) + 1;
-            out_counts[e_itr.first] = spectra->segment(left_roi, spec_size).sum();
+        double run = 0.0;
+        size_t pos = 0;
+        for (size_t k = 0; k < boundaries.size(); k++)
+        {
+            run += (double)spectra.segment(pos, boundaries[k] - pos).sum();
+            prefix[k] = run;
+            pos = boundaries[k];
+        }
+
+        T_real* const row = out_results + p * layout.size();
+        for (size_t i = 0; i < rois.size(); i++)
+        {
+            if (slots[i] >= 0)
+            {
+                row[slots[i]] = static_cast<T_real>(prefix[right_idx[i]] - prefix[left_idx[i]]);
+            }
         }
     }
-    return optimizers::OPTIMIZER_OUTCOME::CONVERGED;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
@@ -116,7 +244,13 @@ void ROI_Fit_Routine<T_real>::initialize(models::Base_Model<T_real>* const model
                                  const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
                                  const struct Range energy_range)
 {
-    //N/A
+    // channel bounds only depend on the calibration so every pixel shares them
+    const Fit_Parameters<T_real>& fitp = model->fit_parameters();
+    _roi_energy_offset = fitp.value(Fit_Param_Id::ENERGY_OFFSET);
+    _roi_energy_slope = fitp.value(Fit_Param_Id::ENERGY_SLOPE);
+    _roi_elements = elements_to_fit;
+    _roi_num_elements = elements_to_fit->size();
+    _calc_element_rois(elements_to_fit, _roi_energy_offset, _roi_energy_slope, _rois);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
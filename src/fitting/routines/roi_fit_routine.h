@@ -72,6 +72,11 @@ public:
                                                       const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
                                                       std::unordered_map<std::string, T_real>& out_counts);
 
+    // one prefix sum pass over each spectra gives every element's roi sum
+    virtual void fit_spectra_batch(const models::Base_Model<T_real>* const model,
+                                   const std::vector<const Spectra<T_real>*>& spectras,
+                                   const Fit_Result_Layout<T_real>& layout,
+                                   T_real* const out_results);
 
     virtual std::string get_name() { return STR_FIT_ROI; }
 
@@ -81,11 +86,39 @@ public:
 
 protected:
 
+    // channel bounds of an element before they are clipped to the spectra size
+    struct Element_ROI
+    {
+        std::string name;
+        long left;
+        long right;
+    };
 
+    // bounds from initialize() if the calibration and elements still match, otherwise computed into scratch
+    const std::vector<Element_ROI>& _element_rois(const models::Base_Model<T_real>* const model,
+                                                  const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
+                                                  std::vector<Element_ROI>& scratch) const;
 
+    static void _calc_element_rois(const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
+                                   T_real energy_offset,
+                                   T_real energy_slope,
+                                   std::vector<Element_ROI>& rois);
+
+    // clip the same way for the single and batch paths, and the same way the per pixel sum always did
+    static void _clip_roi(const Element_ROI& roi, size_t num_channels, size_t& left, size_t& right);
 
 private:
 
+    std::vector<Element_ROI> _rois;
+
+    const Fit_Element_Map_Dict<T_real>* _roi_elements;
+
+    size_t _roi_num_elements;
+
+    T_real _roi_energy_offset;
+
+    T_real _roi_energy_slope;
+
 };
 
 TEMPLATE_CLASS_DLL_EXPORT ROI_Fit_Routine<float>;
@@ -94,52 +94,73 @@ void SVD_Fit_Routine<T_real>::_generate_fitmatrix()
         i++;
     }
 
+    // the fit matrix only changes here so decompose it once and keep the pseudo-inverse for all pixels
+    Eigen::JacobiSVD<Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> > svd(_fitmatrix, Eigen::ComputeThinU | Eigen::ComputeThinV);
+    Eigen::Index rank = svd.rank();
+    VectorTr<T_real> inv_singular = svd.singularValues().head(rank).cwiseInverse();
+    _pinv_fitmatrix = svd.matrixV().leftCols(rank) * inv_singular.asDiagonal() * svd.matrixU().leftCols(rank).transpose();
+
 }
 
 // ----------------------------------------------------------------------------
 
 template<typename T_real>
-optimizers::OPTIMIZER_OUTCOME SVD_Fit_Routine<T_real>::fit_spectra(const models::Base_Model<T_real>* const model,
-                                                           const Spectra<T_real>* const spectra,
-                                                           const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
-                                                           std::unordered_map<std::string, T_real>& out_counts)
+VectorTr<T_real> SVD_Fit_Routine<T_real>::_get_background(const Fit_Parameters<T_real>& fit_params, const Spectra<T_real>* const spectra)
 {
-    Eigen::JacobiSVD<Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> > svd(_fitmatrix, Eigen::ComputeThinU | Eigen::ComputeThinV );
-    VectorTr<T_real> rhs = spectra->segment(this->_energy_range.min, this->_energy_range.count());
-
-    Fit_Parameters<T_real> fit_params = model->fit_parameters();
     VectorTr<T_real> background;
-    if (fit_params.contains(STR_SNIP_WIDTH))
+    if (fit_params.contains(Fit_Param_Id::SNIP_WIDTH))
     {
-        ArrayTr<T_real> bkg = snip_background<T_real>(spectra,
-            fit_params.value(STR_ENERGY_OFFSET),
-            fit_params.value(STR_ENERGY_SLOPE),
-            fit_params.value(STR_ENERGY_QUADRATIC),
-            fit_params.value(STR_SNIP_WIDTH),
+        thread_local ArrayTr<T_real> bkg;
+        std::shared_ptr<const Snip_Schedule<T_real>> schedule = get_snip_schedule<T_real>(spectra->size(),
+            fit_params.value(Fit_Param_Id::ENERGY_OFFSET),
+            fit_params.value(Fit_Param_Id::ENERGY_SLOPE),
+            fit_params.value(Fit_Param_Id::ENERGY_QUADRATIC),
+            fit_params.value(Fit_Param_Id::SNIP_WIDTH),
             this->_energy_range.min,
             this->_energy_range.max);
+        const ArrayTr<T_real>& full_background = shared_snip_background<T_real>(*spectra, schedule, bkg);
 
-        background = bkg.segment(this->_energy_range.min, this->_energy_range.count());
+        background = full_background.segment(this->_energy_range.min, this->_energy_range.count());
     }
     else
     {
         background.setZero(this->_energy_range.count());
     }
+    return background;
+}
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+optimizers::OPTIMIZER_OUTCOME SVD_Fit_Routine<T_real>::fit_spectra(const models::Base_Model<T_real>* const model,
+                                                           const Spectra<T_real>* const spectra,
+                                                           const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
+                                                           std::unordered_map<std::string, T_real>& out_counts)
+{
+    VectorTr<T_real> rhs = spectra->segment(this->_energy_range.min, this->_energy_range.count());
+
+    Fit_Parameters<T_real> fit_params = model->fit_parameters();
+    VectorTr<T_real> background = _get_background(fit_params, spectra);
     
     rhs -= background;
     rhs = rhs.unaryExpr([](T_real v) { return v > 0.0 ? v : (T_real)0.0; });
 
     ArrayTr<T_real> spectra_model = background;
 
-    VectorTr<T_real> result = svd.solve(rhs);
+    VectorTr<T_real> result = _pinv_fitmatrix * rhs;
 
     for(const auto& itr : *elements_to_fit)
     {
-        
-        out_counts[itr.first] = result[_element_row_index[itr.first]];
+        const auto& idx_itr = _element_row_index.find(itr.first);
+        if (idx_itr == _element_row_index.end())
+        {
+            continue;
+        }
+        int idx = idx_itr->second;
+        out_counts[itr.first] = result[idx];
         for (int j = 0; j < this->_energy_range.count(); j++)
         {
-            T_real val = _fitmatrix(j, _element_row_index[itr.first]) * result[_element_row_index[itr.first]];
+            T_real val = _fitmatrix(j, idx) * result[idx];
             if (std::isfinite(val))
             {
                 spectra_model[j] += val;
@@ -147,12 +168,9 @@ optimizers::OPTIMIZER_OUTCOME SVD_Fit_Routine<T_real>::fit_spectra(const models:
         }
     }
 
-    //lock and integrate results
-    {
-        std::lock_guard<std::mutex> lock(this->_int_spec_mutex);
-        this->_integrated_fitted_spectra.add(spectra_model);
-        //_integrated_background.add(background);
-    }
+    //integrate results into this thread's buffers
+    this->_integrate_fit(spectra_model);
+    //_integrated_background.add(background);
 
     out_counts[STR_RESIDUAL] = (_fitmatrix * result - rhs).norm();
 
@@ -161,6 +179,67 @@ optimizers::OPTIMIZER_OUTCOME SVD_Fit_Routine<T_real>::fit_spectra(const models:
 
 // ----------------------------------------------------------------------------
 
+template<typename T_real>
+void SVD_Fit_Routine<T_real>::fit_spectra_batch(const models::Base_Model<T_real>* const model,
+                                                const std::vector<const Spectra<T_real>*>& spectras,
+                                                const Fit_Result_Layout<T_real>& layout,
+                                                T_real* const out_results)
+{
+    const Eigen::Index n_channels = this->_energy_range.count();
+    const Eigen::Index n_spectra = (Eigen::Index)spectras.size();
+    if (n_spectra == 0)
+    {
+        return;
+    }
+
+    Fit_Parameters<T_real> fit_params = model->fit_parameters();
+
+    // one column per spectra so the whole block is solved with a single matrix-matrix product
+    Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> rhs(n_channels, n_spectra);
+    Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> background(n_channels, n_spectra);
+    for (Eigen::Index p = 0; p < n_spectra; p++)
+    {
+        background.col(p) = _get_background(fit_params, spectras[p]);
+        rhs.col(p) = spectras[p]->segment(this->_energy_range.min, n_channels).matrix() - background.col(p);
+    }
+    rhs = rhs.unaryExpr([](T_real v) { return v > 0.0 ? v : (T_real)0.0; });
+
+    Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> result = _pinv_fitmatrix * rhs;
+
+    // only elements_to_fit contribute to the fitted spectra, skip non finite counts like the single pixel fit does
+    Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> model_result = Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic>::Zero(result.rows(), n_spectra);
+    for (size_t s = 0; s < layout.num_elements(); s++)
+    {
+        const auto& idx_itr = _element_row_index.find(layout.name(s));
+        if (idx_itr == _element_row_index.end())
+        {
+            continue;
+        }
+        int idx = idx_itr->second;
+        for (Eigen::Index p = 0; p < n_spectra; p++)
+        {
+            out_results[p * layout.size() + s] = result(idx, p);
+            if (std::isfinite(result(idx, p)))
+            {
+                model_result(idx, p) = result(idx, p);
+            }
+        }
+    }
+
+    Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> fitted = _fitmatrix * result;
+    for (Eigen::Index p = 0; p < n_spectra; p++)
+    {
+        out_results[p * layout.size() + layout.residual_slot()] = (fitted.col(p) - rhs.col(p)).norm();
+    }
+
+    ArrayTr<T_real> spectra_model = (background + (_fitmatrix * model_result)).rowwise().sum().array();
+
+    //integrate results into this thread's buffers once for the whole block
+    this->_integrate_fit(spectra_model);
+}
+
+// ----------------------------------------------------------------------------
+
 template<typename T_real>
 void SVD_Fit_Routine<T_real>::initialize(models::Base_Model<T_real>* const model,
                                  const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
@@ -75,6 +75,10 @@ public:
                                                       const Fit_Element_Map_Dict<T_real>* const elements_to_fit,
                                                       std::unordered_map<std::string, T_real>& out_counts);
 
+    virtual void fit_spectra_batch(const models::Base_Model<T_real>* const model,
+                                   const std::vector<const Spectra<T_real>*>& spectras,
+                                   const Fit_Result_Layout<T_real>& layout,
+                                   T_real* const out_results);
 
     virtual std::string get_name() { return STR_FIT_SVD; }
 
@@ -86,10 +90,15 @@ protected:
 
     void _generate_fitmatrix();
 
+    VectorTr<T_real> _get_background(const Fit_Parameters<T_real>& fit_params, const Spectra<T_real>* const spectra);
+
 private:
 
     Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> _fitmatrix;
 
+    // pseudo-inverse of _fitmatrix, built once in initialize() and only read by fit_spectra
+    Eigen::Matrix<T_real, Eigen::Dynamic, Eigen::Dynamic> _pinv_fitmatrix;
+
     std::unordered_map<std::string, int> _element_row_index;
 
 };
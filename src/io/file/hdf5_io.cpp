@@ -47,6 +47,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 
 #include "hdf5_io.h"
+#include "hdf5_writer.h"
 
 #include <iostream>
 #include <string>
@@ -91,7 +92,7 @@ hsize_t max_dims_1d[1] = { H5S_UNLIMITED };
 hsize_t max_dims_2d[2] = { H5S_UNLIMITED, H5S_UNLIMITED };
 hsize_t max_dims_3d[3] = { H5S_UNLIMITED, H5S_UNLIMITED, H5S_UNLIMITED };
 
-//std::mutex HDF5_IO::_mutex;
+std::recursive_mutex HDF5_IO::_mutex;
 
 //-----------------------------------------------------------------------------
 
@@ -102,6 +103,9 @@ HDF5_IO* HDF5_IO::_this_inst(nullptr);
 
 HDF5_IO::HDF5_IO()
 {
+    // sessions are made while the writer thread is in the library
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+
 	//disable hdf print to std err
 	hid_t status;
     status = H5Eset_auto(H5E_DEFAULT, nullptr, nullptr);
@@ -112,7 +116,7 @@ HDF5_IO::HDF5_IO()
 
 HDF5_IO* HDF5_IO::inst()
 {
-    //std::lock_guard<std::mutex> lock(_mutex);
+    //std::lock_guard<std::recursive_mutex> lock(_mutex);
 
     if (_this_inst == nullptr)
     {
@@ -236,9 +240,17 @@ bool HDF5_IO::_create_memory_space(int rank, const hsize_t* count, hid_t& out_id
 
 //-----------------------------------------------------------------------------
 
-bool HDF5_IO::_open_h5_dataset(const std::string& name, hid_t data_type, hid_t parent_id, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims, hid_t& out_id, hid_t& out_dataspece)
+bool HDF5_IO::_open_h5_dataset(const std::string& name, hid_t data_type, hid_t parent_id, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims, hid_t& out_id, hid_t& out_dataspece, size_t cache_bytes)
 {
-    out_id = H5Dopen(parent_id, name.c_str(), H5P_DEFAULT);
+    hid_t dapl_id = H5P_DEFAULT;
+    if (cache_bytes > 0)
+    {
+        dapl_id = H5Pcreate(H5P_DATASET_ACCESS);
+        // w0 = 1 : evict chunks that were fully written first
+        H5Pset_chunk_cache(dapl_id, 12421, cache_bytes, 1.0);
+        _global_close_map.push({ dapl_id, H5O_PROPERTY });
+    }
+    out_id = H5Dopen(parent_id, name.c_str(), dapl_id);
     if (out_id < 0)
     {
         // if doesn't exist, create new one
@@ -262,10 +274,10 @@ bool HDF5_IO::_open_h5_dataset(const std::string& name, hid_t data_type, hid_t p
 
         hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
         H5Pset_chunk(dcpl_id, dims_size, chunk_dims);
-        H5Pset_deflate(dcpl_id, 7);
+        _layout_policy.apply_filter(dcpl_id);
         _global_close_map.push({ dcpl_id, H5O_PROPERTY });
 
-        out_id = H5Dcreate(parent_id, name.c_str(), data_type, out_dataspece, H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
+        out_id = H5Dcreate(parent_id, name.c_str(), data_type, out_dataspece, H5P_DEFAULT, dcpl_id, dapl_id);
         if (out_id > -1)
         {
             _global_close_map.push({ out_id, H5O_DATASET });
@@ -386,6 +398,13 @@ void HDF5_IO::_close_h5_objects(std::stack<std::pair<hid_t, H5_OBJECTS> >  &clos
 
 bool HDF5_IO::start_save_seq(const std::string filename, bool force_new_file, bool open_file_only)
 {
+    // writes queued by proc_spectra without a session go to the singleton's file that is open now
+    if (this == _this_inst)
+    {
+        HDF5_Writer::inst()->wait_idle();
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
 
     if (_cur_file_id > -1)
     {
@@ -419,8 +438,21 @@ bool HDF5_IO::start_save_seq(const std::string filename, bool force_new_file, bo
 
 //-----------------------------------------------------------------------------
 
+void HDF5_IO::set_filename(std::string fname)
+{
+    // same as start_save_seq, the queued writes may still need the current name
+    if (this == _this_inst)
+    {
+        HDF5_Writer::inst()->wait_idle();
+    }
+    _cur_filename = fname;
+}
+
+//-----------------------------------------------------------------------------
+
 bool HDF5_IO::end_save_seq(bool loginfo)
 {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
 
     if(_cur_file_id > 0)
     {
@@ -622,7 +654,7 @@ bool HDF5_IO::_save_extras(hid_t scan_grp_id, std::vector<data_struct::Extra_PV>
 
 bool HDF5_IO::generate_avg(std::string avg_filename, std::vector<std::string> files_to_avg)
 {
-    std::lock_guard<std::mutex> lock(_mutex);
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
     logI  << avg_filename << "\n";
 
     hid_t ocpypl_id, status, src_maps_grp_id, src_analyzed_grp_id, dst_fit_grp_id, src_quant_grp_id, dst_quant_grp_id;
@@ -1188,7 +1220,7 @@ bool HDF5_IO::close_dataset(size_t d_hash)
 
 void HDF5_IO::update_theta(std::string dataset_file, std::string theta_pv_str)
 {
-    std::lock_guard<std::mutex> lock(_mutex);
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
 	hid_t file_id, theta_id, extra_names, extra_values;
 	std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
 	char tmp_char[256] = { 0 };
@@ -1252,7 +1284,7 @@ void HDF5_IO::update_theta(std::string dataset_file, std::string theta_pv_str)
 
 void HDF5_IO::update_amps(std::string dataset_file, std::string us_amp_str, std::string ds_amp_str)
 {
-	std::lock_guard<std::mutex> lock(_mutex);
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
 	hid_t file_id, us_amp_id, us_amp_num_id, ds_amp_id, ds_amp_num_id;
 
 	hsize_t dims_in[1] = { 0 };
@@ -1354,7 +1386,7 @@ void HDF5_IO::update_amps(std::string dataset_file, std::string us_amp_str, std:
 
 void HDF5_IO::update_quant_amps(std::string dataset_file, std::string us_amp_str, std::string ds_amp_str)
 {
-	std::lock_guard<std::mutex> lock(_mutex);
+	std::lock_guard<std::recursive_mutex> lock(_mutex);
 	hid_t file_id, us_amp_id, ds_amp_id, num_stand_id;
 	std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
 	hsize_t dims_in[1] = { 0 };
@@ -1475,7 +1507,7 @@ void HDF5_IO::update_quant_amps(std::string dataset_file, std::string us_amp_str
 /*
 void HDF5_IO::update_scalers(std::string dataset_file, data_struct::Params_Override<T_real>* params_override)
 {
-    std::lock_guard<std::mutex> lock(_mutex);
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
     if (params_override == nullptr)
     {
         return;
@@ -1945,7 +1977,7 @@ void HDF5_IO::_add_extra_pvs(hid_t file_id, std::string group_name)
 
 void HDF5_IO::add_v9_layout(std::string dataset_file)
 {
-    std::lock_guard<std::mutex> lock(_mutex);
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
     double* dbuf = nullptr;
     float* fbuf = nullptr;
     logI  << dataset_file << "\n";
@@ -2852,7 +2884,7 @@ bool HDF5_IO::_add_exchange_meta(hid_t file_id, std::string exchange_idx, std::s
 
 void HDF5_IO::add_exchange_layout(std::string dataset_file)
 {
-    std::lock_guard<std::mutex> lock(_mutex);
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
 
     logI  << dataset_file << "\n";
     hid_t saved_file_id = _cur_file_id;
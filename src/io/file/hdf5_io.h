@@ -58,6 +58,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <stack>
 #include <type_traits>
 #include "hdf5.h"
+#include "data_struct/background.h"
 #include "data_struct/spectra_volume.h"
 #include "data_struct/fit_element_map.h"
 #include "data_struct/detector.h"
@@ -71,6 +72,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "data_struct/scaler_lookup.h"
 
 #include "csv_io.h"
+#include "hdf5_layout.h"
 namespace io
 {
 namespace file
@@ -186,14 +188,14 @@ public:
 
     static HDF5_IO* inst();
 
-    ~HDF5_IO();
+    virtual ~HDF5_IO();
 
     //-----------------------------------------------------------------------------
 
     template<typename T_real>
     bool load_spectra_volume(std::string path, size_t detector_num, data_struct::Spectra_Volume<T_real>* spec_vol)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         //_is_loaded = ERROR_LOADING;
         std::chrono::time_point<std::chrono::system_clock> start, end;
@@ -203,7 +205,7 @@ public:
 
         logI << path << " detector : " << detector_num << "\n";
 
-        hid_t    file_id, dset_id, dataspace_id, maps_grp_id, memoryspace_id, memoryspace_meta_id, dset_incnt_id, dset_outcnt_id, dset_rt_id, dset_lt_id;
+        hid_t    file_id, dset_id, dataspace_id, maps_grp_id, memoryspace_id, dset_incnt_id, dset_outcnt_id, dset_rt_id, dset_lt_id;
         hid_t    dataspace_lt_id, dataspace_rt_id, dataspace_inct_id, dataspace_outct_id;
         herr_t   error;
         std::string detector_path;
@@ -309,15 +311,14 @@ public:
 
         memoryspace_id = H5Screate_simple(2, count_row, nullptr);
         close_map.push({ memoryspace_id, H5O_DATASPACE });
-        memoryspace_meta_id = H5Screate_simple(1, count_meta, nullptr);
-        close_map.push({ memoryspace_meta_id, H5O_DATASPACE });
         H5Sselect_hyperslab(memoryspace_id, H5S_SELECT_SET, offset_row, nullptr, count_row, nullptr);
-        H5Sselect_hyperslab(memoryspace_meta_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
 
-        T_real live_time = 1.0;
-        T_real real_time = 1.0;
-        T_real in_cnt = 1.0;
-        T_real out_cnt = 1.0;
+        // per pixel times are [detector, rows, cols]; read a whole row of each at once
+        std::vector<T_real> live_times(spec_vol->cols(), 1.0);
+        std::vector<T_real> real_times(spec_vol->cols(), 1.0);
+        std::vector<T_real> in_cnts(spec_vol->cols(), 1.0);
+        std::vector<T_real> out_cnts(spec_vol->cols(), 1.0);
+        count_meta[2] = spec_vol->cols();
 
         offset_meta[0] = detector_num;
         for (size_t row = 0; row < spec_vol->rows(); row++)
@@ -330,27 +331,19 @@ public:
 
             if (error > -1)
             {
+                _read_h5d_block<T_real>(dset_lt_id, dataspace_lt_id, 3, offset_meta, count_meta, live_times.data());
+                _read_h5d_block<T_real>(dset_rt_id, dataspace_rt_id, 3, offset_meta, count_meta, real_times.data());
+                _read_h5d_block<T_real>(dset_incnt_id, dataspace_inct_id, 3, offset_meta, count_meta, in_cnts.data());
+                _read_h5d_block<T_real>(dset_outcnt_id, dataspace_outct_id, 3, offset_meta, count_meta, out_cnts.data());
+
                 for (size_t col = 0; col < spec_vol->cols(); col++)
                 {
-                    offset_meta[2] = col;
                     data_struct::Spectra<T_real>* spectra = &((*spec_vol)[row][col]);
 
-                    H5Sselect_hyperslab(dataspace_lt_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                    error = _read_h5d<T_real>(dset_lt_id, memoryspace_meta_id, dataspace_lt_id, H5P_DEFAULT, &live_time);
-                    spectra->elapsed_livetime(live_time);
-
-                    H5Sselect_hyperslab(dataspace_rt_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                    error = _read_h5d<T_real>(dset_rt_id, memoryspace_meta_id, dataspace_rt_id, H5P_DEFAULT, &real_time);
-                    spectra->elapsed_realtime(real_time);
-
-                    H5Sselect_hyperslab(dataspace_inct_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                    error = _read_h5d<T_real>(dset_incnt_id, memoryspace_meta_id, dataspace_inct_id, H5P_DEFAULT, &in_cnt);
-                    spectra->input_counts(in_cnt);
-
-                    H5Sselect_hyperslab(dataspace_outct_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                    error = _read_h5d<T_real>(dset_outcnt_id, memoryspace_meta_id, dataspace_outct_id, H5P_DEFAULT, &out_cnt);
-                    spectra->output_counts(out_cnt);
-
+                    spectra->elapsed_livetime(live_times[col]);
+                    spectra->elapsed_realtime(real_times[col]);
+                    spectra->input_counts(in_cnts[col]);
+                    spectra->output_counts(out_cnts[col]);
                     spectra->recalc_elapsed_livetime();
 
                     for (size_t s = 0; s < count_row[0]; s++)
@@ -389,7 +382,7 @@ public:
     template<typename T_real>
     bool load_spectra_volume_with_callback(std::string path, const std::vector<size_t>& detector_num_arr, data_struct::IO_Callback_Func_Def<T_real> callback_func, void* user_data)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         //_is_loaded = ERROR_LOADING;
         std::chrono::time_point<std::chrono::system_clock> start, end;
@@ -398,7 +391,7 @@ public:
 
         std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
 
-        hid_t    file_id, maps_grp_id, memoryspace_id, memoryspace_meta_id, dset_incnt_id, dset_outcnt_id, dset_rt_id, dset_lt_id;
+        hid_t    file_id, maps_grp_id, memoryspace_id, dset_incnt_id, dset_outcnt_id, dset_rt_id, dset_lt_id;
         hid_t    dataspace_lt_id, dataspace_rt_id, dataspace_inct_id, dataspace_outct_id;
         herr_t   error = -1;
         std::string detector_path;
@@ -505,14 +498,16 @@ public:
         count[1] = 1; //1 row
 
         memoryspace_id = H5Screate_simple(2, count_row, nullptr);
-        memoryspace_meta_id = H5Screate_simple(1, count_meta, nullptr);
+        close_map.push({ memoryspace_id, H5O_DATASPACE });
         H5Sselect_hyperslab(memoryspace_id, H5S_SELECT_SET, offset_row, nullptr, count_row, nullptr);
-        H5Sselect_hyperslab(memoryspace_meta_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
 
-        T_real live_time = 1.0;
-        T_real real_time = 1.0;
-        T_real in_cnt = 1.0;
-        T_real out_cnt = 1.0;
+        // one row of per pixel times for each requested detector, laid out [detector idx][col]
+        const size_t cols = count_row[1];
+        std::vector<T_real> live_times(detector_num_arr.size() * cols, 1.0);
+        std::vector<T_real> real_times(detector_num_arr.size() * cols, 1.0);
+        std::vector<T_real> in_cnts(detector_num_arr.size() * cols, 1.0);
+        std::vector<T_real> out_cnts(detector_num_arr.size() * cols, 1.0);
+        count_meta[2] = cols;
 
         for (size_t row = 0; row < dims_in[1]; row++)
         {
@@ -527,30 +522,26 @@ public:
 
             if (error > -1)
             {
-                for (size_t col = 0; col < count_row[1]; col++)
+                for (size_t d = 0; d < detector_num_arr.size(); d++)
                 {
-                    offset_meta[2] = col;
+                    offset_meta[0] = detector_num_arr[d];
+                    _read_h5d_block<T_real>(dset_lt_id, dataspace_lt_id, 3, offset_meta, count_meta, &live_times[d * cols]);
+                    _read_h5d_block<T_real>(dset_rt_id, dataspace_rt_id, 3, offset_meta, count_meta, &real_times[d * cols]);
+                    _read_h5d_block<T_real>(dset_incnt_id, dataspace_inct_id, 3, offset_meta, count_meta, &in_cnts[d * cols]);
+                    _read_h5d_block<T_real>(dset_outcnt_id, dataspace_outct_id, 3, offset_meta, count_meta, &out_cnts[d * cols]);
+                }
 
-                    for (size_t detector_num : detector_num_arr)
+                for (size_t col = 0; col < cols; col++)
+                {
+                    for (size_t d = 0; d < detector_num_arr.size(); d++)
                     {
-                        offset_meta[0] = detector_num;
+                        size_t detector_num = detector_num_arr[d];
                         data_struct::Spectra<T_real>* spectra = new data_struct::Spectra<T_real>(dims_in[0]);
 
-                        H5Sselect_hyperslab(dataspace_lt_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                        error = _read_h5d<T_real>(dset_lt_id, memoryspace_meta_id, dataspace_lt_id, H5P_DEFAULT, &live_time);
-                        spectra->elapsed_livetime(live_time);
-
-                        H5Sselect_hyperslab(dataspace_rt_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                        error = _read_h5d<T_real>(dset_rt_id, memoryspace_meta_id, dataspace_rt_id, H5P_DEFAULT, &real_time);
-                        spectra->elapsed_realtime(real_time);
-
-                        H5Sselect_hyperslab(dataspace_inct_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                        error = _read_h5d<T_real>(dset_incnt_id, memoryspace_meta_id, dataspace_inct_id, H5P_DEFAULT, &in_cnt);
-                        spectra->input_counts(in_cnt);
-
-                        H5Sselect_hyperslab(dataspace_outct_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                        error = _read_h5d<T_real>(dset_outcnt_id, memoryspace_meta_id, dataspace_outct_id, H5P_DEFAULT, &out_cnt);
-                        spectra->output_counts(out_cnt);
+                        spectra->elapsed_livetime(live_times[(d * cols) + col]);
+                        spectra->elapsed_realtime(real_times[(d * cols) + col]);
+                        spectra->input_counts(in_cnts[(d * cols) + col]);
+                        spectra->output_counts(out_cnts[(d * cols) + col]);
 
                         for (size_t s = 0; s < count_row[0]; s++)
                         {
@@ -594,7 +585,7 @@ public:
     template<typename T_real>
 	bool load_spectra_volume_emd_with_callback(std::string path, const std::vector<size_t>& detector_num_arr, data_struct::IO_Callback_Func_Def<T_real> callback_func, void* user_data)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         //TDOO: change to unique_lock so we can unlock and allow stream saver to be called
 
 
@@ -901,7 +892,7 @@ public:
     template<typename T_real>
     bool load_spectra_volume_emd(std::string path, size_t frame_num, data_struct::Spectra_Volume<T_real> *spec_vol, bool logerr = true)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         const std::string STR_BINCOUNT = "\"bincount\": \"";
         const std::string STR_WIDTH = "\"Width\": \"";
@@ -1194,7 +1185,7 @@ public:
     template<typename T_real>
     bool load_spectra_line_xspress3(std::string path, size_t detector_num, data_struct::Spectra_Line<T_real>* spec_row)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         //_is_loaded = ERROR_LOADING;
         std::chrono::time_point<std::chrono::system_clock> start, end;
@@ -1203,7 +1194,7 @@ public:
         logI << path << " detector : " << detector_num << "\n";
 
         std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
-        hid_t    file_id, dset_id, dataspace_id, maps_grp_id, scaler_grp_id, memoryspace_id, memoryspace_meta_id, dset_lt_id;
+        hid_t    file_id, dset_id, dataspace_id, maps_grp_id, scaler_grp_id, memoryspace_id, dset_lt_id;
         //hid_t    dset_incnt_id, dset_outcnt_id, dset_rt_id;
         hid_t    dataspace_lt_id;
         //hid_t dataspace_inct_id, dataspace_outct_id;
@@ -1278,12 +1269,11 @@ public:
 
         memoryspace_id = H5Screate_simple(3, count_row, nullptr);
         close_map.push({ memoryspace_id, H5O_DATASPACE });
-        memoryspace_meta_id = H5Screate_simple(1, count_meta, nullptr);
-        close_map.push({ memoryspace_meta_id, H5O_DATASPACE });
         H5Sselect_hyperslab(memoryspace_id, H5S_SELECT_SET, offset_row, nullptr, count_row, nullptr);
-        //H5Sselect_hyperslab (memoryspace_meta_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
 
-        T_real live_time = 1.0;
+        // livetime is one value per col, read the whole line at once
+        std::vector<T_real> live_times(dims_in[0], 1.0);
+        count_meta[0] = dims_in[0];
         //T_real real_time = 1.0;
         //T_real in_cnt = 1.0;
         //T_real out_cnt = 1.0;
@@ -1298,15 +1288,13 @@ public:
 
         if (error > -1)
         {
+            _read_h5d_block<T_real>(dset_lt_id, dataspace_lt_id, 1, offset_meta, count_meta, live_times.data());
 
             for (size_t col = 0; col < dims_in[0]; col++)
             {
-                offset_meta[0] = col;
                 data_struct::Spectra<T_real>* spectra = &((*spec_row)[col]);
 
-                H5Sselect_hyperslab(dataspace_lt_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                error = _read_h5d<T_real>(dset_lt_id, memoryspace_meta_id, dataspace_lt_id, H5P_DEFAULT, &live_time);
-                spectra->elapsed_livetime(live_time * 0.000000125);
+                spectra->elapsed_livetime(live_times[col] * 0.000000125);
 
                 //H5Sselect_hyperslab (dataspace_rt_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
                 //error = H5Dread(dset_rt_id, H5T_NATIVE_REAL, memoryspace_meta_id, dataspace_rt_id, H5P_DEFAULT, &real_time);
@@ -1353,7 +1341,7 @@ public:
     template<typename T_real>
     bool load_spectra_volume_confocal(std::string path, size_t detector_num, data_struct::Spectra_Volume<T_real>* spec_vol, bool log_error=true)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         //_is_loaded = ERROR_LOADING;
         std::chrono::time_point<std::chrono::system_clock> start, end;
@@ -1373,7 +1361,7 @@ public:
                 logI << path << " detector : " << detector_num << "\n";
             }
         }
-        hid_t    file_id, dset_id, dataspace_id, maps_grp_id, memoryspace_id, memoryspace_meta_id, dset_detectors_id, memoryspace_id2;
+        hid_t    file_id, dset_id, dataspace_id, maps_grp_id, memoryspace_id, dset_detectors_id;
         //hid_t    dset_xpos_id, dset_ypos_id, dataspace_xpos_id, dataspace_ypos_id;
         hid_t    dataspace_detectors_id;
         hid_t    attr_detector_names_id, attr_timebase_id;
@@ -1385,14 +1373,13 @@ public:
         std::string detector_path;
         char* detector_names[256];
         T_real time_base = 1.0f;
-        T_real el_time = 1.0f;
         T_real* buffer;
         hsize_t offset_row[2] = { 0,0 };
         hsize_t count_row[2] = { 0,0 };
         hsize_t offset2[2] = { 0,0 };
-        hsize_t count2[2] = { 1,1 };
+        hsize_t count2[2] = { 1,0 };
         hsize_t offset_meta[3] = { 0,0,0 };
-        hsize_t count_meta[3] = { 1,1,1 };
+        hsize_t count_meta[3] = { 1,0,0 };
         std::unordered_map<std::string, int> detector_lookup;
         std::string elt_str = "Timer";
         std::string incnt_str = "ICR Ch ";
@@ -1548,6 +1535,7 @@ public:
             spec_vol->resize_and_zero(dims_in[0], dims_in[1], dims_in[2]);
         }
 
+        size_t num_scalers = 0;
         if (false == confocal_ver_2020)
         {
             int det_rank = H5Sget_simple_extent_ndims(dataspace_detectors_id);
@@ -1566,6 +1554,7 @@ public:
                     //free(detector_names[z]);
                 }
             }
+            num_scalers = det_dims_in[2];
             delete[] det_dims_in;
         }
 
@@ -1587,80 +1576,103 @@ public:
 
         memoryspace_id = H5Screate_simple(2, count_row, nullptr);
         close_map.push({ memoryspace_id, H5O_DATASPACE });
-
-        memoryspace_id2 = H5Screate_simple(2, count2, nullptr);
-        close_map.push({ memoryspace_id2, H5O_DATASPACE });
-
-        memoryspace_meta_id = H5Screate_simple(1, count_meta, nullptr);
-        close_map.push({ memoryspace_meta_id, H5O_DATASPACE });
         H5Sselect_hyperslab(memoryspace_id, H5S_SELECT_SET, offset_row, nullptr, count_row, nullptr);
-        H5Sselect_hyperslab(memoryspace_meta_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-
-        T_real live_time = 1.0;
-        //T_real real_time = 1.0;
-        T_real in_cnt = 1.0;
-        T_real out_cnt = 1.0;
 
+        // per pixel scalers are read a row at a time. 2020 files keep each one in its own [rows, cols]
+        // dataset, older files interleave them in the [rows, cols, scalers] Detectors dataset.
+        std::vector<T_real> live_times(dims_in[1], 1.0);
+        std::vector<T_real> in_cnts(dims_in[1], 1.0);
+        std::vector<T_real> out_cnts(dims_in[1], 1.0);
+        std::vector<T_real> detectors_row;
+        hid_t elt_space_id = -1;
+        hid_t incnt_space_id = -1;
+        hid_t outcnt_space_id = -1;
+        size_t elt_idx = 0;
+        size_t incnt_idx = 0;
+        size_t outcnt_idx = 0;
+        if (confocal_ver_2020)
+        {
+            count2[1] = dims_in[1];
+            if (elt_id > -1)
+            {
+                elt_space_id = H5Dget_space(elt_id);
+                close_map.push({ elt_space_id, H5O_DATASPACE });
+            }
+            if (incnt_id > -1)
+            {
+                incnt_space_id = H5Dget_space(incnt_id);
+                close_map.push({ incnt_space_id, H5O_DATASPACE });
+            }
+            if (outcnt_id > -1)
+            {
+                outcnt_space_id = H5Dget_space(outcnt_id);
+                close_map.push({ outcnt_space_id, H5O_DATASPACE });
+            }
+        }
+        else
+        {
+            elt_idx = detector_lookup[elt_str];
+            incnt_idx = detector_lookup[incnt_str];
+            outcnt_idx = detector_lookup[outcnt_str];
+            count_meta[1] = dims_in[1];
+            count_meta[2] = num_scalers;
+            detectors_row.resize(dims_in[1] * num_scalers, 1.0);
+        }
 
         for (size_t row = 0; row < dims_in[0]; row++)
         {
             offset[0] = row;
-            offset_meta[0] = row;
 
             H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
             error = _read_h5d<T_real>(dset_id, memoryspace_id, dataspace_id, H5P_DEFAULT, buffer);
 
             if (error > -1)
             {
-                for (size_t col = 0; col < dims_in[1]; col++)
+                if (confocal_ver_2020)
                 {
-                    offset_meta[1] = col;
+                    offset2[0] = row;
+                    if (elt_id > -1)
+                    {
+                        _read_h5d_block<T_real>(elt_id, elt_space_id, 2, offset2, count2, live_times.data());
+                    }
+                    if (incnt_id > -1)
+                    {
+                        _read_h5d_block<T_real>(incnt_id, incnt_space_id, 2, offset2, count2, in_cnts.data());
+                    }
+                    if (outcnt_id > -1)
+                    {
+                        _read_h5d_block<T_real>(outcnt_id, outcnt_space_id, 2, offset2, count2, out_cnts.data());
+                    }
+                }
+                else
+                {
+                    offset_meta[0] = row;
+                    if (num_scalers > 0 && _read_h5d_block<T_real>(dset_detectors_id, dataspace_detectors_id, 3, offset_meta, count_meta, detectors_row.data()) > -1)
+                    {
+                        for (size_t col = 0; col < dims_in[1]; col++)
+                        {
+                            live_times[col] = detectors_row[(col * num_scalers) + elt_idx];
+                            in_cnts[col] = detectors_row[(col * num_scalers) + incnt_idx];
+                            out_cnts[col] = detectors_row[(col * num_scalers) + outcnt_idx];
+                        }
+                    }
+                }
 
+                for (size_t col = 0; col < dims_in[1]; col++)
+                {
                     data_struct::Spectra<T_real>* spectra = &((*spec_vol)[row][col]);
 
-
-
-                    if (confocal_ver_2020)
+                    if (false == confocal_ver_2020 || elt_id > -1)
                     {
-                        offset2[0] = row;
-                        offset2[1] = col;
-                        H5Sselect_hyperslab(memoryspace_id2, H5S_SELECT_SET, offset2, nullptr, count2, nullptr);
-                        if (elt_id > -1)
-                        {
-                            error = _read_h5d<T_real>(elt_id, memoryspace_id2, memoryspace_id2, H5P_DEFAULT, &live_time);
-                            el_time = live_time / time_base;
-                            spectra->elapsed_livetime(el_time);
-                        }
-                        if (incnt_id > -1)
-                        {
-                            error = _read_h5d<T_real>(incnt_id, memoryspace_id2, memoryspace_id2, H5P_DEFAULT, &in_cnt);
-                            in_cnt *= 1000.0;
-                            spectra->input_counts(in_cnt);
-                        }
-                        if (outcnt_id > -1)
-                        {
-                            error = _read_h5d<T_real>(outcnt_id, memoryspace_id2, memoryspace_id2, H5P_DEFAULT, &out_cnt);
-                            out_cnt *= 1000.0;
-                            spectra->output_counts(out_cnt);
-                        }
+                        spectra->elapsed_livetime(live_times[col] / time_base);
                     }
-                    else
+                    if (false == confocal_ver_2020 || incnt_id > -1)
                     {
-                        offset_meta[2] = detector_lookup[elt_str];
-                        H5Sselect_hyperslab(dataspace_detectors_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                        error = _read_h5d<T_real>(dset_detectors_id, memoryspace_meta_id, dataspace_detectors_id, H5P_DEFAULT, &live_time);
-                        el_time = live_time / time_base;
-                        spectra->elapsed_livetime(el_time);
-
-                        offset_meta[2] = detector_lookup[incnt_str];
-                        H5Sselect_hyperslab(dataspace_detectors_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                        error = _read_h5d<T_real>(dset_detectors_id, memoryspace_meta_id, dataspace_detectors_id, H5P_DEFAULT, &in_cnt);
-                        spectra->input_counts(in_cnt * 1000.0);
-
-                        offset_meta[2] = detector_lookup[outcnt_str];
-                        H5Sselect_hyperslab(dataspace_detectors_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                        error = _read_h5d<T_real>(dset_detectors_id, memoryspace_meta_id, dataspace_detectors_id, H5P_DEFAULT, &out_cnt);
-                        spectra->output_counts(out_cnt * 1000.0);
+                        spectra->input_counts(in_cnts[col] * 1000.0);
+                    }
+                    if (false == confocal_ver_2020 || outcnt_id > -1)
+                    {
+                        spectra->output_counts(out_cnts[col] * 1000.0);
                     }
 
                     for (size_t s = 0; s < dims_in[2]; s++)
@@ -1695,7 +1707,7 @@ public:
     template<typename T_real>
 	bool load_spectra_volume_gsecars(std::string path, size_t detector_num, data_struct::Spectra_Volume<T_real>* spec_vol, bool log_error = true)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         //_is_loaded = ERROR_LOADING;
         std::chrono::time_point<std::chrono::system_clock> start, end;
@@ -1706,7 +1718,7 @@ public:
         {
             logI << path << " detector : " << detector_num << "\n";
         }
-        hid_t    file_id, dset_id, dataspace_id, maps_grp_id, memoryspace_id, memoryspace_meta_id, dset_detectors_id;
+        hid_t    file_id, dset_id, dataspace_id, maps_grp_id, memoryspace_id, dset_detectors_id;
         hid_t    dset_xypos_id, dataspace_xypos_id;
         hid_t	 livetime_id, realtime_id, inpcounts_id, outcounts_id;
         hid_t    livetime_dataspace_id, realtime_dataspace_id, inpcounts_dataspace_id, outcounts_dataspace_id;
@@ -1890,16 +1902,14 @@ public:
 
         memoryspace_id = H5Screate_simple(2, count_row, nullptr);
         close_map.push({ memoryspace_id, H5O_DATASPACE });
-        memoryspace_meta_id = H5Screate_simple(1, count_meta, nullptr);
-        close_map.push({ memoryspace_meta_id, H5O_DATASPACE });
         H5Sselect_hyperslab(memoryspace_id, H5S_SELECT_SET, offset_row, nullptr, count_row, nullptr);
-        H5Sselect_hyperslab(memoryspace_meta_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-
-        T_real live_time = 1.0;
-        T_real real_time = 1.0;
-        T_real in_cnt = 1.0;
-        T_real out_cnt = 1.0;
 
+        // per pixel times are [rows, cols], read a whole row of each at once
+        std::vector<T_real> live_times(dims_in[1], 1.0);
+        std::vector<T_real> real_times(dims_in[1], 1.0);
+        std::vector<T_real> in_cnts(dims_in[1], 1.0);
+        std::vector<T_real> out_cnts(dims_in[1], 1.0);
+        count_meta[1] = dims_in[1];
 
         for (size_t row = 0; row < dims_in[0]; row++)
         {
@@ -1911,36 +1921,30 @@ public:
 
             if (error > -1) //no error
             {
+                bool has_realtime = _read_h5d_block<T_real>(realtime_id, realtime_dataspace_id, 2, offset_meta, count_meta, real_times.data()) > -1;
+                bool has_livetime = _read_h5d_block<T_real>(livetime_id, livetime_dataspace_id, 2, offset_meta, count_meta, live_times.data()) > -1;
+                bool has_incnt = _read_h5d_block<T_real>(inpcounts_id, inpcounts_dataspace_id, 2, offset_meta, count_meta, in_cnts.data()) > -1;
+                bool has_outcnt = _read_h5d_block<T_real>(outcounts_id, outcounts_dataspace_id, 2, offset_meta, count_meta, out_cnts.data()) > -1;
+
                 for (size_t col = 0; col < dims_in[1]; col++)
                 {
-                    offset_meta[1] = col;
-
                     data_struct::Spectra<T_real>* spectra = &((*spec_vol)[row][col]);
 
-                    H5Sselect_hyperslab(livetime_dataspace_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                    H5Sselect_hyperslab(realtime_dataspace_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                    H5Sselect_hyperslab(inpcounts_dataspace_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                    H5Sselect_hyperslab(outcounts_dataspace_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-
-                    error = _read_h5d<T_real>(realtime_id, memoryspace_meta_id, realtime_dataspace_id, H5P_DEFAULT, &real_time);
-                    if (error > -1)
+                    if (has_realtime)
                     {
-                        spectra->elapsed_realtime(real_time);
+                        spectra->elapsed_realtime(real_times[col]);
                     }
-                    error = _read_h5d<T_real>(livetime_id, memoryspace_meta_id, livetime_dataspace_id, H5P_DEFAULT, &live_time);
-                    if (error > -1)
+                    if (has_livetime)
                     {
-                        spectra->elapsed_livetime(live_time);
+                        spectra->elapsed_livetime(live_times[col]);
                     }
-                    error = _read_h5d<T_real>(inpcounts_id, memoryspace_meta_id, inpcounts_dataspace_id, H5P_DEFAULT, &in_cnt);
-                    if (error > -1)
+                    if (has_incnt)
                     {
-                        spectra->input_counts(in_cnt);
+                        spectra->input_counts(in_cnts[col]);
                     }
-                    error = _read_h5d<T_real>(outcounts_id, memoryspace_meta_id, outcounts_dataspace_id, H5P_DEFAULT, &out_cnt);
-                    if (error > -1)
+                    if (has_outcnt)
                     {
-                        spectra->output_counts(out_cnt);
+                        spectra->output_counts(out_cnts[col]);
                     }
 
                     //spectra->recalc_elapsed_livetime();
@@ -1977,7 +1981,7 @@ public:
     template<typename T_real>
     bool load_spectra_volume_bnl(std::string path, size_t detector_num, data_struct::Spectra_Volume<T_real>* spec_vol, bool log_error = true)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
@@ -2215,7 +2219,7 @@ public:
     template<typename T_real>
     bool load_integrated_spectra_bnl(std::string path, size_t detector_num, data_struct::Spectra<T_real>* spec, bool log_error)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
@@ -2452,7 +2456,7 @@ public:
     template<typename T_real>
     bool load_and_integrate_spectra_volume(std::string path, size_t detector_num, data_struct::Spectra<T_real>* spectra)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
 
         std::chrono::time_point<std::chrono::system_clock> start, end;
@@ -2462,7 +2466,7 @@ public:
 
         logI << path << " detector : " << detector_num << "\n";
 
-        hid_t    file_id, dset_id, dataspace_id, maps_grp_id, memoryspace_id, memoryspace_meta_id, dset_incnt_id, dset_outcnt_id, dset_rt_id, dset_lt_id;
+        hid_t    file_id, dset_id, dataspace_id, maps_grp_id, memoryspace_id, dset_incnt_id, dset_outcnt_id, dset_rt_id, dset_lt_id;
         hid_t    dataspace_lt_id, dataspace_rt_id, dataspace_inct_id, dataspace_outct_id;
         herr_t   error;
         std::string detector_path;
@@ -2564,14 +2568,15 @@ public:
         }
 
         memoryspace_id = H5Screate_simple(2, count_row, nullptr);
-        memoryspace_meta_id = H5Screate_simple(1, count_meta, nullptr);
+        close_map.push({ memoryspace_id, H5O_DATASPACE });
         H5Sselect_hyperslab(memoryspace_id, H5S_SELECT_SET, offset_row, nullptr, count_row, nullptr);
-        H5Sselect_hyperslab(memoryspace_meta_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
 
-        T_real live_time = 1.0;
-        T_real real_time = 1.0;
-        T_real in_cnt = 1.0;
-        T_real out_cnt = 1.0;
+        // per pixel times are [detector, rows, cols], read a whole row of each at once
+        std::vector<T_real> live_times(count_row[1], 0.0);
+        std::vector<T_real> real_times(count_row[1], 0.0);
+        std::vector<T_real> in_cnts(count_row[1], 0.0);
+        std::vector<T_real> out_cnts(count_row[1], 0.0);
+        count_meta[2] = count_row[1];
 
         T_real live_time_total = 0.0;
         T_real real_time_total = 0.0;
@@ -2589,25 +2594,17 @@ public:
 
             if (error > -1)
             {
+                _read_h5d_block<T_real>(dset_lt_id, dataspace_lt_id, 3, offset_meta, count_meta, live_times.data());
+                _read_h5d_block<T_real>(dset_rt_id, dataspace_rt_id, 3, offset_meta, count_meta, real_times.data());
+                _read_h5d_block<T_real>(dset_incnt_id, dataspace_inct_id, 3, offset_meta, count_meta, in_cnts.data());
+                _read_h5d_block<T_real>(dset_outcnt_id, dataspace_outct_id, 3, offset_meta, count_meta, out_cnts.data());
+
                 for (size_t col = 0; col < count_row[1]; col++)
                 {
-                    offset_meta[2] = col;
-
-                    H5Sselect_hyperslab(dataspace_lt_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                    error = _read_h5d<T_real>(dset_lt_id, memoryspace_meta_id, dataspace_lt_id, H5P_DEFAULT, &live_time);
-                    live_time_total += live_time;
-
-                    H5Sselect_hyperslab(dataspace_rt_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                    error = _read_h5d<T_real>(dset_rt_id, memoryspace_meta_id, dataspace_rt_id, H5P_DEFAULT, &real_time);
-                    real_time_total += real_time;
-
-                    H5Sselect_hyperslab(dataspace_inct_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                    error = _read_h5d<T_real>(dset_incnt_id, memoryspace_meta_id, dataspace_inct_id, H5P_DEFAULT, &in_cnt);
-                    in_cnt_total += in_cnt;
-
-                    H5Sselect_hyperslab(dataspace_outct_id, H5S_SELECT_SET, offset_meta, nullptr, count_meta, nullptr);
-                    error = _read_h5d<T_real>(dset_outcnt_id, memoryspace_meta_id, dataspace_outct_id, H5P_DEFAULT, &out_cnt);
-                    out_cnt_total += out_cnt;
+                    live_time_total += live_times[col];
+                    real_time_total += real_times[col];
+                    in_cnt_total += in_cnts[col];
+                    out_cnt_total += out_cnts[col];
 
                     for (size_t s = 0; s < count_row[0]; s++)
                     {
@@ -2654,7 +2651,7 @@ public:
                                       int col_idx_start = 0,
                                       int col_idx_end = -1)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         //_is_loaded = ERROR_LOADING;
         std::chrono::time_point<std::chrono::system_clock> start, end;
@@ -2664,7 +2661,7 @@ public:
 
         logI << path << "\n";
 
-        hid_t    file_id, dset_id, dataspace_id, spec_grp_id, memoryspace_id, memoryspace_meta_id, dset_incnt_id, dset_outcnt_id, dset_rt_id, dset_lt_id;
+        hid_t    file_id, dset_id, dataspace_id, spec_grp_id, dset_incnt_id, dset_outcnt_id, dset_rt_id, dset_lt_id;
         hid_t    dataspace_lt_id, dataspace_rt_id, dataspace_inct_id, dataspace_outct_id;
         herr_t   error;
         hsize_t dims_in[3] = { 0,0,0 };
@@ -2741,55 +2738,51 @@ public:
 
         spectra_volume->resize_and_zero(dims_in[1], dims_in[2], dims_in[0]);
 
-        //buffer = new T_real [dims_in[0] * dims_in[2]]; // cols x spectra_size
+        // mca_arr is [samples, rows, cols] and the times are [rows, cols]. Read the requested
+        // cols of one row of each with a single H5Dread and scatter them into the volume.
+        const size_t cols = (size_t)(col_idx_end - col_idx_start);
+        std::vector<T_real> buffer(dims_in[0] * cols);
+        std::vector<T_real> live_times(cols, 1.0);
+        std::vector<T_real> real_times(cols, 1.0);
+        std::vector<T_real> in_cnts(cols, 1.0);
+        std::vector<T_real> out_cnts(cols, 1.0);
+
         count[0] = dims_in[0];
         count[1] = 1;
-        count[2] = 1;
-
-        memoryspace_id = H5Screate_simple(3, count, nullptr);
-        memoryspace_meta_id = H5Screate_simple(2, count_time, nullptr);
-        H5Sselect_hyperslab(memoryspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
-        H5Sselect_hyperslab(memoryspace_meta_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-
-        T_real live_time = 1.0;
-        T_real real_time = 1.0;
-        T_real in_cnt = 1.0;
-        T_real out_cnt = 1.0;
+        count[2] = cols;
+        offset[2] = col_idx_start;
+        offset_time[1] = col_idx_start;
+        count_time[1] = cols;
 
-        //offset[1] = row;
-
-        for (size_t row = (size_t)row_idx_start; row < (size_t)row_idx_end; row++)
+        for (size_t row = (size_t)row_idx_start; cols > 0 && row < (size_t)row_idx_end; row++)
         {
             offset[1] = row;
             offset_time[0] = row;
-            for (size_t col = (size_t)col_idx_start; col < (size_t)col_idx_end; col++)
+
+            error = _read_h5d_block<T_real>(dset_id, dataspace_id, 3, offset, count, buffer.data());
+            if (error < 0)
             {
-                data_struct::Spectra<T_real>* spectra = &((*spectra_volume)[row][col]);
-                offset[2] = col;
-                offset_time[1] = col;
-                H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+                logW << "Could not read row " << row << "\n";
+                continue;
+            }
+
+            _read_h5d_block<T_real>(dset_rt_id, dataspace_rt_id, 2, offset_time, count_time, real_times.data());
+            _read_h5d_block<T_real>(dset_lt_id, dataspace_lt_id, 2, offset_time, count_time, live_times.data());
+            _read_h5d_block<T_real>(dset_incnt_id, dataspace_inct_id, 2, offset_time, count_time, in_cnts.data());
+            _read_h5d_block<T_real>(dset_outcnt_id, dataspace_outct_id, 2, offset_time, count_time, out_cnts.data());
 
-                //error = H5Dread (dset_id, H5T_NATIVE_REAL, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)&(*spectra)[0]);
-                error = _read_h5d<T_real>(dset_id, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)spectra->data());
-                if (error > 0)
+            for (size_t c = 0; c < cols; c++)
+            {
+                data_struct::Spectra<T_real>* spectra = &((*spectra_volume)[row][col_idx_start + c]);
+                for (size_t s = 0; s < dims_in[0]; s++)
                 {
-                    logW << "Counld not read row " << row << " col " << col << "\n";
+                    (*spectra)[s] = buffer[(s * cols) + c];
                 }
 
-                H5Sselect_hyperslab(dataspace_lt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-                H5Sselect_hyperslab(dataspace_rt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-                H5Sselect_hyperslab(dataspace_inct_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-                H5Sselect_hyperslab(dataspace_outct_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-
-                error = _read_h5d<T_real>(dset_rt_id, memoryspace_meta_id, dataspace_rt_id, H5P_DEFAULT, (void*)&real_time);
-                error = _read_h5d<T_real>(dset_lt_id, memoryspace_meta_id, dataspace_lt_id, H5P_DEFAULT, (void*)&live_time);
-                error = _read_h5d<T_real>(dset_incnt_id, memoryspace_meta_id, dataspace_inct_id, H5P_DEFAULT, (void*)&in_cnt);
-                error = _read_h5d<T_real>(dset_outcnt_id, memoryspace_meta_id, dataspace_outct_id, H5P_DEFAULT, (void*)&out_cnt);
-
-                spectra->elapsed_livetime(live_time);
-                spectra->elapsed_realtime(real_time);
-                spectra->input_counts(in_cnt);
-                spectra->output_counts(out_cnt);
+                spectra->elapsed_livetime(live_times[c]);
+                spectra->elapsed_realtime(real_times[c]);
+                spectra->input_counts(in_cnts[c]);
+                spectra->output_counts(out_cnts[c]);
             }
         }
 
@@ -2809,7 +2802,7 @@ public:
     template<typename T_real>
     bool load_integrated_spectra_analyzed_h5(std::string path, data_struct::Spectra<T_real>* spectra, ROI_Vec* roi = nullptr, bool log_error=true)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         hid_t    file_id;
 
         file_id = H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
@@ -2830,7 +2823,7 @@ public:
     template<typename T_real>
     bool load_integrated_spectra_analyzed_h5_roi(std::string path, data_struct::Spectra<T_real>* int_spectra, ROI_Vec& roi)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         bool is_v9 = false;
         //_is_loaded = ERROR_LOADING;
@@ -2841,7 +2834,7 @@ public:
 
         logI << path << "\n";
 
-        hid_t    file_id, dset_id, dataspace_id, spec_grp_id, memoryspace_id, memoryspace_meta_id, dset_incnt_id, dset_outcnt_id;
+        hid_t    file_id, dset_id, dataspace_id, spec_grp_id, memoryspace_id, dset_incnt_id, dset_outcnt_id;
         hid_t   memoryspace_1;
         hid_t    dset_rt_id, dset_lt_id, dset_scalers, dset_scaler_names;
         hid_t    dataspace_lt_id, dataspace_rt_id, dataspace_inct_id, dataspace_outct_id, dataspace_scalers, dataspace_scaler_names;
@@ -2983,28 +2976,54 @@ public:
         count[2] = 1;
 
         memoryspace_id = H5Screate_simple(3, count, nullptr);
-        memoryspace_meta_id = H5Screate_simple(2, count_time, nullptr);
+        close_map.push({ memoryspace_id, H5O_DATASPACE });
         H5Sselect_hyperslab(memoryspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
-        H5Sselect_hyperslab(memoryspace_meta_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
 
-        T_real live_time = 1.0;
-        T_real real_time = 1.0;
-        T_real in_cnt = 1.0;
-        T_real out_cnt = 1.0;
+        // roi pixels are scattered, so read the whole [rows, cols] time images once and look
+        // each pixel up instead of issuing four single value reads per pixel
+        const size_t img_size = dims_in[1] * dims_in[2];
+        std::vector<T_real> live_times(img_size, 1.0);
+        std::vector<T_real> real_times(img_size, 1.0);
+        std::vector<T_real> in_cnts(img_size, 1.0);
+        std::vector<T_real> out_cnts(img_size, 1.0);
 
+        if (is_v9)
+        {
+            hsize_t offset_img[3] = { 0, 0, 0 };
+            hsize_t count_img[3] = { 1, dims_in[1], dims_in[2] };
+            std::pair<hsize_t, std::vector<T_real>*> planes[4] = { {elt_off, &live_times}, {ert_off, &real_times}, {in_off, &in_cnts}, {out_off, &out_cnts} };
+            for (auto& plane : planes)
+            {
+                offset_img[0] = plane.first;
+                if (plane.first == (hsize_t)-1 || _read_h5d_block<T_real>(dset_scalers, dataspace_scalers, 3, offset_img, count_img, plane.second->data()) < 0)
+                {
+                    std::fill(plane.second->begin(), plane.second->end(), (T_real)0.0);
+                }
+            }
+        }
+        else
+        {
+            count_time[0] = dims_in[1];
+            count_time[1] = dims_in[2];
+            _read_h5d_block<T_real>(dset_rt_id, dataspace_rt_id, 2, offset_time, count_time, real_times.data());
+            _read_h5d_block<T_real>(dset_lt_id, dataspace_lt_id, 2, offset_time, count_time, live_times.data());
+            _read_h5d_block<T_real>(dset_incnt_id, dataspace_inct_id, 2, offset_time, count_time, in_cnts.data());
+            _read_h5d_block<T_real>(dset_outcnt_id, dataspace_outct_id, 2, offset_time, count_time, out_cnts.data());
+        }
 
         for (auto& itr : roi)
         {
             hsize_t xoffset = itr.first;
             hsize_t yoffset = itr.second;
-            
+            if (yoffset >= dims_in[1] || xoffset >= dims_in[2])
+            {
+                logW << "roi pixel row " << yoffset << " col " << xoffset << " is outside the dataset, skipping\n";
+                continue;
+            }
+
             offset[0] = 0;
             offset[1] = yoffset;
-            offset_time[0] = yoffset;
             offset[2] = xoffset;
-            offset_time[1] = xoffset;
-
-            count[0] = dims_in[0];
 
             H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
 
@@ -3012,56 +3031,16 @@ public:
             spectra.resize(dims_in[0]);
 
             error = _read_h5d<T_real>(dset_id, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)spectra.data());
-            if (error > 0)
-            {
-                logW << "Counld not read row " << yoffset << " col " << xoffset << "\n";
-            }
-
-            if (is_v9)
-            {
-                count[0] = 1;
-
-                offset[0] = elt_off;
-                H5Sselect_hyperslab(dataspace_scalers, H5S_SELECT_SET, offset, nullptr, count, nullptr);
-                error = _read_h5d<T_real>(dset_scalers, memoryspace_meta_id, dataspace_scalers, H5P_DEFAULT, (void*)&live_time);
-                if (error > 0)
-                    live_time = 0;
-
-                offset[0] = ert_off;
-                H5Sselect_hyperslab(dataspace_scalers, H5S_SELECT_SET, offset, nullptr, count, nullptr);
-                error = _read_h5d<T_real>(dset_scalers, memoryspace_meta_id, dataspace_scalers, H5P_DEFAULT, (void*)&real_time);
-                if (error > 0)
-                    real_time = 0;
-
-                offset[0] = in_off;
-                H5Sselect_hyperslab(dataspace_scalers, H5S_SELECT_SET, offset, nullptr, count, nullptr);
-                error = _read_h5d<T_real>(dset_scalers, memoryspace_meta_id, dataspace_scalers, H5P_DEFAULT, (void*)&in_cnt);
-                if (error > 0)
-                    in_cnt = 0;
-
-                offset[0] = out_off;
-                H5Sselect_hyperslab(dataspace_scalers, H5S_SELECT_SET, offset, nullptr, count, nullptr);
-                error = _read_h5d<T_real>(dset_scalers, memoryspace_meta_id, dataspace_scalers, H5P_DEFAULT, (void*)&out_cnt);
-                if (error > 0)
-                    out_cnt = 0;
-            }
-            else
+            if (error < 0)
             {
-                H5Sselect_hyperslab(dataspace_lt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-                H5Sselect_hyperslab(dataspace_rt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-                H5Sselect_hyperslab(dataspace_inct_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-                H5Sselect_hyperslab(dataspace_outct_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-
-                error = _read_h5d<T_real>(dset_rt_id, memoryspace_meta_id, dataspace_rt_id, H5P_DEFAULT, (void*)&real_time);
-                error = _read_h5d<T_real>(dset_lt_id, memoryspace_meta_id, dataspace_lt_id, H5P_DEFAULT, (void*)&live_time);
-                error = _read_h5d<T_real>(dset_incnt_id, memoryspace_meta_id, dataspace_inct_id, H5P_DEFAULT, (void*)&in_cnt);
-                error = _read_h5d<T_real>(dset_outcnt_id, memoryspace_meta_id, dataspace_outct_id, H5P_DEFAULT, (void*)&out_cnt);
+                logW << "Could not read row " << yoffset << " col " << xoffset << "\n";
             }
 
-            spectra.elapsed_livetime(live_time);
-            spectra.elapsed_realtime(real_time);
-            spectra.input_counts(in_cnt);
-            spectra.output_counts(out_cnt);
+            const size_t idx = (yoffset * dims_in[2]) + xoffset;
+            spectra.elapsed_livetime(live_times[idx]);
+            spectra.elapsed_realtime(real_times[idx]);
+            spectra.input_counts(in_cnts[idx]);
+            spectra.output_counts(out_cnts[idx]);
 
             int_spectra->add(spectra);
         }
@@ -3088,7 +3067,7 @@ public:
     template<typename T_real>
     bool load_quantification_scalers_analyzed_h5(std::string path, data_struct::Params_Override<T_real> *override_values)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         //_is_loaded = ERROR_LOADING;
         std::chrono::time_point<std::chrono::system_clock> start, end;
@@ -3262,7 +3241,7 @@ public:
     bool load_quantification_analyzed_h5(std::string path, data_struct::Detector<T_real>* detector)
     {
 
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
@@ -3417,6 +3396,8 @@ public:
     template<typename T_real>
     bool load_scalers_analyzed_h5(std::string path, std::map<std::string, data_struct::ArrayXXr<T_real>> &scalers_map)
     {
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
+
         hid_t file_id = -1;
         hid_t maps_grp_id = -1;
         hid_t counts_dset_id, channels_dset_id, counts_dspace_id, channels_dspace_id, fit_int_spec_dset_id;
@@ -3523,6 +3504,7 @@ public:
     template<typename T_real>
     bool load_scan_info_analyzed_h5(std::string path, data_struct::Detector<T_real>* detector, data_struct::Scan_Info<T_real> &scan_info)
     {
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         hid_t file_id = -1;
         hid_t x_axis_id = -1;
@@ -3654,7 +3636,7 @@ public:
     template<typename T_real>
     bool load_quantification_scalers_gsecars(std::string path, data_struct::Params_Override<T_real> *override_values)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
@@ -3811,7 +3793,7 @@ public:
     template<typename T_real>
     bool load_quantification_scalers_BNL(std::string path, data_struct::Params_Override<T_real>* override_values)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
@@ -3959,7 +3941,7 @@ public:
     template<typename T_real>
     bool get_scalers_and_metadata_emd(std::string path, data_struct::Scan_Info<T_real>* scan_info)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         hid_t    file_id, src_maps_grp_id, detectors_grp_id, hash_grp_id, data_id, spectrumstream_grp_id, hash2_grp_id, data2_id;
         std::stack<std::pair<hid_t, H5_OBJECTS> > close_map;
         std::chrono::time_point<std::chrono::system_clock> start, end;
@@ -4075,7 +4057,7 @@ public:
     template<typename T_real>
     bool get_scalers_and_metadata_confocal(std::string path, data_struct::Scan_Info<T_real>* scan_info)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
 
@@ -4246,7 +4228,7 @@ public:
     template<typename T_real>
     bool get_scalers_and_metadata_gsecars(std::string path, data_struct::Scan_Info<T_real>* scan_info)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
 
@@ -4379,7 +4361,7 @@ public:
     template<typename T_real>
     bool get_scalers_and_metadata_bnl(std::string path, data_struct::Scan_Info<T_real>* scan_info)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
 
@@ -4572,14 +4554,25 @@ public:
 
     bool start_save_seq(bool force_new_file=false){ return start_save_seq(_cur_filename, force_new_file, false);}
 
-    void set_filename(std::string fname) {_cur_filename = fname;}
+    /**
+     * @brief set_layout_policy : Chunk shapes and compression for datasets created after this.
+     */
+    void set_layout_policy(const H5_Layout_Policy& policy) { _layout_policy = policy; }
+
+    const H5_Layout_Policy& layout_policy() const { return _layout_policy; }
+
+    /**
+     * @brief set_filename : Name of the file for start_save_seq(bool). On HDF5_IO::inst() this and start_save_seq
+     *        wait for the writes still queued on HDF5_Writer, since they go to the singleton's file.
+     */
+    void set_filename(std::string fname);
 
     //-----------------------------------------------------------------------------
 
     template<typename T_real>
     bool save_spectra_volume(const std::string path, data_struct::Spectra_Volume<T_real>* spectra_volume, size_t row_idx_start=0, int row_idx_end=-1, size_t col_idx_start=0, int col_idx_end=-1)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
 
 
@@ -4630,25 +4623,16 @@ public:
         count[0] = dims_out[0];
         count[1] = 1;
         count[2] = 1;
-        chunk_dims[0] = dims_out[0];
-        chunk_dims[1] = 1;
-        chunk_dims[2] = 1;
+        _layout_policy.spectra_chunk(dims_out, sizeof(T_real), chunk_dims);
+        const size_t cache_bytes = _layout_policy.spectra_cache_bytes(dims_out, chunk_dims, sizeof(T_real));
 
 
         dims_time_out[0] = spectra_volume->rows();
         dims_time_out[1] = spectra_volume->cols();
-        chunk_dims_times[0] = spectra_volume->rows();
-        chunk_dims_times[1] = 1;
+        _layout_policy.image_chunk(2, dims_time_out, sizeof(T_real), chunk_dims_times);
 
         offset_time[0] = 0;
         offset_time[1] = 0;
-        count_time[0] = 1;
-        count_time[1] = 1;
-
-        _create_memory_space(3, count, memoryspace_id);
-        _create_memory_space(2, count_time, memoryspace_time_id);
-
-        H5Sselect_hyperslab(memoryspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
 
         // open /MAPS
         if (false == _open_or_create_group(STR_MAPS, _cur_file_id, maps_grp_id))
@@ -4663,7 +4647,7 @@ public:
         }
 
         // try to open mca dataset and expand before creating 
-        if (false == _open_h5_dataset<T_real>(path, spec_grp_id, 3, dims_out, chunk_dims, dset_id, dataspace_id))
+        if (false == _open_h5_dataset<T_real>(path, spec_grp_id, 3, dims_out, chunk_dims, dset_id, dataspace_id, cache_bytes))
         {
             logE << "Error creating " << path << "\n";
             return false;
@@ -4690,59 +4674,98 @@ public:
             return false;
         }
 
-        H5Sselect_hyperslab(memoryspace_time_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+        // one H5Dwrite per dataset for a block of rows. The block is a row of chunks so every chunk is written once.
+        size_t block_rows = 1;
+        hsize_t file_chunk_dims[3] = { 0, 0, 0 };
+        hid_t dset_dcpl_id = H5Dget_create_plist(dset_id);
+        if (H5Pget_layout(dset_dcpl_id) == H5D_CHUNKED && H5Pget_chunk(dset_dcpl_id, 3, file_chunk_dims) == 3)
+        {
+            block_rows = std::max((size_t)file_chunk_dims[1], (size_t)1);
+        }
+        H5Pclose(dset_dcpl_id);
 
-        T_real real_time;
-        T_real life_time;
-        T_real in_cnt;
-        T_real out_cnt;
-        for (size_t row = row_idx_start; row < (size_t)row_idx_end; row++)
+        const size_t samples = dims_out[0];
+        const size_t num_cols = (size_t)col_idx_end - col_idx_start;
+        std::vector<T_real> spectra_block(samples * block_rows * num_cols);
+        std::vector<T_real> real_time_block(block_rows * num_cols);
+        std::vector<T_real> live_time_block(block_rows * num_cols);
+        std::vector<T_real> in_cnt_block(block_rows * num_cols);
+        std::vector<T_real> out_cnt_block(block_rows * num_cols);
+
+        for (size_t first_row = row_idx_start; num_cols > 0 && first_row < (size_t)row_idx_end; first_row += block_rows)
         {
-            offset[1] = row;
-            offset_time[0] = row;
-            for (size_t col = col_idx_start; col < (size_t)col_idx_end; col++)
-            {
-                const data_struct::Spectra<T_real>* spectra = &((*spectra_volume)[row][col]);
-                offset[2] = col;
-                offset_time[1] = col;
-                H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+            const size_t last_row = std::min(first_row + block_rows, (size_t)row_idx_end);
+            const size_t block_pixels = (last_row - first_row) * num_cols;
+            spectra_volume->prefetch_rows(last_row, last_row + block_rows);
 
-                status = _write_h5d<T_real>(dset_id, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)&(*spectra)[0]);
-                if (status < 0)
+            // mca_arr is [samples, rows, cols], transpose the spectra a few cache lines of samples at a time
+            for (size_t first_sample = 0; first_sample < samples; first_sample += 64)
+            {
+                const size_t last_sample = std::min(first_sample + 64, samples);
+                for (size_t pixel = 0; pixel < block_pixels; pixel++)
                 {
-                    logE << " H5Dwrite failed to write spectra\n";
+                    const data_struct::Spectra<T_real>& spectra = (*spectra_volume)[first_row + pixel / num_cols][col_idx_start + pixel % num_cols];
+                    for (size_t s = first_sample; s < last_sample; s++)
+                    {
+                        spectra_block[s * block_pixels + pixel] = spectra[s];
+                    }
                 }
+            }
+            for (size_t pixel = 0; pixel < block_pixels; pixel++)
+            {
+                const data_struct::Spectra<T_real>& spectra = (*spectra_volume)[first_row + pixel / num_cols][col_idx_start + pixel % num_cols];
+                real_time_block[pixel] = spectra.elapsed_realtime();
+                live_time_block[pixel] = spectra.elapsed_livetime();
+                in_cnt_block[pixel] = spectra.input_counts();
+                out_cnt_block[pixel] = spectra.output_counts();
+            }
 
-                H5Sselect_hyperslab(dataspace_rt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-                H5Sselect_hyperslab(dataspace_lt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-                H5Sselect_hyperslab(dataspace_incr_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
-                H5Sselect_hyperslab(dataspace_ocr_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+            offset[1] = first_row;
+            offset[2] = col_idx_start;
+            count[1] = last_row - first_row;
+            count[2] = num_cols;
+            offset_time[0] = first_row;
+            offset_time[1] = col_idx_start;
+            count_time[0] = last_row - first_row;
+            count_time[1] = num_cols;
+            memoryspace_id = H5Screate_simple(3, count, nullptr);
+            memoryspace_time_id = H5Screate_simple(2, count_time, nullptr);
 
-                real_time = spectra->elapsed_realtime();
-                life_time = spectra->elapsed_livetime();
-                in_cnt = spectra->input_counts();
-                out_cnt = spectra->output_counts();
-                status = _write_h5d<T_real>(dset_rt_id, memoryspace_time_id, dataspace_rt_id, H5P_DEFAULT, (void*)&real_time);
-                if (status < 0)
-                {
-                    logE << " H5Dwrite failed to write " << STR_ELAPSED_REAL_TIME << "\n";
-                }
-                status = _write_h5d<T_real>(dset_lt_id, memoryspace_time_id, dataspace_lt_id, H5P_DEFAULT, (void*)&life_time);
-                if (status < 0)
-                {
-                    logE << " H5Dwrite failed to write " << STR_ELAPSED_LIVE_TIME << "\n";
-                }
-                status = _write_h5d<T_real>(incnt_dset_id, memoryspace_time_id, dataspace_incr_id, H5P_DEFAULT, (void*)&in_cnt);
-                if (status < 0)
-                {
-                    logE << " H5Dwrite failed to write " << STR_INPUT_COUNTS << "\n";
-                }
-                status = _write_h5d<T_real>(outcnt_dset_id, memoryspace_time_id, dataspace_ocr_id, H5P_DEFAULT, (void*)&out_cnt);
-                if (status < 0)
-                {
-                    logE << " H5Dwrite failed to write " << STR_OUTPUT_COUNTS << "\n";
-                }
+            H5Sselect_hyperslab(dataspace_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+            status = _write_h5d<T_real>(dset_id, memoryspace_id, dataspace_id, H5P_DEFAULT, (void*)spectra_block.data());
+            if (status < 0)
+            {
+                logE << " H5Dwrite failed to write spectra\n";
+            }
+
+            H5Sselect_hyperslab(dataspace_rt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+            H5Sselect_hyperslab(dataspace_lt_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+            H5Sselect_hyperslab(dataspace_incr_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+            H5Sselect_hyperslab(dataspace_ocr_id, H5S_SELECT_SET, offset_time, nullptr, count_time, nullptr);
+            status = _write_h5d<T_real>(dset_rt_id, memoryspace_time_id, dataspace_rt_id, H5P_DEFAULT, (void*)real_time_block.data());
+            if (status < 0)
+            {
+                logE << " H5Dwrite failed to write " << STR_ELAPSED_REAL_TIME << "\n";
             }
+            status = _write_h5d<T_real>(dset_lt_id, memoryspace_time_id, dataspace_lt_id, H5P_DEFAULT, (void*)live_time_block.data());
+            if (status < 0)
+            {
+                logE << " H5Dwrite failed to write " << STR_ELAPSED_LIVE_TIME << "\n";
+            }
+            status = _write_h5d<T_real>(incnt_dset_id, memoryspace_time_id, dataspace_incr_id, H5P_DEFAULT, (void*)in_cnt_block.data());
+            if (status < 0)
+            {
+                logE << " H5Dwrite failed to write " << STR_INPUT_COUNTS << "\n";
+            }
+            status = _write_h5d<T_real>(outcnt_dset_id, memoryspace_time_id, dataspace_ocr_id, H5P_DEFAULT, (void*)out_cnt_block.data());
+            if (status < 0)
+            {
+                logE << " H5Dwrite failed to write " << STR_OUTPUT_COUNTS << "\n";
+            }
+            H5Sclose(memoryspace_id);
+            H5Sclose(memoryspace_time_id);
+
+            spectra_volume->release_rows(first_row, last_row);
         }
 
         if (false == _open_or_create_group(STR_INT_SPEC, spec_grp_id, int_spec_grp_id))
@@ -4844,7 +4867,7 @@ public:
     bool save_energy_calib(int spectra_size, T_real energy_offset, T_real energy_slope, T_real energy_quad)
     {
 
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         if (_cur_file_id < 0)
         {
             logE << "hdf5 file was never initialized. Call start_save_seq() before this function." << "\n";
@@ -4924,7 +4947,7 @@ public:
     template<typename T_real>
     bool save_element_fits(const std::string path, const data_struct::Fit_Count_Dict<T_real>* const element_counts, size_t row_idx_start=0, int row_idx_end=-1, size_t col_idx_start=0, int col_idx_end=-1)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
 
 
@@ -4953,6 +4976,7 @@ public:
         hsize_t count[1] = { 1 };
         hsize_t count_3d[3] = { 1, 1, 1 };
         hsize_t chunk_dims[3];
+        hsize_t counts_chunk_dims[3];
         hsize_t tmp_dims[3];
 
         //fix this
@@ -4974,6 +4998,7 @@ public:
         chunk_dims[0] = 1;
         chunk_dims[1] = dims_out[1];
         chunk_dims[2] = dims_out[2];
+        _layout_policy.image_chunk(3, dims_out, sizeof(T_real), counts_chunk_dims);
 
         _create_memory_space(1, count_3d, dataspace_ch_off_id);
         _create_memory_space(3, count_3d, memoryspace);
@@ -4993,7 +5018,7 @@ public:
             return false;
         }
 
-        if (false == _open_h5_dataset<T_real>(STR_COUNTS_PER_SEC, fit_grp_id, 3, dims_out, dims_out, dset_id, dataspace_id))
+        if (false == _open_h5_dataset<T_real>(STR_COUNTS_PER_SEC, fit_grp_id, 3, dims_out, counts_chunk_dims, dset_id, dataspace_id))
         {
             return false;
         }
@@ -5119,7 +5144,7 @@ public:
     template<typename T_real>
     bool save_fitted_int_spectra(const std::string path, const data_struct::Spectra<T_real>& spectra, const data_struct::Range& range, const data_struct::Spectra<T_real>& background, const size_t save_spectra_size)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         if (_cur_file_id < 0)
         {
@@ -5203,7 +5228,7 @@ public:
 							const data_struct::Spectra<T_real>& max_10_spectra,
                             const data_struct::Spectra<T_real>& fit_int_background)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         if (_cur_file_id < 0)
         {
@@ -5273,7 +5298,7 @@ public:
     bool save_quantification(data_struct::Detector<T_real>* detector)
     {
 
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
@@ -5746,7 +5771,7 @@ public:
                            int col_idx_end=-1)
     {
 
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
 
@@ -5838,7 +5863,7 @@ public:
                                     int col_idx_end=-1)
     {
 
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
 
@@ -6140,7 +6165,7 @@ public:
 								int col_idx_end = -1)
     {
 
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
 
@@ -6428,7 +6453,7 @@ public:
         int col_idx_end = -1)
     {
 
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
         std::chrono::time_point<std::chrono::system_clock> start, end;
         start = std::chrono::system_clock::now();
 
@@ -6679,7 +6704,7 @@ public:
     template<typename T_real>
     void export_int_fitted_to_csv(std::string dataset_file)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         logI << dataset_file << "\n";
 
@@ -6790,7 +6815,7 @@ public:
     bool add_background(std::string directory, std::string filename, data_struct::Params_Override<T_real>& params)
     {
 
-        std::lock_guard<std::mutex> lock(_mutex);
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
 
         std::string fullname = directory + DIR_END_CHAR + "img.dat" + DIR_END_CHAR + filename;
         logI << fullname << "\n";
@@ -6845,7 +6870,7 @@ public:
         count[0] = dims_in[0];
         hid_t memoryspace_id = H5Screate_simple(1, dims_in, nullptr);
 
-        data_struct::ArrayTr<T_real>   buffer(count[0]);
+        data_struct::Spectra<T_real>   buffer(count[0]);
         fitting::models::Range energy_range = data_struct::get_energy_range(dims_in[0], &(params.fit_params));
 
         logI << params.fit_params.value(STR_ENERGY_OFFSET) << " " << params.fit_params.value(STR_ENERGY_SLOPE) << " " << params.fit_params.value(STR_ENERGY_QUADRATIC) << " " << 0.0f << " " << params.fit_params.value(STR_SNIP_WIDTH) << " " << energy_range.min << " " << energy_range.max << "\n ";
@@ -6861,7 +6886,7 @@ public:
                 hid_t error = _read_h5d<T_real>(mca_arr_id, memoryspace_id, mca_arr_space, H5P_DEFAULT, buffer.data());
                 if (error > -1)
                 {
-                    data_struct::ArrayTr<T_real> background = data_struct::snip_background<T_real>((data_struct::Spectra<T_real>*) & buffer, params.fit_params.value(STR_ENERGY_OFFSET), params.fit_params.value(STR_ENERGY_SLOPE), params.fit_params.value(STR_ENERGY_QUADRATIC), params.fit_params.value(STR_SNIP_WIDTH), energy_range.min, energy_range.max);
+                    data_struct::ArrayTr<T_real> background = data_struct::snip_background<T_real>(&buffer, params.fit_params.value(STR_ENERGY_OFFSET), params.fit_params.value(STR_ENERGY_SLOPE), params.fit_params.value(STR_ENERGY_QUADRATIC), params.fit_params.value(STR_SNIP_WIDTH), energy_range.min, energy_range.max);
                     error = _write_h5d<T_real>(back_arr_id, memoryspace_id, mca_arr_space, H5P_DEFAULT, background.data());
                     if (error < 0)
                     {
@@ -6879,14 +6904,16 @@ public:
 
     //-----------------------------------------------------------------------------
 
-private:
+protected:
 
     HDF5_IO();
 
-    static HDF5_IO *_this_inst;
+    // the serial HDF5 build is not thread safe, every instance shares this lock around its library calls
+    static std::recursive_mutex _mutex;
 
-    //static std::mutex _mutex;
-    std::mutex _mutex;
+private:
+
+    static HDF5_IO *_this_inst;
 
     //-----------------------------------------------------------------------------
 
@@ -7507,20 +7534,21 @@ private:
     bool _open_h5_object(hid_t &id, H5_OBJECTS obj, std::stack<std::pair<hid_t, H5_OBJECTS> > &close_map, std::string s1, hid_t id2, bool log_error=true, bool close_on_fail=true);
     bool _open_or_create_group(const std::string name, hid_t parent_id, hid_t& out_id, bool log_error = true, bool close_on_fail = true);
     bool _create_memory_space(int rank, const hsize_t* count, hid_t& out_id);
-    bool _open_h5_dataset(const std::string& name, hid_t data_type, hid_t parent_id, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims, hid_t& out_id, hid_t& out_dataspece);
+    // cache_bytes > 0 sets the dataset's chunk cache, otherwise the library default (1MB) is used
+    bool _open_h5_dataset(const std::string& name, hid_t data_type, hid_t parent_id, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims, hid_t& out_id, hid_t& out_dataspece, size_t cache_bytes = 0);
 
     //-----------------------------------------------------------------------------
 
     template<typename T_real>
-    bool _open_h5_dataset(const std::string& name, hid_t parent_id, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims, hid_t& out_id, hid_t& out_dataspece)
+    bool _open_h5_dataset(const std::string& name, hid_t parent_id, int dims_size, const hsize_t* dims, const hsize_t* chunk_dims, hid_t& out_id, hid_t& out_dataspece, size_t cache_bytes = 0)
     {
         if (std::is_same<T_real, float>::value)
         {
-            return _open_h5_dataset(name, H5T_INTEL_F32, parent_id, dims_size, dims, chunk_dims, out_id, out_dataspece);
+            return _open_h5_dataset(name, H5T_INTEL_F32, parent_id, dims_size, dims, chunk_dims, out_id, out_dataspece, cache_bytes);
         }
         else if (std::is_same<T_real, double>::value)
         {
-            return _open_h5_dataset(name, H5T_INTEL_F64, parent_id, dims_size, dims, chunk_dims, out_id, out_dataspece);
+            return _open_h5_dataset(name, H5T_INTEL_F64, parent_id, dims_size, dims, chunk_dims, out_id, out_dataspece, cache_bytes);
         }
         return false;
     }
@@ -7544,7 +7572,32 @@ private:
         }
         return -1;
     }
-    
+
+    //-----------------------------------------------------------------------------
+
+    /**
+     * @brief _read_h5d_block : read one hyperslab (offset, count) of a dataset into a contiguous buffer
+     *  with a single H5Dread. Used to pull a whole row or image of per-pixel scalers at once.
+     *  The memory space has the same shape as the selection so hdf5 can copy it in runs instead of
+     *  element by element.
+     */
+    template<typename T_real>
+    herr_t _read_h5d_block(hid_t dset_id, hid_t file_space_id, int rank, const hsize_t* offset, const hsize_t* count, T_real* buf)
+    {
+        hid_t mem_space_id = H5Screate_simple(rank, count, nullptr);
+        if (mem_space_id < 0)
+        {
+            return -1;
+        }
+        herr_t error = H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+        if (error > -1)
+        {
+            error = _read_h5d<T_real>(dset_id, mem_space_id, file_space_id, H5P_DEFAULT, (void*)buf);
+        }
+        H5Sclose(mem_space_id);
+        return error;
+    }
+
     //-----------------------------------------------------------------------------
 
     template<typename T_real>
@@ -7563,8 +7616,11 @@ private:
 
     //-----------------------------------------------------------------------------
 
+protected:
+
     hid_t _cur_file_id;
     std::string _cur_filename;
+    H5_Layout_Policy _layout_policy;
     std::stack<std::pair<hid_t, H5_OBJECTS> > _global_close_map;
 
 };
@@ -0,0 +1,262 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#include "hdf5_layout.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace io
+{
+namespace file
+{
+
+// lz4 / zstd become shuffle-deflate at this level when their hdf5 plugin is not loaded, in parse and again when the
+// dataset is created
+static const int MISSING_PLUGIN_LEVEL = 4;
+
+//-----------------------------------------------------------------------------
+
+static bool plugin_missing(H5_Filter filter)
+{
+    return (filter == H5_Filter::LZ4 && H5Zfilter_avail(H5Z_FILTER_LZ4_ID) <= 0)
+        || (filter == H5_Filter::ZSTD && H5Zfilter_avail(H5Z_FILTER_ZSTD_ID) <= 0);
+}
+
+//-----------------------------------------------------------------------------
+
+H5_Layout_Policy::H5_Layout_Policy()
+{
+    // built in filters only so any hdf5 reader can open the file. deflate 7 takes several times longer for a few % size
+    filter = H5_Filter::SHUFFLE_DEFLATE;
+    level = 4;
+    spectra_chunk_bytes = 256 * 1024;
+    image_chunk_bytes = 4 * 1024 * 1024;
+}
+
+//-----------------------------------------------------------------------------
+
+bool H5_Layout_Policy::parse(const std::string& str)
+{
+    std::string name = str.substr(0, str.find(':'));
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    int new_level = -1;
+    if (str.find(':') != std::string::npos)
+    {
+        const std::string level_str = str.substr(str.find(':') + 1);
+        if (level_str.empty() || level_str.find_first_not_of("0123456789") != std::string::npos)
+        {
+            return false;
+        }
+        new_level = std::stoi(level_str);
+    }
+
+    H5_Filter new_filter;
+    if (name == "none")
+    {
+        new_filter = H5_Filter::NONE;
+    }
+    else if (name == "deflate" || name == "shuffle-deflate")
+    {
+        new_filter = (name == "deflate") ? H5_Filter::DEFLATE : H5_Filter::SHUFFLE_DEFLATE;
+        if (new_level < 0)
+        {
+            new_level = 7;
+        }
+        if (new_level > 9)
+        {
+            return false;
+        }
+    }
+    else if (name == "lz4" || name == "zstd")
+    {
+        const bool is_zstd = (name == "zstd");
+        new_filter = is_zstd ? H5_Filter::ZSTD : H5_Filter::LZ4;
+        // the lz4 filter has no level, its only parameter is the block size
+        if (false == is_zstd && new_level > -1)
+        {
+            logW << "lz4 does not take a compression level, use lz4 without :" << new_level << "\n";
+            return false;
+        }
+        if (new_level < 0)
+        {
+            new_level = 3;
+        }
+        if (is_zstd && (new_level < 1 || new_level > 22))
+        {
+            return false;
+        }
+        if (plugin_missing(new_filter))
+        {
+            new_filter = H5_Filter::SHUFFLE_DEFLATE;
+            new_level = MISSING_PLUGIN_LEVEL;
+            logW << name << " hdf5 filter plugin not found, check HDF5_PLUGIN_PATH. Using shuffle-deflate:" << MISSING_PLUGIN_LEVEL << "\n";
+        }
+    }
+    else
+    {
+        return false;
+    }
+
+    filter = new_filter;
+    level = std::max(new_level, 0);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+std::string H5_Layout_Policy::to_string() const
+{
+    switch (filter)
+    {
+    case H5_Filter::NONE:
+        return "none";
+    case H5_Filter::DEFLATE:
+        return "deflate:" + std::to_string(level);
+    case H5_Filter::SHUFFLE_DEFLATE:
+        return "shuffle-deflate:" + std::to_string(level);
+    case H5_Filter::LZ4:
+        return "lz4";
+    case H5_Filter::ZSTD:
+        return "zstd:" + std::to_string(level);
+    }
+    return "";
+}
+
+//-----------------------------------------------------------------------------
+
+bool H5_Layout_Policy::apply_filter(hid_t dcpl_id) const
+{
+    // a policy set in code can skip parse, or the plugin can go away before the file is written
+    H5_Filter use_filter = filter;
+    int use_level = level;
+    if (plugin_missing(filter))
+    {
+        use_filter = H5_Filter::SHUFFLE_DEFLATE;
+        use_level = MISSING_PLUGIN_LEVEL;
+    }
+
+    switch (use_filter)
+    {
+    case H5_Filter::NONE:
+        return true;
+    case H5_Filter::DEFLATE:
+        return H5Pset_deflate(dcpl_id, std::min(use_level, 9)) > -1;
+    case H5_Filter::SHUFFLE_DEFLATE:
+        return H5Pset_shuffle(dcpl_id) > -1 && H5Pset_deflate(dcpl_id, std::min(use_level, 9)) > -1;
+    case H5_Filter::LZ4:
+        return H5Pset_filter(dcpl_id, H5Z_FILTER_LZ4_ID, H5Z_FLAG_OPTIONAL, 0, nullptr) > -1;
+    case H5_Filter::ZSTD:
+    {
+        const unsigned int cd_values[1] = { (unsigned int)level };
+        return H5Pset_filter(dcpl_id, H5Z_FILTER_ZSTD_ID, H5Z_FLAG_OPTIONAL, 1, cd_values) > -1;
+    }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+
+void H5_Layout_Policy::spectra_chunk(const hsize_t* const dims, size_t type_size, hsize_t* chunk) const
+{
+    const hsize_t samples = std::max(dims[0], (hsize_t)1);
+    const hsize_t rows = std::max(dims[1], (hsize_t)1);
+    const hsize_t cols = std::max(dims[2], (hsize_t)1);
+    const size_t spectrum_bytes = samples * type_size;
+    const size_t row_bytes = spectrum_bytes * cols;
+
+    chunk[0] = samples;
+    if (row_bytes <= spectra_chunk_bytes)
+    {
+        chunk[1] = std::min(std::max((hsize_t)(spectra_chunk_bytes / row_bytes), (hsize_t)1), rows);
+        chunk[2] = cols;
+    }
+    else
+    {
+        chunk[1] = 1;
+        chunk[2] = std::min(std::max((hsize_t)(spectra_chunk_bytes / spectrum_bytes), (hsize_t)1), cols);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+void H5_Layout_Policy::image_chunk(int rank, const hsize_t* const dims, size_t type_size, hsize_t* chunk) const
+{
+    for (int i = 0; i < rank; i++)
+    {
+        chunk[i] = std::max(dims[i], (hsize_t)1);
+    }
+    if (rank < 2)
+    {
+        return;
+    }
+
+    const int row_dim = rank - 2;
+    for (int i = 0; i < row_dim; i++)
+    {
+        chunk[i] = 1;
+    }
+    const size_t row_bytes = chunk[row_dim + 1] * type_size;
+    if (chunk[row_dim] * row_bytes > image_chunk_bytes)
+    {
+        chunk[row_dim] = std::max((hsize_t)(image_chunk_bytes / row_bytes), (hsize_t)1);
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+size_t H5_Layout_Policy::spectra_cache_bytes(const hsize_t* const dims, const hsize_t* const chunk, size_t type_size) const
+{
+    const hsize_t tiles = (std::max(dims[2], (hsize_t)1) + chunk[2] - 1) / chunk[2];
+    // never less than the library default of 1MB
+    return std::max((size_t)(chunk[0] * chunk[1] * chunk[2] * tiles * type_size), (size_t)(1024 * 1024));
+}
+
+//-----------------------------------------------------------------------------
+
+}// end namespace file
+}// end namespace io
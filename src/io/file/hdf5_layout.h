@@ -0,0 +1,128 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef HDF5_Layout_H
+#define HDF5_Layout_H
+
+#include <string>
+
+#include "hdf5.h"
+#include "core/defines.h"
+
+namespace io
+{
+namespace file
+{
+
+// third party filters from the HDF Group registry, used when their plugin can be loaded
+#define H5Z_FILTER_LZ4_ID 32004
+#define H5Z_FILTER_ZSTD_ID 32015
+
+enum class H5_Filter { NONE, DEFLATE, SHUFFLE_DEFLATE, LZ4, ZSTD };
+
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief The H5_Layout_Policy class : Chunk shapes and compression for datasets in analyzed files, picked by how
+ *        they are read back. mca_arr is read a spectrum or a block of rows at a time, so its chunks hold whole spectra
+ *        for a block of rows. Element maps are read an image at a time, so Counts_Per_Sec gets one chunk per image
+ *        (tiled by rows when an image is bigger than image_chunk_bytes).
+ */
+class DLL_EXPORT H5_Layout_Policy
+{
+public:
+
+    H5_Layout_Policy();
+
+    /**
+     * @brief parse : filter[:level] with filter one of none, deflate, shuffle-deflate, lz4, zstd. ex shuffle-deflate:4
+     *                lz4 takes no level.
+     * @return false and leaves the policy as is if str can not be parsed
+     */
+    bool parse(const std::string& str);
+
+    std::string to_string() const;
+
+    /**
+     * @brief apply_filter : Add the compression filter to a dataset creation property list. lz4 and zstd fall back to
+     *                       shuffle-deflate:4 if their plugin is not available.
+     */
+    bool apply_filter(hid_t dcpl_id) const;
+
+    /**
+     * @brief spectra_chunk : chunk for a [samples, rows, cols] volume : whole spectra for as many full rows as fit in
+     *                        spectra_chunk_bytes, a row bigger than that is split into column tiles.
+     */
+    void spectra_chunk(const hsize_t* const dims, size_t type_size, hsize_t* chunk) const;
+
+    /**
+     * @brief image_chunk : chunk for a stack of images [.., rows, cols] (rank 2 or 3) : one image per chunk, split
+     *                      into blocks of rows if it is bigger than image_chunk_bytes.
+     */
+    void image_chunk(int rank, const hsize_t* const dims, size_t type_size, hsize_t* chunk) const;
+
+    /**
+     * @brief spectra_cache_bytes : chunk cache that holds every chunk of one block of rows, so writing the volume
+     *                              pixel by pixel does not recompress a chunk per pixel.
+     */
+    size_t spectra_cache_bytes(const hsize_t* const dims, const hsize_t* const chunk, size_t type_size) const;
+
+    H5_Filter filter;
+
+    int level;
+
+    size_t spectra_chunk_bytes;
+
+    size_t image_chunk_bytes;
+
+};
+
+//-----------------------------------------------------------------------------
+
+}// end namespace file
+}// end namespace io
+
+#endif // HDF5_Layout_H
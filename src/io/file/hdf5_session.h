@@ -0,0 +1,103 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef H5_Session_H
+#define H5_Session_H
+
+#include <string>
+
+#include "io/file/hdf5_io.h"
+
+namespace io
+{
+namespace file
+{
+
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief The H5_Session class : One open analyzed file with its own handles, for saving several files at once.
+ *        Carries every HDF5_IO save/load function, only the HDF5 library lock is shared with the other instances.
+ *        Starts with the layout policy HDF5_IO::inst() has when it is made, the file is closed when it goes away.
+ */
+class DLL_EXPORT H5_Session : public HDF5_IO
+{
+public:
+
+    H5_Session(const std::string& filename);
+
+    ~H5_Session();
+
+    H5_Session(const H5_Session&) = delete;
+
+    H5_Session& operator=(const H5_Session&) = delete;
+
+    /**
+     * @brief open : start_save_seq() on this session's file.
+     */
+    bool open(bool force_new_file=false, bool open_file_only=false);
+
+    /**
+     * @brief close : end_save_seq() if the file is open. The file name is kept so the session can be opened again.
+     */
+    bool close(bool loginfo=true);
+
+    bool is_open() const { return _cur_file_id > -1; }
+
+    const std::string& filename() const { return _filename; }
+
+private:
+
+    std::string _filename;
+
+};
+
+//-----------------------------------------------------------------------------
+
+}// end namespace file
+}// end namespace io
+
+#endif // H5_Session_H
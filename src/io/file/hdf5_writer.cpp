@@ -0,0 +1,243 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#include "hdf5_writer.h"
+
+#include <algorithm>
+
+namespace io
+{
+namespace file
+{
+
+// a few routines worth of counts, plus the energy calibration, mca_arr and closing the file
+#define DEFAULT_MAX_QUEUED_WRITES 8
+
+HDF5_Writer* HDF5_Writer::_this_inst(nullptr);
+
+std::mutex HDF5_Writer::_inst_mutex;
+
+//-----------------------------------------------------------------------------
+
+HDF5_Writer::HDF5_Writer()
+{
+    _max_queued = DEFAULT_MAX_QUEUED_WRITES;
+    _busy = false;
+    _stop = false;
+    _failed = 0;
+    _thread = std::thread(&HDF5_Writer::_run, this);
+}
+
+//-----------------------------------------------------------------------------
+
+HDF5_Writer* HDF5_Writer::inst()
+{
+    std::lock_guard<std::mutex> lock(_inst_mutex);
+
+    if (_this_inst == nullptr)
+    {
+        _this_inst = new HDF5_Writer();
+    }
+    return _this_inst;
+}
+
+//-----------------------------------------------------------------------------
+
+HDF5_Writer::~HDF5_Writer()
+{
+    shutdown();
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_Writer::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cond_queued.notify_all();
+    // the thread drains the queue before it exits
+    if (_thread.joinable() && false == on_writer_thread())
+    {
+        _thread.join();
+    }
+    return flush();
+}
+
+//-----------------------------------------------------------------------------
+
+void HDF5_Writer::set_max_queued(size_t max_queued)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _max_queued = std::max(max_queued, (size_t)1);
+}
+
+//-----------------------------------------------------------------------------
+
+std::future<bool> HDF5_Writer::enqueue(const std::string& name, std::function<bool()> command)
+{
+    std::packaged_task<bool()> task([this, name, command]() { return _run_command(name, command); });
+    std::future<bool> result = task.get_future();
+
+    if (on_writer_thread())
+    {
+        // queueing from inside a command would wait on itself, the writes are still in order if it runs now
+        task();
+        return result;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_stop)
+        {
+            // shut down, no thread left to run it. Let the queue drain first so the writes stay in order
+            _cond_done.wait(lock, [this] { return _queue.empty() && false == _busy; });
+            lock.unlock();
+            task();
+            return result;
+        }
+        _cond_done.wait(lock, [this] { return _queue.size() < _max_queued; });
+        _queue.push_back(std::move(task));
+    }
+    _cond_queued.notify_one();
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+
+void HDF5_Writer::wait_idle()
+{
+    if (on_writer_thread())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cond_done.wait(lock, [this] { return _queue.empty() && false == _busy; });
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_Writer::flush()
+{
+    wait_idle();
+
+    size_t failed = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        failed = _failed;
+        _failed = 0;
+    }
+    if (failed > 0)
+    {
+        logE << failed << " queued hdf5 write(s) failed, see above.\n";
+        return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool HDF5_Writer::_run_command(const std::string& name, const std::function<bool()>& command)
+{
+    bool ret = false;
+    try
+    {
+        ret = command();
+    }
+    catch (std::exception& e)
+    {
+        logE << name << " : " << e.what() << "\n";
+    }
+    catch (...)
+    {
+        // anything else would end the writer thread in std::terminate
+        logE << name << " : unknown exception\n";
+    }
+    if (false == ret)
+    {
+        logE << "Failed to write " << name << "\n";
+        std::lock_guard<std::mutex> lock(_mutex);
+        _failed++;
+    }
+    return ret;
+}
+
+//-----------------------------------------------------------------------------
+
+void HDF5_Writer::_run()
+{
+    while (true)
+    {
+        std::packaged_task<bool()> task;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cond_queued.wait(lock, [this] { return _stop || false == _queue.empty(); });
+            if (_queue.empty())
+            {
+                return;
+            }
+            task = std::move(_queue.front());
+            _queue.pop_front();
+            _busy = true;
+        }
+        // a slot opened up for a blocked enqueue
+        _cond_done.notify_all();
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _busy = false;
+        }
+        _cond_done.notify_all();
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+}// end namespace file
+}// end namespace io
@@ -0,0 +1,157 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+
+#ifndef HDF5_Writer_H
+#define HDF5_Writer_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "core/defines.h"
+
+namespace io
+{
+namespace file
+{
+
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief The HDF5_Writer class : A single background thread that runs queued HDF5 writes in order, so saving a
+ *        finished result does not hold up fitting the next one. Commands run after the caller has moved on and have
+ *        to own (or outlive) the data they write. The queue is bounded, enqueue() blocks while it is full so finished
+ *        results can not pile up in memory.
+ *        Only the analyzed result saves (counts, integrated spectra, energy calibration, mca_arr, closing the file) go
+ *        through here. Loading the next dataset, scaler / quantification saves and the h5 update tools still call HDF5
+ *        on their own thread, so the writer does not own every handle. HDF5_IO's recursive mutex keeps those calls
+ *        from interleaving with a queued write. Loads stay off the queue so the next file can be read while the last
+ *        one is still being written.
+ */
+class DLL_EXPORT HDF5_Writer
+{
+public:
+
+    static HDF5_Writer* inst();
+
+    // shutdown()
+    ~HDF5_Writer();
+
+    /**
+     * @brief shutdown : Run everything still queued, join the writer thread and report failed writes like flush().
+     *                   Call it on the program's exit path, the singleton is never deleted. Writes enqueued after
+     *                   this run on the caller's thread.
+     * @return false if any write failed
+     */
+    bool shutdown();
+
+    /**
+     * @brief enqueue : Queue a write. name is used when reporting a failure. The command returns false (or throws)
+     *                  if the write failed.
+     * @return future holding the command's result
+     */
+    std::future<bool> enqueue(const std::string& name, std::function<bool()> command);
+
+    /**
+     * @brief wait_idle : Block until every queued command has run. Does nothing on the writer thread.
+     */
+    void wait_idle();
+
+    /**
+     * @brief flush : wait_idle() then report the writes that failed since the last flush.
+     * @return false if any write failed
+     */
+    bool flush();
+
+    bool on_writer_thread() const { return std::this_thread::get_id() == _thread.get_id(); }
+
+    void set_max_queued(size_t max_queued);
+
+    size_t max_queued() const { return _max_queued; }
+
+private:
+
+    HDF5_Writer();
+
+    void _run();
+
+    bool _run_command(const std::string& name, const std::function<bool()>& command);
+
+    static HDF5_Writer *_this_inst;
+
+    static std::mutex _inst_mutex;
+
+    std::thread _thread;
+
+    std::mutex _mutex;
+
+    std::condition_variable _cond_queued;
+
+    std::condition_variable _cond_done;
+
+    std::deque<std::packaged_task<bool()> > _queue;
+
+    size_t _max_queued;
+
+    // a command is popped before it runs, idle means empty queue and nothing running
+    bool _busy;
+
+    bool _stop;
+
+    size_t _failed;
+
+};
+
+//-----------------------------------------------------------------------------
+
+}// end namespace file
+}// end namespace io
+
+#endif // HDF5_Writer_H
@@ -253,10 +253,10 @@ void save_optimized_fit_params(std::string dataset_dir, std::string dataset_file
     fitting::models::Gaussian_Model<double> model;
     //Range of energy in spectra to fit
     fitting::models::Range energy_range = data_struct::get_energy_range(spectra->size(), fit_params);
-    data_struct::Spectra<double> snip_spectra = spectra->sub_spectra(energy_range.min, energy_range.count());
+    data_struct::ArrayTr<double> snip_spectra = spectra->sub_spectra(energy_range.min, energy_range.count());
 
     unordered_map<string, ArrayTr<double>> labeled_spectras;
-    data_struct::Spectra<double> model_spectra = model.model_spectrum(fit_params, elements_to_fit, &labeled_spectras, energy_range);
+    data_struct::ArrayTr<double> model_spectra = model.model_spectrum(fit_params, elements_to_fit, &labeled_spectras, energy_range);
     
     data_struct::ArrayTr<double> background;
 
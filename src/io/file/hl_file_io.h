@@ -233,6 +233,9 @@ DLL_EXPORT bool load_override_params(std::string dataset_directory,
             logit_s << itr.first << " ";
         }
         logit_s << "\n";
+
+        // calibration and snip width may have changed, drop background schedules built for the old values
+        data_struct::Snip_Schedule_Cache<T_real>::inst()->clear();
     }
 
     return true;
@@ -273,7 +276,9 @@ DLL_EXPORT bool init_analysis_job_detectors(data_struct::Analysis_Job<T_real>* a
 
         if (detector->model == nullptr)
         {
-            detector->model = new fitting::models::Gaussian_Model<T_real>();
+            fitting::models::Gaussian_Model<T_real>* model = new fitting::models::Gaussian_Model<T_real>();
+            model->set_window_tolerance(analysis_job->peak_window_tolerance);
+            detector->model = model;
         }
         data_struct::Params_Override<T_real>* override_params = &(detector->fit_params_override_dict);
 
@@ -307,6 +312,10 @@ DLL_EXPORT bool init_analysis_job_detectors(data_struct::Analysis_Job<T_real>* a
         {
             //Fitting models
             detector->fit_routines[proc_type] = generate_fit_routine(proc_type, analysis_job->optimizer());
+            if (detector->fit_routines[proc_type] != nullptr)
+            {
+                detector->fit_routines[proc_type]->set_neighbor_warm_start(analysis_job->neighbor_warm_start);
+            }
 
             //reset model fit parameters to defaults
             detector->model->reset_to_default_fit_params();
@@ -668,8 +677,14 @@ DLL_EXPORT bool load_spectra_volume(std::string dataset_directory,
                          data_struct::Spectra_Volume<T_real>* spectra_volume,
                          data_struct::Params_Override<T_real>* params_override,
                          bool *is_loaded_from_analyazed_h5,
-                         bool save_scalers)
+                         bool save_scalers,
+                         io::file::HDF5_IO* h5_io = nullptr)
 {
+    // the analyzed file is opened on h5_io, callers saving several datasets at once pass their own H5_Session
+    if (h5_io == nullptr)
+    {
+        h5_io = io::file::HDF5_IO::inst();
+    }
 
     //Dataset importer
     io::file::MDA_IO<T_real> mda_io;
@@ -814,11 +829,11 @@ DLL_EXPORT bool load_spectra_volume(std::string dataset_directory,
 
             spectra_volume->resize_and_zero(1, 1, spec.size());
             (*spectra_volume)[0][0] = spec;
-            io::file::HDF5_IO::inst()->start_save_seq(true);
+            h5_io->start_save_seq(true);
 
             // add ELT, ERT, INCNT, OUTCNT to scaler map
             spectra_volume->generate_scaler_maps(&(scan_info.scaler_maps));
-            io::file::HDF5_IO::inst()->save_scan_scalers(detector_num, &scan_info, params_override);
+            h5_io->save_scan_scalers(detector_num, &scan_info, params_override);
             return true;
         }
     }
@@ -846,11 +861,11 @@ DLL_EXPORT bool load_spectra_volume(std::string dataset_directory,
     }
     */
     //  try to load from a pre analyzed file because they should contain the whole mca_arr spectra volume
-    if (true == io::file::HDF5_IO::inst()->load_spectra_vol_analyzed_h5(fullpath, spectra_volume))
+    if (true == h5_io->load_spectra_vol_analyzed_h5(fullpath, spectra_volume))
     {
         logI << "Loaded spectra volume from h5.\n";
         *is_loaded_from_analyazed_h5 = true;
-        return io::file::HDF5_IO::inst()->start_save_seq(false);
+        return h5_io->start_save_seq(false);
     }
     else
     {
@@ -860,7 +875,7 @@ DLL_EXPORT bool load_spectra_volume(std::string dataset_directory,
     //try loading emd dataset if it ends in .emd
     if (dataset_file.rfind(".emd") == dataset_file.length() - 4)
     {
-        if (true == io::file::HDF5_IO::inst()->load_spectra_volume_emd(dataset_directory + DIR_END_CHAR + dataset_file, detector_num, spectra_volume))
+        if (true == h5_io->load_spectra_volume_emd(dataset_directory + DIR_END_CHAR + dataset_file, detector_num, spectra_volume))
         {
             //*is_loaded_from_analyazed_h5 = true;//test to not save volume
             std::string str_detector_num = "";
@@ -869,39 +884,39 @@ DLL_EXPORT bool load_spectra_volume(std::string dataset_directory,
                 str_detector_num = std::to_string(detector_num);
             }
             std::string full_save_path = dataset_directory + DIR_END_CHAR + "img.dat" + DIR_END_CHAR + dataset_file + "_frame_" + str_detector_num + ".h5";
-            io::file::HDF5_IO::inst()->start_save_seq(full_save_path, true);
+            h5_io->start_save_seq(full_save_path, true);
             return true;
         }
     }
 
     //try loading confocal dataset
-    if (true == io::file::HDF5_IO::inst()->load_spectra_volume_confocal(dataset_directory + DIR_END_CHAR + dataset_file, detector_num, spectra_volume, false))
+    if (true == h5_io->load_spectra_volume_confocal(dataset_directory + DIR_END_CHAR + dataset_file, detector_num, spectra_volume, false))
     {
         if (save_scalers)
         {
-            io::file::HDF5_IO::inst()->start_save_seq(true);
-            io::file::HDF5_IO::inst()->save_scan_scalers_confocal<T_real>(dataset_directory + DIR_END_CHAR + dataset_file, detector_num);
+            h5_io->start_save_seq(true);
+            h5_io->save_scan_scalers_confocal<T_real>(dataset_directory + DIR_END_CHAR + dataset_file, detector_num);
         }
         return true;
     }
 
     //try loading gse cars dataset
-    if (true == io::file::HDF5_IO::inst()->load_spectra_volume_gsecars<T_real>(dataset_directory + DIR_END_CHAR + dataset_file, detector_num, spectra_volume, false))
+    if (true == h5_io->load_spectra_volume_gsecars<T_real>(dataset_directory + DIR_END_CHAR + dataset_file, detector_num, spectra_volume, false))
     {
         if (save_scalers)
         {
-            io::file::HDF5_IO::inst()->start_save_seq(true);
-            io::file::HDF5_IO::inst()->save_scan_scalers_gsecars<T_real>(dataset_directory + DIR_END_CHAR + dataset_file, detector_num);
+            h5_io->start_save_seq(true);
+            h5_io->save_scan_scalers_gsecars<T_real>(dataset_directory + DIR_END_CHAR + dataset_file, detector_num);
         }
         return true;
     }
 
-    if (true == io::file::HDF5_IO::inst()->load_spectra_volume_bnl<T_real>(dataset_directory + DIR_END_CHAR + dataset_file, detector_num, spectra_volume, false))
+    if (true == h5_io->load_spectra_volume_bnl<T_real>(dataset_directory + DIR_END_CHAR + dataset_file, detector_num, spectra_volume, false))
     {
         if (save_scalers)
         {
-            io::file::HDF5_IO::inst()->start_save_seq(true);
-            io::file::HDF5_IO::inst()->save_scan_scalers_bnl<T_real>(dataset_directory + DIR_END_CHAR + dataset_file, detector_num);
+            h5_io->start_save_seq(true);
+            h5_io->save_scan_scalers_bnl<T_real>(dataset_directory + DIR_END_CHAR + dataset_file, detector_num);
         }
         return true;
     }
@@ -988,7 +1003,7 @@ DLL_EXPORT bool load_spectra_volume(std::string dataset_directory,
         }
         else if (hasHdf)
         {
-            io::file::HDF5_IO::inst()->load_spectra_volume(dataset_directory + "flyXRF.h5" + DIR_END_CHAR + tmp_dataset_file + file_middle + "0.h5", detector_num, spectra_volume);
+            h5_io->load_spectra_volume(dataset_directory + "flyXRF.h5" + DIR_END_CHAR + tmp_dataset_file + file_middle + "0.h5", detector_num, spectra_volume);
         }
         else if (hasXspress)
         {
@@ -996,7 +1011,7 @@ DLL_EXPORT bool load_spectra_volume(std::string dataset_directory,
             for (size_t i = 0; i < spectra_volume->rows(); i++)
             {
                 full_filename = dataset_directory + "flyXspress" + DIR_END_CHAR + tmp_dataset_file + file_middle + std::to_string(i) + ".h5";
-                io::file::HDF5_IO::inst()->load_spectra_line_xspress3(full_filename, detector_num, &(*spectra_volume)[i]);
+                h5_io->load_spectra_line_xspress3(full_filename, detector_num, &(*spectra_volume)[i]);
             }
         }
 
@@ -1004,7 +1019,7 @@ DLL_EXPORT bool load_spectra_volume(std::string dataset_directory,
 
     if (save_scalers)
     {
-        io::file::HDF5_IO::inst()->start_save_seq(true);
+        h5_io->start_save_seq(true);
         data_struct::Scan_Info<T_real>* scan_info = mda_io.get_scan_info();
         // add ELT, ERT, INCNT, OUTCNT to scaler map
         if (spectra_volume != nullptr && scan_info != nullptr)
@@ -1023,7 +1038,7 @@ DLL_EXPORT bool load_spectra_volume(std::string dataset_directory,
                 }
             }
         }
-        io::file::HDF5_IO::inst()->save_scan_scalers(detector_num, scan_info, params_override);
+        h5_io->save_scan_scalers(detector_num, scan_info, params_override);
     }
 
     mda_io.unload();
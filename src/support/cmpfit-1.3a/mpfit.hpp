@@ -498,6 +498,9 @@ int mp_fdjac2(int (*mp_func)(int m, int n, _T *x, _T *fvec, _T **dvec, void *pri
     /* Skip parameters already done by user-computed partials */
     if (dside && dsidei == 3) continue;
 
+    /* Column j of fjac, the skip above must not shift later columns */
+    ij = j*m;
+
     temp = x[ifree[j]];
     h = eps * fabs(temp);
     if (step  &&  step[ifree[j]] > 0) h = step[ifree[j]];
@@ -741,7 +741,10 @@ template <typename _T>
 void lmmin(const int n, _T* x, const int m, const void* data,
            void (*evaluate)(const _T* par, const int m_dat,
                             const void* data, _T* fvec, int* userbreak),
-           const lm_control_struct<_T>* C, lm_status_struct<_T>* S)
+           const lm_control_struct<_T>* C, lm_status_struct<_T>* S,
+           void (*jacobian)(const _T* par, const int m_dat, const int n_par,
+                            const void* data, _T* fjac, int* analytic,
+                            int* userbreak) = nullptr)
 /*
  *   This routine contains the core algorithm of our library.
  *
@@ -773,6 +776,17 @@ void lmmin(const int n, _T* x, const int m, const void* data,
  *          userbreak is an integer pointer. When *userbreak is set to a
  *            nonzero value, lmmin will terminate.
  *
+ *      jacobian is an optional user-supplied function that fills columns
+ *        of the Jacobian analytically (XRF-Maps addition).
+ *        Parameters:
+ *          n_par, par, m_dat, data as above.
+ *          fjac is an array of length m*n; column j starts at fjac[j*m].
+ *          analytic is an array of length n, all zero on INPUT; set
+ *            analytic[j] to 1 for every column j that was filled. The
+ *            remaining columns use the forward-difference approximation.
+ *          userbreak as above.
+ *        Pass nullptr to get the original behavior.
+ *
  *      control contains INPUT variables that control the fit algorithm,
  *        as declared and explained in lmstruct.h
  *
@@ -863,7 +877,7 @@ void lmmin(const int n, _T* x, const int m, const void* data,
 
     /* Allocate total workspace with just one system call */
     char* ws;
-    if ((ws = (char*)malloc((2*m + 5*n + m*n) * sizeof(_T) + n * sizeof(int))) == NULL)
+    if ((ws = (char*)malloc((2*m + 5*n + m*n) * sizeof(_T) + 2 * n * sizeof(int))) == NULL)
     {
         S->outcome = 9;
         return;
@@ -889,6 +903,8 @@ void lmmin(const int n, _T* x, const int m, const void* data,
     pws += m * sizeof(_T) / sizeof(char);
     int* Pivot = (int*)pws;
     pws += n * sizeof(int) / sizeof(char);
+    int* Analytic = (int*)pws;
+    pws += n * sizeof(int) / sizeof(char);
 
     /* Initialize diag. */
     if (!C->scale_diag)
@@ -925,7 +941,17 @@ void lmmin(const int n, _T* x, const int m, const void* data,
     for (int outer = 0;; ++outer) {
 
         /** Calculate the Jacobian. **/
+        for (j = 0; j < n; j++)
+            Analytic[j] = 0;
+        if (jacobian) {
+            (*jacobian)(x, m, n, data, fjac, Analytic, &(S->userbreak));
+            ++(S->nfev);
+            if (S->userbreak)
+                goto terminate;
+        }
         for (j = 0; j < n; j++) {
+            if (Analytic[j])
+                continue;
             temp = x[j];
             step = MAX(eps * eps, eps * std::fabs(temp));
             x[j] += step; /* replace temporarily */
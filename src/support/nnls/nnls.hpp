@@ -25,6 +25,8 @@
 // Argonne National Lab
 // Dec 2017 : Modified to make it template class and use Eigen data structures
 #include <Eigen/Core>
+#include <vector>
+#include <algorithm>
 
 namespace nsNNLS 
 {
@@ -47,20 +49,28 @@ namespace nsNNLS
 			this->b = b;
 			this->maxit = maxit; 
 			this->x0 = nullptr;
+			this->gram = nullptr;
+			this->atb = nullptr;
+			this->btb = 0.0;
 			out.iter = -1;
-			fset = 0;
+			fssize = 0;
 			// convergence controlling parameters
 			M = 100;
 			beta = 1.0;
+			init_beta = 1.0;
 			decay = 0.9;
 			pgtol = 1e-3;
 			sigma = .01;
 		}
 
-        nnls(Eigen::Matrix<_T, Eigen::Dynamic, Eigen::Dynamic> *A, TArrayXr *b, TArrayXr* x0, int maxit)
+        nnls(const Eigen::Matrix<_T, Eigen::Dynamic, Eigen::Dynamic> *gram, const TArrayXr *atb, _T btb, int maxit) : nnls(nullptr, nullptr, maxit)
+		{
+			setGramData(gram, atb, btb);
+		}
+
+        nnls(Eigen::Matrix<_T, Eigen::Dynamic, Eigen::Dynamic> *A, TArrayXr *b, const TArrayXr* x0, int maxit) : nnls(A, b, maxit)
 		{
-			nnls(A, b, maxit);
-			this->x0 = x0; 
+			this->x0 = x0;
 		}
 
 		~nnls()
@@ -75,18 +85,23 @@ namespace nsNNLS
 		_T getObj() { return out.obj[out.iter - 1]; }
 		_T getPgTol() const { return pgtol; }
         TArrayXr* getSolution() { return &x; }
-		size_t* getFset() { return fset; }
+		size_t* getFset() { return fset.data(); }
 		size_t getMaxit() const { return maxit; }
 		_T getSigma() const { return sigma; }
 
 		void setDecay(_T d) { decay = d; }
 		void setM(int m) { M = m; }
-		void setBeta(_T b) { beta = b; }
+		void setBeta(_T b) { beta = b; init_beta = b; }
 		void setPgTol(_T pg) { pgtol = pg; }
 		void setMaxit(size_t m) { maxit = m; }
 		void setSigma(_T s) { sigma = s; }
 
-        void setData(Eigen::Matrix<_T, Eigen::Dynamic, Eigen::Dynamic>* A, TArrayXr* b) { this->A = A; this->b = b; }
+        void setData(Eigen::Matrix<_T, Eigen::Dynamic, Eigen::Dynamic>* A, TArrayXr* b) { this->A = A; this->b = b; this->gram = nullptr; }
+
+		// Solve in the A.cols() sized space: gram = A'A, atb = A'b, btb = b'b. gram can be shared by many right hand sides
+		void setGramData(const Eigen::Matrix<_T, Eigen::Dynamic, Eigen::Dynamic>* gram, const TArrayXr* atb, _T btb) { this->gram = gram; this->atb = atb; this->btb = btb; }
+		// Start the next optimize() from x0 instead of .5, ignored if the size does not match. nullptr for a cold start
+		void setX0(const TArrayXr* x0) { this->x0 = x0; }
 
 		// The functions that actually launch the ship, and land it!
 		void optimize(int &num_itr, _T& npg)
@@ -130,7 +145,7 @@ namespace nsNNLS
     // The variables used during compute time
 	private:                      
         TArrayXr x;                  // The solution -- also current iterate
-        TArrayXr* x0;                 // Starting value
+        const TArrayXr* x0;           // Starting value
         TArrayXr oldx;               // Previous iterate
         TArrayXr gradient;                  // Current gradient
         TArrayXr oldg;               // Previous gradient
@@ -142,7 +157,10 @@ namespace nsNNLS
 		Eigen::Matrix<_T, Eigen::Dynamic, Eigen::Dynamic> *A;
         TArrayXr *b;
         TArrayXr ax;                 // vector to hold A*x
-		size_t* fset;               // fixed set 
+		const Eigen::Matrix<_T, Eigen::Dynamic, Eigen::Dynamic> *gram; // A'A when solving from normal equations
+		const TArrayXr *atb;         // A'b
+		_T btb;                      // b'b
+		std::vector<size_t> fset;   // fixed set 
 		size_t fssize;              // sizeof fixed set
 
 		// The parameters of the solver
@@ -150,6 +168,7 @@ namespace nsNNLS
 		int   M;                    // max num. of null iterations
 		_T decay;               // parameter to make diminishing scalar to decay by
 		_T beta;                // diminishing scalar
+		_T init_beta;           // beta at the start of optimize()
 		_T pgtol;               // projected gradient tolerance
 		_T sigma;               // constant for descent condition
 
@@ -165,7 +184,10 @@ namespace nsNNLS
 		// The helper functions used by the solver                      
 		int initialize()
 		{
-			size_t n = A->cols();
+			size_t n = (gram != nullptr) ? gram->cols() : A->cols();
+			out.iter = -1;
+			beta = init_beta;
+			fssize = 0;
 			x.resize(n);
 			gradient.resize(n);
 			refx.resize(n);
@@ -178,9 +200,12 @@ namespace nsNNLS
 			xdelta.resize(n);
 			gdelta.resize(n);
 			
-			ax.resize(A->rows());
+			if (gram == nullptr)
+			{
+				ax.resize(A->rows());
+			}
 
-			fset = (size_t*) malloc(sizeof(size_t)*n);
+			fset.assign(n, 0);
 
 			x.setConstant(.5);
 
@@ -189,13 +214,15 @@ namespace nsNNLS
 			out.pgnorms.resize(maxit+1);
 			out.pgnorms.setZero();
 
-			if (x0) 
+			if (x0 != nullptr && (size_t)x0->size() == n)
 			{
-				oldg.setZero();
 				x = (*x0);
-				ax = (*A) * x.matrix();
-				ax -= (*b);
-				gradient = A->transpose() * ax.matrix();
+			}
+			// oldx = 0 so the first BB step is measured from the origin for a warm start too
+			if (gram != nullptr)
+			{
+				// Initial gradient = A'A*0 - A'b, since x0 = 0
+				oldg = -(*atb);
 			}
 			else
 			{
@@ -205,9 +232,16 @@ namespace nsNNLS
 			}
 
 			// old gradient = A'*(ax - b)
-			ax = (*A) * x.matrix();
-			ax -= (*b);
-			gradient = A->transpose() * ax.matrix();
+			if (gram != nullptr)
+			{
+				gradient = ((*gram) * x.matrix()).array() - (*atb);
+			}
+			else
+			{
+				ax = (*A) * x.matrix();
+				ax -= (*b);
+				gradient = A->transpose() * ax.matrix();
+			}
 
 			// Set the reference iterations
 			refx = x;
@@ -234,10 +268,10 @@ namespace nsNNLS
 
 		void findFixedVariables()
 		{
-			size_t n = A->cols();
+			size_t n = x.size();
 
 			// Clean out fixed set first
-			memset(fset, 0, sizeof(size_t)*n);
+			std::fill(fset.begin(), fset.end(), 0);
 			fssize = 0;
 
 			for (size_t i = 0; i < n; i++)
@@ -251,7 +285,7 @@ namespace nsNNLS
 
 		void computeXandGradDelta()
 		{
-			size_t n = A->cols();
+			size_t n = x.size();
 
 			for (size_t i = 0; i < n; i++) 
 			{
@@ -273,6 +307,14 @@ namespace nsNNLS
 
 		void computeObjGrad()
 		{
+			if (gram != nullptr)
+			{
+				// 0.5 * |Ax - b|^2 = 0.5 * x'A'Ax - x'A'b + 0.5 * b'b
+				gradient = ((*gram) * x.matrix()).array();
+				out.obj[out.iter] = (0.5 * (x * gradient).sum()) - (x * (*atb)).sum() + (0.5 * btb);
+				gradient -= (*atb);
+				return;
+			}
 			ax = (*A) * x.matrix();
 			ax -= (*b);        // ax = ax - b
 			_T d = (ax*ax).sum();
@@ -354,13 +396,13 @@ namespace nsNNLS
 
 		_T normProjectedGradient()
 		{
-			size_t n = A->cols();
+			size_t n = x.size();
 			_T pg = 0.0;
 			size_t ctr = 0;
 			// compute the norm of the gradient for all variables not in fset
 			for (size_t i = 0; i < n; i++) 
 			{
-				if (i==fset[ctr]) 
+				if (ctr < fssize && i==fset[ctr]) 
 				{
 					ctr++; continue;
 				}
@@ -0,0 +1,211 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+/// Write / size / read latency of the analyzed h5 layout for a compression setting. Writes a synthetic
+/// rows x cols x samples spectra volume and 40 element maps through HDF5_IO, then times the reads a viewer does:
+/// one element image, single pixel spectra and one channel image across the map. Also checks the volume reads back.
+///
+/// h5_layout_bench <out.h5> [filter[:level]] [spectra_chunk_kb] [rows] [samples]
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "io/file/hdf5_io.h"
+
+// ----------------------------------------------------------------------------
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ----------------------------------------------------------------------------
+
+static void read_hyperslab(hid_t dset_id, const hsize_t* offset, const hsize_t* count, float* buffer)
+{
+    hid_t file_space = H5Dget_space(dset_id);
+    hid_t mem_space = H5Screate_simple(3, count, nullptr);
+    H5Sselect_hyperslab(file_space, H5S_SELECT_SET, offset, nullptr, count, nullptr);
+    H5Dread(dset_id, H5T_NATIVE_FLOAT, mem_space, file_space, H5P_DEFAULT, buffer);
+    H5Sclose(mem_space);
+    H5Sclose(file_space);
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: %s <out.h5> [filter[:level]] [spectra_chunk_kb] [rows] [samples]\n", argv[0]);
+        return 1;
+    }
+    const std::string filename = argv[1];
+    const std::string compression = argc > 2 ? argv[2] : "default";
+    const size_t rows = argc > 4 ? std::stoul(argv[4]) : 128;
+    const size_t cols = rows;
+    const size_t samples = argc > 5 ? std::stoul(argv[5]) : 2048;
+    const size_t num_elements = 40;
+    const int num_spectra_reads = 50;
+
+    io::file::H5_Layout_Policy policy;
+    if (argc > 2 && false == policy.parse(argv[2]))
+    {
+        printf("Could not parse compression %s\n", argv[2]);
+        return 1;
+    }
+    if (argc > 3)
+    {
+        policy.spectra_chunk_bytes = std::stoul(argv[3]) * 1024;
+    }
+    io::file::HDF5_IO::inst()->set_layout_policy(policy);
+
+    // poisson counts on two peaks that move a little across the map, close to what a scan compresses like
+    std::mt19937 rng(1);
+    data_struct::Spectra_Volume<float> volume;
+    volume.resize_and_zero(rows, cols, samples);
+    for (size_t r = 0; r < rows; r++)
+    {
+        for (size_t c = 0; c < cols; c++)
+        {
+            data_struct::Spectra<float>& spectra = volume[r][c];
+            for (size_t i = 0; i < samples; i++)
+            {
+                double mu = 5.0 + 200.0 * std::exp(-0.5 * std::pow((double(i) - 700.0 - (r % 7)) / 15.0, 2))
+                            + 50.0 * std::exp(-0.5 * std::pow((double(i) - 1200.0) / 20.0, 2)) * (c % 5);
+                spectra[i] = (float)std::poisson_distribution<int>(mu)(rng);
+            }
+            spectra.elapsed_livetime(1.0f);
+            spectra.elapsed_realtime(1.1f);
+            spectra.input_counts(1000.0f + c);
+            spectra.output_counts(900.0f + r);
+        }
+    }
+    data_struct::Fit_Count_Dict<float> counts;
+    for (size_t e = 0; e < num_elements; e++)
+    {
+        auto& map = counts[data_struct::Element_Symbols[e + 10]];
+        map.resize(rows, cols);
+        for (size_t r = 0; r < rows; r++)
+        {
+            for (size_t c = 0; c < cols; c++)
+            {
+                map(r, c) = (float)std::poisson_distribution<int>(20 + (r * c) % 50)(rng) * 0.37f;
+            }
+        }
+    }
+
+    io::file::HDF5_IO* h5 = io::file::HDF5_IO::inst();
+    if (false == h5->start_save_seq(filename, true))
+    {
+        printf("Could not create %s\n", filename.c_str());
+        return 1;
+    }
+    const double write_start = now();
+    h5->save_spectra_volume("mca_arr", &volume);
+    const double write_spectra = now();
+    h5->save_element_fits("NNLS", &counts);
+    const double write_counts = now();
+    h5->end_save_seq(false);
+    struct stat file_stat;
+    stat(filename.c_str(), &file_stat);
+
+    hid_t file_id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+
+    // element image
+    std::vector<float> image(rows * cols);
+    hid_t dset_id = H5Dopen(file_id, "/MAPS/XRF_Analyzed/NNLS/Counts_Per_Sec", H5P_DEFAULT);
+    const hsize_t image_offset[3] = { 17, 0, 0 };
+    const hsize_t image_count[3] = { 1, rows, cols };
+    const double image_start = now();
+    read_hyperslab(dset_id, image_offset, image_count, image.data());
+    const double image_end = now();
+    H5Dclose(dset_id);
+
+    // single pixel spectra, then one channel across the map
+    std::vector<float> spectra(samples);
+    dset_id = H5Dopen(file_id, "/MAPS/Spectra/mca_arr", H5P_DEFAULT);
+    const hsize_t spectra_count[3] = { samples, 1, 1 };
+    const double spectra_start = now();
+    for (int k = 0; k < num_spectra_reads; k++)
+    {
+        const hsize_t spectra_offset[3] = { 0, (hsize_t)((k * 37) % rows), (hsize_t)((k * 53) % cols) };
+        read_hyperslab(dset_id, spectra_offset, spectra_count, spectra.data());
+    }
+    const double spectra_end = now();
+    const hsize_t channel_offset[3] = { 700, 0, 0 };
+    const double channel_start = now();
+    read_hyperslab(dset_id, channel_offset, image_count, image.data());
+    const double channel_end = now();
+
+    size_t mismatches = 0;
+    std::vector<float> all(samples * rows * cols);
+    H5Dread(dset_id, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, all.data());
+    for (size_t s = 0; s < samples; s++)
+    {
+        for (size_t r = 0; r < rows; r++)
+        {
+            for (size_t c = 0; c < cols; c++)
+            {
+                if (all[(s * rows + r) * cols + c] != volume[r][c][s])
+                {
+                    mismatches++;
+                }
+            }
+        }
+    }
+    H5Dclose(dset_id);
+    H5Fclose(file_id);
+
+    printf("%-20s mca_arr %6.2fs counts %6.3fs size %7.1fMB | image %6.2fms spectrum %6.2fms channel image %7.1fms | mismatches %zu\n",
+           compression.c_str(), write_spectra - write_start, write_counts - write_spectra, file_stat.st_size / 1.0e6,
+           (image_end - image_start) * 1.0e3, (spectra_end - spectra_start) * 1.0e3 / num_spectra_reads,
+           (channel_end - channel_start) * 1.0e3, mismatches);
+    return mismatches == 0 ? 0 : 1;
+}
@@ -23,20 +23,27 @@ freely, subject to the following restrictions:
    3. This notice may not be removed or altered from any source
    distribution.
 
+Altered: the single locked task queue was replaced with per worker
+work-stealing deques and a lock-free injection list, enqueue_range added.
+
 ***/
 
 #ifndef THREAD_POOL_H
 #define THREAD_POOL_H
 
+#include <algorithm>
 #include <vector>
 #include <queue>
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <exception>
+#include <cstdint>
 
 #if defined _WIN32 || defined __CYGWIN__
 #include <Windows.h>
@@ -46,6 +53,159 @@ freely, subject to the following restrictions:
 
 //#include "task.h"
 
+namespace thread_pool_detail
+{
+
+struct Task
+{
+    std::function<void()> func;
+    Task* next = nullptr;
+};
+
+/**
+ * Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli, PPoPP 2013), with the fences folded into
+ * release / seq_cst operations on top and bottom.
+ * Only the owning worker calls push/take, any thread may call steal.
+ * Rings replaced on growth are kept until the deque is destroyed since a thief may still be reading them.
+ */
+class Work_Steal_Deque
+{
+public:
+    Work_Steal_Deque(int64_t capacity = 1024) : _top(0), _bottom(0)
+    {
+        _rings.emplace_back(new Ring(capacity));
+        _ring.store(_rings.back().get(), std::memory_order_relaxed);
+    }
+
+    Work_Steal_Deque(const Work_Steal_Deque&) = delete;
+    Work_Steal_Deque& operator=(const Work_Steal_Deque&) = delete;
+
+    void push(Task* task)
+    {
+        int64_t b = _bottom.load(std::memory_order_relaxed);
+        int64_t t = _top.load(std::memory_order_acquire);
+        Ring* r = _ring.load(std::memory_order_relaxed);
+        if (b - t > r->capacity - 1)
+        {
+            r = _grow(r, b, t);
+        }
+        r->put(b, task);
+        _bottom.store(b + 1, std::memory_order_release);
+    }
+
+    Task* take()
+    {
+        int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        Ring* r = _ring.load(std::memory_order_relaxed);
+        // seq_cst store then load keeps the thieves from reading a stale bottom
+        _bottom.store(b, std::memory_order_seq_cst);
+        int64_t t = _top.load(std::memory_order_seq_cst);
+        Task* task = nullptr;
+        if (t <= b)
+        {
+            task = r->get(b);
+            if (t == b)
+            {
+                // last item, race against thieves
+                if (false == _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    task = nullptr;
+                }
+                _bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+        {
+            _bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    Task* steal()
+    {
+        int64_t t = _top.load(std::memory_order_seq_cst);
+        int64_t b = _bottom.load(std::memory_order_seq_cst);
+        if (t < b)
+        {
+            Ring* r = _ring.load(std::memory_order_acquire);
+            Task* task = r->get(t);
+            if (_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+
+    struct Ring
+    {
+        Ring(int64_t cap) : capacity(cap), mask(cap - 1), slots(new std::atomic<Task*>[cap]) {}
+        Task* get(int64_t i) const { return slots[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, Task* task) { slots[i & mask].store(task, std::memory_order_relaxed); }
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<Task*>[]> slots;
+    };
+
+    Ring* _grow(Ring* old_ring, int64_t b, int64_t t)
+    {
+        Ring* new_ring = new Ring(old_ring->capacity * 2);
+        for (int64_t i = t; i < b; i++)
+        {
+            new_ring->put(i, old_ring->get(i));
+        }
+        _rings.emplace_back(new_ring);
+        _ring.store(new_ring, std::memory_order_release);
+        return new_ring;
+    }
+
+    std::atomic<int64_t> _top;
+    std::atomic<int64_t> _bottom;
+    std::atomic<Ring*> _ring;
+    // owned by the worker, only touched in push
+    std::vector<std::unique_ptr<Ring> > _rings;
+};
+
+// Small dense ids for threads, an id goes back to the free list when its thread exits
+class Thread_Slots
+{
+public:
+    // never deleted, thread_local destructors can run after static destruction
+    static Thread_Slots* inst() { static Thread_Slots* slots = new Thread_Slots(); return slots; }
+
+    size_t acquire()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(_free.empty())
+            return _next++;
+        size_t slot = _free.back();
+        _free.pop_back();
+        return slot;
+    }
+
+    void release(size_t slot)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.push_back(slot);
+    }
+
+private:
+    std::mutex _mutex;
+    std::vector<size_t> _free;
+    size_t _next = 0;
+};
+
+struct Thread_Slot
+{
+    Thread_Slot() : idx(Thread_Slots::inst()->acquire()) {}
+    ~Thread_Slot() { Thread_Slots::inst()->release(idx); }
+    const size_t idx;
+};
+
+} //namespace thread_pool_detail
+
 class ThreadPool {
 public:
     ThreadPool(size_t);
@@ -53,47 +213,175 @@ public:
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
 
+    // Split [begin, end) into chunks of grain items and call f(chunk_begin, chunk_end) for each.
+    // One future for the whole range, it holds the first exception thrown by any chunk.
+    template<class F>
+    std::future<void> enqueue_range(size_t begin, size_t end, size_t grain, F f);
+
     //void enqueue_task(task* t);
 
+    size_t size() const { return workers.size(); }
+
+    // Dense index of the calling thread, pool worker or not, for per thread state kept in a vector.
+    // Unique among live threads, reused once a thread exits
+    static size_t worker_slot() { thread_local thread_pool_detail::Thread_Slot slot; return slot.idx; }
+
     ~ThreadPool();
 private:
+    typedef thread_pool_detail::Task Task;
+
+    void submit(Task* first, Task* last, size_t count);
+    Task* find_task(size_t worker_idx, uint32_t& rng);
+    void worker_loop(size_t worker_idx);
+
     // need to keep track of threads so we can join them
     std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
+    // one deque per worker, the owner pushes and pops the bottom, everyone else steals the top
+    std::vector< std::unique_ptr<thread_pool_detail::Work_Steal_Deque> > deques;
+    // tasks from threads outside the pool, lock-free stack a worker takes whole
+    std::atomic<Task*> injected;
+    // tasks submitted but not yet started
+    std::atomic<size_t> pending;
 
-    // synchronization
-    std::mutex queue_mutex;
+    // only used to park idle workers
+    std::mutex sleep_mutex;
     std::condition_variable condition;
-    bool stop;
+    std::atomic<size_t> sleepers;
+    std::atomic<bool> stop;
+
+    // pool and worker index of the calling thread, nullptr if it is not a pool worker
+    static ThreadPool*& tl_pool() { thread_local ThreadPool* pool = nullptr; return pool; }
+    static size_t& tl_worker_idx() { thread_local size_t idx = 0; return idx; }
 };
 
 // the constructor just launches some amount of workers
 inline ThreadPool::ThreadPool(size_t threads)
-    :   stop(false)
+    :   injected(nullptr), pending(0), sleepers(0), stop(false)
 {
     for(size_t i = 0;i<threads;++i)
-        workers.emplace_back(
-            [this]
-            {
-                for(;;)
-                {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-
-                    task();
-                }
-            }
-        );
+        deques.emplace_back(new thread_pool_detail::Work_Steal_Deque());
+    for(size_t i = 0;i<threads;++i)
+        workers.emplace_back([this, i] { this->worker_loop(i); });
+}
+
+// hand a linked list of tasks to the pool and wake a sleeping worker
+inline void ThreadPool::submit(Task* first, Task* last, size_t count)
+{
+    if(stop.load())
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+
+    pending.fetch_add(count);
+    if(tl_pool() == this)
+    {
+        // submitted from one of our workers, keep it local so it stays cache warm
+        for(Task* t = first; t != nullptr; )
+        {
+            Task* next = t->next;
+            t->next = nullptr;
+            deques[tl_worker_idx()]->push(t);
+            t = next;
+        }
+    }
+    else
+    {
+        last->next = injected.load(std::memory_order_relaxed);
+        while(!injected.compare_exchange_weak(last->next, first, std::memory_order_release, std::memory_order_relaxed))
+            ;
+    }
+
+    if(sleepers.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        if(count > 1)
+            condition.notify_all();
+        else
+            condition.notify_one();
+    }
+}
+
+inline ThreadPool::Task* ThreadPool::find_task(size_t worker_idx, uint32_t& rng)
+{
+    Task* task = deques[worker_idx]->take();
+    if(task != nullptr)
+        return task;
+
+    // take the whole injected stack, run the oldest and make the rest stealable
+    Task* list = injected.exchange(nullptr, std::memory_order_acquire);
+    if(list != nullptr)
+    {
+        Task* reversed = nullptr;
+        while(list != nullptr)
+        {
+            Task* next = list->next;
+            list->next = reversed;
+            reversed = list;
+            list = next;
+        }
+        task = reversed;
+        reversed = reversed->next;
+        task->next = nullptr;
+        // push newest first so take() hands them back oldest first
+        std::vector<Task*> rest;
+        for(Task* t = reversed; t != nullptr; t = t->next)
+            rest.push_back(t);
+        for(auto itr = rest.rbegin(); itr != rest.rend(); ++itr)
+        {
+            (*itr)->next = nullptr;
+            deques[worker_idx]->push(*itr);
+        }
+        return task;
+    }
+
+    // steal starting at a random victim
+    const size_t num = deques.size();
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    const size_t start = rng % num;
+    for(size_t n = 0; n < num; n++)
+    {
+        size_t victim = (start + n) % num;
+        if(victim == worker_idx)
+            continue;
+        task = deques[victim]->steal();
+        if(task != nullptr)
+            return task;
+    }
+    return nullptr;
+}
+
+inline void ThreadPool::worker_loop(size_t worker_idx)
+{
+    tl_pool() = this;
+    tl_worker_idx() = worker_idx;
+    uint32_t rng = static_cast<uint32_t>(worker_idx) * 2654435761u + 1u;
+    for(;;)
+    {
+        Task* task = find_task(worker_idx, rng);
+        if(task != nullptr)
+        {
+            pending.fetch_sub(1);
+            task->func();
+            delete task;
+            continue;
+        }
+
+        if(pending.load() > 0)
+        {
+            // work exists but another worker is about to take it
+            std::this_thread::yield();
+            continue;
+        }
+
+        if(stop.load())
+            return;
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        sleepers.fetch_add(1);
+        condition.wait(lock,
+            [this]{ return this->stop.load() || this->pending.load() > 0; });
+        sleepers.fetch_sub(1);
+    }
 }
 
 // add new work item to the pool
@@ -108,16 +396,87 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
         );
 
     std::future<return_type> res = task->get_future();
+
+    Task* t = new Task();
+    t->func = [task](){ (*task)(); };
+    submit(t, t, 1);
+    return res;
+}
+
+// add a range of work items to the pool with one future for all of them
+template<class F>
+std::future<void> ThreadPool::enqueue_range(size_t begin, size_t end, size_t grain, F f)
+{
+    struct Range_State
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        std::promise<void> done;
+        std::atomic<size_t> remaining;
+        std::atomic<bool> failed;
+        std::exception_ptr error;
+        F func;
+        Range_State(size_t n, F&& fn) : remaining(n), failed(false), func(std::move(fn)) {}
+    };
 
-        // don't allow enqueueing after stopping the pool
-        if(stop)
-            throw std::runtime_error("enqueue on stopped ThreadPool");
+    if(grain < 1)
+        grain = 1;
+    const size_t num_chunks = (end > begin) ? ((end - begin) + grain - 1) / grain : 0;
+    auto state = std::make_shared<Range_State>(num_chunks, std::move(f));
+    std::future<void> res = state->done.get_future();
+    if(num_chunks == 0)
+    {
+        state->done.set_value();
+        return res;
+    }
 
-        tasks.emplace([task](){ (*task)(); });
+    Task* first = nullptr;
+    Task* last = nullptr;
+    for(size_t c = num_chunks; c > 0; c--)
+    {
+        // build the list back to front so the injected stack pops the first chunk first
+        const size_t chunk_begin = begin + ((c - 1) * grain);
+        const size_t chunk_end = std::min(chunk_begin + grain, end);
+        Task* t = new Task();
+        t->func = [state, chunk_begin, chunk_end]()
+        {
+            try
+            {
+                state->func(chunk_begin, chunk_end);
+            }
+            catch(...)
+            {
+                bool expected = false;
+                if(state->failed.compare_exchange_strong(expected, true))
+                    state->error = std::current_exception();
+            }
+            if(state->remaining.fetch_sub(1) == 1)
+            {
+                if(state->failed.load())
+                    state->done.set_exception(state->error);
+                else
+                    state->done.set_value();
+            }
+        };
+        if(last == nullptr)
+            last = t;
+        else
+            t->next = first;
+        first = t;
+    }
+    // the injected stack is LIFO, reverse so the first chunk is taken first
+    if(tl_pool() != this)
+    {
+        Task* reversed = nullptr;
+        last = first;
+        while(first != nullptr)
+        {
+            Task* next = first->next;
+            first->next = reversed;
+            reversed = first;
+            first = next;
+        }
+        first = reversed;
     }
-    condition.notify_one();
+    submit(first, last, num_chunks);
     return res;
 }
 
@@ -125,7 +484,7 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
 inline ThreadPool::~ThreadPool()
 {
     {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+        std::unique_lock<std::mutex> lock(sleep_mutex);
         stop = true;
     }
     condition.notify_all();
@@ -0,0 +1,160 @@
+/***
+Copyright (c) 2016, UChicago Argonne, LLC. All rights reserved.
+
+Copyright 2016. UChicago Argonne, LLC. This software was produced
+under U.S. Government contract DE-AC02-06CH11357 for Argonne National
+Laboratory (ANL), which is operated by UChicago Argonne, LLC for the
+U.S. Department of Energy. The U.S. Government has rights to use,
+reproduce, and distribute this software.  NEITHER THE GOVERNMENT NOR
+UChicago Argonne, LLC MAKES ANY WARRANTY, EXPRESS OR IMPLIED, OR
+ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If software is
+modified to produce derivative works, such modified software should
+be clearly marked, so as not to confuse it with the version available
+from ANL.
+
+Additionally, redistribution and use in source and binary forms, with
+or without modification, are permitted provided that the following
+conditions are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the
+      distribution.
+
+    * Neither the name of UChicago Argonne, LLC, Argonne National
+      Laboratory, ANL, the U.S. Government, nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY UChicago Argonne, LLC AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL UChicago
+Argonne, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+***/
+
+/// Checks the simd_math exp, erfc and exp * erfc kernels against libm over the arguments Gaussian_Model builds
+/// for a spectrum: channel energies 0 - 40 keV, peaks 1 - 25 keV, a spread of detector resolutions and tail gammas.
+/// Returns non zero if the max relative error goes over the limit for float or double.
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "core/simd_math.h"
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+struct Max_Error
+{
+    double rel = 0.0;
+    double at = 0.0;
+
+    void check(T_real arg, T_real value, double ref, double smallest)
+    {
+        // results under the flush threshold may be 0, nothing to compare
+        if (ref < smallest)
+        {
+            return;
+        }
+        double err = std::abs((double)value - ref) / ref;
+        if (err > rel || std::isnan(err))
+        {
+            rel = err;
+            at = arg;
+        }
+    }
+};
+
+// ----------------------------------------------------------------------------
+
+template<typename T_real>
+bool sweep(const char* type_name, double max_rel, double smallest)
+{
+    const size_t num_channels = 4096;
+    const T_real energy_slope = (T_real)0.01;
+    const std::vector<T_real> fwhm_offsets = { (T_real)0.05, (T_real)0.12, (T_real)0.3 };
+    const T_real fwhm_fanoprime = (T_real)0.00012;
+    const std::vector<T_real> gammas = { (T_real)0.5, (T_real)2.5, (T_real)10.0 };
+
+    Max_Error<T_real> exp_err, erfc_err, exp_erfc_err;
+    std::vector<T_real> delta_energy(num_channels);
+    std::vector<T_real> arg(num_channels), arg2(num_channels), out(num_channels);
+
+    for (T_real peak_E = (T_real)1.0; peak_E <= (T_real)25.0; peak_E += (T_real)0.25)
+    {
+        for (T_real fwhm_offset : fwhm_offsets)
+        {
+            // same as Gaussian_Model: sigma from the fwhm offset and the fano term at the peak energy
+            const T_real sigma = std::sqrt(std::pow(fwhm_offset / (T_real)2.3548, (T_real)2.0) + peak_E * (T_real)2.96 * fwhm_fanoprime);
+            for (size_t i = 0; i < num_channels; i++)
+            {
+                delta_energy[i] = (T_real)i * energy_slope - peak_E;
+            }
+
+            // peak
+            for (size_t i = 0; i < num_channels; i++)
+            {
+                arg[i] = (T_real)-0.5 * (delta_energy[i] / sigma) * (delta_energy[i] / sigma);
+            }
+            simd_math::exp(arg.data(), out.data(), num_channels);
+            for (size_t i = 0; i < num_channels; i++)
+            {
+                exp_err.check(arg[i], out[i], std::exp((double)arg[i]), smallest);
+            }
+
+            // step
+            for (size_t i = 0; i < num_channels; i++)
+            {
+                arg[i] = delta_energy[i] / ((T_real)M_SQRT2 * sigma);
+            }
+            simd_math::erfc(arg.data(), out.data(), num_channels);
+            for (size_t i = 0; i < num_channels; i++)
+            {
+                erfc_err.check(arg[i], out[i], std::erfc((double)arg[i]), smallest);
+            }
+
+            // tail
+            for (T_real gamma : gammas)
+            {
+                for (size_t i = 0; i < num_channels; i++)
+                {
+                    arg[i] = delta_energy[i] < (T_real)0.0 ? delta_energy[i] / (gamma * sigma) : (T_real)0.0;
+                    arg2[i] = delta_energy[i] / ((T_real)M_SQRT2 * sigma) + (T_real)1.0 / (gamma * (T_real)M_SQRT2);
+                }
+                simd_math::exp_erfc(arg.data(), arg2.data(), out.data(), num_channels);
+                for (size_t i = 0; i < num_channels; i++)
+                {
+                    exp_erfc_err.check(arg2[i], out[i], std::exp((double)arg[i]) * std::erfc((double)arg2[i]), smallest);
+                }
+            }
+        }
+    }
+
+    bool passed = exp_err.rel <= max_rel && erfc_err.rel <= max_rel && exp_erfc_err.rel <= max_rel;
+    std::printf("%-6s exp %.3g (x = %g)  erfc %.3g (z = %g)  exp_erfc %.3g (z = %g)  limit %.3g : %s\n", type_name,
+                exp_err.rel, exp_err.at, erfc_err.rel, erfc_err.at, exp_erfc_err.rel, exp_erfc_err.at, max_rel, passed ? "ok" : "FAILED");
+    return passed;
+}
+
+// ----------------------------------------------------------------------------
+
+int main()
+{
+    // the kernels flush results below 2^-1021 / 2^-124 to 0, only compare above that
+    bool passed = sweep<double>("double", 1.0e-14, std::ldexp(1.0, -1020));
+    passed = sweep<float>("float", 2.0e-6, std::ldexp(1.0, -123)) && passed;
+    return passed ? 0 : 1;
+}